@@ -0,0 +1,137 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/allocators/thread_caching_allocator.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct Malloc
+{
+  static void* allocate(size_t size) { return std::malloc(size); }
+  static void deallocate(void* ptr) { std::free(ptr); }
+};
+
+struct ThreadCaching
+{
+  static void* allocate(size_t size) { return higanbana::ThreadCachingHeap::allocate(size); }
+  static void deallocate(void* ptr) { higanbana::ThreadCachingHeap::deallocate(ptr); }
+};
+
+// Random small alloc/free mix per thread, sizes mostly below 256 bytes with an occasional bigger one.
+template <typename Alloc>
+size_t churn(int threadCount, size_t operations)
+{
+  std::atomic<size_t> checksum = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      std::minstd_rand gen(t + 1);
+      std::vector<void*> live;
+      live.reserve(1024);
+      size_t sum = 0;
+      for (size_t i = 0; i < operations; ++i)
+      {
+        if (live.size() < 1024 && (live.empty() || gen() % 2))
+        {
+          size_t size = (gen() % 64 == 0) ? 1 + gen() % 16384 : 1 + gen() % 256;
+          auto ptr = reinterpret_cast<char*>(Alloc::allocate(size));
+          ptr[0] = static_cast<char>(i);
+          live.push_back(ptr);
+        }
+        else
+        {
+          size_t index = gen() % live.size();
+          sum += *reinterpret_cast<char*>(live[index]);
+          Alloc::deallocate(live[index]);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+      for (auto ptr : live)
+        Alloc::deallocate(ptr);
+      checksum += sum;
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  return checksum;
+}
+
+// Producer allocates, the next thread frees. Exercises the remote free path.
+template <typename Alloc>
+size_t handoff(int threadCount, size_t operations)
+{
+  constexpr size_t batch = 256;
+  std::vector<std::vector<void*>> mailbox(threadCount);
+  std::vector<std::atomic<int>> full(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      int next = (t + 1) % threadCount;
+      std::vector<void*> mine;
+      for (size_t round = 0; round < operations / batch; ++round)
+      {
+        mine.clear();
+        for (size_t i = 0; i < batch; ++i)
+          mine.push_back(Alloc::allocate(16 + (i * 40) % 512));
+        // wait for our slot in the next thread's mailbox to empty
+        while (full[next].load(std::memory_order_acquire))
+          std::this_thread::yield();
+        mailbox[next].swap(mine);
+        full[next].store(1, std::memory_order_release);
+        // free what the previous thread gave us
+        while (!full[t].load(std::memory_order_acquire))
+          std::this_thread::yield();
+        for (auto ptr : mailbox[t])
+          Alloc::deallocate(ptr);
+        mailbox[t].clear();
+        full[t].store(0, std::memory_order_release);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (auto& box : mailbox)
+    for (auto ptr : box)
+      Alloc::deallocate(ptr);
+  return operations;
+}
+}
+
+TEST_CASE("Benchmark thread caching heap vs malloc", "[benchmark]") {
+  const int hwThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  constexpr size_t operations = 1000000;
+  std::vector<int> threadCounts = {1, 4};
+  if (hwThreads != 1 && hwThreads != 4)
+    threadCounts.push_back(hwThreads);
+  for (int threads : threadCounts)
+  {
+    std::string suffix = " - " + std::to_string(threads) + " threads";
+    BENCHMARK("malloc churn" + suffix) {
+      return churn<Malloc>(threads, operations);
+    };
+    BENCHMARK("thread caching churn" + suffix) {
+      return churn<ThreadCaching>(threads, operations);
+    };
+    if (threads > 1)
+    {
+      BENCHMARK("malloc cross thread free" + suffix) {
+        return handoff<Malloc>(threads, operations / 4);
+      };
+      BENCHMARK("thread caching cross thread free" + suffix) {
+        return handoff<ThreadCaching>(threads, operations / 4);
+      };
+    }
+  }
+}
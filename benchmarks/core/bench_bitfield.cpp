@@ -0,0 +1,79 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/entity/bitfield.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+const char* levelName(higanbana::bitfieldUtils::SimdLevel level)
+{
+  using higanbana::bitfieldUtils::SimdLevel;
+  switch (level)
+  {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "sse4.2";
+  }
+}
+}
+
+TEST_CASE("Benchmark bitfield kernels per simd level", "[benchmark]") {
+  using namespace higanbana;
+  using namespace higanbana::bitfieldUtils;
+  const SimdLevel best = simdLevel();
+  // 64M ids, 8MB per field so the working set doesn't fit in cache
+  constexpr size_t buckets = 512 * 1024;
+  std::mt19937_64 gen(7);
+  std::vector<DynamicBitfield> fields(6);
+  for (auto& field : fields)
+  {
+    field.reserveBuckets(buckets);
+    uint64_t* words = reinterpret_cast<uint64_t*>(field.data());
+    for (size_t i = 0; i < buckets * 2; ++i)
+      words[i] = gen() | gen(); // mostly set so that the intersection isn't trivially empty
+  }
+  DynamicBitfield out;
+  out.reserveBuckets(buckets);
+  const __m128i* sources[6];
+  for (size_t s = 0; s < fields.size(); ++s)
+    sources[s] = fields[s].data();
+
+  for (auto level : {SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512})
+  {
+    if (setSimdLevel(level) != level)
+      continue;
+    std::string name = levelName(level);
+
+    BENCHMARK("intersect 4 fields - " + name) {
+      intersect(out.data(), sources, 4, buckets);
+      return out.data()[123];
+    };
+    BENCHMARK("intersect 6 fields - " + name) {
+      intersect(out.data(), sources, 6, buckets);
+      return out.data()[123];
+    };
+    BENCHMARK("intersect 6 fields + popcount - " + name) {
+      intersect(out.data(), sources, 6, buckets);
+      return popcount(out.data(), buckets);
+    };
+    BENCHMARK("union - " + name) {
+      unite(out.data(), sources[0], sources[1], buckets);
+      return out.data()[123];
+    };
+    BENCHMARK("popcount - " + name) {
+      return popcount(sources[0], buckets);
+    };
+    BENCHMARK("empty bucket scan - " + name) {
+      setZero(out.data(), static_cast<int>(buckets));
+      return leadingEmpty(out.data(), buckets);
+    };
+    BENCHMARK("full bucket scan - " + name) {
+      setFull(out.data(), static_cast<int>(buckets));
+      return leadingFull(out.data(), buckets);
+    };
+  }
+  setSimdLevel(best);
+}
@@ -0,0 +1,82 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/entity/database.hpp>
+#include <higanbana/core/math/math.hpp>
+
+#include <random>
+#include <string>
+
+namespace
+{
+struct Position
+{
+  float4 val;
+};
+
+struct Velocity
+{
+  float4 val;
+};
+
+struct Sleeping {};
+
+void populate(higanbana::Database<2048>& db, size_t count)
+{
+  auto& pos = db.get<Position>();
+  auto& vel = db.get<Velocity>();
+  auto& sleeping = db.getTag<Sleeping>();
+  std::mt19937 gen(1337);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto e = db.createEntity();
+    pos.insert(e, Position{float4(dist(gen), dist(gen), dist(gen), 1.f)});
+    // first half is dense, later half only has every 4th entity moving
+    if (i < count / 2 || gen() % 4 == 0)
+      vel.insert(e, Velocity{float4(dist(gen), dist(gen), dist(gen), 0.f)});
+    if (gen() % 8 == 0)
+      sleeping.insert(e);
+  }
+}
+
+void integrate(higanbana::Id, Position& pos, Velocity& vel)
+{
+  using namespace higanbana;
+  pos.val = math::add(pos.val, math::mul(vel.val, 0.016f));
+  vel.val = math::mul(vel.val, 0.99f);
+}
+}
+
+TEST_CASE("Benchmark entity query serial vs parallel", "[benchmark]") {
+  using namespace higanbana;
+  css::createThreadPool();
+  for (size_t count : {100000ull, 1000000ull})
+  {
+    Database<2048> db;
+    populate(db, count);
+    auto& pos = db.get<Position>();
+    auto& vel = db.get<Velocity>();
+    std::string size = std::to_string(count / 1000) + "k";
+
+    BENCHMARK("query - " + size) {
+      query(pack(pos, vel), integrate);
+      return pos.get(0).val.x;
+    };
+    BENCHMARK("queryParallel - " + size) {
+      queryParallel(pack(pos, vel), integrate).wait();
+      return pos.get(0).val.x;
+    };
+    BENCHMARK("queryParallel 64 splits - " + size) {
+      queryParallel(pack(pos, vel), integrate, 64).wait();
+      return pos.get(0).val.x;
+    };
+    BENCHMARK("query with tag - " + size) {
+      query(pack(pos, vel), pack(db.getTag<Sleeping>()), integrate);
+      return pos.get(0).val.x;
+    };
+    BENCHMARK("queryParallel with tag - " + size) {
+      queryParallel(pack(pos, vel), pack(db.getTag<Sleeping>()), integrate).wait();
+      return pos.get(0).val.x;
+    };
+  }
+}
@@ -0,0 +1,256 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/filesystem/filesystem.hpp>
+#include <higanbana/core/filesystem/asset_archive.hpp>
+#include <higanbana/core/system/time.hpp>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace higanbana;
+
+namespace
+{
+// Synthetic asset tree, mostly small files with a few big ones like a real data directory.
+// Total size from HIGANBANA_FS_BENCH_MB, 512MB by default.
+struct AssetTree
+{
+  std::filesystem::path root;
+  size_t files = 0;
+  size_t bytes = 0;
+
+  AssetTree()
+    : root(std::filesystem::temp_directory_path() / "higanbana_bench_assets")
+  {
+    size_t targetBytes = 512ull * 1024 * 1024;
+    if (auto env = std::getenv("HIGANBANA_FS_BENCH_MB"))
+      targetBytes = std::strtoull(env, nullptr, 10) * 1024 * 1024;
+    std::filesystem::remove_all(root);
+    std::mt19937 gen(5);
+    std::vector<char> buffer(32 * 1024 * 1024);
+    for (auto& c : buffer)
+      c = static_cast<char>(gen());
+    while (bytes < targetBytes)
+    {
+      size_t size = (files % 16 == 15) ? 16 * 1024 * 1024 + gen() % (16 * 1024 * 1024) : 1024 + gen() % (256 * 1024);
+      size = std::min(size, targetBytes - bytes + 1);
+      auto dir = root / ("dir" + std::to_string(files % 32));
+      std::filesystem::create_directories(dir);
+      std::ofstream file(dir / ("asset" + std::to_string(files) + ".bin"), std::ios::binary);
+      file.write(buffer.data(), size);
+      bytes += size;
+      ++files;
+    }
+  }
+  ~AssetTree()
+  {
+    std::error_code error;
+    std::filesystem::remove_all(root, error);
+  }
+};
+
+size_t residentBytes()
+{
+#if defined(__linux__)
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * 4096;
+#else
+  return 0;
+#endif
+}
+
+// Drops the files from the page cache so the next read has to go to the disk, no-op elsewhere.
+void evictFromPageCache(const AssetTree& tree)
+{
+#if defined(__linux__)
+  for (auto&& entry : std::filesystem::recursive_directory_iterator(tree.root))
+  {
+    if (!entry.is_regular_file())
+      continue;
+    int fd = ::open(entry.path().c_str(), O_RDONLY);
+    if (fd < 0)
+      continue;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+#endif
+}
+
+// stand in for decoding, touches every cache line
+uint64_t parse(const MemoryBlob& blob)
+{
+  uint64_t sum = 0;
+  for (size_t i = 0; i < blob.size(); i += 64)
+    sum += blob.cdata()[i];
+  return sum;
+}
+
+uint64_t touchEverything(FileSystem& fs, const vector<std::string>& paths)
+{
+  uint64_t sum = 0;
+  for (auto&& path : paths)
+  {
+    auto view = fs.viewToFile(path);
+    for (size_t i = 0; i < view.size(); i += 4096)
+      sum += view[i];
+  }
+  return sum;
+}
+}
+
+TEST_CASE("Benchmark FileSystem startup and memory", "[benchmark]") {
+  AssetTree tree;
+  std::unordered_map<std::string, std::string> mappings = {{"/data", tree.root.string()}};
+  const char* modeNames[] = {"read everything", "map on demand"};
+  // mapped first so the other mode's freed heap doesn't hide in its numbers
+  for (auto mode : {FileSystem::LoadMode::MapOnDemand, FileSystem::LoadMode::ReadEverything})
+  {
+    auto rssBefore = residentBytes();
+    Timer timer;
+    FileSystem fs(mappings, mode);
+    fs.initialLoad();
+    auto startup = timer.reset();
+    auto rssStartup = residentBytes();
+    auto paths = fs.recursiveList("/data", ".bin");
+    auto sum = touchEverything(fs, paths);
+    auto touch = timer.reset();
+    auto rssTouched = residentBytes();
+    WARN(modeNames[static_cast<int>(mode)] << ": " << tree.files << " files, " << tree.bytes / (1024 * 1024) << "MB, startup "
+      << startup / 1000000.0 << "ms (+" << (rssStartup - rssBefore) / (1024 * 1024) << "MB rss), touching every page "
+      << touch / 1000000.0 << "ms (+" << (rssTouched - rssBefore) / (1024 * 1024) << "MB rss) " << sum);
+
+    auto bigFile = paths.front();
+    for (auto&& path : paths)
+      if (fs.viewToFile(path).size() > fs.viewToFile(bigFile).size())
+        bigFile = path;
+    BENCHMARK(std::string("readFile biggest asset - ") + modeNames[static_cast<int>(mode)]) {
+      return fs.readFile(bigFile).size();
+    };
+  }
+}
+
+TEST_CASE("Benchmark cold scene load - sequential vs async reads", "[benchmark]") {
+  AssetTree tree;
+  std::unordered_map<std::string, std::string> mappings = {{"/data", tree.root.string()}};
+  vector<std::string> paths;
+  {
+    FileSystem fs(mappings, FileSystem::LoadMode::MapOnDemand);
+    fs.initialLoad();
+    paths = fs.recursiveList("/data", ".bin");
+  }
+
+  // sequential: read a file, parse it, read the next one
+  evictFromPageCache(tree);
+  uint64_t sequentialSum = 0;
+  Timer timer;
+  {
+    FileSystem fs(mappings, FileSystem::LoadMode::MapOnDemand);
+    for (auto&& path : paths)
+      sequentialSum += parse(fs.readFile(path));
+  }
+  auto sequential = timer.reset();
+
+  // async: every read submitted up front, parse each as it's needed
+  evictFromPageCache(tree);
+  uint64_t asyncSum = 0;
+  timer.reset();
+  {
+    FileSystem fs(mappings, FileSystem::LoadMode::MapOnDemand);
+    auto reads = fs.readFilesAsync(paths);
+    for (auto&& read : reads)
+      asyncSum += parse(read.get());
+  }
+  auto async = timer.reset();
+  REQUIRE(sequentialSum == asyncSum);
+  WARN("cold load of " << paths.size() << " files, " << tree.bytes / (1024 * 1024) << "MB: sequential "
+    << sequential / 1000000.0 << "ms, async " << async / 1000000.0 << "ms");
+}
+
+TEST_CASE("Benchmark watched files per frame", "[benchmark]") {
+  auto root = std::filesystem::temp_directory_path() / "higanbana_bench_watch";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  for (int i = 0; i < 500; ++i)
+    std::ofstream(root / ("shader" + std::to_string(i) + ".hlsl")) << "float4 main() : SV_Target { return 0; }";
+  {
+    FileSystem fs({{"/shaders", root.string()}});
+    vector<WatchFile> watches;
+    for (int i = 0; i < 500; ++i)
+      watches.push_back(fs.watchFile("/shaders/shader" + std::to_string(i) + ".hlsl"));
+
+    BENCHMARK("updateWatchedFiles - 500 watched, nothing changed") {
+      fs.updateWatchedFiles();
+    };
+
+    Timer timer;
+    std::ofstream(root / "shader250.hlsl") << "float4 main() : SV_Target { return 1; }";
+    int frames = 0;
+    while (!watches[250].updated() && timer.timeFromLastReset() < 10'000'000'000ll)
+    {
+      fs.updateWatchedFiles();
+      ++frames;
+    }
+    WARN("change noticed after " << timer.timeFromLastReset() / 1000000.0 << "ms, " << frames << " updateWatchedFiles calls");
+  }
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Benchmark packed archive against loose files", "[benchmark]") {
+  auto root = std::filesystem::temp_directory_path() / "higanbana_bench_loose";
+  auto archivePath = std::filesystem::temp_directory_path() / "higanbana_bench_packed.hpak";
+  std::filesystem::remove_all(root);
+  std::mt19937 gen(7);
+  vector<std::string> paths;
+  AssetArchiveBuilder builder;
+  for (int i = 0; i < 5000; ++i)
+  {
+    auto relative = "/dir" + std::to_string(i % 50) + "/asset" + std::to_string(i) + ".bin";
+    std::filesystem::create_directories(root / ("dir" + std::to_string(i % 50)));
+    std::vector<uint8_t> contents(512 + gen() % 4096);
+    for (auto& byte : contents)
+      byte = static_cast<uint8_t>("shader text "[gen() % 12]);
+    std::ofstream(root.string() + relative, std::ios::binary).write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    builder.addFile(relative, root.string() + relative, i % 2 == 0);
+    paths.push_back(relative);
+  }
+  AssetArchiveBuilder::Stats stats;
+  REQUIRE(builder.write(archivePath.string().c_str(), &stats));
+  {
+    Timer timer;
+    FileSystem loose({{"/data", root.string()}}, FileSystem::LoadMode::MapOnDemand);
+    loose.initialLoad();
+    auto looseStartup = timer.reset();
+    FileSystem packed(std::unordered_map<std::string, std::string>{});
+    REQUIRE(packed.mountArchive("/data", archivePath.string()));
+    auto packedStartup = timer.reset();
+    WARN("5000 files: loose startup " << looseStartup / 1000000.0 << "ms, archive mount " << packedStartup / 1000000.0
+      << "ms, " << stats.bytes / 1024 << "KB stored as " << stats.storedBytes / 1024 << "KB");
+
+    vector<std::string> fullPaths;
+    for (auto&& path : paths)
+      fullPaths.push_back("/data" + path);
+    // warm both so only lookups are timed
+    for (auto&& path : fullPaths)
+      REQUIRE(loose.viewToFile(path).size() == packed.viewToFile(path).size());
+    size_t next = 0;
+    BENCHMARK("viewToFile - loose files") {
+      return loose.viewToFile(fullPaths[next++ % fullPaths.size()]).size();
+    };
+    BENCHMARK("viewToFile - packed archive") {
+      return packed.viewToFile(fullPaths[next++ % fullPaths.size()]).size();
+    };
+  }
+  std::filesystem::remove_all(root);
+  std::filesystem::remove(archivePath);
+}
@@ -0,0 +1,159 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/system/heap_allocator.hpp>
+
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct TraceOp
+{
+  uint32_t id;
+  uint64_t size; // 0 means free
+  uint64_t alignment;
+};
+
+struct Trace
+{
+  std::string name;
+  uint64_t heapSize;
+  uint32_t ids;
+  std::vector<TraceOp> ops;
+};
+
+// Text trace, one op per line: "a <id> <size> <alignment>" or "f <id>". First line is "heap <bytes>".
+bool loadTrace(const char* path, Trace& trace)
+{
+  std::ifstream file(path);
+  std::string op;
+  if (!(file >> op >> trace.heapSize) || op != "heap")
+    return false;
+  trace.name = path;
+  trace.ids = 0;
+  uint32_t id;
+  while (file >> op >> id)
+  {
+    TraceOp entry{id, 0, 1};
+    if (op == "a" && !(file >> entry.size >> entry.alignment))
+      return false;
+    trace.ops.push_back(entry);
+    trace.ids = std::max(trace.ids, id + 1);
+  }
+  return true;
+}
+
+// Resources of mixed lifetimes in a gpu heap, tens of thousands live at the same time.
+Trace gpuHeapTrace()
+{
+  Trace trace{"gpu heap", 4ull * 1024 * 1024 * 1024, 0, {}};
+  std::mt19937 gen(11);
+  std::vector<uint32_t> live;
+  uint32_t nextId = 0;
+  for (int i = 0; i < 400000; ++i)
+  {
+    if (live.size() < 40000 && (live.size() < 20000 || gen() % 2))
+    {
+      uint64_t size = (gen() % 64 == 0) ? 65536 * (1 + gen() % 64) : 256 * (1 + gen() % 256);
+      uint64_t alignment = size >= 65536 ? 65536 : 256;
+      trace.ops.push_back(TraceOp{nextId, size, alignment});
+      live.push_back(nextId++);
+    }
+    else
+    {
+      auto index = gen() % live.size();
+      trace.ops.push_back(TraceOp{live[index], 0, 1});
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  trace.ids = nextId;
+  return trace;
+}
+
+// Per frame upload blocks that die a few frames later, mostly in order.
+Trace uploadTrace()
+{
+  Trace trace{"upload ring", 256ull * 1024 * 1024, 0, {}};
+  std::mt19937 gen(12);
+  std::deque<std::vector<uint32_t>> frames;
+  uint32_t nextId = 0;
+  for (int frame = 0; frame < 600; ++frame)
+  {
+    frames.emplace_back();
+    for (int i = 0; i < 1000; ++i)
+    {
+      uint64_t size = (gen() % 64 == 0) ? 4096 * (1 + gen() % 64) : 16 * (1 + gen() % 256);
+      trace.ops.push_back(TraceOp{nextId, size, 256});
+      frames.back().push_back(nextId++);
+    }
+    if (frames.size() > 3)
+    {
+      for (auto id : frames.front())
+        trace.ops.push_back(TraceOp{id, 0, 1});
+      frames.pop_front();
+    }
+  }
+  trace.ids = nextId;
+  return trace;
+}
+
+struct ReplayResult
+{
+  size_t failures = 0;
+  uint64_t fragmentation = 0; // 1/1000 of free space that the largest free block can't use, at the end
+};
+
+ReplayResult replay(const Trace& trace)
+{
+  higanbana::HeapAllocator heap(trace.heapSize, 16);
+  std::vector<higanbana::RangeBlock> blocks(trace.ids);
+  ReplayResult result;
+  for (auto& op : trace.ops)
+  {
+    auto& block = blocks[op.id];
+    if (op.size == 0)
+    {
+      heap.free(block);
+      block = {};
+      continue;
+    }
+    auto allocation = heap.allocate(op.size, op.alignment);
+    if (allocation)
+      block = allocation.value();
+    else
+      ++result.failures;
+  }
+  if (heap.size() > 0)
+    result.fragmentation = 1000 - heap.findLargestAllocation() * 1000 / heap.size();
+  for (auto& block : blocks)
+    heap.free(block);
+  return result;
+}
+}
+
+TEST_CASE("Benchmark HeapAllocator trace replay", "[benchmark]") {
+  std::vector<Trace> traces;
+  traces.push_back(gpuHeapTrace());
+  traces.push_back(uploadTrace());
+  if (const char* path = std::getenv("HIGANBANA_HEAP_TRACE"))
+  {
+    Trace recorded;
+    if (loadTrace(path, recorded))
+      traces.push_back(std::move(recorded));
+  }
+
+  for (auto& trace : traces)
+  {
+    auto result = replay(trace);
+    WARN(trace.name << ": " << trace.ops.size() << " ops, " << result.failures << " failed allocations, "
+      << result.fragmentation / 10.0 << "% of free space fragmented");
+    BENCHMARK("replay " + trace.name) {
+      return replay(trace).failures;
+    };
+  }
+}
@@ -0,0 +1,257 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/system/LBS.hpp>
+#include <higanbana/core/system/WorkStealingDeque.hpp>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <string>
+
+namespace
+{
+  // The queueing scheme LBS used before: one global mutex plus a mutex per thread deque.
+  struct LockedQueues
+  {
+    std::mutex global;
+    std::vector<std::unique_ptr<std::mutex>> mutexes;
+    std::vector<std::deque<int>> deques;
+
+    LockedQueues(int threads)
+    {
+      for (int i = 0; i < threads; ++i)
+        mutexes.emplace_back(std::make_unique<std::mutex>());
+      deques.resize(threads);
+    }
+
+    void push(int thread, int value)
+    {
+      std::lock(global, *mutexes[thread]);
+      std::unique_lock<std::mutex> u1(global, std::adopt_lock);
+      std::unique_lock<std::mutex> u2(*mutexes[thread], std::adopt_lock);
+      deques[thread].push_front(value);
+    }
+
+    bool pop(int thread, int& value)
+    {
+      std::lock_guard<std::mutex> guard(*mutexes[thread]);
+      if (deques[thread].empty())
+        return false;
+      value = deques[thread].back();
+      deques[thread].pop_back();
+      return true;
+    }
+
+    bool steal(int thread, int& value)
+    {
+      std::lock_guard<std::mutex> guard(*mutexes[thread]);
+      if (deques[thread].empty())
+        return false;
+      value = deques[thread].front();
+      deques[thread].pop_front();
+      return true;
+    }
+  };
+
+  struct LockFreeQueues
+  {
+    std::vector<std::unique_ptr<higanbana::WorkStealingDeque<int>>> deques;
+
+    LockFreeQueues(int threads)
+    {
+      for (int i = 0; i < threads; ++i)
+        deques.emplace_back(std::make_unique<higanbana::WorkStealingDeque<int>>());
+    }
+
+    void push(int thread, int value)
+    {
+      deques[thread]->push(value);
+    }
+
+    bool pop(int thread, int& value)
+    {
+      return deques[thread]->pop(value);
+    }
+
+    bool steal(int thread, int& value)
+    {
+      return deques[thread]->steal(value);
+    }
+  };
+
+  // every thread pushes small tasks to its own queue and pops them, only thread 0 produces extra work so others have to steal.
+  template <typename Queues>
+  size_t contend(int threads, int tasksPerThread)
+  {
+    Queues queues(threads);
+    std::atomic<size_t> consumed = 0;
+    const size_t total = static_cast<size_t>(threads) * tasksPerThread + tasksPerThread;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+      workers.emplace_back([&, t]()
+      {
+        int value;
+        int pushes = t == 0 ? tasksPerThread * 2 : tasksPerThread;
+        for (int i = 0; i < pushes; ++i)
+        {
+          queues.push(t, i);
+          if (i % 2 == 0 && queues.pop(t, value))
+            consumed++;
+        }
+        while (consumed.load(std::memory_order_relaxed) < total)
+        {
+          if (queues.pop(t, value))
+          {
+            consumed++;
+            continue;
+          }
+          for (int o = 1; o < threads; ++o)
+          {
+            if (queues.steal((t + o) % threads, value))
+            {
+              consumed++;
+              break;
+            }
+          }
+        }
+      });
+    }
+    for (auto& it : workers)
+      it.join();
+    return consumed.load();
+  }
+}
+
+TEST_CASE("Benchmark LBS queue contention", "[benchmark]")
+{
+  const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  constexpr int tasksPerThread = 100000;
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    BENCHMARK("mutex deques - " + std::to_string(threads) + " threads")
+    {
+      return contend<LockedQueues>(threads, tasksPerThread);
+    };
+    BENCHMARK("work stealing deques - " + std::to_string(threads) + " threads")
+    {
+      return contend<LockFreeQueues>(threads, tasksPerThread);
+    };
+  }
+}
+
+TEST_CASE("Benchmark LBS small parallel fors", "[benchmark]")
+{
+  using namespace higanbana;
+  const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  constexpr size_t iterations = 1000000;
+  std::vector<unsigned> data(iterations, 1);
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    LBS lbs(threads);
+    BENCHMARK("addParallelFor<16> - " + std::to_string(threads) + " threads")
+    {
+      lbs.addParallelFor<16>("work", {}, {}, 0, iterations, [&data](size_t i)
+      {
+        data[i] = data[i] * 3 + 1;
+      });
+      lbs.sleepTillKeywords({ "work" });
+      return data[123];
+    };
+  }
+}
+
+TEST_CASE("Benchmark LBS fixed vs adaptive chunk size", "[benchmark]")
+{
+  using namespace higanbana;
+  LBS lbs;
+  constexpr size_t cheapIterations = 1000000;
+  constexpr size_t costlyIterations = 2000;
+  std::vector<unsigned> data(cheapIterations, 1);
+  auto cheap = [&data](size_t i)
+  {
+    data[i] = data[i] * 3 + 1;
+  };
+  auto costly = [&data](size_t i)
+  {
+    unsigned v = data[i];
+    for (int k = 0; k < 5000; ++k)
+      v = v * 1664525u + 1013904223u;
+    data[i] = v;
+  };
+  BENCHMARK("cheap loop - addParallelFor<16>")
+  {
+    lbs.addParallelFor<16>("work", {}, {}, 0, cheapIterations, cheap);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+  BENCHMARK("cheap loop - addParallelFor<1024>")
+  {
+    lbs.addParallelFor<1024>("work", {}, {}, 0, cheapIterations, cheap);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+  BENCHMARK("cheap loop - addParallelForAuto")
+  {
+    lbs.addParallelForAuto("work", {}, {}, 0, cheapIterations, cheap);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+  BENCHMARK("costly loop - addParallelFor<16>")
+  {
+    lbs.addParallelFor<16>("work", {}, {}, 0, costlyIterations, costly);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+  BENCHMARK("costly loop - addParallelFor<1024>")
+  {
+    lbs.addParallelFor<1024>("work", {}, {}, 0, costlyIterations, costly);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+  BENCHMARK("costly loop - addParallelForAuto")
+  {
+    lbs.addParallelForAuto("work", {}, {}, 0, costlyIterations, costly);
+    lbs.sleepTillKeywords({ "work" });
+    return data[123];
+  };
+}
+
+TEST_CASE("Benchmark LBS dependency chain", "[benchmark]")
+{
+  using namespace higanbana;
+  LBS lbs;
+  constexpr int chainLength = 1000;
+  // fulfilled requirements stay fulfilled, so every run needs its own names or later chains don't wait on anything
+  int runs = 0;
+  BENCHMARK_ADVANCED("1000 task chain")(Catch::Benchmark::Chronometer meter)
+  {
+    std::vector<std::vector<std::string>> names(meter.runs());
+    for (auto&& chain : names)
+    {
+      auto prefix = "run" + std::to_string(runs++) + "_step";
+      for (int i = 0; i < chainLength; ++i)
+        chain.push_back(prefix + std::to_string(i));
+    }
+    std::atomic<int> counter = 0;
+    meter.measure([&](int run)
+    {
+      auto& chain = names[run];
+      for (int i = chainLength - 1; i > 0; --i)
+      {
+        lbs.addTask(chain[i], { chain[i - 1] }, {}, [&counter](size_t)
+        {
+          counter++;
+        });
+      }
+      lbs.addTask(chain[0], {}, {}, [&counter](size_t)
+      {
+        counter++;
+      });
+      lbs.sleepTillKeywords(std::vector<std::string>(chain));
+      return counter.load();
+    });
+    REQUIRE(counter.load() == chainLength * meter.runs());
+  };
+}
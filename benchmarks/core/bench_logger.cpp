@@ -0,0 +1,62 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/global_debug.hpp>
+#include <higanbana/core/system/logger.hpp>
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+// 100 messages per sample, divide the time by 100 for per message cost.
+uint64_t formattedOnCaller(const std::string& name)
+{
+  char buffer[1024];
+  uint64_t sum = 0;
+  for (int i = 0; i < 100; ++i)
+    sum += snprintf(buffer, sizeof(buffer), "[Output] frame %d took %.3f ms in %s\n", i, i * 0.25f, name.c_str());
+  return sum;
+}
+
+void deferred(const std::string& name)
+{
+  for (int i = 0; i < 100; ++i)
+    HIGAN_LOG("frame %d took %.3f ms in %s\n", i, i * 0.25f, name.c_str());
+}
+
+void filtered(const std::string& name)
+{
+  for (int i = 0; i < 100; ++i)
+    HIGAN_DEBUG_LOG("frame %d took %.3f ms in %s\n", i, i * 0.25f, name.c_str());
+}
+}
+
+TEST_CASE("Benchmark logging cost on the calling thread", "[benchmark]") {
+  using namespace higanbana;
+  Logger logger;
+  size_t printed = 0;
+  log::setOutput([&](std::string_view out) { printed += out.size(); });
+  std::string name = "bench_logger";
+
+  BENCHMARK("100 messages - snprintf on the caller") {
+    return formattedOnCaller(name);
+  };
+  // flushed between samples so the queue mostly has room, Catch's iteration estimate still overflows it
+  BENCHMARK_ADVANCED("100 messages - deferred")(Catch::Benchmark::Chronometer meter) {
+    log::flush();
+    meter.measure([&] { deferred(name); });
+  };
+  // includes the log thread's formatting, on one core that's the total cost
+  BENCHMARK("100 messages - deferred and flushed") {
+    deferred(name);
+    log::flush();
+  };
+  log::setLevelEnabled(log::Level::Debug, false);
+  BENCHMARK("100 messages - filtered out") {
+    filtered(name);
+  };
+  log::setLevelEnabled(log::Level::Debug, true);
+  log::flush();
+  log::setOutput(nullptr);
+  REQUIRE(printed > 0);
+}
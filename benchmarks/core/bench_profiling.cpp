@@ -0,0 +1,62 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/profiling/profiling.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace
+{
+// 1000 brackets per sample, divide the time by 1000 for per bracket overhead.
+uint64_t brackets()
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    HIGAN_CPU_BRACKET("bench bracket");
+    sum += i;
+  }
+  return sum;
+}
+
+uint64_t transientBrackets(const std::string& name)
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    HIGAN_CPU_BRACKET(name.c_str());
+    sum += i;
+  }
+  return sum;
+}
+}
+
+TEST_CASE("Benchmark profiling bracket overhead", "[benchmark]") {
+  using namespace higanbana;
+  std::string transient = "bench transient bracket";
+  BENCHMARK("1000 brackets - profiling off") {
+    return brackets();
+  };
+  auto profiler = profiling::initializeProfiling(4);
+  profiling::enableProfiling();
+  auto path = (std::filesystem::temp_directory_path() / "higanbana_bench_profiling.htrace").string();
+  profiling::beginTraceCapture(profiler.get(), path, std::chrono::milliseconds(5));
+  BENCHMARK("1000 brackets - capturing") {
+    return brackets();
+  };
+  BENCHMARK("1000 transient name brackets - capturing") {
+    return transientBrackets(transient);
+  };
+  profiling::endTraceCapture(profiler.get());
+  profiling::enableSampling(profiler.get());
+  // a "frame" of 1000 brackets including folding them into the histograms
+  BENCHMARK("1000 brackets - sampling with frame end") {
+    auto sum = brackets();
+    profiling::endProfilingFrame(profiler.get());
+    return sum;
+  };
+  profiling::disableSampling(profiler.get());
+  profiling::disableProfiling();
+  std::remove(path.c_str());
+}
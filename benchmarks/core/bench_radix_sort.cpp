@@ -3,9 +3,63 @@
 #include <higanbana/core/profiling/profiling.hpp>
 #include <higanbana/core/sort/radix_sort.hpp>
 #include <higanbana/core/sort/radix_sort_coro.hpp>
+#include <higanbana/core/system/LBS.hpp>
 
 #include <random>
 
+namespace
+{
+// Same passes and splits as radix_sort_task_fast but on LBS, whose thread placement we control.
+template<unsigned radixBits>
+void radix_sort_lbs_fast(higanbana::LBS& lbs, higanbana::vector<unsigned>& data, unsigned taskSplit) {
+  higanbana::vector<unsigned> copy = data;
+  higanbana::vector<unsigned>* read = &data;
+  higanbana::vector<unsigned>* output = &copy;
+  const size_t dataSize = data.size();
+  const size_t splitTo = (dataSize + taskSplit) / taskSplit;
+  std::vector<unsigned> counts(taskSplit * (1 << radixBits));
+
+  for (unsigned bitOffset = 0; bitOffset < 32; bitOffset += radixBits) {
+    unsigned bitsToHandle = std::min(32u - bitOffset, radixBits);
+    unsigned mask = ((1 << bitsToHandle) - 1) << bitOffset;
+    unsigned countsSize = (1 << bitsToHandle);
+
+    lbs.addParallelFor<1>("count", {}, {}, 0, taskSplit, [&](size_t t) {
+      size_t begin = std::min(t * splitTo, dataSize);
+      size_t end = std::min(begin + splitTo, dataSize);
+      unsigned* c = counts.data() + t * countsSize;
+      std::fill(c, c + countsSize, 0u);
+      for (size_t i = begin; i < end; i++)
+        c[((*read)[i] & mask) >> bitOffset]++;
+    });
+    lbs.sleepTillKeywords({"count"});
+
+    // prefix sum
+    unsigned sum = 0;
+    for (unsigned i = 0; i < countsSize; i++) {
+      for (unsigned t = 0; t < taskSplit; t++) {
+        counts[t * countsSize + i] += sum;
+        sum = counts[t * countsSize + i];
+      }
+    }
+
+    lbs.addParallelFor<1>("write", {}, {}, 0, taskSplit, [&](size_t t) {
+      size_t begin = std::min(t * splitTo, dataSize);
+      size_t end = std::min(begin + splitTo, dataSize);
+      unsigned* c = counts.data() + t * countsSize;
+      for (size_t i = end; i > begin; i--) {
+        auto actualValue = (*read)[i-1];
+        (*output)[--c[(actualValue & mask) >> bitOffset]] = actualValue;
+      }
+    });
+    lbs.sleepTillKeywords({"write"});
+    std::swap(read, output);
+  }
+  if (read != &data)
+    std::copy(read->begin(), read->end(), data.begin());
+}
+}
+
 
 TEST_CASE("Benchmark radix sort", "[benchmark]") {
   using namespace higanbana;
@@ -83,4 +137,148 @@ TEST_CASE("Benchmark radix sort", "[benchmark]") {
     radix_sort_task_fast<11, 8>(copy).wait();
     return copy[123];
   };
-}
\ No newline at end of file
+}
+
+TEST_CASE("Benchmark radix sort 64bit", "[benchmark]") {
+  using namespace higanbana;
+  css::createThreadPool();
+  std::mt19937_64 gen64;
+  vector<uint64_t> srcKeys;
+  vector<uint64_t> drawKeys;
+  vector<uint32_t> srcValues;
+  for (size_t i = 0; i < 1000000ull; i++) {
+    srcKeys.push_back(gen64());
+    // draw sort key like, only the low 24 bits vary
+    drawKeys.push_back((0x1234ull << 48) | (gen64() & 0xffffff));
+    srcValues.push_back(static_cast<uint32_t>(i));
+  }
+  vector<uint64_t> keyScratch(srcKeys.size());
+  vector<uint32_t> valueScratch(srcValues.size());
+
+  BENCHMARK("std keys") {
+    auto copy = srcKeys;
+    std::sort(copy.begin(), copy.end());
+    return copy[123];
+  };
+  BENCHMARK("task keys 8bit - 8 Thread") {
+    auto copy = srcKeys;
+    radix_sort_task_u64<8, 8>(copy, keyScratch).wait();
+    return copy[123];
+  };
+  BENCHMARK("task keys 11bit - 8 Thread") {
+    auto copy = srcKeys;
+    radix_sort_task_u64<11, 8>(copy, keyScratch).wait();
+    return copy[123];
+  };
+  BENCHMARK("task keys 16bit - 8 Thread") {
+    auto copy = srcKeys;
+    radix_sort_task_u64<16, 8>(copy, keyScratch).wait();
+    return copy[123];
+  };
+  BENCHMARK("std pairs") {
+    vector<std::pair<uint64_t, uint32_t>> copy;
+    copy.reserve(srcKeys.size());
+    for (size_t i = 0; i < srcKeys.size(); i++) {
+      copy.emplace_back(srcKeys[i], srcValues[i]);
+    }
+    std::sort(copy.begin(), copy.end());
+    return copy[123].second;
+  };
+  BENCHMARK("task pairs 8bit - 8 Thread") {
+    auto keys = srcKeys;
+    auto values = srcValues;
+    radix_sort_task_pairs<8, 8>(keys, values, keyScratch, valueScratch).wait();
+    return values[123];
+  };
+  BENCHMARK("task draw keys pairs 8bit - 8 Thread") {
+    auto keys = drawKeys;
+    auto values = srcValues;
+    radix_sort_task_pairs<8, 8>(keys, values, keyScratch, valueScratch).wait();
+    return values[123];
+  };
+}
+
+TEST_CASE("Benchmark radix sort big inputs and key types", "[benchmark]") {
+  using namespace higanbana;
+  css::createThreadPool();
+  std::mt19937 gen32;
+  std::uniform_real_distribution<float> distances(-1000.f, 1000.f);
+  vector<unsigned> srcKeys;
+  vector<float> srcDepths;
+  vector<int32_t> srcSigned;
+  for (size_t i = 0; i < 16000000ull; i++) {
+    srcKeys.push_back(gen32());
+    srcDepths.push_back(distances(gen32));
+    srcSigned.push_back(static_cast<int32_t>(gen32()));
+  }
+  vector<unsigned> keyScratch(srcKeys.size());
+  vector<float> depthScratch(srcKeys.size());
+  vector<int32_t> signedScratch(srcKeys.size());
+
+  // 16M keys split 8 ways, both go through the write combined scatter
+  BENCHMARK("task fast - 8 Thread 16 Million") {
+    auto copy = srcKeys;
+    radix_sort_task_fast<8, 8>(copy).wait();
+    return copy[123];
+  };
+  BENCHMARK("task keys write combined - 8 Thread 16 Million") {
+    auto copy = srcKeys;
+    radix_sort_task_keys<8, 8>(copy, keyScratch).wait();
+    return copy[123];
+  };
+  BENCHMARK("std float - 16 Million") {
+    auto copy = srcDepths;
+    std::sort(copy.begin(), copy.end());
+    return copy[123];
+  };
+  BENCHMARK("task float - 8 Thread 16 Million") {
+    auto copy = srcDepths;
+    radix_sort_task_keys<8, 8>(copy, depthScratch).wait();
+    return copy[123];
+  };
+  BENCHMARK("std int32 - 16 Million") {
+    auto copy = srcSigned;
+    std::sort(copy.begin(), copy.end());
+    return copy[123];
+  };
+  BENCHMARK("task int32 - 8 Thread 16 Million") {
+    auto copy = srcSigned;
+    radix_sort_task_keys<8, 8>(copy, signedScratch).wait();
+    return copy[123];
+  };
+}
+
+TEST_CASE("Benchmark radix sort thread placement", "[benchmark]") {
+  using namespace higanbana;
+  css::createThreadPool();
+  std::mt19937 gen32;
+  vector<unsigned> srcData;
+  srcData.reserve(10000000ull);
+  for (size_t i = 0; i < 10000000ull; i++) {
+    srcData.push_back(gen32());
+  }
+  const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // coroutine pool threads aren't pinned, reference point for the LBS runs below.
+  BENCHMARK("task fast - 8 Thread 10 Million") {
+    auto copy = srcData;
+    radix_sort_task_fast<8, 8>(copy).wait();
+    return copy[123];
+  };
+  {
+    LBS lbs(threads, ThreadPlacement::Free);
+    BENCHMARK("lbs fast unpinned - " + std::to_string(threads) + " Thread 10 Million") {
+      auto copy = srcData;
+      radix_sort_lbs_fast<8>(lbs, copy, threads);
+      return copy[123];
+    };
+  }
+  {
+    LBS lbs(threads, ThreadPlacement::Pinned);
+    BENCHMARK("lbs fast pinned - " + std::to_string(threads) + " Thread 10 Million") {
+      auto copy = srcData;
+      radix_sort_lbs_fast<8>(lbs, copy, threads);
+      return copy[123];
+    };
+  }
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/core/system/RangeBlockAllocator.hpp>
+#include <higanbana/core/entity/bitfield.hpp>
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace higanbana;
+
+// Previous implementation, one bit at a time behind a mutex. Kept here as the baseline.
+class BitByBitAllocator
+{
+  DynamicBitfield m_blocks;
+  int64_t m_size = 0;
+  std::mutex m_mutex;
+public:
+  BitByBitAllocator(size_t size)
+    : m_blocks(size)
+    , m_size(size)
+  {
+    m_blocks.initFull();
+  }
+
+  FixedRangeBlock allocate(size_t blocks)
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    int64_t count = static_cast<int64_t>(blocks);
+    int64_t run = 0;
+    for (int64_t i = 0; i < m_size; ++i)
+    {
+      run = m_blocks.checkBit(i) ? run + 1 : 0;
+      if (run == count)
+      {
+        for (int64_t k = i - count + 1; k <= i; ++k)
+          m_blocks.clearBit(k);
+        return FixedRangeBlock{ i - count + 1, count };
+      }
+    }
+    return FixedRangeBlock{ -1, -1 };
+  }
+
+  void release(FixedRangeBlock range)
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (int64_t i = range.offset; i < range.offset + range.size; ++i)
+      m_blocks.setBit(i);
+  }
+};
+
+constexpr size_t HeapBlocks = 1024 * 1024;
+
+// Fills the heap to ~90% with mixed sizes and frees every third range, then times alloc/free pairs in the holes.
+template <typename Allocator>
+size_t fragmentedChurn(Allocator& allocator, std::vector<FixedRangeBlock>& live, size_t operations, int seed)
+{
+  std::mt19937 gen(seed);
+  size_t sum = 0;
+  for (size_t i = 0; i < operations; ++i)
+  {
+    auto block = allocator.allocate(1 + gen() % 200);
+    if (block.offset == -1)
+      continue;
+    sum += block.offset;
+    auto index = gen() % live.size();
+    std::swap(live[index], block);
+    allocator.release(block);
+  }
+  return sum;
+}
+
+template <typename Allocator>
+std::vector<FixedRangeBlock> fragment(Allocator& allocator)
+{
+  std::mt19937 gen(3);
+  std::vector<FixedRangeBlock> live;
+  size_t used = 0;
+  while (used < HeapBlocks * 9 / 10)
+  {
+    auto block = allocator.allocate(1 + gen() % 200);
+    if (block.offset == -1)
+      break;
+    used += block.size;
+    live.push_back(block);
+  }
+  std::vector<FixedRangeBlock> kept;
+  for (size_t i = 0; i < live.size(); ++i)
+  {
+    if (i % 3 == 0)
+      allocator.release(live[i]);
+    else
+      kept.push_back(live[i]);
+  }
+  return kept;
+}
+
+template <typename Allocator>
+size_t threadedChurn(Allocator& allocator, int threadCount, size_t operations)
+{
+  std::vector<std::thread> threads;
+  std::atomic<size_t> sum = 0;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      std::mt19937 gen(t);
+      std::vector<FixedRangeBlock> live;
+      size_t local = 0;
+      for (size_t i = 0; i < operations; ++i)
+      {
+        if (live.size() < 256 && (live.empty() || gen() % 2))
+        {
+          auto block = allocator.allocate(1 + gen() % 64);
+          if (block.offset != -1)
+          {
+            local += block.offset;
+            live.push_back(block);
+          }
+        }
+        else
+        {
+          auto index = gen() % live.size();
+          allocator.release(live[index]);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+      for (auto& block : live)
+        allocator.release(block);
+      sum += local;
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  return sum;
+}
+}
+
+TEST_CASE("Benchmark RangeBlockAllocator 1M blocks", "[benchmark]") {
+  {
+    BitByBitAllocator allocator(HeapBlocks);
+    auto live = fragment(allocator);
+    BENCHMARK("bit by bit - fragmented alloc/free") {
+      return fragmentedChurn(allocator, live, 200, 1);
+    };
+  }
+  {
+    RangeBlockAllocator allocator(HeapBlocks);
+    auto live = fragment(allocator);
+    BENCHMARK("word scan - fragmented alloc/free") {
+      return fragmentedChurn(allocator, live, 200, 1);
+    };
+  }
+  const int threadCount = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+  std::string threads = " - " + std::to_string(threadCount) + " threads";
+  {
+    BitByBitAllocator allocator(HeapBlocks);
+    BENCHMARK("bit by bit, mutex" + threads) {
+      return threadedChurn(allocator, threadCount, 2000);
+    };
+  }
+  {
+    RangeBlockAllocator allocator(HeapBlocks);
+    BENCHMARK("word scan, lock-free" + threads) {
+      return threadedChurn(allocator, threadCount, 2000);
+    };
+  }
+}
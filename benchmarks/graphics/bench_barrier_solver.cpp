@@ -0,0 +1,117 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/graphics/common/barrier_solver.hpp>
+
+#include <algorithm>
+#include <execution>
+#include <memory>
+
+using namespace higanbana;
+using namespace higanbana::backend;
+
+namespace
+{
+constexpr int BufferCount = 512;
+constexpr int TextureCount = 128;
+// views only cover one mip, like render targets of a mip chain
+constexpr int TextureMips = 10;
+
+ViewResourceHandle view(uint64_t id, ResourceType type, int mip = 0)
+{
+  ViewResourceHandle view;
+  view.resource = ResourceHandle(id, 0, type, 1, false).rawValue;
+  view.subresourceRange(mip, 1, 0, 1);
+  return view;
+}
+
+struct Frame
+{
+  HandleVector<ResourceState> buffers;
+  HandleVector<TextureResourceState> textures;
+  vector<BarrierSolver> solvers;
+
+  Frame(int lists)
+  {
+    for (int i = 0; i < TextureCount; ++i)
+    {
+      auto& tex = textures[view(i, ResourceType::Texture).resourceHandle()];
+      tex.mips = TextureMips;
+      tex.states.resize(TextureMips);
+    }
+    for (int i = 0; i < lists; ++i)
+      solvers.emplace_back(buffers, textures);
+  }
+};
+
+// same shape as firstPassBarrierSolve feeds the solver, a few resources per node
+void localPass(BarrierSolver& solver, HandleVector<ResourceState>& buffers, HandleVector<TextureResourceState>& textures, int list, int nodes)
+{
+  solver.reset(&buffers, &textures);
+  for (int i = 0; i < nodes; ++i)
+  {
+    auto draw = solver.addDrawCall();
+    int node = list * nodes + i;
+    bool write = node % 3 == 0;
+    auto usage = write ? AccessUsage::ReadWrite : AccessUsage::Read;
+    auto stage = write ? AccessStage::Compute : AccessStage::Graphics;
+    for (int k = 0; k < 4; ++k)
+      solver.addBuffer(draw, view((node * 7 + k) % BufferCount, ResourceType::Buffer), ResourceState(usage, stage, TextureLayout::General, QueueType::Graphics));
+    auto layout = write ? TextureLayout::General : TextureLayout::ShaderReadOnly;
+    solver.addTexture(draw, view(node % TextureCount, ResourceType::Texture, node % TextureMips), ResourceState(usage, stage, layout, QueueType::Graphics));
+  }
+  solver.localBarrierPass1(false);
+}
+
+void localPasses(Frame& frame, int nodes, bool parallel)
+{
+  auto lists = static_cast<int>(frame.solvers.size());
+  auto nodesPerList = nodes / lists;
+  if (parallel)
+  {
+    std::for_each(std::execution::par_unseq, std::begin(frame.solvers), std::end(frame.solvers), [&](BarrierSolver& solver) {
+      auto list = static_cast<int>(&solver - frame.solvers.data());
+      localPass(solver, frame.buffers, frame.textures, list, nodesPerList);
+    });
+  }
+  else
+  {
+    for (int list = 0; list < lists; ++list)
+      localPass(frame.solvers[list], frame.buffers, frame.textures, list, nodesPerList);
+  }
+}
+
+// order dependant
+void stitch(Frame& frame)
+{
+  for (auto&& solver : frame.solvers)
+    solver.globalBarrierPass2();
+}
+}
+
+TEST_CASE("Benchmark barrier solving for large graphs", "[benchmark]") {
+  for (int nodes : {4096, 16384})
+  {
+    Frame serial(64);
+    Frame parallel(64);
+    BENCHMARK(std::to_string(nodes) + " nodes in 64 lists, serial") {
+      localPasses(serial, nodes, false);
+      stitch(serial);
+      return serial.solvers.back().barrierInfos().size();
+    };
+    BENCHMARK(std::to_string(nodes) + " nodes in 64 lists, parallel local passes") {
+      localPasses(parallel, nodes, true);
+      stitch(parallel);
+      return parallel.solvers.back().barrierInfos().size();
+    };
+    // the serial part left on the critical path
+    BENCHMARK_ADVANCED(std::to_string(nodes) + " nodes in 64 lists, stitch only")(Catch::Benchmark::Chronometer meter) {
+      vector<std::unique_ptr<Frame>> frames;
+      for (int i = 0; i < meter.runs(); ++i)
+      {
+        frames.emplace_back(std::make_unique<Frame>(64));
+        localPasses(*frames.back(), nodes, false);
+      }
+      meter.measure([&](int i) { stitch(*frames[i]); });
+    };
+  }
+}
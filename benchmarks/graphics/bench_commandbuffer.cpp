@@ -0,0 +1,24 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/graphics/common/command_buffer.hpp>
+#include <higanbana/graphics/common/command_packets.hpp>
+
+using namespace higanbana;
+using namespace higanbana::backend;
+
+TEST_CASE("Benchmark recording 50k draws", "[benchmark]") {
+  BENCHMARK("fresh buffer every frame") {
+    CommandBuffer buffer;
+    for (uint32_t i = 0; i < 50000; ++i)
+      buffer.insert<gfxpacket::Draw>(3u, 1u, i, 0u);
+    return buffer.size();
+  };
+
+  CommandBuffer recycled;
+  BENCHMARK("recycled buffer") {
+    recycled.reset();
+    for (uint32_t i = 0; i < 50000; ++i)
+      recycled.insert<gfxpacket::Draw>(3u, 1u, i, 0u);
+    return recycled.size();
+  };
+}
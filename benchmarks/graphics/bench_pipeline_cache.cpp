@@ -0,0 +1,161 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/graphics/GraphicsCore.hpp>
+#include <higanbana/core/system/time.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace higanbana;
+
+// Run on lavapipe by leaving it as the only ICD, VK_ICD_FILENAMES=.../lvp_icd.x86_64.json
+// Needs a Vulkan device, shaders are written into a temp directory so no data directory is needed.
+
+SHADER_STRUCT(BenchConsts,
+  float value;
+);
+
+namespace
+{
+constexpr int Pipelines = 64;
+constexpr int Frames = 30;
+
+// enough math that building the pipeline is the expensive part, not just the bookkeeping around it
+const char* ShaderSource = R"(#include "bench_pipeline.if.hlsl"
+
+[RootSignature(ROOTSIG)]
+[numthreads(HIGANBANA_THREADGROUP_X, HIGANBANA_THREADGROUP_Y, HIGANBANA_THREADGROUP_Z)] // @nolint
+void main(uint id : SV_DispatchThreadID)
+{
+  float v = float(id) * constants.value;
+  [unroll] for (int i = 0; i < 64; ++i)
+    v = sin(v + i) * cos(v * 0.5f) + sqrt(abs(v));
+  output[id] = v;
+}
+)";
+
+struct BenchDirs
+{
+  std::filesystem::path root;
+  BenchDirs()
+  {
+    root = std::filesystem::temp_directory_path() / "higanbana_bench_pipelines";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "shaders");
+    std::filesystem::create_directories(root / "shader_binaries");
+    std::ofstream(root / "shaders" / "bench_pipeline.cs.hlsl") << ShaderSource;
+  }
+  ~BenchDirs()
+  {
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+  }
+  void dropPipelineCache()
+  {
+    for (auto&& entry : std::filesystem::directory_iterator(root / "shader_binaries"))
+      if (entry.path().extension() == ".pipelinecache")
+        std::filesystem::remove(entry.path());
+  }
+};
+
+struct FrameTimes
+{
+  double device = 0;
+  double firstFrame = 0;
+  double worstFrame = 0;
+};
+
+double ms(int64_t nanoseconds)
+{
+  return nanoseconds / 1000000.0;
+}
+
+FrameTimes run(GraphicsSubsystem& graphics, GpuInfo gpu, BenchDirs& dirs, PipelineCompilation mode)
+{
+  FrameTimes times;
+  gpu.pipelineCompilation = mode;
+  FileSystem fs({{"/shaders", (dirs.root / "shaders").string()}, {"/shader_binaries", (dirs.root / "shader_binaries").string()}});
+
+  Timer timer;
+  auto dev = graphics.createDevice(fs, gpu);
+  times.device = ms(timer.reset());
+
+  auto argumentsLayout = dev.createShaderArgumentsLayout(
+    ShaderArgumentsLayoutDescriptor()
+      .readWrite(ShaderResourceType::Buffer, "float", "output"));
+  // thread group size is baked into the shader, so every pipeline is its own build
+  vector<ComputePipeline> pipelines;
+  for (int i = 0; i < Pipelines; ++i)
+    pipelines.push_back(dev.createComputePipeline(
+      ComputePipelineDescriptor()
+        .setInterface(PipelineInterfaceDescriptor()
+          .constants<BenchConsts>()
+          .shaderArguments(0, argumentsLayout))
+        .setShader("/shaders/bench_pipeline")
+        .setThreadGroups(uint3(i + 1, 1, 1))));
+
+  auto output = dev.createBufferUAV(
+    ResourceDescriptor()
+      .setFormat(FormatType::Float32)
+      .setUsage(ResourceUsage::GpuRW)
+      .setElementsCount(Pipelines));
+  auto arguments = dev.createShaderArguments(
+    ShaderArgumentsDescriptor("bench pipeline output", argumentsLayout)
+      .bind("output", output));
+
+  for (int frame = 0; frame < Frames; ++frame)
+  {
+    auto graph = dev.createGraph();
+    auto node = graph.createPass("every pipeline once");
+    for (auto&& pipeline : pipelines)
+    {
+      auto binding = node.bind(pipeline);
+      BenchConsts consts{};
+      consts.value = float(frame);
+      binding.constants(consts);
+      binding.arguments(0, arguments);
+      node.dispatch(binding, uint3(1, 1, 1));
+    }
+    graph.addPass(std::move(node));
+    dev.submit(graph);
+    dev.waitGpuIdle();
+    auto frameTime = ms(timer.reset());
+    if (frame == 0)
+      times.firstFrame = frameTime;
+    else
+      times.worstFrame = std::max(times.worstFrame, frameTime);
+  }
+  return times;
+}
+}
+
+TEST_CASE("Benchmark Vulkan time to first frame with cold and warm pipeline cache", "[benchmark]") {
+  BenchDirs dirs;
+  GraphicsSubsystem graphics(GraphicsApi::Vulkan, "bench_pipeline_cache");
+  auto gpu = graphics.getVendorDevice(GraphicsApi::Vulkan);
+  WARN("device: " << gpu.name);
+
+  // spirv compiles land in shader_binaries, only pipeline builds are left for the measured runs
+  run(graphics, gpu, dirs, PipelineCompilation::WaitOnBind);
+
+  struct Case
+  {
+    const char* name;
+    PipelineCompilation mode;
+    bool warmCache;
+  };
+  for (auto&& c : {
+    Case{"wait on bind, cold cache", PipelineCompilation::WaitOnBind, false},
+    Case{"wait on bind, warm cache", PipelineCompilation::WaitOnBind, true},
+    Case{"skip until ready, cold cache", PipelineCompilation::SkipUntilReady, false},
+    Case{"skip until ready, warm cache", PipelineCompilation::SkipUntilReady, true}})
+  {
+    if (!c.warmCache)
+      dirs.dropPipelineCache();
+    auto times = run(graphics, gpu, dirs, c.mode);
+    WARN(c.name << ": " << Pipelines << " compute pipelines, device " << times.device << "ms, first frame "
+      << times.firstFrame << "ms, worst of the next " << Frames - 1 << " frames " << times.worstFrame << "ms");
+  }
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch_all.hpp>
+
+#include <higanbana/graphics/GraphicsCore.hpp>
+
+using namespace higanbana;
+
+namespace
+{
+// Every pass copies around a ring of buffers so each copy depends on the previous ones,
+// keeps the barrier solver busy without needing shaders.
+void recordAndSubmit(GpuGroup& dev, vector<Buffer>& buffers, int passes, int copiesPerPass, ThreadedSubmission threading)
+{
+  auto graph = dev.createGraph();
+  for (int i = 0; i < passes; ++i)
+  {
+    auto node = graph.createPass("copies");
+    for (int k = 0; k < copiesPerPass; ++k)
+    {
+      auto dst = (i * copiesPerPass + k) % buffers.size();
+      node.copy(buffers[dst], buffers[(dst + 1) % buffers.size()]);
+    }
+    graph.addPass(std::move(node));
+  }
+  dev.submit(graph, threading);
+  dev.waitGpuIdle();
+}
+}
+
+TEST_CASE("Benchmark frame graph submit on the Null backend", "[benchmark]") {
+  GraphicsSubsystem graphics(GraphicsApi::Null, "bench_submit");
+  FileSystem fs;
+  auto dev = graphics.createDevice(fs, graphics.getVendorDevice(GraphicsApi::Null));
+
+  vector<Buffer> buffers;
+  for (int i = 0; i < 64; ++i)
+    buffers.push_back(dev.createBuffer(ResourceDescriptor()
+      .setFormat(FormatType::Uint32)
+      .setElementsCount(1024)));
+
+  BENCHMARK("10k copies in 100 passes, sequenced") {
+    recordAndSubmit(dev, buffers, 100, 100, ThreadedSubmission::Sequenced);
+  };
+  BENCHMARK("10k copies in 100 passes, parallel") {
+    recordAndSubmit(dev, buffers, 100, 100, ThreadedSubmission::ParallelUnsequenced);
+  };
+  BENCHMARK("100k copies in 1000 passes, sequenced") {
+    recordAndSubmit(dev, buffers, 1000, 100, ThreadedSubmission::Sequenced);
+  };
+  BENCHMARK("100k copies in 1000 passes, parallel") {
+    recordAndSubmit(dev, buffers, 1000, 100, ThreadedSubmission::ParallelUnsequenced);
+  };
+}
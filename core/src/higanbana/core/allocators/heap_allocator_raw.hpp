@@ -95,7 +95,7 @@ class HeapAllocatorRaw {
 
   inline void mapping(uint64_t size, int& fl, int& sl) noexcept {
     fl = fls(size);
-    sl = ((size ^ (1 << fl)) >> (fl - sli));
+    sl = fl < static_cast<int>(sli) ? 0 : static_cast<int>((size ^ (1ull << fl)) >> (fl - sli));
     fl = first_level_index(fl);
   }
 
@@ -112,13 +112,13 @@ class HeapAllocatorRaw {
     control.flBitmap = 0;
     for (int i = min_fli; i < 64; ++i) {
       auto sizeClassIndex = first_level_index(i);
-      size_t sizeClass = 1 << i;
+      size_t sizeClass = 1ull << i;
       control.sizeclasses[sizeClassIndex] = TLSFSizeClass{sizeClass, 0, nullptr};
     }
   }
 
-  inline void remove_bit(uint64_t& value, int index) noexcept { value = value ^ (1 << index); }
-  inline void set_bit(uint64_t& value, int index) noexcept { value |= (1 << index); }
+  inline void remove_bit(uint64_t& value, int index) noexcept { value = value ^ (1ull << index); }
+  inline void set_bit(uint64_t& value, int index) noexcept { value |= (1ull << index); }
   inline bool is_bit_set(uint64_t& value, int index) noexcept { return ((value >> index) & 1U) > 0; }
 
 
@@ -150,12 +150,12 @@ class HeapAllocatorRaw {
     auto& secondLevel = control.sizeclasses[fl];
     auto candidatePtr = secondLevel.freeBlocks[sl];
     if (candidatePtr == nullptr || candidatePtr->size < size) {
-      sl = ffs(secondLevel.slBitmap);
+      // only classes above sl are guaranteed to fit, same class can hold smaller blocks.
+      sl = sl + 1 < 64 ? ffs(secondLevel.slBitmap & (~0ull << (sl + 1))) : -1;
       candidatePtr = sl >= 0 ? secondLevel.freeBlocks[sl] : nullptr;
       if (sl < 0 || candidatePtr == nullptr) { // still didn't find
         // second step, scan bitmaps for empty slots
-        // create mask to ignore first bits, could be wrong
-        uint64_t mask = ~((1 << (fl+1)) - 1);
+        uint64_t mask = fl + 1 < 64 ? ~((1ull << (fl+1)) - 1) : 0;
         auto fl2 = ffs(control.flBitmap & mask);
         if (fl2 >= 0) {
           auto& secondLevel2 = control.sizeclasses[fl2];
@@ -186,6 +186,8 @@ class HeapAllocatorRaw {
     // update the original block
     block->size = size;
     block->lastPhysicalBlock = 0; // since we splitted, we will never be last one.
+    if (!split->isLastPhysicalBlockInPool())
+      split->nextBlockHeader()->previousPhysBlock = reinterpret_cast<uintptr_t>(split);
     HIGAN_ASSERT(block->nextBlockHeader() == split, "ensure correct link with next block"); // ensure correct link with next block
     HIGAN_ASSERT(split->fetchPreviousPhysBlock() == block, "both ways correct links"); // both ways correct links
     return split;
@@ -246,6 +248,8 @@ class HeapAllocatorRaw {
         merged->size += next->size + sizeof(TLSFHeader);
       }
     }
+    if (!merged->isLastPhysicalBlockInPool())
+      merged->nextBlockHeader()->previousPhysBlock = reinterpret_cast<uintptr_t>(merged);
     return merged;
   }
 
@@ -271,10 +275,12 @@ HeapAllocatorRaw(void* heap, uintptr_t size, size_t minimumBlockSize = 16, int s
 {
   int fl, sl, fl2, sl2;
   TLSFHeader *found_block, *remaining_block;
+  // keeps every header 16 byte aligned and big enough to become a free block later
+  size = std::max((size + 15) & ~size_t(15), size_t(mbs));
   mapping(size, fl, sl); // O(1)
   found_block=search_suitable_block(size,fl,sl);// O(1)
   remove(found_block); // O(1)
-  if (found_block && found_block->size > size) {
+  if (found_block && found_block->size >= size + sizeof(TLSFHeader) + mbs) {
     HIGAN_ASSERT(found_block->freeBlock == 0, "block shouldnt be free ");
     remaining_block = split(found_block, size);
     mapping(remaining_block->size, fl2, sl2);
@@ -283,6 +289,8 @@ HeapAllocatorRaw(void* heap, uintptr_t size, size_t minimumBlockSize = 16, int s
     HIGAN_ASSERT(remaining_block->freeBlock == 1, "block should be free at this point");
   }
   HIGAN_ASSERT(found_block == nullptr || found_block->freeBlock == 0, "block should be free at this point");
+  if (found_block)
+    m_usedSize += found_block->size + sizeof(TLSFHeader);
   return found_block ? found_block->data() : nullptr;
 }
 
@@ -290,6 +298,7 @@ void free(void* block) noexcept {
   HIGAN_ASSERT(block != nullptr, "freed block should be valid");
   TLSFHeader* header = TLSFHeader::fromDataPointer(block); 
   HIGAN_ASSERT(header->size > 0, "freed block size should be bigger than 0");
+  m_usedSize -= header->size + sizeof(TLSFHeader);
   TLSFHeader* bigBlock = merge(header);
   int fl, sl;
   mapping(bigBlock->size, fl, sl);
@@ -298,6 +307,16 @@ void free(void* block) noexcept {
 
 size_t findLargestAllocation() const noexcept;
 
+// usable size of a block returned by allocate, can be bit more than was asked.
+static size_t allocationSize(void* block) noexcept {
+  return TLSFHeader::fromDataPointer(block)->size;
+}
+
+// bytes needed in front of every allocation
+static constexpr size_t headerSize() noexcept {
+  return sizeof(TLSFHeader);
+}
+
 inline size_t size() const noexcept {
   return m_heapSize - m_usedSize;
 }
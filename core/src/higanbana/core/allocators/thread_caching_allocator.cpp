@@ -0,0 +1,427 @@
+#include "higanbana/core/allocators/thread_caching_allocator.hpp"
+#include "higanbana/core/allocators/heap_allocator_raw.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+#include "higanbana/core/global_debug.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace higanbana
+{
+namespace
+{
+// Chunks are aligned to their size so the owner of any pointer is found by masking.
+constexpr size_t ChunkSize = 4 * 1024 * 1024;
+constexpr size_t PageSize = 4096;
+
+std::atomic<size_t> s_mappedBytes = 0;
+
+void* mapAligned(size_t size, size_t alignment)
+{
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  while (true)
+  {
+    // reserve big enough range to find an aligned address, release and take the aligned part. Another thread can race us to it.
+    char* probe = reinterpret_cast<char*>(VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS));
+    if (probe == nullptr)
+      return nullptr;
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(probe) + alignment - 1) & ~(alignment - 1);
+    VirtualFree(probe, 0, MEM_RELEASE);
+    void* ptr = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (ptr != nullptr)
+    {
+      s_mappedBytes += size;
+      return ptr;
+    }
+  }
+#else
+  char* raw = reinterpret_cast<char*>(mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (raw == MAP_FAILED)
+    return nullptr;
+  char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + alignment - 1) & ~(alignment - 1));
+  if (aligned > raw)
+    munmap(raw, aligned - raw);
+  size_t tail = (raw + size + alignment) - (aligned + size);
+  if (tail > 0)
+    munmap(aligned + size, tail);
+  s_mappedBytes += size;
+  return aligned;
+#endif
+}
+
+void unmap(void* ptr, size_t size)
+{
+  s_mappedBytes -= size;
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, size);
+#endif
+}
+
+// Size classes: 16 byte steps up to 128, then 4 classes per power of two up to SmallSize.
+constexpr size_t ClassCount = 8 + 4 * 8;
+
+constexpr size_t classSize(size_t sizeClass)
+{
+  if (sizeClass < 8)
+    return (sizeClass + 1) * 16;
+  size_t group = (sizeClass - 8) / 4;
+  size_t step = (sizeClass - 8) % 4;
+  size_t base = size_t(128) << group;
+  return base + (step + 1) * (base / 4);
+}
+static_assert(classSize(ClassCount - 1) == ThreadCachingHeap::SmallSize, "classes should end at SmallSize");
+
+struct ClassTable
+{
+  // indexed by (size + 15) / 16
+  std::array<uint8_t, ThreadCachingHeap::SmallSize / 16 + 1> classOf;
+  constexpr ClassTable()
+    : classOf{}
+  {
+    size_t sizeClass = 0;
+    for (size_t i = 0; i < classOf.size(); ++i)
+    {
+      while (classSize(sizeClass) < i * 16)
+        ++sizeClass;
+      classOf[i] = static_cast<uint8_t>(sizeClass);
+    }
+  }
+};
+constexpr ClassTable s_classes;
+
+inline size_t classOf(size_t size)
+{
+  return s_classes.classOf[(size + 15) / 16];
+}
+
+// Cache depth per class, about 64KB per class and at least a few entries for the big ones.
+constexpr uint32_t cacheLimit(size_t sizeClass)
+{
+  size_t count = (64 * 1024) / classSize(sizeClass);
+  return static_cast<uint32_t>(count < 4 ? 4 : (count > 256 ? 256 : count));
+}
+
+struct FreeNode
+{
+  FreeNode* next;
+};
+
+struct FreeList
+{
+  FreeNode* head = nullptr;
+  uint32_t count = 0;
+};
+
+struct Arena;
+
+enum class ChunkKind : uint32_t
+{
+  Heap,
+  Large,
+};
+
+struct alignas(64) ChunkHeader
+{
+  ChunkKind kind;
+  size_t mappedSize;
+  Arena* owner;
+  ChunkHeader* next;
+  HeapAllocatorRaw heap;
+};
+constexpr size_t ChunkHeaderSize = (sizeof(ChunkHeader) + 63) & ~size_t(63);
+
+inline ChunkHeader* chunkOf(void* ptr)
+{
+  return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~(ChunkSize - 1));
+}
+
+struct Arena
+{
+  alignas(64) std::atomic<FreeNode*> remoteFrees = nullptr;
+  // rest is only touched by the owning thread
+  alignas(64) ChunkHeader* chunks = nullptr;
+  ChunkHeader* current = nullptr;
+  Arena* nextIdle = nullptr;
+  std::array<FreeList, ClassCount> cache;
+};
+
+std::mutex s_arenaLock;
+Arena* s_idleArenas = nullptr;
+// used after a thread's arena has been released during thread exit
+Arena* s_exitArena = nullptr;
+
+ChunkHeader* mapChunk(Arena* owner)
+{
+  void* memory = mapAligned(ChunkSize, ChunkSize);
+  if (memory == nullptr)
+    return nullptr;
+  auto* chunk = new (memory) ChunkHeader{ChunkKind::Heap, ChunkSize, owner, owner->chunks, HeapAllocatorRaw(reinterpret_cast<char*>(memory) + ChunkHeaderSize, ChunkSize - ChunkHeaderSize)};
+  owner->chunks = chunk;
+  return chunk;
+}
+
+void releaseChunk(Arena* arena, ChunkHeader* chunk)
+{
+  ChunkHeader** link = &arena->chunks;
+  while (*link != chunk)
+    link = &(*link)->next;
+  *link = chunk->next;
+  if (arena->current == chunk)
+    arena->current = arena->chunks;
+  chunk->~ChunkHeader();
+  unmap(chunk, ChunkSize);
+}
+
+void drainRemote(Arena* arena);
+
+void* heapAllocate(Arena* arena, size_t size)
+{
+  if (arena->current)
+  {
+    if (void* ptr = arena->current->heap.allocate(size))
+      return ptr;
+  }
+  for (auto* chunk = arena->chunks; chunk != nullptr; chunk = chunk->next)
+  {
+    if (chunk == arena->current)
+      continue;
+    if (void* ptr = chunk->heap.allocate(size))
+    {
+      arena->current = chunk;
+      return ptr;
+    }
+  }
+  auto* chunk = mapChunk(arena);
+  if (chunk == nullptr)
+    return nullptr;
+  arena->current = chunk;
+  return chunk->heap.allocate(size);
+}
+
+void heapFree(Arena* arena, ChunkHeader* chunk, void* ptr)
+{
+  chunk->heap.free(ptr);
+  // keep the chunk we are allocating from, give others back to the os when they empty out
+  if (chunk != arena->current && chunk->heap.size_allocated() == 0)
+    releaseChunk(arena, chunk);
+}
+
+void flushClass(Arena* arena, size_t sizeClass, uint32_t keep)
+{
+  auto& list = arena->cache[sizeClass];
+  while (list.count > keep)
+  {
+    FreeNode* node = list.head;
+    list.head = node->next;
+    list.count--;
+    heapFree(arena, chunkOf(node), node);
+  }
+}
+
+void localFree(Arena* arena, ChunkHeader* chunk, void* ptr)
+{
+  size_t size = HeapAllocatorRaw::allocationSize(ptr);
+  if (size <= ThreadCachingHeap::SmallSize)
+  {
+    size_t sizeClass = classOf(size);
+    // TLSF hands out a bit bigger block when the leftover is too small to split, those skip the cache
+    if (classSize(sizeClass) == size)
+    {
+      auto& list = arena->cache[sizeClass];
+      auto* node = reinterpret_cast<FreeNode*>(ptr);
+      node->next = list.head;
+      list.head = node;
+      if (++list.count > cacheLimit(sizeClass))
+        flushClass(arena, sizeClass, cacheLimit(sizeClass) / 2);
+      return;
+    }
+  }
+  heapFree(arena, chunk, ptr);
+}
+
+void drainRemote(Arena* arena)
+{
+  FreeNode* node = arena->remoteFrees.exchange(nullptr, std::memory_order_acquire);
+  while (node != nullptr)
+  {
+    FreeNode* next = node->next;
+    localFree(arena, chunkOf(node), node);
+    node = next;
+  }
+}
+
+void remoteFree(Arena* owner, void* ptr)
+{
+  auto* node = reinterpret_cast<FreeNode*>(ptr);
+  FreeNode* head = owner->remoteFrees.load(std::memory_order_relaxed);
+  do
+  {
+    node->next = head;
+  } while (!owner->remoteFrees.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void* allocateFrom(Arena* arena, size_t size)
+{
+  if (size <= ThreadCachingHeap::SmallSize)
+  {
+    size_t sizeClass = classOf(size);
+    auto& list = arena->cache[sizeClass];
+    if (list.head == nullptr)
+    {
+      drainRemote(arena);
+      // refill half of the cache in one go
+      uint32_t batch = cacheLimit(sizeClass) / 2;
+      while (list.count < batch)
+      {
+        void* ptr = heapAllocate(arena, classSize(sizeClass));
+        if (ptr == nullptr)
+          break;
+        auto* node = reinterpret_cast<FreeNode*>(ptr);
+        node->next = list.head;
+        list.head = node;
+        list.count++;
+      }
+      if (list.head == nullptr)
+        return nullptr;
+    }
+    FreeNode* node = list.head;
+    list.head = node->next;
+    list.count--;
+    return node;
+  }
+  void* ptr = heapAllocate(arena, size);
+  if (ptr == nullptr)
+  {
+    drainRemote(arena);
+    ptr = heapAllocate(arena, size);
+  }
+  return ptr;
+}
+
+Arena* acquireArena()
+{
+  {
+    std::lock_guard<std::mutex> guard(s_arenaLock);
+    if (s_idleArenas != nullptr)
+    {
+      Arena* arena = s_idleArenas;
+      s_idleArenas = arena->nextIdle;
+      arena->nextIdle = nullptr;
+      return arena;
+    }
+  }
+  // arenas live forever, their chunks may still hold memory owned by other threads
+  void* memory = mapAligned((sizeof(Arena) + PageSize - 1) & ~(PageSize - 1), PageSize);
+  HIGAN_ASSERT(memory != nullptr, "Couldn't map memory for allocator arena.");
+  return new (memory) Arena();
+}
+
+void releaseArena(Arena* arena)
+{
+  drainRemote(arena);
+  for (size_t i = 0; i < ClassCount; ++i)
+    flushClass(arena, i, 0);
+  std::lock_guard<std::mutex> guard(s_arenaLock);
+  arena->nextIdle = s_idleArenas;
+  s_idleArenas = arena;
+}
+
+// trivially destructible so it's still readable while other thread_locals are destroyed
+thread_local bool t_exited = false;
+
+struct ThreadArena
+{
+  Arena* arena = nullptr;
+  ~ThreadArena()
+  {
+    // frees from here on go through the remote queue, allocations through the shared exit arena
+    t_exited = true;
+    if (arena)
+      releaseArena(arena);
+    arena = nullptr;
+  }
+};
+
+thread_local ThreadArena t_arena;
+
+inline Arena* threadArena()
+{
+  if (t_arena.arena == nullptr && !t_exited)
+    t_arena.arena = acquireArena();
+  return t_arena.arena;
+}
+
+void* allocateLarge(size_t size)
+{
+  size_t mapped = (ChunkHeaderSize + size + PageSize - 1) & ~(PageSize - 1);
+  void* memory = mapAligned(mapped, ChunkSize);
+  if (memory == nullptr)
+    return nullptr;
+  auto* chunk = reinterpret_cast<ChunkHeader*>(memory);
+  chunk->kind = ChunkKind::Large;
+  chunk->mappedSize = mapped;
+  chunk->owner = nullptr;
+  chunk->next = nullptr;
+  return reinterpret_cast<char*>(memory) + ChunkHeaderSize;
+}
+}
+
+void* ThreadCachingHeap::allocate(size_t size) noexcept
+{
+  if (size == 0)
+    size = 1;
+  if (size > LargeSize)
+    return allocateLarge(size);
+  if (Arena* arena = threadArena())
+    return allocateFrom(arena, size);
+  // thread is being torn down, go through a shared arena
+  std::lock_guard<std::mutex> guard(s_arenaLock);
+  if (s_exitArena == nullptr)
+  {
+    void* memory = mapAligned((sizeof(Arena) + PageSize - 1) & ~(PageSize - 1), PageSize);
+    if (memory == nullptr)
+      return nullptr;
+    s_exitArena = new (memory) Arena();
+  }
+  return allocateFrom(s_exitArena, size);
+}
+
+void ThreadCachingHeap::deallocate(void* ptr) noexcept
+{
+  if (ptr == nullptr)
+    return;
+  ChunkHeader* chunk = chunkOf(ptr);
+  if (chunk->kind == ChunkKind::Large)
+  {
+    unmap(chunk, chunk->mappedSize);
+    return;
+  }
+  Arena* arena = t_exited ? nullptr : t_arena.arena;
+  if (chunk->owner == arena)
+    localFree(arena, chunk, ptr);
+  else
+    remoteFree(chunk->owner, ptr);
+}
+
+size_t ThreadCachingHeap::allocationSize(void* ptr) noexcept
+{
+  ChunkHeader* chunk = chunkOf(ptr);
+  if (chunk->kind == ChunkKind::Large)
+    return chunk->mappedSize - ChunkHeaderSize;
+  return HeapAllocatorRaw::allocationSize(ptr);
+}
+
+size_t ThreadCachingHeap::mappedBytes() noexcept
+{
+  return s_mappedBytes.load(std::memory_order_relaxed);
+}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace higanbana
+{
+// Multi-threaded general purpose heap built from HeapAllocatorRaw.
+// Every thread owns an arena of mmapped chunks, each chunk is one TLSF heap, so allocation never takes a lock.
+// Small sizes go through per thread size class freelists that are refilled and flushed in batches.
+// Memory freed by another thread goes to the owning arena's lock-free remote free queue and is reclaimed by the owner.
+// Arenas of exited threads are adopted by new threads. Allocations above LargeSize are mapped directly.
+class ThreadCachingHeap
+{
+public:
+  static constexpr size_t Alignment = 16;
+  static constexpr size_t SmallSize = 32 * 1024;
+  static constexpr size_t LargeSize = 1024 * 1024;
+
+  // 16 byte aligned, nullptr if the os is out of memory.
+  [[nodiscard]] static void* allocate(size_t size) noexcept;
+  // from any thread, nullptr is fine.
+  static void deallocate(void* ptr) noexcept;
+  // usable bytes behind ptr, at least what was asked.
+  static size_t allocationSize(void* ptr) noexcept;
+  // bytes currently mapped from the os for all arenas and large allocations.
+  static size_t mappedBytes() noexcept;
+};
+
+// std allocator interface for ThreadCachingHeap.
+template <typename T>
+class ThreadCachingAllocator
+{
+  static_assert(alignof(T) <= ThreadCachingHeap::Alignment, "ThreadCachingHeap only aligns to 16 bytes.");
+public:
+  using value_type = T;
+
+  ThreadCachingAllocator() noexcept = default;
+  template <typename U>
+  ThreadCachingAllocator(const ThreadCachingAllocator<U>&) noexcept {}
+
+  [[nodiscard]] T* allocate(size_t count)
+  {
+    void* ptr = ThreadCachingHeap::allocate(count * sizeof(T));
+    if (ptr == nullptr)
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, size_t) noexcept
+  {
+    ThreadCachingHeap::deallocate(ptr);
+  }
+
+  template <typename U>
+  bool operator==(const ThreadCachingAllocator<U>&) const noexcept { return true; }
+  template <typename U>
+  bool operator!=(const ThreadCachingAllocator<U>&) const noexcept { return false; }
+};
+}
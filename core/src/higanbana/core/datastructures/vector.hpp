@@ -1,8 +1,17 @@
 #pragma once
 #include <vector>
+#if defined(HIGANBANA_THREAD_CACHING_VECTOR)
+#include "higanbana/core/allocators/thread_caching_allocator.hpp"
+#endif
 
 namespace higanbana
 {
+#if defined(HIGANBANA_THREAD_CACHING_VECTOR)
+  // Opt in for now, parts of the tree still pass std::vector where higanbana::vector is expected.
+  template <typename type>
+  using vector = std::vector<type, ThreadCachingAllocator<type>>;
+#else
   template <typename type>
   using vector = std::vector<type>;
-}
\ No newline at end of file
+#endif
+}
@@ -1,4 +1,8 @@
 #include "higanbana/core/entity/bitfield.hpp"
+#include "higanbana/core/system/cpu_features.hpp"
+#include <immintrin.h>
+#include <atomic>
+#include "higanbana/core/global_debug.hpp"
 
 
 
@@ -21,6 +25,340 @@
           _mm_store_si128(data + i, _mm_sub_epi64(_mm_set_epi64x(0LL, 0LL), _mm_set_epi64x(1LL, 1LL)));
         }
       }
+
+      namespace
+      {
+        inline void intersect_tail(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t i, size_t count)
+        {
+          for (; i < count; ++i)
+          {
+            __m128i v = _mm_load_si128(sources[0] + i);
+            for (size_t s = 1; s < sourceCount; ++s)
+            {
+              v = _mm_and_si128(v, _mm_load_si128(sources[s] + i));
+            }
+            _mm_store_si128(dst + i, v);
+          }
+        }
+
+        // SSE4.2 baseline, everything else falls back here for the tails.
+        void intersect_sse(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t count)
+        {
+          size_t i = 0;
+          for (; i + 4 <= count; i += 4)
+          {
+            __m128i v0 = _mm_load_si128(sources[0] + i);
+            __m128i v1 = _mm_load_si128(sources[0] + i + 1);
+            __m128i v2 = _mm_load_si128(sources[0] + i + 2);
+            __m128i v3 = _mm_load_si128(sources[0] + i + 3);
+            for (size_t s = 1; s < sourceCount; ++s)
+            {
+              v0 = _mm_and_si128(v0, _mm_load_si128(sources[s] + i));
+              v1 = _mm_and_si128(v1, _mm_load_si128(sources[s] + i + 1));
+              v2 = _mm_and_si128(v2, _mm_load_si128(sources[s] + i + 2));
+              v3 = _mm_and_si128(v3, _mm_load_si128(sources[s] + i + 3));
+            }
+            _mm_store_si128(dst + i, v0);
+            _mm_store_si128(dst + i + 1, v1);
+            _mm_store_si128(dst + i + 2, v2);
+            _mm_store_si128(dst + i + 3, v3);
+          }
+          intersect_tail(dst, sources, sourceCount, i, count);
+        }
+
+        void unite_sse(__m128i* dst, const __m128i* a, const __m128i* b, size_t count)
+        {
+          for (size_t i = 0; i < count; ++i)
+          {
+            _mm_store_si128(dst + i, _mm_or_si128(_mm_load_si128(a + i), _mm_load_si128(b + i)));
+          }
+        }
+
+        size_t popcount_sse(const __m128i* data, size_t count)
+        {
+          const uint64_t* words = reinterpret_cast<const uint64_t*>(data);
+          size_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+          size_t i = 0;
+          for (; i + 2 <= count; i += 2)
+          {
+            sum0 += _mm_popcnt_u64(words[i * 2]);
+            sum1 += _mm_popcnt_u64(words[i * 2 + 1]);
+            sum2 += _mm_popcnt_u64(words[i * 2 + 2]);
+            sum3 += _mm_popcnt_u64(words[i * 2 + 3]);
+          }
+          for (; i < count; ++i)
+          {
+            sum0 += _mm_popcnt_u64(words[i * 2]) + _mm_popcnt_u64(words[i * 2 + 1]);
+          }
+          return sum0 + sum1 + sum2 + sum3;
+        }
+
+        size_t leadingFull_sse(const __m128i* data, size_t count)
+        {
+          size_t i = 0;
+          while (i < count && _mm_test_all_ones(_mm_load_si128(data + i)))
+          {
+            ++i;
+          }
+          return i;
+        }
+
+        size_t leadingEmpty_sse(const __m128i* data, size_t count)
+        {
+          size_t i = 0;
+          while (i < count && _mm_testz_si128(_mm_load_si128(data + i), _mm_load_si128(data + i)))
+          {
+            ++i;
+          }
+          return i;
+        }
+
+        // 256 bit versions, two buckets per register. Bitfield storage is only 16 byte aligned.
+        HIGAN_TARGET_AVX2 void intersect_avx2(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t count)
+        {
+          size_t i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            const __m256i* src = reinterpret_cast<const __m256i*>(sources[0] + i);
+            __m256i v0 = _mm256_loadu_si256(src);
+            __m256i v1 = _mm256_loadu_si256(src + 1);
+            __m256i v2 = _mm256_loadu_si256(src + 2);
+            __m256i v3 = _mm256_loadu_si256(src + 3);
+            for (size_t s = 1; s < sourceCount; ++s)
+            {
+              src = reinterpret_cast<const __m256i*>(sources[s] + i);
+              v0 = _mm256_and_si256(v0, _mm256_loadu_si256(src));
+              v1 = _mm256_and_si256(v1, _mm256_loadu_si256(src + 1));
+              v2 = _mm256_and_si256(v2, _mm256_loadu_si256(src + 2));
+              v3 = _mm256_and_si256(v3, _mm256_loadu_si256(src + 3));
+            }
+            __m256i* out = reinterpret_cast<__m256i*>(dst + i);
+            _mm256_storeu_si256(out, v0);
+            _mm256_storeu_si256(out + 1, v1);
+            _mm256_storeu_si256(out + 2, v2);
+            _mm256_storeu_si256(out + 3, v3);
+          }
+          intersect_tail(dst, sources, sourceCount, i, count);
+        }
+
+        HIGAN_TARGET_AVX2 void unite_avx2(__m128i* dst, const __m128i* a, const __m128i* b, size_t count)
+        {
+          size_t i = 0;
+          for (; i + 2 <= count; i += 2)
+          {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(va, vb));
+          }
+          unite_sse(dst + i, a + i, b + i, count - i);
+        }
+
+        // nibble lookup popcount (Mula), byte counts summed with sad.
+        HIGAN_TARGET_AVX2 size_t popcount_avx2(const __m128i* data, size_t count)
+        {
+          const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+          const __m256i low = _mm256_set1_epi8(0x0f);
+          __m256i acc0 = _mm256_setzero_si256();
+          __m256i acc1 = _mm256_setzero_si256();
+          size_t i = 0;
+          for (; i + 4 <= count; i += 4)
+          {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+            __m256i c0 = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v0, low)),
+                                         _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v0, 4), low)));
+            __m256i c1 = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v1, low)),
+                                         _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v1, 4), low)));
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(c0, _mm256_setzero_si256()));
+            acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(c1, _mm256_setzero_si256()));
+          }
+          __m256i acc = _mm256_add_epi64(acc0, acc1);
+          size_t sum = static_cast<size_t>(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+                                         + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+          return sum + popcount_sse(data + i, count - i);
+        }
+
+        HIGAN_TARGET_AVX2 size_t leadingFull_avx2(const __m128i* data, size_t count)
+        {
+          const __m256i ones = _mm256_set1_epi32(-1);
+          size_t i = 0;
+          while (i + 2 <= count && _mm256_testc_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), ones))
+          {
+            i += 2;
+          }
+          return i + leadingFull_sse(data + i, count - i);
+        }
+
+        HIGAN_TARGET_AVX2 size_t leadingEmpty_avx2(const __m128i* data, size_t count)
+        {
+          size_t i = 0;
+          while (i + 2 <= count)
+          {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            if (!_mm256_testz_si256(v, v))
+              break;
+            i += 2;
+          }
+          return i + leadingEmpty_sse(data + i, count - i);
+        }
+
+        // 512 bit versions, four buckets per register. Needs vpopcntdq for the popcount.
+        HIGAN_TARGET_AVX512 void intersect_avx512(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t count)
+        {
+          size_t i = 0;
+          for (; i + 16 <= count; i += 16)
+          {
+            const __m512i* src = reinterpret_cast<const __m512i*>(sources[0] + i);
+            __m512i v0 = _mm512_loadu_si512(src);
+            __m512i v1 = _mm512_loadu_si512(src + 1);
+            __m512i v2 = _mm512_loadu_si512(src + 2);
+            __m512i v3 = _mm512_loadu_si512(src + 3);
+            for (size_t s = 1; s < sourceCount; ++s)
+            {
+              src = reinterpret_cast<const __m512i*>(sources[s] + i);
+              v0 = _mm512_and_si512(v0, _mm512_loadu_si512(src));
+              v1 = _mm512_and_si512(v1, _mm512_loadu_si512(src + 1));
+              v2 = _mm512_and_si512(v2, _mm512_loadu_si512(src + 2));
+              v3 = _mm512_and_si512(v3, _mm512_loadu_si512(src + 3));
+            }
+            __m512i* out = reinterpret_cast<__m512i*>(dst + i);
+            _mm512_storeu_si512(out, v0);
+            _mm512_storeu_si512(out + 1, v1);
+            _mm512_storeu_si512(out + 2, v2);
+            _mm512_storeu_si512(out + 3, v3);
+          }
+          intersect_tail(dst, sources, sourceCount, i, count);
+        }
+
+        HIGAN_TARGET_AVX512 void unite_avx512(__m128i* dst, const __m128i* a, const __m128i* b, size_t count)
+        {
+          size_t i = 0;
+          for (; i + 4 <= count; i += 4)
+          {
+            __m512i va = _mm512_loadu_si512(a + i);
+            __m512i vb = _mm512_loadu_si512(b + i);
+            _mm512_storeu_si512(dst + i, _mm512_or_si512(va, vb));
+          }
+          unite_sse(dst + i, a + i, b + i, count - i);
+        }
+
+        HIGAN_TARGET_AVX512 size_t popcount_avx512(const __m128i* data, size_t count)
+        {
+          __m512i acc0 = _mm512_setzero_si512();
+          __m512i acc1 = _mm512_setzero_si512();
+          size_t i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i)));
+            acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i + 4)));
+          }
+          size_t sum = static_cast<size_t>(_mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1)));
+          return sum + popcount_sse(data + i, count - i);
+        }
+
+        HIGAN_TARGET_AVX512 size_t leadingFull_avx512(const __m128i* data, size_t count)
+        {
+          const __m512i ones = _mm512_set1_epi32(-1);
+          size_t i = 0;
+          while (i + 4 <= count && _mm512_cmpneq_epi64_mask(_mm512_loadu_si512(data + i), ones) == 0)
+          {
+            i += 4;
+          }
+          return i + leadingFull_sse(data + i, count - i);
+        }
+
+        HIGAN_TARGET_AVX512 size_t leadingEmpty_avx512(const __m128i* data, size_t count)
+        {
+          size_t i = 0;
+          while (i + 4 <= count)
+          {
+            __m512i v = _mm512_loadu_si512(data + i);
+            if (_mm512_test_epi64_mask(v, v) != 0)
+              break;
+            i += 4;
+          }
+          return i + leadingEmpty_sse(data + i, count - i);
+        }
+
+        struct Kernels
+        {
+          SimdLevel level;
+          void (*intersect)(__m128i*, const __m128i* const*, size_t, size_t);
+          void (*unite)(__m128i*, const __m128i*, const __m128i*, size_t);
+          size_t (*popcount)(const __m128i*, size_t);
+          size_t (*leadingFull)(const __m128i*, size_t);
+          size_t (*leadingEmpty)(const __m128i*, size_t);
+        };
+
+        const Kernels s_levels[] = {
+          {SimdLevel::SSE42, intersect_sse, unite_sse, popcount_sse, leadingFull_sse, leadingEmpty_sse},
+          {SimdLevel::AVX2, intersect_avx2, unite_avx2, popcount_avx2, leadingFull_avx2, leadingEmpty_avx2},
+          {SimdLevel::AVX512, intersect_avx512, unite_avx512, popcount_avx512, leadingFull_avx512, leadingEmpty_avx512},
+        };
+
+        SimdLevel bestLevel()
+        {
+          auto& f = cpuFeatures();
+          if (f.avx512f && f.avx512bw && f.avx512vl && f.avx512vpopcntdq)
+            return SimdLevel::AVX512;
+          if (f.avx2)
+            return SimdLevel::AVX2;
+          return SimdLevel::SSE42;
+        }
+
+        std::atomic<const Kernels*> s_kernels = nullptr;
+
+        inline const Kernels& kernels()
+        {
+          const Kernels* k = s_kernels.load(std::memory_order_relaxed);
+          if (!k)
+          {
+            k = &s_levels[static_cast<int>(bestLevel())];
+            s_kernels.store(k, std::memory_order_relaxed);
+          }
+          return *k;
+        }
+      }
+
+      SimdLevel simdLevel()
+      {
+        return kernels().level;
+      }
+
+      SimdLevel setSimdLevel(SimdLevel level)
+      {
+        level = std::min(level, bestLevel());
+        s_kernels.store(&s_levels[static_cast<int>(level)], std::memory_order_relaxed);
+        return level;
+      }
+
+      void intersect(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t count)
+      {
+        HIGAN_ASSERT(sourceCount > 0, "nothing to intersect.");
+        kernels().intersect(dst, sources, sourceCount, count);
+      }
+
+      void unite(__m128i* dst, const __m128i* a, const __m128i* b, size_t count)
+      {
+        kernels().unite(dst, a, b, count);
+      }
+
+      size_t popcount(const __m128i* data, size_t count)
+      {
+        return kernels().popcount(data, count);
+      }
+
+      size_t leadingFull(const __m128i* data, size_t count)
+      {
+        return kernels().leadingFull(data, count);
+      }
+
+      size_t leadingEmpty(const __m128i* data, size_t count)
+      {
+        return kernels().leadingEmpty(data, count);
+      }
     }
 
     namespace bitOps
@@ -3,6 +3,8 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <emmintrin.h>
 #include <smmintrin.h>
 #include <tmmintrin.h>
@@ -33,6 +35,26 @@ namespace higanbana
     void setZero(__m128i* data, int count);
     void setFull(__m128i* data, int count);
 
+    // Bulk kernels over 128 bit buckets, 256/512 bit versions are picked from cpuFeatures() on first use.
+    enum class SimdLevel
+    {
+      SSE42,
+      AVX2,
+      AVX512
+    };
+    SimdLevel simdLevel();
+    // For benchmarks and tests, clamped to what the cpu supports. Don't call while kernels are running.
+    SimdLevel setSimdLevel(SimdLevel level);
+
+    // dst = AND of all sources in one pass, dst may be one of the sources.
+    void intersect(__m128i* dst, const __m128i* const* sources, size_t sourceCount, size_t count);
+    // dst = a | b, dst may be a or b.
+    void unite(__m128i* dst, const __m128i* a, const __m128i* b, size_t count);
+    size_t popcount(const __m128i* data, size_t count);
+    // amount of full/empty buckets from the start of data
+    size_t leadingFull(const __m128i* data, size_t count);
+    size_t leadingEmpty(const __m128i* data, size_t count);
+
     template <size_t rsize>
     std::array<__m128i, rsize> init()
     {
@@ -119,19 +141,15 @@ namespace higanbana
 
     inline size_t nextPopBucket(size_t index) const
     {
-      while (index < rsize && bitOps::popcount(m_table[index]) == 0)
-      {
-        ++index;
-      }
-      return index;
+      if (index >= rsize || !_mm_testz_si128(m_table[index], m_table[index]))
+        return index;
+      return index + bitfieldUtils::leadingEmpty(m_table.data() + index, rsize - index);
     }
 
     inline int64_t nextBucketWithRoom(size_t index) const
     {
-      while (index < rsize && bitOps::popcount(m_table[index]) == 128)
-      {
-        ++index;
-      }
+      if (index < rsize)
+        index += bitfieldUtils::leadingFull(m_table.data() + index, rsize - index);
       if (index >= rsize)
         return -1;
       return index;
@@ -317,23 +335,14 @@ namespace higanbana
     }
     size_t countElements() const
     {
-      size_t res = 0;
-      for (size_t i = 0; i < rsize; ++i)
-      {
-        res += bitOps::popcount(m_table[i]);
-      }
-      return res;
+      return bitfieldUtils::popcount(m_table.data(), rsize);
     }
 
     inline size_t contiguous_full_buckets(size_t index) const
     {
-      size_t count = 0;
-      while (index < rsize && bitOps::popcount(m_table[index]) == 128)
-      {
-        ++count;
-        ++index;
-      }
-      return count;
+      if (index >= rsize || !_mm_test_all_ones(m_table[index]))
+        return 0;
+      return bitfieldUtils::leadingFull(m_table.data() + index, rsize - index);
     }
 
     inline size_t popcount_element(size_t index) const
@@ -481,13 +490,10 @@ namespace higanbana
       auto maxSize = std::max(m_pages, other.m_pages);
       auto interSize = std::min(m_pages, other.m_pages);
       //DynamicBitfield result(maxSize * BitCount);
-      const __m128i* vec0 = data();
-      const __m128i* vec1 = other.data();
+      const __m128i* sources[2] = {data(), other.data()};
       __m128i* p = data();
-      for (size_t i = 0; i < interSize; ++i)
-      {
-        _mm_store_si128(p+i,_mm_and_si128(vec0[i], vec1[i]));
-      }
+      if (interSize > 0)
+        bitfieldUtils::intersect(p, sources, 2, interSize);
       if (m_pages > other.m_pages)
       {
         for (size_t i = interSize; i < maxSize; ++i)
@@ -502,13 +508,9 @@ namespace higanbana
       auto maxSize = std::max(m_pages, other.m_pages);
       auto interSize = std::min(m_pages, other.m_pages);
       DynamicBitfield result(maxSize * BitCount);
-      const __m128i* vec0 = data();
-      const __m128i* vec1 = other.data();
-      __m128i* p = reinterpret_cast<__m128i*>(result.data());
-      for (size_t i = 0; i < interSize; ++i)
-      {
-        _mm_store_si128(p+i,_mm_and_si128(vec0[i], vec1[i]));
-      }
+      const __m128i* sources[2] = {data(), other.data()};
+      if (interSize > 0)
+        bitfieldUtils::intersect(result.data(), sources, 2, interSize);
       return result;
     }
 
@@ -553,13 +555,7 @@ namespace higanbana
       if (other.m_pages > m_pages)
         growTo(other.m_pages-1);
       auto unionSize = std::min(m_pages, other.m_pages);
-      const __m128i* vec0 = data();
-      const __m128i* vec1 = other.data();
-      __m128i* p = data();
-      for (size_t i = 0; i < unionSize; ++i)
-      {
-        _mm_store_si128(p+i,_mm_or_si128(vec0[i], vec1[i]));
-      }
+      bitfieldUtils::unite(data(), data(), other.data(), unionSize);
     }
 
     inline DynamicBitfield unionFields(const DynamicBitfield& other)
@@ -587,12 +583,91 @@ namespace higanbana
 
     inline size_t setBits() const
     {
-      size_t res = 0;
-      for (size_t i = 0; i < m_pages; ++i)
+      return bitfieldUtils::popcount(m_data.data(), m_pages);
+    }
+
+    // amount of 128 bit buckets, same as Bitfield::size()
+    inline size_t buckets() const
+    {
+      return m_pages;
+    }
+
+    // grows to hold at least bucketCount buckets, new buckets are empty
+    inline void reserveBuckets(size_t bucketCount)
+    {
+      if (bucketCount > 0)
+        growTo(bucketCount - 1);
+    }
+
+    inline size_t popcount_element(size_t index) const
+    {
+      return bitOps::popcount(m_data[index]);
+    }
+
+    // first bucket check is inline, the common case in query loops is a populated/partial bucket.
+    inline size_t nextPopBucket(size_t index) const
+    {
+      if (index >= m_pages || !_mm_testz_si128(m_data[index], m_data[index]))
+        return index;
+      return index + bitfieldUtils::leadingEmpty(m_data.data() + index, m_pages - index);
+    }
+
+    inline size_t contiguous_full_buckets(size_t index) const
+    {
+      if (index >= m_pages || !_mm_test_all_ones(m_data[index]))
+        return 0;
+      return bitfieldUtils::leadingFull(m_data.data() + index, m_pages - index);
+    }
+
+    template<size_t TableSize>
+    inline size_t skip_find_indexes(std::array<size_t, TableSize>& table, size_t table_size, size_t index) const
+    {
+      uint64_t a = _mm_extract_epi64(m_data[index], 0);
+      uint64_t b = _mm_extract_epi64(m_data[index], 1);
+      size_t offset = index * BitCount;
+      size_t idx = table_size;
+      while (a)
       {
-        res += bitOps::popcount(m_data[i]);
+        table[idx++] = calcCtzll(a) + offset;
+        a &= a - 1;
       }
-      return res;
+      while (b)
+      {
+        table[idx++] = calcCtzll(b) + 64 + offset;
+        b &= b - 1;
+      }
+      return idx;
+    }
+
+    // first index at or after start that isn't set, can be size() or past it when everything is taken.
+    inline size_t findFirstClearBit(size_t start) const
+    {
+      size_t dataIndex = start / BitCount;
+      while (dataIndex < m_pages)
+      {
+        uint64_t a = ~static_cast<uint64_t>(_mm_extract_epi64(m_data[dataIndex], 0));
+        uint64_t b = ~static_cast<uint64_t>(_mm_extract_epi64(m_data[dataIndex], 1));
+        size_t base = dataIndex * BitCount;
+        if (start > base)
+        {
+          size_t skip = start - base;
+          if (skip >= 64)
+          {
+            a = 0;
+            b &= ~0ull << (skip - 64);
+          }
+          else
+          {
+            a &= ~0ull << skip;
+          }
+        }
+        if (a)
+          return base + calcCtzll(a);
+        if (b)
+          return base + 64 + calcCtzll(b);
+        ++dataIndex;
+      }
+      return std::max(start, m_pages * BitCount);
     }
 
     int findFirstSetBit(int index) const
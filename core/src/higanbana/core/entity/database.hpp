@@ -14,6 +14,7 @@
 #include <unordered_set>
 #include <cassert>
 #include <string>
+#include <algorithm>
 namespace higanbana
 {
   template <typename T>
@@ -32,42 +33,32 @@ namespace higanbana
 
 
   // COuNTER ACTION RISING!
+  // INDEX_TABLE/MAXELEMENTS are only a sizing hint for the entity table, ids are not capped.
+  // Component storage grows page by page as ids get written.
   template<size_t INDEX_TABLE, size_t MAXELEMENTS = INDEX_TABLE*128>
   class Database
   {
     template <typename T>
-    using SparseTable = _SparseTable<T, MAXELEMENTS, INDEX_TABLE>;
+    using SparseTable = _SparseTable<T>;
     template <typename T>
-    using TagTable = _TagTable<T, INDEX_TABLE>;
-    using Indexfield = Bitfield<INDEX_TABLE>;
+    using TagTable = _TagTable<T>;
 
     // data
     std::unordered_map<std::string, std::shared_ptr<void>> m_components;
     std::unordered_map<std::string, std::shared_ptr<void>> m_tags;
-    std::vector<Indexfield*> m_indextables;
-    Indexfield m_entities;
+    std::vector<DynamicBitfield*> m_indextables;
+    DynamicBitfield m_entities;
 
-    // random
-    //std::mt19937 m_eng;
-    uint64_t m_nextId;
+    // every id below this has been taken at some point, keeps the id space dense so pages stay full.
+    uint64_t m_nextId = 0;
 
     inline Id nextUniqueIndex()
     {
-      //Id id(m_eng() % MAXELEMENTS);
-      Id id((m_nextId++) % MAXELEMENTS);
-
-      while (id < MAXELEMENTS  && m_entities.checkIdxBit(id))
-      {
-        ++id;
-        if (id >= MAXELEMENTS)
-        {
-          id = (m_nextId++) % MAXELEMENTS;
-        }
-      }
+      Id id = m_entities.findFirstClearBit(m_nextId);
+      m_nextId = id + 1;
       return id;
     }
 
-
     bool seen(std::string hash)
     {
       return m_components.find(hash) != m_components.end();
@@ -78,12 +69,15 @@ namespace higanbana
     }
 
   public:
-    Database(){}
+    Database()
+    {
+      m_entities.reserveBuckets((MAXELEMENTS + 127) / 128);
+    }
 
     Id createEntity()
     {
       auto e = nextUniqueIndex();
-      m_entities.setIdxBit(e); //m_entities only used for checking available id
+      m_entities.setBit(e); //m_entities only used for checking available id
       return e;
     }
 
@@ -94,27 +88,31 @@ namespace higanbana
       if (m_indextables.size() == 0)
         return;
 
-      Bitfield<INDEX_TABLE> transaction;
-      //printf("m_indextables size %ld\n", m_indextables.size());
-      for (int i=0;i<m_indextables.size();++i)
+      DynamicBitfield transaction;
+      transaction.reserveBuckets(m_entities.buckets());
+      for (auto it : m_indextables)
       {
-        transaction = bitunion(transaction, *m_indextables[i]);
+        transaction.add(*it);
       }
-      m_entities = transaction;
+      m_entities = std::move(transaction);
+      m_nextId = 0;
     }
 
     void deleteEntity(Id e)
     {
       for (auto it : m_indextables)
       {
-        it->clearIdxBit(e);
+        if (it->checkBit(e))
+          it->clearBit(e);
       }
-      m_entities.clearIdxBit(e);
+      if (m_entities.checkBit(e))
+        m_entities.clearBit(e);
+      m_nextId = std::min(m_nextId, static_cast<uint64_t>(e));
     }
 
     size_t entityCount()
     {
-      return m_entities.countElements();
+      return m_entities.setBits();
     }
 
     template<typename T>
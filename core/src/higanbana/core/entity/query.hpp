@@ -1,9 +1,13 @@
 #pragma once
 #include "sparsetable.hpp"
 #include "tagtable.hpp"
-
-
-#define DISABLED_LBS_VERSIONS 0
+#include <tuple>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#if JGPU_COROUTINES
+#include <css/task.hpp>
+#endif
 
 namespace higanbana
 {
@@ -11,38 +15,23 @@ namespace higanbana
   Bitfield<size> intersect(Bitfield<size>& v0, Bitfield<size>& v1)
   {
     std::array<__m128i, size> result;
-    std::array<__m128i, size>& vec0 = v0.data();
-    std::array<__m128i, size>& vec1 = v1.data();
-    __m128i* p = reinterpret_cast<__m128i*>(result.data());
-    for (size_t i = 0; i < size; ++i)
-    {
-      _mm_store_si128(p+i,_mm_and_si128(vec0[i], vec1[i]));
-    }
+    const __m128i* sources[2] = {v0.data().data(), v1.data().data()};
+    bitfieldUtils::intersect(result.data(), sources, 2, size);
     return Bitfield<size>(result);
   }
 
   template<size_t size>
   inline void intersect_void(Bitfield<size>& v0, Bitfield<size>& v1)
   {
-    std::array<__m128i, size>& vec0 = v0.data();
-    std::array<__m128i, size>& vec1 = v1.data();
-    for (size_t i = 0; i < size; ++i)
-    {
-      vec0[i] =_mm_and_si128(vec0[i], vec1[i]);
-    }
+    const __m128i* sources[2] = {v0.data().data(), v1.data().data()};
+    bitfieldUtils::intersect(v0.data().data(), sources, 2, size);
   }
 
   template<size_t size>
   Bitfield<size> bitunion(Bitfield<size>& v0, Bitfield<size>& v1)
   {
     std::array<__m128i, size> result;
-    std::array<__m128i, size>& vec0 = v0.data();
-    std::array<__m128i, size>& vec1 = v1.data();
-    __m128i* p = reinterpret_cast<__m128i*>(result.data());
-    for (size_t i = 0; i < size; ++i)
-    {
-      _mm_store_si128(p+i,_mm_or_si128(vec0[i], vec1[i]));
-    }
+    bitfieldUtils::unite(result.data(), v0.data().data(), v1.data().data(), size);
     return Bitfield<size>(result);
   }
 
@@ -59,17 +48,17 @@ namespace higanbana
   };
 
   // call the lambda with correct parameters
-  template<typename T,size_t size, size_t rsize>
-  inline Bitfield<rsize>& extractBitfield(_SparseTable<T, size, rsize>& table)
+  template<typename T, size_t PageSize>
+  inline DynamicBitfield& extractBitfield(_SparseTable<T, PageSize>& table)
   {
     return table.getBitfield();
   }
 
   // call the lambda with correct parameters
-  template<typename T, size_t size>
-  inline Bitfield<size>& extractBitfield(_TagTable<T, size>& table)
+  template<typename T>
+  inline DynamicBitfield& extractBitfield(_TagTable<T>& table)
   {
-	  return table.getBitfield();
+    return table.getBitfield();
   }
 
   template<typename Func, typename... Args>
@@ -96,43 +85,73 @@ namespace higanbana
                           std::forward<Tup>(tup),
                           std::make_index_sequence<Size>{});
   }
-  // call the lambda with correct parameters
-  template<typename T,size_t size, size_t rsize>
-  inline char* extractPtr(_SparseTable<T, size, rsize>& table)
-  {
-    return table.getPtr();
-  }
-  template<typename T,size_t size, size_t rsize>
-  inline size_t extractStride(_SparseTable<T, size, rsize>& table)
+
+  // Intersection is built this many buckets at a time, chunks where some component table has no page are skipped.
+  constexpr size_t QueryChunkBuckets = 8;
+
+  template<typename T, size_t PageSize>
+  inline bool hasQueryChunk(_SparseTable<T, PageSize>& table, size_t chunk)
   {
-    return sizeof(T);
+    return table.hasPage(chunk * QueryChunkBuckets * 128 / PageSize);
   }
-  template<typename Func, typename... Args>
-  inline void applyPtr(Func&& func, Args&&... args)
+
+  template<typename T>
+  inline bool hasQueryChunk(_TagTable<T>&, size_t)
   {
-    pass{ (func(extractPtr(std::forward<Args>(args)), extractStride(std::forward<Args>(args))),1)... };
+    return true;
   }
-  template<typename Func, typename Tup, std::size_t... index>
-  inline void invoke_apply_tablePtr(Func&& func, Tup&& tup,
-      std::index_sequence<index...>)
+
+  template<typename Tup, std::size_t... index>
+  inline bool hasQueryChunkAll(Tup&& tup, size_t chunk, std::index_sequence<index...>)
   {
-      applyPtr(std::forward<Func>(func),
-          std::get<index>(std::forward<Tup>(tup))...);
+    return (hasQueryChunk(std::get<index>(std::forward<Tup>(tup)), chunk) && ...);
   }
-  // needed so we can create our intersection
-  template<typename Tup, typename Func>
-  inline decltype(auto) for_each_tableptr(Tup&& tup, Func&& func)
+
+  // AND of every table in tup, only as long as the shortest bitfield since nothing past it can match.
+  template<typename Tup,
+    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value>
+  inline DynamicBitfield intersectTables(Tup&& tup)
   {
-      constexpr auto Size =
-        std::tuple_size<typename std::decay<Tup>::type>::value;
-      invoke_apply_tablePtr(std::forward<Func>(func),
-                          std::forward<Tup>(tup),
-                          std::make_index_sequence<Size>{});
+    size_t buckets = TupleSize > 0 ? std::numeric_limits<size_t>::max() : 0;
+    for_each_bitfield(tup, [&](DynamicBitfield& b)
+    {
+      buckets = std::min(buckets, b.buckets());
+    });
+    DynamicBitfield intersected;
+    intersected.reserveBuckets(buckets);
+    std::array<const __m128i*, TupleSize> sources;
+    size_t source = 0;
+    for_each_bitfield(tup, [&](DynamicBitfield& b)
+    {
+      sources[source++] = b.data();
+    });
+    // runs of chunks that every table has go to the wide kernel in one call
+    size_t begin = 0;
+    while (begin < buckets)
+    {
+      size_t end = begin;
+      while (end < buckets && hasQueryChunkAll(tup, end / QueryChunkBuckets, std::make_index_sequence<TupleSize>{}))
+        end += QueryChunkBuckets;
+      end = std::min(end, buckets);
+      if (end > begin)
+      {
+        std::array<const __m128i*, TupleSize> offsetted;
+        for (size_t i = 0; i < TupleSize; ++i)
+          offsetted[i] = sources[i] + begin;
+        bitfieldUtils::intersect(intersected.data() + begin, offsetted.data(), TupleSize, end - begin);
+        begin = end;
+      }
+      else
+      {
+        begin += QueryChunkBuckets; // stays empty
+      }
+    }
+    return intersected;
   }
 
   // call the lambda with correct parameters
-  template<typename T,size_t size, size_t rsize>
-  inline T& getIndex(size_t& i, _SparseTable<T, size, rsize>& table)
+  template<typename T, size_t PageSize>
+  inline T& getIndex(size_t& i, _SparseTable<T, PageSize>& table)
   {
     return table.get(i);
   }
@@ -148,35 +167,24 @@ namespace higanbana
           getIndex(table_index, std::get<index>(std::forward<Tup>(tup)))...);
   }
 
-
-  template<typename Tup, typename Func,
-    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-    size_t rsize = 2048,
-    size_t innerArray = 256>
-  void query(Tup&& tup, Func&& func)
+  // Calls func(id) for every set bit in buckets [index, end) in increasing order.
+  // Full buckets are walked linearly, sparse ones are gathered to idx_info first.
+  template<size_t innerArray, typename Func>
+  inline void forEachSetIndex(const DynamicBitfield& intersected, size_t index, size_t end, Func&& func)
   {
-    Bitfield<rsize> intersected(true);
-    for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-    {
-      intersect_void(intersected, b);
-    });
-
-    size_t index = 0;
+    static_assert(innerArray >= 128, "needs to fit at least one bucket.");
     size_t contiguous_fbs = 0;
     std::array<size_t, innerArray> idx_info;
     size_t idx = 0;
-    while (index < rsize)
+    while (index < end)
     {
-      index = intersected.nextPopBucket(index);
-      contiguous_fbs = intersected.contiguous_full_buckets(index);
+      index = std::min(intersected.nextPopBucket(index), end);
+      contiguous_fbs = std::min(intersected.contiguous_full_buckets(index), end - index);
       if (contiguous_fbs > 0)
       {
         for (size_t i = 0; i < contiguous_fbs * 128; ++i)
         {
-          size_t id = index * 128 + i;
-          callFuncWithIndex(id, std::forward<Func>(func),
-                              std::forward<Tup>(tup),
-                              std::make_index_sequence<TupleSize>{});
+          func(index * 128 + i);
         }
         index += contiguous_fbs;
       }
@@ -184,7 +192,7 @@ namespace higanbana
       {
         idx = 0;
         size_t temp_count = 0;
-        while (index < rsize &&
+        while (index < end &&
             idx + (temp_count = intersected.popcount_element(index)) < innerArray+1)
         {
           if (temp_count == 0) // nothing here, next
@@ -201,464 +209,152 @@ namespace higanbana
         }
         for (size_t i = 0; i < idx; ++i)
         {
-          size_t id = idx_info[i];
-          callFuncWithIndex(id, std::forward<Func>(func),
-                              std::forward<Tup>(tup),
-                              std::make_index_sequence<TupleSize>{});
+          func(idx_info[i]);
         }
       }
     }
   }
 
- template<size_t rsize, typename Tup, typename Func,
+  template<typename Tup, typename Func,
     size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-    size_t innerArray = 128>
-  void queryI(Tup&& tup, Func&& func)
+    size_t rsize = 2048,
+    size_t innerArray = 256>
+  void query(Tup&& tup, Func&& func)
   {
-    Bitfield<rsize> intersected(true);
-    for_each_bitfield(tup, [&](Bitfield<rsize>& b)
+    auto intersected = intersectTables(tup);
+    forEachSetIndex<innerArray>(intersected, 0, intersected.buckets(), [&](size_t id)
     {
-      intersect_void(intersected, b);
+      callFuncWithIndex(id, std::forward<Func>(func),
+                          std::forward<Tup>(tup),
+                          std::make_index_sequence<TupleSize>{});
     });
+  }
 
-    size_t index = 0;
-    size_t contiguous_fbs = 0;
-    std::array<size_t, innerArray> idx_info;
-    size_t idx = 0;
-    while (index < rsize)
-    {
-      index = intersected.nextPopBucket(index);
-      contiguous_fbs = intersected.contiguous_full_buckets(index);
-      if (contiguous_fbs > 0)
-      {
-        for (size_t i = 0; i < contiguous_fbs * 128; ++i)
-        {
-          size_t id = index * 128 + i;
-          callFuncWithIndex(id, std::forward<Func>(func),
-                              std::forward<Tup>(tup),
-                              std::make_index_sequence<TupleSize>{});
-        }
-        index += contiguous_fbs;
-      }
-      else
-      {
-        idx = 0;
-        size_t temp_count = 0;
-        while (index < rsize &&
-            idx + (temp_count = intersected.popcount_element(index)) < innerArray+1)
-        {
-          if (temp_count == 0) // nothing here, next
-          {
-            ++index;
-            continue;
-          }
-          else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-          {                           // But keep the memory access linear so empty our array next.
-            break;
-          }
-          idx = intersected.skip_find_indexes(idx_info, idx, index);
-          ++index;
-        }
-        for (size_t i = 0; i < idx; ++i)
-        {
-          size_t id = idx_info[i];
-          callFuncWithIndex(id, std::forward<Func>(func),
-                              std::forward<Tup>(tup),
-                              std::make_index_sequence<TupleSize>{});
-        }
-      }
-    }
+  // rsize is kept for old callers, tables grow dynamically now.
+  template<size_t rsize, typename Tup, typename Func,
+    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
+    size_t innerArray = 128>
+  void queryI(Tup&& tup, Func&& func)
+  {
+    query<Tup, Func, TupleSize, rsize, innerArray>(std::forward<Tup>(tup), std::forward<Func>(func));
   }
 
   template<typename Tup, typename Tup2, typename Func,
-	  size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-	  size_t rsize = 2048,
-	  size_t innerArray = 256>
-	  void query(Tup&& tup, Tup2&& tags, Func&& func)
+    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
+    size_t rsize = 2048,
+    size_t innerArray = 256>
+  void query(Tup&& tup, Tup2&& tags, Func&& func)
   {
-	  Bitfield<rsize> intersected(true);
-	  for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(intersected, b);
-	  });
-	  for_each_bitfield(tags, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(intersected, b);
-	  });
-
-	  size_t index = 0;
-	  size_t contiguous_fbs = 0;
-	  std::array<size_t, innerArray> idx_info;
-	  size_t idx = 0;
-	  while (index < rsize)
-	  {
-		  index = intersected.nextPopBucket(index);
-		  contiguous_fbs = intersected.contiguous_full_buckets(index);
-		  if (contiguous_fbs > 0)
-		  {
-			  for (size_t i = 0; i < contiguous_fbs * 128; ++i)
-			  {
-				  size_t id = index * 128 + i;
-				  callFuncWithIndex(id, std::forward<Func>(func),
-					  std::forward<Tup>(tup),
-					  std::make_index_sequence<TupleSize>{});
-			  }
-			  index += contiguous_fbs;
-		  }
-		  else
-		  {
-			  idx = 0;
-			  size_t temp_count = 0;
-			  while (index < rsize &&
-				  idx + (temp_count = intersected.popcount_element(index)) < innerArray + 1)
-			  {
-				  if (temp_count == 0) // nothing here, next
-				  {
-					  ++index;
-					  continue;
-				  }
-				  else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-				  {                           // But keep the memory access linear so empty our array next.
-					  break;
-				  }
-				  idx = intersected.skip_find_indexes(idx_info, idx, index);
-				  ++index;
-			  }
-			  for (size_t i = 0; i < idx; ++i)
-			  {
-				  size_t id = idx_info[i];
-				  callFuncWithIndex(id, std::forward<Func>(func),
-					  std::forward<Tup>(tup),
-					  std::make_index_sequence<TupleSize>{});
-			  }
-		  }
-	  }
+    auto intersected = intersectTables(std::tuple_cat(tup, tags));
+    forEachSetIndex<innerArray>(intersected, 0, intersected.buckets(), [&](size_t id)
+    {
+      callFuncWithIndex(id, std::forward<Func>(func),
+                          std::forward<Tup>(tup),
+                          std::make_index_sequence<TupleSize>{});
+    });
   }
 
   template<size_t rsize, typename Tup, typename Tup2, typename Func,
-	  size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-	  size_t innerArray = 128>
+    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
+    size_t innerArray = 128>
   void queryI(Tup&& tup, Tup2&& tags, Func&& func)
   {
-	  Bitfield<rsize> intersected(true);
-	  for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(intersected, b);
-	  });
-	  for_each_bitfield(tags, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(intersected, b);
-	  });
-
-	  size_t index = 0;
-	  size_t contiguous_fbs = 0;
-	  std::array<size_t, innerArray> idx_info;
-	  size_t idx = 0;
-	  while (index < rsize)
-	  {
-		  index = intersected.nextPopBucket(index);
-		  contiguous_fbs = intersected.contiguous_full_buckets(index);
-		  if (contiguous_fbs > 0)
-		  {
-			  for (size_t i = 0; i < contiguous_fbs * 128; ++i)
-			  {
-				  size_t id = index * 128 + i;
-				  callFuncWithIndex(id, std::forward<Func>(func),
-					  std::forward<Tup>(tup),
-					  std::make_index_sequence<TupleSize>{});
-			  }
-			  index += contiguous_fbs;
-		  }
-		  else
-		  {
-			  idx = 0;
-			  size_t temp_count = 0;
-			  while (index < rsize &&
-				  idx + (temp_count = intersected.popcount_element(index)) < innerArray + 1)
-			  {
-				  if (temp_count == 0) // nothing here, next
-				  {
-					  ++index;
-					  continue;
-				  }
-				  else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-				  {                           // But keep the memory access linear so empty our array next.
-					  break;
-				  }
-				  idx = intersected.skip_find_indexes(idx_info, idx, index);
-				  ++index;
-			  }
-			  for (size_t i = 0; i < idx; ++i)
-			  {
-				  size_t id = idx_info[i];
-				  callFuncWithIndex(id, std::forward<Func>(func),
-					  std::forward<Tup>(tup),
-					  std::make_index_sequence<TupleSize>{});
-			  }
-		  }
-	  }
+    query<Tup, Tup2, Func, TupleSize, rsize, innerArray>(std::forward<Tup>(tup), std::forward<Tup2>(tags), std::forward<Func>(func));
   }
 
   template<size_t rsize, typename Tup2, typename Func,
-	  size_t innerArray = 128>
-    void queryTag(Tup2&& tags, Func&& func)
+    size_t innerArray = 128>
+  void queryTag(Tup2&& tags, Func&& func)
   {
-    Bitfield<rsize> intersected(true);
-    for_each_bitfield(tags, [&](Bitfield<rsize>& b)
-    {
-      intersect_void(intersected, b);
-    });
+    auto intersected = intersectTables(tags);
+    forEachSetIndex<innerArray>(intersected, 0, intersected.buckets(), std::forward<Func>(func));
+  }
 
-    size_t index = 0;
-    size_t contiguous_fbs = 0;
-    std::array<size_t, innerArray> idx_info;
-    size_t idx = 0;
-    while (index < rsize)
+  // Cuts buckets [0, buckets()) to at most splits ranges with about the same amount of set bits each.
+  // Returned values are range ends, first range starts from 0.
+  inline std::vector<size_t> splitByPopcount(const DynamicBitfield& field, size_t splits)
+  {
+    std::vector<size_t> ends;
+    size_t total = field.setBits();
+    splits = std::max(std::min(splits, total), size_t(1));
+    size_t seen = 0;
+    size_t nextCut = (total + splits - 1) / splits;
+    for (size_t i = 0; i < field.buckets() && ends.size() + 1 < splits; ++i)
     {
-      index = intersected.nextPopBucket(index);
-      contiguous_fbs = intersected.contiguous_full_buckets(index);
-      if (contiguous_fbs > 0)
-      {
-        for (size_t i = 0; i < contiguous_fbs * 128; ++i)
-        {
-          size_t id = index * 128 + i;
-          func(id);
-        }
-        index += contiguous_fbs;
-      }
-      else
+      seen += field.popcount_element(i);
+      if (seen >= nextCut)
       {
-        idx = 0;
-        size_t temp_count = 0;
-        while (index < rsize &&
-          idx + (temp_count = intersected.popcount_element(index)) < innerArray + 1)
-        {
-          if (temp_count == 0) // nothing here, next
-          {
-            ++index;
-            continue;
-          }
-          else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-          {                           // But keep the memory access linear so empty our array next.
-            break;
-          }
-          idx = intersected.skip_find_indexes(idx_info, idx, index);
-          ++index;
-        }
-        for (size_t i = 0; i < idx; ++i)
-        {
-          size_t id = idx_info[i];
-          func(id);
-        }
+        ends.push_back(i + 1);
+        nextCut = (total * (ends.size() + 1) + splits - 1) / splits;
       }
     }
+    ends.push_back(field.buckets());
+    return ends;
   }
-  
-#if DISABLED_LBS_VERSIONS
-  template<typename Tup, typename Func,
-    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-    size_t rsize = 2048,
-    size_t innerArray = 256,
-    size_t offset = 128>
-  void queryParallel(LBS& lbs, desc::Task& task, Tup&& tup, Func&& func)
+
+#if JGPU_COROUTINES
+  template<typename T>
+  struct is_tuple : std::false_type {};
+  template<typename... Args>
+  struct is_tuple<std::tuple<Args...>> : std::true_type {};
+
+  // Entities handed to a single task at minimum, below this the scheduling costs more than the work.
+  constexpr size_t QueryParallelMinEntities = 4096;
+
+  template<size_t innerArray, typename Tup, typename Func,
+    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value>
+  css::Task<void> queryParallelRange(const DynamicBitfield* intersected, size_t begin, size_t end, Tup tup, Func* func)
   {
-    auto intersected = std::make_shared<Bitfield<rsize>>(Bitfield<rsize>(true));
-    for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-    {
-      intersect_void(*intersected, b);
-    });
-    lbs.addParallelFor<1>(task, 0, rsize / offset, [=](size_t query_index)
+    forEachSetIndex<innerArray>(*intersected, begin, end, [&](size_t id)
     {
-      size_t index = query_index * offset;
-      size_t contiguous_fbs = 0;
-      std::array<size_t, innerArray> idx_info;
-      size_t idx = 0;
-      while (index < query_index * offset + offset)
-      {
-        index = intersected->nextPopBucket(index);
-        contiguous_fbs = intersected->contiguous_full_buckets(index);
-        if (contiguous_fbs > 0)
-        {
-          contiguous_fbs = std::min(index - query_index * offset + offset, contiguous_fbs);
-          for (size_t i = index*128; i < contiguous_fbs*128+index*128; ++i)
-          {
-            callFuncWithIndex(i, func,
-                                tup,
-                                std::make_index_sequence<TupleSize>{});
-          }
-          index += contiguous_fbs;
-        }
-        else
-        {
-          idx = 0;
-          size_t temp_count = 0;
-          while (index < query_index * offset + offset && idx + (temp_count = intersected->popcount_element(index)) < innerArray + 1)
-          {
-
-            if (temp_count == 0)
-            {
-              ++index;
-              continue;
-            }
-            else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-            {                           // rewrite contiguous here because logical.
-              break;
-            }
-            idx = intersected->skip_find_indexes(idx_info, idx, index);
-            ++index;
-          }
-          for (size_t i = 0; i < idx; ++i)
-          {
-            callFuncWithIndex(idx_info[i], func,
-                                tup,
-                                std::make_index_sequence<TupleSize>{});
-          }
-        }
-      }
+      callFuncWithIndex(id, *func, tup, std::make_index_sequence<TupleSize>{});
     });
+    co_return;
   }
 
-  template<typename Tup, typename Tup2, typename Func,
-	  size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-	  size_t rsize = 2048,
-	  size_t innerArray = 256,
-	  size_t offset = 32>
-	  void queryParallel(LBS& lbs, desc::Task& task, Tup&& tup, Tup2&& tags, Func&& func)
+  template<size_t innerArray, typename Tup, typename Func>
+  css::Task<void> queryParallelIntersected(DynamicBitfield intersected, Tup tup, Func func, size_t splits)
   {
-	  auto intersected = std::make_shared<Bitfield<rsize>>(Bitfield<rsize>(true));
-	  for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(*intersected, b);
-	  });
-	  for_each_bitfield(tags, [&](Bitfield<rsize>& b)
-	  {
-		  intersect_void(*intersected, b);
-	  });
-
-	  lbs.addParallelFor<1>(task, 0, rsize / offset, [=](size_t query_index, size_t)
-	  {
-		  size_t index = query_index * offset;
-		  size_t contiguous_fbs = 0;
-		  std::array<size_t, innerArray> idx_info;
-		  size_t idx = 0;
-		  while (index < query_index * offset + offset)
-		  {
-			  index = intersected->nextPopBucket(index);
-			  contiguous_fbs = intersected->contiguous_full_buckets(index);
-			  if (contiguous_fbs > 0)
-			  {
-				  contiguous_fbs = std::min(index - query_index * offset + offset, contiguous_fbs);
-				  for (size_t i = index * 128; i < contiguous_fbs * 128 + index * 128; ++i)
-				  {
-					  callFuncWithIndex(i, func,
-						  tup,
-						  std::make_index_sequence<TupleSize>{});
-				  }
-				  index += contiguous_fbs;
-			  }
-			  else
-			  {
-				  idx = 0;
-				  size_t temp_count = 0;
-				  while (index < query_index * offset + offset && idx + (temp_count = intersected->popcount_element(index)) < innerArray + 1)
-				  {
-
-					  if (temp_count == 0)
-					  {
-						  ++index;
-						  continue;
-					  }
-					  else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-					  {                           // rewrite contiguous here because logical.
-						  break;
-					  }
-					  idx = intersected->skip_find_indexes(idx_info, idx, index);
-					  ++index;
-				  }
-				  for (size_t i = 0; i < idx; ++i)
-				  {
-					  callFuncWithIndex(idx_info[i], func,
-						  tup,
-						  std::make_index_sequence<TupleSize>{});
-				  }
-			  }
-		  }
-	  });
+    if (splits == 0)
+      splits = std::max(std::thread::hardware_concurrency(), 1u) * 4;
+    splits = std::min(splits, intersected.setBits() / QueryParallelMinEntities);
+    if (splits <= 1)
+    {
+      co_await queryParallelRange<innerArray>(&intersected, 0, intersected.buckets(), tup, &func);
+      co_return;
+    }
+    auto ends = splitByPopcount(intersected, splits);
+    std::vector<css::Task<void>> tasks;
+    size_t begin = 0;
+    for (auto end : ends)
+    {
+      tasks.emplace_back(queryParallelRange<innerArray>(&intersected, begin, end, tup, &func));
+      begin = end;
+    }
+    for (auto&& task : tasks)
+    {
+      co_await task;
+    }
   }
 
+  // Parallel query(), the matching entities are split to about equal sized ranges and func is run on them from the steal pool.
+  // func is called concurrently and needs to be safe for that, components of one id are only touched by one call.
+  // Tables need to stay alive and unmodified until the task is done. splits 0 picks amount from hardware threads.
   template<typename Tup, typename Func,
-    size_t TupleSize = std::tuple_size<typename std::decay<Tup>::type>::value,
-    size_t rsize = 2048,
-    size_t innerArray = 128,
-    size_t offset = 128>
-  void queryParallel_prefetch(LBS& lbs, desc::Task& task, Tup&& tup, Func&& func)
+    size_t innerArray = 256>
+  css::Task<void> queryParallel(Tup tup, Func func, size_t splits = 0)
   {
-    auto intersected = std::make_shared<Bitfield<rsize>>(Bitfield<rsize>(true));
-    for_each_bitfield(tup, [&](Bitfield<rsize>& b)
-    {
-      intersect_void(*intersected, b);
-    });
-    lbs.addParallelFor<1>(task, 0, rsize / offset, [=](size_t query_index, size_t)
-    {
-      size_t index = query_index * offset;
-      size_t contiguous_fbs = 0;
-      std::array<size_t, innerArray> idx_info;
-      size_t idx = 0;
-    
-      while (index < query_index * offset + offset)
-      {
-        index = intersected->nextPopBucket(index);
-        contiguous_fbs = intersected->contiguous_full_buckets(index);
-        if (contiguous_fbs > 0)
-        {
-          contiguous_fbs = std::min(index - query_index * offset + offset, contiguous_fbs);
-          for (size_t i = index*128; i < contiguous_fbs*128+index*128; ++i)
-          {
-            callFuncWithIndex(i, func,
-                                tup,
-                                std::make_index_sequence<TupleSize>{});
-          }
-          index += contiguous_fbs;
-        }
-        else
-        {
-          idx = 0;
-          size_t temp_count = 0;
-          while (index < query_index * offset + offset && idx + (temp_count = intersected->popcount_element(index)) < innerArray + 1)
-          {
+    return queryParallelIntersected<innerArray>(intersectTables(tup), tup, std::move(func), splits);
+  }
 
-            if (temp_count == 0)
-            {
-              ++index;
-              continue;
-            }
-            else if (temp_count == 128) // Contiguous!! break and let the contiguous handle it.
-            {                           // rewrite contiguous here because logical.
-              break;
-            }
-            idx = intersected->skip_find_indexes_prefetch(idx_info, idx, index, [tup](size_t index) 
-            {
-              for_each_tableptr(tup, [=, &index](char* ptr, size_t stride)
-              {
-#ifdef HIGANBANA_PLATFORM_WINDOWS
-                _mm_prefetch(ptr + index*stride, _MM_HINT_NTA);
-#else
-                __builtin_prefetch(ptr + index*stride, 1, 0);
-#endif
-              });
-            });
-            ++index;
-          }
-          for (size_t i = 0; i < idx; ++i)
-          {
-            callFuncWithIndex(idx_info[i], func,
-                                tup,
-                                std::make_index_sequence<TupleSize>{});
-          }
-        }
-      }
-    });
+  template<typename Tup, typename Tup2, typename Func,
+    size_t innerArray = 256,
+    typename = std::enable_if_t<is_tuple<Tup2>::value>>
+  css::Task<void> queryParallel(Tup tup, Tup2 tags, Func func, size_t splits = 0)
+  {
+    return queryParallelIntersected<innerArray>(intersectTables(std::tuple_cat(tup, tags)), tup, std::move(func), splits);
   }
 #endif
+
 };
 
@@ -2,6 +2,7 @@
 #include "bitfield.hpp"
 #include <memory>
 #include <array>
+#include <vector>
 #include <cassert>
 #include <optional>
 
@@ -9,43 +10,66 @@ namespace higanbana
 {
   typedef size_t Id;
 
-  template <typename T, size_t t_size, size_t r_size>
+  // Components live in fixed size pages that are allocated when an id inside them is first written,
+  // sparse components don't pay for the whole id range and there is no upper limit for ids.
+  // Pages are never moved, references from get() stay valid while the table lives.
+  template <typename T, size_t PageSize = 1024>
   class _SparseTable
   {
+    static_assert(PageSize % 1024 == 0, "queries skip missing pages 1024 ids at a time.");
+  public:
+    using Page = std::array<T, PageSize>;
+    static constexpr size_t PageBuckets = PageSize / 128;
+
   private:
-    std::unique_ptr<std::array<T, t_size>> m_array;
-    Bitfield<r_size> m_bitfield;
+    std::vector<std::unique_ptr<Page>> m_pages;
+    DynamicBitfield m_bitfield;
+
+    inline Page& page(Id id)
+    {
+      size_t pageIndex = id / PageSize;
+      if (pageIndex >= m_pages.size())
+        m_pages.resize(pageIndex + 1);
+      if (!m_pages[pageIndex])
+        m_pages[pageIndex] = std::make_unique<Page>();
+      return *m_pages[pageIndex];
+    }
 
   public:
-    _SparseTable() :m_array(std::make_unique<std::array<T, t_size>>()) {}
+    _SparseTable() {}
+    _SparseTable(size_t expectedIds)
+    {
+      m_pages.reserve((expectedIds + PageSize - 1) / PageSize);
+    }
 
     void insert_m(Id id, T&& component)
     {
-      assert(id < t_size);
-      (*m_array)[id] = std::move(component);
-      m_bitfield.setIdxBit(id);
+      page(id)[id % PageSize] = std::move(component);
+      m_bitfield.setBit(id);
     }
 
     void insert(Id id, T component)
     {
-      assert(id < t_size);
-      (*m_array)[id] = std::move(component);
-      m_bitfield.setIdxBit(id);
+      page(id)[id % PageSize] = std::move(component);
+      m_bitfield.setBit(id);
     }
 
     void remove(Id id)
     {
-      m_bitfield.clearIdxBit(id);
+      if (m_bitfield.checkBit(id))
+        m_bitfield.clearBit(id);
     }
 
     bool check(Id id)
     {
-      return m_bitfield.checkIdxBit(id);
+      return m_bitfield.checkBit(id);
     }
 
+    // id needs to have been inserted at some point
     inline T& get(Id id)
     {
-      return (*m_array)[id];
+      assert(hasPage(id / PageSize));
+      return (*m_pages[id / PageSize])[id % PageSize];
     }
 
     std::optional<T> tryGet(Id id)
@@ -57,19 +81,28 @@ namespace higanbana
       return std::optional<T>{};
     }
 
+    // ids the table can currently address without allocating
     size_t size() const
     {
-      return t_size;
+      return m_pages.size() * PageSize;
     }
 
-    Bitfield<r_size>& getBitfield()
+    inline bool hasPage(size_t pageIndex) const
     {
-      return m_bitfield;
+      return pageIndex < m_pages.size() && m_pages[pageIndex] != nullptr;
+    }
+
+    size_t populatedPages() const
+    {
+      size_t count = 0;
+      for (auto& it : m_pages)
+        count += it != nullptr;
+      return count;
     }
 
-    inline char* getPtr()
+    DynamicBitfield& getBitfield()
     {
-      return reinterpret_cast<char*>(m_array.Get());
+      return m_bitfield;
     }
   };
 }
@@ -5,52 +5,52 @@
 
 namespace higanbana
 {
-  template <typename T, size_t tsize>
+  template <typename T>
   class _TagTable
   {
   private:
-    Bitfield<tsize> m_bitfield;
+    DynamicBitfield m_bitfield;
 
   public:
     _TagTable() {}
 
     void insert(size_t id)
     {
-      assert(id < tsize * 128);
-      m_bitfield.setIdxBit(id);
+      m_bitfield.setBit(id);
     }
 
     void remove(size_t id)
     {
-      m_bitfield.clearIdxBit(id);
+      if (m_bitfield.checkBit(id))
+        m_bitfield.clearBit(id);
     }
 
     void toggle(size_t id)
     {
-      m_bitfield.toggleIdxBit(id);
+      m_bitfield.toggleBit(id);
     }
 
     bool check(size_t id)
     {
-      return m_bitfield.checkIdxBit(id);
+      return m_bitfield.checkBit(id);
     }
 
     bool checkAndDisable(size_t id)
     {
-      bool ret = m_bitfield.checkIdxBit(id);
-      m_bitfield.clearIdxBit(id);
+      bool ret = m_bitfield.checkBit(id);
+      if (ret)
+        m_bitfield.clearBit(id);
       return ret;
     }
 
     size_t size() const
     {
-      return tsize;
+      return m_bitfield.size();
     }
 
-    Bitfield<tsize>& getBitfield()
+    DynamicBitfield& getBitfield()
     {
       return m_bitfield;
     }
   };
 }
-
@@ -0,0 +1,412 @@
+#include "higanbana/core/filesystem/asset_archive.hpp"
+#include "higanbana/core/filesystem/block_compression.hpp"
+#include "higanbana/core/filesystem/mapped_file.hpp"
+#include "higanbana/core/external/SpookyV2.hpp"
+#include "higanbana/core/profiling/profiling.hpp"
+#include "higanbana/core/global_debug.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace higanbana
+{
+namespace
+{
+constexpr uint64_t PathSeed = 0x48504b31;
+
+size_t bucketOf(uint64_t hash, uint32_t bucketBits)
+{
+  return bucketBits ? static_cast<size_t>(hash >> (64 - bucketBits)) : 0;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t readU32(const uint8_t* ptr)
+{
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+}
+
+std::shared_ptr<AssetArchive> AssetArchive::open(const char* nativePath)
+{
+  HIGAN_CPU_FUNCTION_SCOPE();
+  auto file = MappedFile::open(nativePath);
+  if (!file || file->size() < sizeof(Header))
+    return nullptr;
+  auto header = reinterpret_cast<const Header*>(file->data());
+  const uint64_t size = file->size();
+  if (header->magic != Magic || header->version != Version || header->fileSize != size)
+    return nullptr;
+  if (header->bucketBits > 31 || header->chunkSize == 0 || header->bucketsOffset % alignof(uint32_t) || header->entriesOffset % alignof(Entry))
+    return nullptr;
+  const uint64_t bucketsSize = ((1ull << header->bucketBits) + 1) * sizeof(uint32_t);
+  const uint64_t entriesSize = static_cast<uint64_t>(header->entryCount) * sizeof(Entry);
+  if (header->bucketsOffset > size || bucketsSize > size - header->bucketsOffset
+    || header->entriesOffset > size || entriesSize > size - header->entriesOffset
+    || header->namesOffset > size || header->namesSize > size - header->namesOffset)
+    return nullptr;
+
+  auto archive = std::shared_ptr<AssetArchive>(new AssetArchive());
+  archive->m_data = file->data();
+  archive->m_header = header;
+  archive->m_buckets = reinterpret_cast<const uint32_t*>(file->data() + header->bucketsOffset);
+  archive->m_entries = reinterpret_cast<const Entry*>(file->data() + header->entriesOffset);
+  archive->m_names = reinterpret_cast<const char*>(file->data() + header->namesOffset);
+  archive->m_file = std::move(file);
+  return archive;
+}
+
+uint64_t AssetArchive::hashPath(std::string_view path)
+{
+  return SpookyHash::Hash64(path.data(), path.size(), PathSeed);
+}
+
+int64_t AssetArchive::find(std::string_view path) const
+{
+  const uint64_t hash = hashPath(path);
+  const size_t bucket = bucketOf(hash, m_header->bucketBits);
+  const uint32_t end = std::min(m_buckets[bucket + 1], m_header->entryCount);
+  for (uint32_t i = m_buckets[bucket]; i < end; ++i)
+  {
+    if (m_entries[i].pathHash == hash && name(i) == path)
+      return i;
+  }
+  return -1;
+}
+
+std::string_view AssetArchive::name(size_t index) const
+{
+  auto& e = m_entries[index];
+  if (e.nameOffset > m_header->namesSize || e.nameSize > m_header->namesSize - e.nameOffset)
+    return {};
+  return std::string_view(m_names + e.nameOffset, e.nameSize);
+}
+
+bool AssetArchive::storedRange(const Entry& entry) const
+{
+  return entry.offset <= m_header->fileSize && entry.storedSize <= m_header->fileSize - entry.offset;
+}
+
+bool AssetArchive::decompressChunk(const Entry& entry, size_t chunk, uint8_t* dst) const
+{
+  const uint8_t* stored = m_data + entry.offset;
+  const uint64_t tableSize = static_cast<uint64_t>(entry.chunkCount) * sizeof(uint32_t);
+  const uint64_t dataSize = entry.storedSize - tableSize;
+  const uint64_t begin = chunk ? readU32(stored + (chunk - 1) * sizeof(uint32_t)) : 0;
+  const uint64_t end = readU32(stored + chunk * sizeof(uint32_t));
+  if (begin > end || end > dataSize)
+    return false;
+  const size_t chunkStart = chunk * m_header->chunkSize;
+  const size_t chunkLength = static_cast<size_t>(std::min<uint64_t>(m_header->chunkSize, entry.size - chunkStart));
+  const uint8_t* src = stored + tableSize + begin;
+  // chunks that didn't compress are stored as is
+  if (end - begin == chunkLength)
+  {
+    memcpy(dst, src, chunkLength);
+    return true;
+  }
+  return blockCompression::decompress(src, static_cast<size_t>(end - begin), dst, chunkLength);
+}
+
+size_t AssetArchive::read(size_t index, size_t offset, uint8_t* dst, size_t size) const
+{
+  auto& e = m_entries[index];
+  if (offset >= e.size || !storedRange(e))
+    return 0;
+  size = static_cast<size_t>(std::min<uint64_t>(size, e.size - offset));
+  const uint8_t* stored = m_data + e.offset;
+  if (!(e.flags & Compressed))
+  {
+    if (e.storedSize != e.size)
+      return 0;
+    memcpy(dst, stored + offset, size);
+    return size;
+  }
+  const size_t chunkSize = m_header->chunkSize;
+  if (e.chunkCount != (e.size + chunkSize - 1) / chunkSize || static_cast<uint64_t>(e.chunkCount) * sizeof(uint32_t) > e.storedSize)
+    return 0;
+  size_t copied = 0;
+  std::vector<uint8_t> partial;
+  for (size_t chunk = offset / chunkSize; copied < size; ++chunk)
+  {
+    const size_t chunkStart = chunk * chunkSize;
+    const size_t chunkLength = static_cast<size_t>(std::min<uint64_t>(chunkSize, e.size - chunkStart));
+    const size_t from = offset + copied - chunkStart;
+    const size_t count = std::min(chunkLength - from, size - copied);
+    if (from == 0 && count == chunkLength)
+    {
+      if (!decompressChunk(e, chunk, dst + copied))
+        return copied;
+    }
+    else
+    {
+      partial.resize(chunkLength);
+      if (!decompressChunk(e, chunk, partial.data()))
+        return copied;
+      memcpy(dst + copied, partial.data() + from, count);
+    }
+    copied += count;
+  }
+  return copied;
+}
+
+MemoryBlob AssetArchive::contents(size_t index)
+{
+  auto& e = m_entries[index];
+  if (!storedRange(e))
+    return MemoryBlob();
+  if (!(e.flags & Compressed))
+  {
+    if (e.storedSize != e.size)
+      return MemoryBlob();
+    return MemoryBlob(shared_from_this(), m_data + e.offset, static_cast<size_t>(e.size));
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_decompressedLock);
+    auto found = m_decompressed.find(index);
+    if (found != m_decompressed.end())
+      return MemoryBlob(found->second, found->second->data(), found->second->size());
+  }
+  HIGAN_CPU_BRACKET("AssetArchive::decompress");
+  auto decompressed = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(e.size));
+  if (read(index, 0, decompressed->data(), decompressed->size()) != decompressed->size())
+  {
+    HIGAN_LOGi("AssetArchive: %.*s is corrupt\n", static_cast<int>(name(index).size()), name(index).data());
+    return MemoryBlob();
+  }
+  std::lock_guard<std::mutex> guard(m_decompressedLock);
+  // another thread may have beaten us to it, everyone shares the first one
+  auto& slot = m_decompressed[index];
+  if (!slot)
+    slot = std::move(decompressed);
+  return MemoryBlob(slot, slot->data(), slot->size());
+}
+
+AssetArchiveBuilder::AssetArchiveBuilder(uint32_t alignment)
+  : m_alignment(std::max(alignment, 8u))
+{
+  HIGAN_ASSERT((m_alignment & (m_alignment - 1)) == 0, "alignment has to be a power of two");
+}
+
+void AssetArchiveBuilder::add(std::string path, std::vector<uint8_t> contents, bool compress)
+{
+  m_files.push_back({std::move(path), std::string(), std::move(contents), compress});
+}
+
+void AssetArchiveBuilder::addFile(std::string path, std::string nativePath, bool compress)
+{
+  m_files.push_back({std::move(path), std::move(nativePath), {}, compress});
+}
+
+namespace
+{
+// chunk end table followed by the chunks, empty if compressing didn't pay off
+std::vector<uint8_t> compressChunked(const std::vector<uint8_t>& contents, uint32_t& chunkCount)
+{
+  const size_t chunkSize = AssetArchive::ChunkSize;
+  chunkCount = static_cast<uint32_t>((contents.size() + chunkSize - 1) / chunkSize);
+  const size_t tableSize = chunkCount * sizeof(uint32_t);
+  std::vector<uint8_t> out(tableSize);
+  std::vector<uint8_t> scratch(blockCompression::compressBound(chunkSize));
+  for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+  {
+    const size_t start = chunk * chunkSize;
+    const size_t length = std::min(chunkSize, contents.size() - start);
+    size_t compressed = blockCompression::compress(contents.data() + start, length, scratch.data(), scratch.size());
+    // equal length marks a raw chunk, so compressed ones have to be strictly smaller
+    if (compressed == 0 || compressed >= length)
+      out.insert(out.end(), contents.begin() + start, contents.begin() + start + length);
+    else
+      out.insert(out.end(), scratch.begin(), scratch.begin() + compressed);
+    uint32_t end = static_cast<uint32_t>(out.size() - tableSize);
+    memcpy(out.data() + chunk * sizeof(uint32_t), &end, sizeof(end));
+  }
+  // not worth a decompress for less than 1/16 saved
+  if (out.size() >= contents.size() - contents.size() / 16)
+    return {};
+  return out;
+}
+
+struct ContentKey
+{
+  uint64_t hash[2];
+  uint64_t size;
+  bool operator==(const ContentKey& other) const
+  {
+    return hash[0] == other.hash[0] && hash[1] == other.hash[1] && size == other.size;
+  }
+};
+
+struct ContentKeyHash
+{
+  size_t operator()(const ContentKey& key) const { return static_cast<size_t>(key.hash[0]); }
+};
+}
+
+bool AssetArchiveBuilder::write(const char* nativePath, Stats* stats)
+{
+  HIGAN_CPU_FUNCTION_SCOPE();
+  using Header = AssetArchive::Header;
+  using Entry = AssetArchive::Entry;
+  Stats counts;
+
+  // index order is path hash order
+  struct Sorted
+  {
+    uint64_t hash;
+    size_t file;
+  };
+  vector<Sorted> order;
+  for (size_t i = 0; i < m_files.size(); ++i)
+    order.push_back({AssetArchive::hashPath(m_files[i].path), i});
+  std::sort(order.begin(), order.end(), [&](const Sorted& a, const Sorted& b) {
+    return a.hash != b.hash ? a.hash < b.hash : m_files[a.file].path < m_files[b.file].path;
+  });
+  order.erase(std::unique(order.begin(), order.end(), [&](const Sorted& a, const Sorted& b) {
+    if (a.hash != b.hash || m_files[a.file].path != m_files[b.file].path)
+      return false;
+    HIGAN_LOGi("AssetArchiveBuilder: %s added twice, keeping the first\n", m_files[a.file].path.c_str());
+    return true;
+  }), order.end());
+
+  Header header = {};
+  header.magic = AssetArchive::Magic;
+  header.version = AssetArchive::Version;
+  header.entryCount = static_cast<uint32_t>(order.size());
+  while ((1ull << header.bucketBits) < order.size())
+    ++header.bucketBits;
+  header.chunkSize = AssetArchive::ChunkSize;
+  header.alignment = m_alignment;
+
+  vector<uint32_t> buckets((1ull << header.bucketBits) + 1);
+  std::string names;
+  vector<Entry> entries(order.size());
+  for (size_t i = 0, bucket = 0; i <= order.size(); ++i)
+  {
+    const size_t bucketEnd = i < order.size() ? bucketOf(order[i].hash, header.bucketBits) : buckets.size() - 1;
+    for (; bucket <= bucketEnd; ++bucket)
+      buckets[bucket] = static_cast<uint32_t>(i);
+    if (i == order.size())
+      break;
+    auto& path = m_files[order[i].file].path;
+    entries[i].pathHash = order[i].hash;
+    entries[i].nameOffset = static_cast<uint32_t>(names.size());
+    entries[i].nameSize = static_cast<uint32_t>(path.size());
+    names += path;
+  }
+  header.bucketsOffset = sizeof(Header);
+  header.entriesOffset = alignUp(header.bucketsOffset + buckets.size() * sizeof(uint32_t), alignof(Entry));
+  header.namesOffset = header.entriesOffset + entries.size() * sizeof(Entry);
+  header.namesSize = names.size();
+  const uint64_t dataOffset = alignUp(header.namesOffset + header.namesSize, m_alignment);
+
+  auto target = std::filesystem::path(nativePath);
+  auto tempPath = target;
+  tempPath += ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out)
+  {
+    HIGAN_LOGi("AssetArchiveBuilder: couldn't write %s\n", tempPath.string().c_str());
+    return false;
+  }
+  std::error_code error;
+  std::vector<char> padding(std::max<uint64_t>(dataOffset, m_alignment));
+  out.write(padding.data(), dataOffset);
+  uint64_t position = dataOffset;
+
+  std::unordered_map<ContentKey, size_t, ContentKeyHash> stored;
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    auto& pending = m_files[order[i].file];
+    std::vector<uint8_t> loaded;
+    if (!pending.nativePath.empty())
+    {
+      std::ifstream file(pending.nativePath, std::ios::binary);
+      if (!file)
+      {
+        HIGAN_LOGi("AssetArchiveBuilder: couldn't read %s\n", pending.nativePath.c_str());
+        out.close();
+        std::filesystem::remove(tempPath, error);
+        return false;
+      }
+      loaded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const auto& contents = pending.nativePath.empty() ? pending.contents : loaded;
+    auto& entry = entries[i];
+    ContentKey key = {{0x48504b, 0x48504b}, contents.size()};
+    SpookyHash::Hash128(contents.data(), contents.size(), &key.hash[0], &key.hash[1]);
+    entry.contentHash = key.hash[0];
+    entry.size = contents.size();
+    counts.files++;
+    counts.bytes += contents.size();
+
+    auto same = stored.find(key);
+    if (same != stored.end())
+    {
+      auto& original = entries[same->second];
+      entry.offset = original.offset;
+      entry.storedSize = original.storedSize;
+      entry.flags = original.flags;
+      entry.chunkCount = original.chunkCount;
+      counts.deduplicated++;
+      continue;
+    }
+    std::vector<uint8_t> compressed;
+    if (pending.compress && !contents.empty())
+      compressed = compressChunked(contents, entry.chunkCount);
+    const auto& bytes = compressed.empty() ? contents : compressed;
+    if (compressed.empty())
+    {
+      entry.flags = 0;
+      entry.chunkCount = 0;
+    }
+    else
+    {
+      entry.flags = AssetArchive::Compressed;
+      counts.compressed++;
+    }
+
+    const uint64_t aligned = alignUp(position, m_alignment);
+    out.write(padding.data(), aligned - position);
+    entry.offset = aligned;
+    entry.storedSize = bytes.size();
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    position = aligned + bytes.size();
+    counts.storedBytes += bytes.size();
+    stored[key] = i;
+  }
+  header.fileSize = position;
+
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(uint32_t));
+  out.seekp(header.entriesOffset);
+  out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+  out.write(names.data(), names.size());
+  out.close();
+  if (!out)
+  {
+    HIGAN_LOGi("AssetArchiveBuilder: writing %s failed\n", tempPath.string().c_str());
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  std::filesystem::rename(tempPath, target, error);
+  if (error)
+  {
+    HIGAN_LOGi("AssetArchiveBuilder: couldn't replace %s: %s\n", target.string().c_str(), error.message().c_str());
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  if (stats)
+    *stats = counts;
+  return true;
+}
+}
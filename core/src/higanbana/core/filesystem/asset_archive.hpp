@@ -0,0 +1,128 @@
+#pragma once
+#include "higanbana/core/filesystem/filesystem.hpp"
+#include "higanbana/core/datastructures/vector.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace higanbana
+{
+  class MappedFile;
+
+  // Many files packed into one, read through a single mapping.
+  // Layout: Header | bucket table | entries sorted by path hash | names | aligned file data.
+  // Path hashes are bucketed by their top bits so a lookup is a bucket read and a short scan.
+  // Compressed files are stored in independent chunks after a table of chunk ends,
+  // so a range read only decompresses the chunks it touches.
+  class AssetArchive : public std::enable_shared_from_this<AssetArchive>
+  {
+  public:
+    static constexpr uint32_t Magic = 0x4b415048; // "HPAK"
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t ChunkSize = 64 * 1024;
+
+    struct Header
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t entryCount;
+      uint32_t bucketBits;
+      uint32_t chunkSize;
+      uint32_t alignment;
+      uint64_t bucketsOffset; // uint32_t[(1 << bucketBits) + 1], first entry of each bucket
+      uint64_t entriesOffset;
+      uint64_t namesOffset;
+      uint64_t namesSize;
+      uint64_t fileSize;
+    };
+
+    enum EntryFlags : uint32_t
+    {
+      Compressed = 1
+    };
+
+    struct Entry
+    {
+      uint64_t pathHash;
+      uint64_t contentHash;
+      uint64_t offset; // from the start of the archive
+      uint64_t size; // decompressed
+      uint64_t storedSize;
+      uint32_t nameOffset;
+      uint32_t nameSize;
+      uint32_t flags;
+      uint32_t chunkCount;
+    };
+
+    // nullptr if the file is missing or isn't an archive. Doesn't touch the entries.
+    static std::shared_ptr<AssetArchive> open(const char* nativePath);
+    // paths are relative to the archive root and start with '/'
+    static uint64_t hashPath(std::string_view path);
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    // entry index or -1
+    int64_t find(std::string_view path) const;
+    size_t entryCount() const noexcept { return m_header->entryCount; }
+    const Entry& entry(size_t index) const { return m_entries[index]; }
+    std::string_view name(size_t index) const;
+
+    // Whole file. Stored files point into the mapping, compressed ones are decompressed on
+    // first use and kept. The blob keeps the archive alive. Empty blob if the entry is corrupt.
+    MemoryBlob contents(size_t index);
+    // Copies [offset, offset + size) of the file to dst, decompressing only the chunks in the range.
+    // Returns bytes copied, less than size past the end of the file or on corrupt data.
+    size_t read(size_t index, size_t offset, uint8_t* dst, size_t size) const;
+
+  private:
+    AssetArchive() = default;
+    bool storedRange(const Entry& entry) const;
+    bool decompressChunk(const Entry& entry, size_t chunk, uint8_t* dst) const;
+
+    std::shared_ptr<MappedFile> m_file;
+    uint8_t* m_data = nullptr;
+    const Header* m_header = nullptr;
+    const uint32_t* m_buckets = nullptr;
+    const Entry* m_entries = nullptr;
+    const char* m_names = nullptr;
+
+    std::mutex m_decompressedLock;
+    std::unordered_map<size_t, std::shared_ptr<std::vector<uint8_t>>> m_decompressed;
+  };
+
+  // Collects files and writes them as an AssetArchive. Identical contents are stored once.
+  class AssetArchiveBuilder
+  {
+  public:
+    struct Stats
+    {
+      size_t files = 0;
+      size_t bytes = 0;
+      size_t storedBytes = 0;
+      size_t deduplicated = 0;
+      size_t compressed = 0;
+    };
+
+    AssetArchiveBuilder(uint32_t alignment = 64);
+    // path relative to the archive root, "/textures/albedo.png"
+    void add(std::string path, std::vector<uint8_t> contents, bool compress);
+    // read when the archive is written so the builder doesn't hold everything
+    void addFile(std::string path, std::string nativePath, bool compress);
+    // written next to the target and renamed over it
+    bool write(const char* nativePath, Stats* stats = nullptr);
+  private:
+    struct Pending
+    {
+      std::string path;
+      std::string nativePath;
+      std::vector<uint8_t> contents;
+      bool compress;
+    };
+    uint32_t m_alignment;
+    vector<Pending> m_files;
+  };
+}
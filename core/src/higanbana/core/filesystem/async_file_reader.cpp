@@ -0,0 +1,477 @@
+#include "higanbana/core/filesystem/async_file_reader.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+#include "higanbana/core/profiling/profiling.hpp"
+#include "higanbana/core/global_debug.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#if defined(HIGANBANA_PLATFORM_LINUX)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace higanbana
+{
+void FileReadState::wait() const
+{
+  int current = status.load(std::memory_order_acquire);
+  while (current == Pending)
+  {
+    status.wait(current, std::memory_order_acquire);
+    current = status.load(std::memory_order_acquire);
+  }
+}
+
+void FileReadState::complete(std::shared_ptr<std::vector<uint8_t>> contents)
+{
+  data = contents->data();
+  size = contents->size();
+  owner = std::move(contents);
+  if (onComplete)
+    onComplete(*this);
+  status.store(Done, std::memory_order_release);
+  status.notify_all();
+}
+
+void FileReadState::fail()
+{
+  if (onComplete)
+    onComplete(*this);
+  status.store(Failed, std::memory_order_release);
+  status.notify_all();
+}
+
+class AsyncFileReader::Impl
+{
+public:
+  virtual ~Impl() {}
+  virtual void submit(MemView<std::shared_ptr<FileReadState>> reads) = 0;
+  virtual Backend backend() const = 0;
+};
+
+namespace
+{
+bool readWholeFile(const char* path, std::vector<uint8_t>& contents)
+{
+  auto fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+  fseek(fp, 0L, SEEK_END);
+  auto fsize = ftell(fp);
+  fseek(fp, 0L, SEEK_SET);
+  if (fsize < 0)
+  {
+    fclose(fp);
+    return false;
+  }
+  contents.resize(static_cast<size_t>(fsize));
+  size_t offset = 0;
+  while (offset < contents.size())
+  {
+    auto read = fread(contents.data() + offset, 1, contents.size() - offset, fp);
+    if (read == 0)
+      break;
+    offset += read;
+  }
+  contents.resize(offset);
+  fclose(fp);
+  return true;
+}
+
+// Blocking reads on a few threads, when nothing better is around.
+class ThreadReader : public AsyncFileReader::Impl
+{
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  std::deque<std::shared_ptr<FileReadState>> m_queue;
+  bool m_stop = false;
+  std::vector<std::thread> m_threads;
+
+  void loop()
+  {
+    while (true)
+    {
+      std::shared_ptr<FileReadState> read;
+      {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_wake.wait(guard, [this]{ return m_stop || !m_queue.empty(); });
+        if (m_queue.empty())
+          return;
+        read = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      HIGAN_CPU_BRACKET("ThreadReader::read");
+      auto contents = std::make_shared<std::vector<uint8_t>>();
+      if (readWholeFile(read->nativePath.c_str(), *contents))
+        read->complete(std::move(contents));
+      else
+        read->fail();
+    }
+  }
+public:
+  ThreadReader(int threads)
+  {
+    for (int i = 0; i < std::max(threads, 1); ++i)
+      m_threads.emplace_back([this]{ loop(); });
+  }
+  ~ThreadReader()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto&& thread : m_threads)
+      thread.join();
+  }
+  void submit(MemView<std::shared_ptr<FileReadState>> reads) override
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      for (auto&& read : reads)
+        m_queue.push_back(read);
+    }
+    m_wake.notify_all();
+  }
+  AsyncFileReader::Backend backend() const override { return AsyncFileReader::Backend::Threads; }
+};
+
+#if defined(HIGANBANA_PLATFORM_LINUX)
+// Raw io_uring without liburing. One io thread owns the ring, submitters queue reads and poke an
+// eventfd that the ring itself is reading, so the io thread only ever sleeps inside io_uring_enter.
+class UringReader : public AsyncFileReader::Impl
+{
+  static constexpr unsigned RingEntries = 256;
+  static constexpr unsigned MaxInFlight = 128;
+  static constexpr uint64_t WakeTag = ~0ull;
+  static constexpr size_t MaxReadBytes = 1u << 30;
+
+  struct InFlight
+  {
+    std::shared_ptr<FileReadState> read;
+    std::shared_ptr<std::vector<uint8_t>> contents;
+    int fd = -1;
+    size_t offset = 0;
+  };
+
+  int m_ring = -1;
+  int m_wakeFd = -1;
+  uint64_t m_wakeValue = 0;
+  void* m_sqMap = nullptr;
+  size_t m_sqMapSize = 0;
+  void* m_cqMap = nullptr;
+  size_t m_cqMapSize = 0;
+  io_uring_sqe* m_sqes = nullptr;
+  size_t m_sqesSize = 0;
+  unsigned* m_sqHead = nullptr;
+  unsigned* m_sqTail = nullptr;
+  unsigned* m_sqArray = nullptr;
+  unsigned m_sqMask = 0;
+  unsigned m_sqEntries = 0;
+  unsigned* m_cqHead = nullptr;
+  unsigned* m_cqTail = nullptr;
+  unsigned m_cqMask = 0;
+  io_uring_cqe* m_cqes = nullptr;
+  unsigned m_sqLocalTail = 0;
+  unsigned m_toSubmit = 0;
+
+  std::mutex m_lock;
+  std::deque<std::shared_ptr<FileReadState>> m_queue;
+  bool m_stop = false;
+  std::thread m_thread;
+
+  // io thread only
+  std::vector<InFlight> m_slots;
+  std::vector<uint32_t> m_freeSlots;
+  std::deque<std::shared_ptr<FileReadState>> m_pending;
+
+  io_uring_sqe* nextSqe()
+  {
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (m_sqLocalTail - head >= m_sqEntries)
+      return nullptr;
+    unsigned index = m_sqLocalTail & m_sqMask;
+    auto sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    ++m_sqLocalTail;
+    ++m_toSubmit;
+    return sqe;
+  }
+
+  void prepareRead(io_uring_sqe* sqe, int fd, void* buffer, size_t bytes, uint64_t offset, uint64_t tag)
+  {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = static_cast<uint32_t>(std::min(bytes, MaxReadBytes));
+    sqe->off = offset;
+    sqe->user_data = tag;
+  }
+
+  bool armWake()
+  {
+    auto sqe = nextSqe();
+    if (!sqe)
+      return false;
+    prepareRead(sqe, m_wakeFd, &m_wakeValue, sizeof(m_wakeValue), ~0ull, WakeTag);
+    return true;
+  }
+
+  bool queueSlotRead(uint32_t slot)
+  {
+    auto sqe = nextSqe();
+    if (!sqe)
+      return false;
+    auto& inflight = m_slots[slot];
+    prepareRead(sqe, inflight.fd, inflight.contents->data() + inflight.offset, inflight.contents->size() - inflight.offset, inflight.offset, slot);
+    return true;
+  }
+
+  void finish(uint32_t slot, bool success)
+  {
+    auto& inflight = m_slots[slot];
+    close(inflight.fd);
+    if (success)
+    {
+      inflight.contents->resize(inflight.offset);
+      inflight.read->complete(std::move(inflight.contents));
+    }
+    else
+      inflight.read->fail();
+    inflight = InFlight{};
+    m_freeSlots.push_back(slot);
+  }
+
+  // open and size synchronously, the reads themselves go to the ring.
+  void startPending()
+  {
+    while (!m_pending.empty() && !m_freeSlots.empty())
+    {
+      auto read = std::move(m_pending.front());
+      m_pending.pop_front();
+      int fd = open(read->nativePath.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat info;
+      if (fd < 0 || fstat(fd, &info) != 0)
+      {
+        if (fd >= 0)
+          close(fd);
+        read->fail();
+        continue;
+      }
+      auto contents = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(info.st_size));
+      if (contents->empty())
+      {
+        close(fd);
+        read->complete(std::move(contents));
+        continue;
+      }
+      auto slot = m_freeSlots.back();
+      m_freeSlots.pop_back();
+      m_slots[slot] = InFlight{std::move(read), std::move(contents), fd, 0};
+      // ring has room for every slot and the wake read
+      bool queued = queueSlotRead(slot);
+      HIGAN_ASSERT(queued, "submission queue full");
+    }
+  }
+
+  void reap()
+  {
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+      auto& cqe = m_cqes[head & m_cqMask];
+      if (cqe.user_data == WakeTag)
+      {
+        armWake();
+        continue;
+      }
+      auto slot = static_cast<uint32_t>(cqe.user_data);
+      auto& inflight = m_slots[slot];
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+        queueSlotRead(slot);
+      else if (cqe.res < 0)
+        finish(slot, false);
+      else
+      {
+        inflight.offset += static_cast<size_t>(cqe.res);
+        // file shrunk under us, keep what was there
+        if (cqe.res == 0 || inflight.offset == inflight.contents->size())
+          finish(slot, true);
+        else
+          queueSlotRead(slot);
+      }
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+  }
+
+  void loop()
+  {
+    armWake();
+    while (true)
+    {
+      bool stop;
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        stop = m_stop;
+        while (!m_queue.empty())
+        {
+          m_pending.push_back(std::move(m_queue.front()));
+          m_queue.pop_front();
+        }
+      }
+      startPending();
+      if (stop && m_pending.empty() && m_freeSlots.size() == m_slots.size())
+        break;
+      __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+      int submitted = static_cast<int>(syscall(__NR_io_uring_enter, m_ring, m_toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+      if (submitted < 0)
+      {
+        HIGAN_ASSERT(errno == EINTR || errno == EBUSY, "io_uring_enter failed %d", errno);
+      }
+      else
+        m_toSubmit -= static_cast<unsigned>(submitted);
+      reap();
+    }
+  }
+
+public:
+  bool init()
+  {
+    io_uring_params params{};
+    m_ring = static_cast<int>(syscall(__NR_io_uring_setup, RingEntries, &params));
+    if (m_ring < 0)
+      return false;
+    m_sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+      m_sqMapSize = m_cqMapSize = std::max(m_sqMapSize, m_cqMapSize);
+    m_sqMap = mmap(nullptr, m_sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+    if (m_sqMap == MAP_FAILED)
+    {
+      m_sqMap = nullptr;
+      return false;
+    }
+    m_cqMap = singleMap ? m_sqMap : mmap(nullptr, m_cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+    if (m_cqMap == MAP_FAILED)
+    {
+      m_cqMap = nullptr;
+      return false;
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return false;
+    m_sqes = reinterpret_cast<io_uring_sqe*>(sqes);
+    auto sq = reinterpret_cast<uint8_t*>(m_sqMap);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sqLocalTail = *m_sqTail;
+    auto cq = reinterpret_cast<uint8_t*>(m_cqMap);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    m_wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (m_wakeFd < 0)
+      return false;
+    auto inFlight = std::min(MaxInFlight, m_sqEntries - 1);
+    m_slots.resize(inFlight);
+    for (uint32_t i = 0; i < inFlight; ++i)
+      m_freeSlots.push_back(inFlight - 1 - i);
+    m_thread = std::thread([this]{ loop(); });
+    return true;
+  }
+
+  ~UringReader()
+  {
+    if (m_thread.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+      }
+      uint64_t one = 1;
+      [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+      m_thread.join();
+    }
+    if (m_sqes)
+      munmap(m_sqes, m_sqesSize);
+    if (m_cqMap && m_cqMap != m_sqMap)
+      munmap(m_cqMap, m_cqMapSize);
+    if (m_sqMap)
+      munmap(m_sqMap, m_sqMapSize);
+    if (m_wakeFd >= 0)
+      close(m_wakeFd);
+    if (m_ring >= 0)
+      close(m_ring);
+  }
+
+  void submit(MemView<std::shared_ptr<FileReadState>> reads) override
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      for (auto&& read : reads)
+        m_queue.push_back(read);
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+  }
+  AsyncFileReader::Backend backend() const override { return AsyncFileReader::Backend::IoUring; }
+};
+#endif
+}
+
+AsyncFileReader::AsyncFileReader(Backend backend, int threads)
+{
+#if defined(HIGANBANA_PLATFORM_LINUX)
+  if (backend != Backend::Threads)
+  {
+    auto uring = std::make_unique<UringReader>();
+    // seccomp'd containers and old kernels refuse io_uring
+    if (uring->init())
+      m_impl = std::move(uring);
+  }
+#endif
+  if (!m_impl)
+    m_impl = std::make_unique<ThreadReader>(threads);
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+}
+
+void AsyncFileReader::submit(std::shared_ptr<FileReadState> read)
+{
+  m_impl->submit(MemView<std::shared_ptr<FileReadState>>(read));
+}
+
+void AsyncFileReader::submit(MemView<std::shared_ptr<FileReadState>> reads)
+{
+  if (!reads.empty())
+    m_impl->submit(reads);
+}
+
+AsyncFileReader::Backend AsyncFileReader::backend() const
+{
+  return m_impl->backend();
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "higanbana/core/system/memview.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace higanbana
+{
+  // One whole file read, shared between the submitter and the io thread.
+  struct FileReadState
+  {
+    enum Status : int
+    {
+      Pending,
+      Done,
+      Failed
+    };
+    std::string nativePath;
+    std::atomic<int> status = Pending;
+    // contents, owner keeps data alive
+    std::shared_ptr<void> owner;
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    // runs on the io thread after the contents are in, before waiters wake
+    std::function<void(FileReadState&)> onComplete;
+
+    bool ready() const { return status.load(std::memory_order_acquire) != Pending; }
+    void wait() const;
+    void complete(std::shared_ptr<std::vector<uint8_t>> contents);
+    void fail();
+  };
+
+  // Reads whole files in the background. io_uring on Linux with as many reads in flight as the
+  // queue allows, a few blocking reader threads elsewhere or when the kernel says no.
+  class AsyncFileReader
+  {
+  public:
+    enum class Backend
+    {
+      Auto,
+      IoUring,
+      Threads
+    };
+    class Impl;
+
+    AsyncFileReader(Backend backend = Backend::Auto, int threads = 4);
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+    // finishes everything submitted before returning
+    ~AsyncFileReader();
+
+    void submit(std::shared_ptr<FileReadState> read);
+    // one wakeup for the whole batch
+    void submit(MemView<std::shared_ptr<FileReadState>> reads);
+    Backend backend() const;
+  private:
+    std::unique_ptr<Impl> m_impl;
+  };
+}
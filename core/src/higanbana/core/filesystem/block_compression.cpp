@@ -0,0 +1,172 @@
+#include "higanbana/core/filesystem/block_compression.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace higanbana
+{
+namespace blockCompression
+{
+namespace
+{
+constexpr int HashBits = 12;
+constexpr size_t MinMatch = 4;
+// the tail is always literals so matches never read past the end
+constexpr size_t LastLiterals = 5;
+constexpr size_t MaxOffset = 65535;
+
+uint32_t read32(const uint8_t* ptr)
+{
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+uint32_t hashOf(uint32_t value)
+{
+  return (value * 2654435761u) >> (32 - HashBits);
+}
+
+bool writeLength(uint8_t*& out, const uint8_t* end, size_t length)
+{
+  while (length >= 255)
+  {
+    if (out >= end)
+      return false;
+    *out++ = 255;
+    length -= 255;
+  }
+  if (out >= end)
+    return false;
+  *out++ = static_cast<uint8_t>(length);
+  return true;
+}
+
+bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+{
+  uint8_t byte;
+  do
+  {
+    if (in >= end)
+      return false;
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// matchLength 0 is the last sequence, literals only
+bool writeSequence(uint8_t*& out, const uint8_t* end, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+  if (out >= end)
+    return false;
+  uint8_t* token = out++;
+  size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+  *token = static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+  if (literalCount >= 15 && !writeLength(out, end, literalCount - 15))
+    return false;
+  if (static_cast<size_t>(end - out) < literalCount)
+    return false;
+  memcpy(out, literals, literalCount);
+  out += literalCount;
+  if (matchLength == 0)
+    return true;
+  if (end - out < 2)
+    return false;
+  *out++ = static_cast<uint8_t>(offset);
+  *out++ = static_cast<uint8_t>(offset >> 8);
+  return matchCode < 15 || writeLength(out, end, matchCode - 15);
+}
+}
+
+size_t compressBound(size_t size)
+{
+  return size + size / 255 + 16;
+}
+
+size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+{
+  uint32_t table[1 << HashBits] = {};
+  uint8_t* out = dst;
+  const uint8_t* end = dst + capacity;
+  size_t anchor = 0;
+  size_t pos = 0;
+  if (size > MinMatch + LastLiterals)
+  {
+    const size_t lastMatchStart = size - LastLiterals - MinMatch;
+    while (pos <= lastMatchStart)
+    {
+      uint32_t value = read32(src + pos);
+      auto& slot = table[hashOf(value)];
+      size_t candidate = slot;
+      slot = static_cast<uint32_t>(pos);
+      if (candidate >= pos || pos - candidate > MaxOffset || read32(src + candidate) != value)
+      {
+        // skip faster through data that doesn't compress
+        pos += 1 + ((pos - anchor) >> 6);
+        continue;
+      }
+      size_t length = MinMatch;
+      const size_t maxLength = size - LastLiterals - pos;
+      while (length < maxLength && src[candidate + length] == src[pos + length])
+        ++length;
+      while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1])
+      {
+        --pos;
+        --candidate;
+        ++length;
+      }
+      if (!writeSequence(out, end, src + anchor, pos - anchor, pos - candidate, length))
+        return 0;
+      pos += length;
+      anchor = pos;
+      if (pos - 2 <= lastMatchStart)
+        table[hashOf(read32(src + pos - 2))] = static_cast<uint32_t>(pos - 2);
+    }
+  }
+  if (!writeSequence(out, end, src + anchor, size - anchor, 0, 0))
+    return 0;
+  return static_cast<size_t>(out - dst);
+}
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+  const uint8_t* in = src;
+  const uint8_t* inEnd = src + srcSize;
+  uint8_t* out = dst;
+  uint8_t* outEnd = dst + dstSize;
+  while (in < inEnd)
+  {
+    uint8_t token = *in++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(in, inEnd, literals))
+      return false;
+    if (static_cast<size_t>(inEnd - in) < literals || static_cast<size_t>(outEnd - out) < literals)
+      return false;
+    memcpy(out, in, literals);
+    in += literals;
+    out += literals;
+    if (in == inEnd)
+      break;
+    if (inEnd - in < 2)
+      return false;
+    size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+    in += 2;
+    size_t length = token & 15;
+    if (length == 15 && !readLength(in, inEnd, length))
+      return false;
+    length += MinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(out - dst) || static_cast<size_t>(outEnd - out) < length)
+      return false;
+    const uint8_t* match = out - offset;
+    if (offset >= length)
+      memcpy(out, match, length);
+    else
+      for (size_t i = 0; i < length; ++i)
+        out[i] = match[i];
+    out += length;
+  }
+  return out == outEnd;
+}
+}
+}
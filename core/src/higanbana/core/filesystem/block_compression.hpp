@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace higanbana
+{
+  // LZ4 style block codec, token + literals + 16 bit offset matches. Fast to decode, no entropy coding.
+  // Blocks are independent and the window is 64KB, so callers compress in chunks of at most that.
+  namespace blockCompression
+  {
+    // worst case output for incompressible input
+    size_t compressBound(size_t size);
+    // returns compressed size, 0 if it didn't fit in capacity
+    size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+    // dstSize has to be the exact decompressed size, false on corrupt input
+    bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+  }
+}
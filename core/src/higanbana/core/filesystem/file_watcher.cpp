@@ -0,0 +1,226 @@
+#include "higanbana/core/filesystem/file_watcher.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+#include "higanbana/core/profiling/profiling.hpp"
+#include "higanbana/core/global_debug.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(HIGANBANA_PLATFORM_LINUX)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace higanbana
+{
+class FileWatcher::Impl
+{
+public:
+  virtual ~Impl() {}
+  virtual bool watch(const std::string& nativePath, const std::string& tag) = 0;
+  std::atomic<bool> m_pending = false;
+  std::mutex m_lock;
+  std::unordered_set<std::string> m_changed;
+  vector<std::string> m_unwatched;
+
+  void drain(vector<std::string>& changedTags, vector<std::string>& unwatchedTags)
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_pending.store(false, std::memory_order_relaxed);
+    for (auto&& tag : m_changed)
+      changedTags.push_back(tag);
+    m_changed.clear();
+    for (auto&& tag : m_unwatched)
+      unwatchedTags.push_back(tag);
+    m_unwatched.clear();
+  }
+};
+
+#if defined(HIGANBANA_PLATFORM_LINUX)
+namespace
+{
+// One watch per directory, events for files nobody asked about are dropped on the watcher thread.
+class InotifyWatcher : public FileWatcher::Impl
+{
+  static constexpr uint32_t WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB;
+  int m_inotify = -1;
+  int m_stopFd = -1;
+  std::thread m_thread;
+  // under m_lock
+  std::unordered_map<int, std::string> m_directories;
+  std::unordered_map<std::string, int> m_directoryWatches;
+  std::unordered_map<std::string, std::string> m_tags; // directory/filename -> tag
+
+  static std::string key(const std::string& directory, const char* filename)
+  {
+    return directory + "/" + filename;
+  }
+
+  void queueAllLocked()
+  {
+    for (auto&& [path, tag] : m_tags)
+      m_changed.insert(tag);
+  }
+
+  void handle(const inotify_event& event)
+  {
+    if (event.mask & IN_Q_OVERFLOW)
+    {
+      // lost track of what happened, everything might have changed
+      HIGAN_LOGi("FileWatcher: inotify queue overflowed, treating every watched file as changed\n");
+      queueAllLocked();
+      return;
+    }
+    auto directory = m_directories.find(event.wd);
+    if (directory == m_directories.end())
+      return;
+    if (event.mask & IN_IGNORED)
+    {
+      // directory went away, nothing asks for its files again so they are handed back for polling
+      auto prefix = directory->second + "/";
+      for (auto tag = m_tags.begin(); tag != m_tags.end();)
+      {
+        auto& path = tag->first;
+        if (path.compare(0, prefix.size(), prefix) == 0 && path.find('/', prefix.size()) == std::string::npos)
+        {
+          m_changed.insert(tag->second);
+          m_unwatched.push_back(tag->second);
+          tag = m_tags.erase(tag);
+        }
+        else
+          ++tag;
+      }
+      m_directoryWatches.erase(directory->second);
+      m_directories.erase(directory);
+      return;
+    }
+    if (event.len == 0)
+      return;
+    auto found = m_tags.find(key(directory->second, event.name));
+    if (found != m_tags.end())
+      m_changed.insert(found->second);
+  }
+
+  void loop()
+  {
+    alignas(inotify_event) char buffer[16 * 1024];
+    pollfd fds[2] = {{m_inotify, POLLIN, 0}, {m_stopFd, POLLIN, 0}};
+    while (true)
+    {
+      if (poll(fds, 2, -1) < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        HIGAN_LOGi("FileWatcher: poll failed (%d), watching stopped\n", errno);
+        return;
+      }
+      if (fds[1].revents)
+        return;
+      auto bytes = read(m_inotify, buffer, sizeof(buffer));
+      if (bytes <= 0)
+        continue;
+      HIGAN_CPU_BRACKET("FileWatcher::events");
+      std::lock_guard<std::mutex> guard(m_lock);
+      for (char* ptr = buffer; ptr < buffer + bytes;)
+      {
+        auto& event = *reinterpret_cast<inotify_event*>(ptr);
+        handle(event);
+        ptr += sizeof(inotify_event) + event.len;
+      }
+      if (!m_changed.empty())
+        m_pending.store(true, std::memory_order_relaxed);
+    }
+  }
+public:
+  bool init()
+  {
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+      return false;
+    m_stopFd = eventfd(0, EFD_CLOEXEC);
+    if (m_stopFd < 0)
+      return false;
+    m_thread = std::thread([this]{ loop(); });
+    return true;
+  }
+
+  ~InotifyWatcher()
+  {
+    if (m_thread.joinable())
+    {
+      uint64_t one = 1;
+      [[maybe_unused]] auto written = write(m_stopFd, &one, sizeof(one));
+      m_thread.join();
+    }
+    if (m_stopFd >= 0)
+      close(m_stopFd);
+    if (m_inotify >= 0)
+      close(m_inotify);
+  }
+
+  bool watch(const std::string& nativePath, const std::string& tag) override
+  {
+    auto path = std::filesystem::path(nativePath).lexically_normal();
+    auto directory = path.parent_path().string();
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_directoryWatches.find(directory) == m_directoryWatches.end())
+    {
+      int wd = inotify_add_watch(m_inotify, directory.c_str(), WatchMask);
+      if (wd < 0)
+      {
+        HIGAN_LOGi("FileWatcher: couldn't watch %s (%d)\n", directory.c_str(), errno);
+        return false;
+      }
+      m_directoryWatches[directory] = wd;
+      m_directories[wd] = directory;
+    }
+    m_tags[key(directory, path.filename().c_str())] = tag;
+    return true;
+  }
+};
+}
+#endif
+
+FileWatcher::FileWatcher()
+{
+#if defined(HIGANBANA_PLATFORM_LINUX)
+  auto inotify = std::make_unique<InotifyWatcher>();
+  if (inotify->init())
+    m_impl = std::move(inotify);
+  else
+    HIGAN_LOGi("FileWatcher: inotify unavailable (%d), falling back to polling\n", errno);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+bool FileWatcher::valid() const
+{
+  return m_impl != nullptr;
+}
+
+bool FileWatcher::watch(const std::string& nativePath, const std::string& tag)
+{
+  return m_impl && m_impl->watch(nativePath, tag);
+}
+
+bool FileWatcher::pending() const
+{
+  return m_impl && m_impl->m_pending.load(std::memory_order_relaxed);
+}
+
+void FileWatcher::drain(vector<std::string>& changedTags, vector<std::string>& unwatchedTags)
+{
+  if (m_impl)
+    m_impl->drain(changedTags, unwatchedTags);
+}
+}
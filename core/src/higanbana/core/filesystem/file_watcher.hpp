@@ -0,0 +1,33 @@
+#pragma once
+#include "higanbana/core/datastructures/vector.hpp"
+#include <memory>
+#include <string>
+
+namespace higanbana
+{
+  // Gets told by the os when watched files change instead of asking about each one.
+  // inotify on Linux, a watcher thread queues the changes and pending() is all that's left per frame.
+  // Elsewhere valid() is false and the caller keeps polling.
+  class FileWatcher
+  {
+  public:
+    class Impl;
+
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    bool valid() const;
+    // tag comes back from drain when the file is written, replaced or touched.
+    // Watches the directory so editors saving through a rename are seen too.
+    bool watch(const std::string& nativePath, const std::string& tag);
+    // one relaxed load, true when drain has something
+    bool pending() const;
+    // tags of the files changed since the last drain, each once.
+    // unwatchedTags gets the files whose directory was deleted, the watcher has forgotten them.
+    void drain(vector<std::string>& changedTags, vector<std::string>& unwatchedTags);
+  private:
+    std::unique_ptr<Impl> m_impl;
+  };
+}
@@ -1,4 +1,6 @@
 #include "higanbana/core/filesystem/filesystem.hpp"
+#include "higanbana/core/filesystem/asset_archive.hpp"
+#include "higanbana/core/filesystem/mapped_file.hpp"
 #include "higanbana/core/profiling/profiling.hpp"
 #include "higanbana/core/system/time.hpp"
 #include "higanbana/core/global_debug.hpp"
@@ -98,27 +100,39 @@ MemoryBlob::MemoryBlob()
 }
 
 MemoryBlob::MemoryBlob(std::vector<uint8_t> data)
-  : m_data(data)
+{
+  auto owned = std::make_shared<std::vector<uint8_t>>(std::move(data));
+  m_data = owned->data();
+  m_size = owned->size();
+  m_owner = std::move(owned);
+}
+
+MemoryBlob::MemoryBlob(std::shared_ptr<void> owner, uint8_t* data, size_t size)
+  : m_owner(std::move(owner))
+  , m_data(data)
+  , m_size(size)
 {
 }
 
 size_t MemoryBlob::size() const noexcept
 {
-  return m_data.size();
+  return m_size;
 }
 
 uint8_t* MemoryBlob::data() noexcept
 {
-  return m_data.data();
+  return m_data;
 }
 
 const uint8_t* MemoryBlob::cdata() const noexcept
 {
-  return m_data.data();
+  return m_data;
 }
 
 std::vector<uint8_t> readFileNative(const char* path) {
   auto fp = fopen(path, "rb");
+  if (!fp)
+    return {};
   fseek(fp, 0L, SEEK_END);
   auto fsize = ftell(fp);
   fseek(fp, 0L, SEEK_SET);
@@ -127,10 +141,11 @@ std::vector<uint8_t> readFileNative(const char* path) {
   size_t offset = 0;
   while (leftToRead > 0)
   {
-    offset = fread(contents.data() + offset, sizeof(uint8_t), leftToRead, fp);
-    if (offset == 0)
+    auto read = fread(contents.data() + offset, sizeof(uint8_t), leftToRead, fp);
+    if (read == 0)
       break;
-    leftToRead -= offset;
+    offset += read;
+    leftToRead -= read;
   }
   fclose(fp);
   return contents;
@@ -163,8 +178,9 @@ std::string FileSystem::mountPoint(std::string_view filepath) {
 }
 std::string FileSystem::mountPointOSPath(std::string_view filepath) {
   auto mp = mountPoint(filepath);
-  HIGAN_ASSERT(m_mappings.find(mp) != m_mappings.end(), "uups");
-  return m_mappings[mp];
+  auto found = m_mappings.find(mp);
+  HIGAN_ASSERT(found != m_mappings.end(), "uups");
+  return found->second;
 }
 
 std::optional<std::string> FileSystem::resolveNativePath(std::string_view filepath) {
@@ -175,7 +191,9 @@ std::optional<std::string> FileSystem::resolveNativePath(std::string_view filepa
     auto name = f->second;
     if (getFirst < filepath.size())
       name += std::string(filepath.substr(getFirst));
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
     std::replace(name.begin(), name.end(), '/', '\\');
+#endif
     //HIGAN_LOGi("base path: \"%s\" => \"%s\"\n", filepath.data(), name.c_str());
     return name;
   }
@@ -186,7 +204,14 @@ FileSystem::FileSystem()
 {
 }
 
-FileSystem::FileSystem(std::string relativeOffset, MappingMode mode, const char* mappingFileName)
+FileSystem::FileSystem(std::unordered_map<std::string, std::string> mappings, LoadMode loadMode)
+  : m_mappings(std::move(mappings))
+  , m_loadMode(loadMode)
+{
+}
+
+FileSystem::FileSystem(std::string relativeOffset, MappingMode mode, const char* mappingFileName, LoadMode loadMode)
+  : m_loadMode(loadMode)
 {
   auto ourPath = system_fs::current_path().string();
   auto mappings = tryExtractMappings(ourPath + relativeOffset + "/mapping.json");
@@ -212,13 +237,59 @@ void FileSystem::initialLoad() {
   m_initialLoadComplete = true;
 }
 
+bool FileSystem::mountArchive(std::string mountPoint, std::string archiveNativePath) {
+  HIGAN_CPU_FUNCTION_SCOPE();
+  HIGAN_ASSERT(mountPoint.size() > 1 && mountPoint[0] == '/' && mountPoint.find('/', 1) == std::string::npos, "mount points look like \"/name\"");
+  auto archive = AssetArchive::open(archiveNativePath.c_str());
+  if (!archive) {
+    HIGAN_LOGi("Filesystem: %s isn't an asset archive\n", archiveNativePath.c_str());
+    return false;
+  }
+  std::error_code error;
+  auto time = static_cast<size_t>(system_fs::last_write_time(archiveNativePath, error).time_since_epoch().count());
+  HIGAN_ILOG("Filesystem", "mounted %s with %zu files at %s", archiveNativePath.c_str(), archive->entryCount(), mountPoint.c_str());
+  for (auto&& mounted : m_archives) {
+    if (mounted.mountPoint == mountPoint) {
+      mounted = {mountPoint, std::move(archive), time};
+      return true;
+    }
+  }
+  m_archives.push_back({mountPoint, std::move(archive), time});
+  return true;
+}
+
+FileSystem::MountedArchive* FileSystem::archiveOf(std::string_view path, std::string_view& relative) {
+  for (auto&& mounted : m_archives) {
+    auto& mp = mounted.mountPoint;
+    if (path.compare(0, mp.size(), mp) == 0 && (path.size() == mp.size() || path[mp.size()] == '/')) {
+      relative = path.substr(mp.size());
+      return &mounted;
+    }
+  }
+  return nullptr;
+}
+
+void FileSystem::ensureInitialLoad() {
+  if (m_initialLoadComplete.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::mutex> guard(m_initialLoadLock);
+  if (!m_initialLoadComplete.load(std::memory_order_relaxed))
+    initialLoad();
+}
+
+FileSystem::FileShard& FileSystem::shardOf(const std::string& path) {
+  return m_files[std::hash<std::string>{}(path) % FileShardCount];
+}
+
 std::string FileSystem::directoryPath(std::string filePath) {
   return system_fs::path(filePath).parent_path().string();
 }
 
 bool FileSystem::tryLoadFile(std::string path) {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+    return mounted->archive->find(relative) >= 0;
   auto fullPath = resolveNativePath(path).value();
   FileInfo info;
   info.nativePath = fullPath;
@@ -231,16 +302,13 @@ bool FileSystem::tryLoadFile(std::string path) {
 bool FileSystem::fileExists(std::string path)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  if (!m_initialLoadComplete)
-    initialLoad();
-  std::lock_guard<std::mutex> guard(m_lock);
-  //auto fullPath = system_fs::path(getBasePath() + path).string();
-#if defined(HIGANBANA_PLATFORM_WINDOWS)
-  //std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
-#endif
-  auto found = m_files.find(path);
-  auto end = m_files.end();
-  auto hasFile = found != end;
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+    return mounted->archive->find(relative) >= 0;
+  ensureInitialLoad();
+  auto& shard = shardOf(path);
+  std::shared_lock<std::shared_mutex> guard(shard.lock);
+  auto hasFile = shard.files.find(path) != shard.files.end();
   FS_ILOG("checking %s... %s\n", path.c_str(), hasFile ? "found" : "error");
   return hasFile;
 }
@@ -252,24 +320,101 @@ bool FileSystem::loadFileFromHDD(FileInfo& path, std::string mountpoint, size_t&
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
   std::replace(path.nativePath.begin(), path.nativePath.end(), '/', '\\');
 #endif
-  auto last5 = path.withoutNative.substr(path.withoutNative.size()-5);
-  if (strcmp("trace", last5.c_str()) == 0)
+  auto& name = path.withoutNative;
+  if (name.size() >= 5 && name.compare(name.size() - 5, 5, "trace") == 0)
     return false;
-  std::vector<uint8_t> contents = readFileNative(path.nativePath.c_str());
-  //contents.resize(size - leftToRead);
   auto time = static_cast<size_t>(system_fs::last_write_time(path.nativePath).time_since_epoch().count());
-  auto fsize = contents.size();
-  FS_ILOG("found file %s(%zu), loading %.2fMB(%ld)...", path.nativePath.c_str(), time, static_cast<float>(fsize) / 1024.f / 1024.f, fsize);
   auto fullpath = mountpoint + path.withoutNative;
-  m_files[fullpath] = FileObj{ time, contents };
-  size = contents.size();
+  // contents are loaded by the first access with MapOnDemand
+  std::shared_ptr<std::vector<uint8_t>> contents;
+  size = static_cast<size_t>(system_fs::file_size(path.nativePath));
+  if (m_loadMode == LoadMode::ReadEverything)
+  {
+    contents = std::make_shared<std::vector<uint8_t>>(readFileNative(path.nativePath.c_str()));
+    FS_ILOG("found file %s(%zu), loading %.2fMB(%zu)...", path.nativePath.c_str(), time, static_cast<float>(contents->size()) / 1024.f / 1024.f, contents->size());
+    size = contents->size();
+  }
+  auto& shard = shardOf(fullpath);
+  std::unique_lock<std::shared_mutex> guard(shard.lock);
+  auto& file = shard.files[fullpath];
+  file.timeModified = time;
+  file.nativePath = path.nativePath;
+  file.data = contents ? contents->data() : nullptr;
+  file.size = size;
+  file.owner = std::move(contents);
+  return true;
+}
+
+MemView<const uint8_t> FileSystem::contentsLocked(FileObj& file)
+{
+  if (!file.owner && !file.nativePath.empty())
+  {
+    HIGAN_CPU_BRACKET("FileSystem::loadOnDemand");
+    std::shared_ptr<MappedFile> mapped;
+    if (file.size >= MapThreshold)
+      mapped = MappedFile::open(file.nativePath.c_str());
+    if (mapped)
+    {
+      file.data = mapped->data();
+      file.size = mapped->size();
+      file.owner = std::move(mapped);
+    }
+    else
+    {
+      auto contents = std::make_shared<std::vector<uint8_t>>(readFileNative(file.nativePath.c_str()));
+      file.data = contents->data();
+      file.size = contents->size();
+      file.owner = std::move(contents);
+    }
+  }
+  return MemView<const uint8_t>(file.data, file.size);
+}
+
+bool FileSystem::contents(const std::string& path, MemView<const uint8_t>& view, MemoryBlob* blob)
+{
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+  {
+    auto index = mounted->archive->find(relative);
+    if (index < 0)
+      return false;
+    // stored files point into the mapping and decompressed ones stay cached, views outlive the blob
+    auto contents = mounted->archive->contents(static_cast<size_t>(index));
+    view = MemView<const uint8_t>(contents.cdata(), contents.size());
+    if (blob)
+      *blob = std::move(contents);
+    return true;
+  }
+  auto& shard = shardOf(path);
+  {
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto found = shard.files.find(path);
+    if (found == shard.files.end())
+      return false;
+    auto& file = found->second;
+    if (file.owner)
+    {
+      view = MemView<const uint8_t>(file.data, file.size);
+      if (blob)
+        *blob = MemoryBlob(file.owner, file.data, file.size);
+      return true;
+    }
+  }
+  // first access, load under the exclusive lock so it happens once
+  std::unique_lock<std::shared_mutex> guard(shard.lock);
+  auto found = shard.files.find(path);
+  if (found == shard.files.end())
+    return false;
+  auto& file = found->second;
+  view = contentsLocked(file);
+  if (blob)
+    *blob = MemoryBlob(file.owner, file.data, file.size);
   return true;
 }
 
 void FileSystem::loadDirectoryContentsRecursive(std::string path)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
   auto targetmount = mountPointOSPath(path);
   auto mp = mountPoint(path);
   auto fullPath = resolveNativePath(path).value();
@@ -286,7 +431,10 @@ void FileSystem::loadDirectoryContentsRecursive(std::string path)
     allSize += fileSize;
   }
   int64_t micros = loadSpeed.timeMicro();
-  if (!files.empty()) {
+  if (!files.empty() && m_loadMode == LoadMode::MapOnDemand) {
+    HIGAN_ILOG("Filesystem", "found %zu files(%.2fMB total) in %.2fms, loading on demand", files.size(), static_cast<float>(allSize) / 1024.f / 1024.f, micros / 1000.0);
+  }
+  else if (!files.empty()) {
     double bandwidth = (double(allSize)/ 1000.0 / 1000.0 / 1000.0) / (double(micros)/1000.0/1000.0);
     HIGAN_ILOG("Filesystem", "found and loaded %zu files(%.2fMB total, %.3fGB/s)", files.size(), static_cast<float>(allSize) / 1024.f / 1024.f, bandwidth);
   }
@@ -296,7 +444,21 @@ void FileSystem::loadDirectoryContentsRecursive(std::string path)
 void FileSystem::getFilesWithinDir(std::string path, std::function<void(std::string&, MemView<const uint8_t>)> func)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+  {
+    auto& archive = *mounted->archive;
+    for (size_t i = 0; i < archive.entryCount(); ++i)
+    {
+      auto name = archive.name(i);
+      if (name.compare(0, relative.size(), relative) != 0)
+        continue;
+      std::string withoutMount(name);
+      auto contents = archive.contents(i);
+      func(withoutMount, MemView<const uint8_t>(contents.cdata(), contents.size()));
+    }
+    return;
+  }
   const auto ospath = mountPointOSPath(path);
   const auto mp = mountPoint(path);
   auto fullPath = resolveNativePath(path);
@@ -304,10 +466,10 @@ void FileSystem::getFilesWithinDir(std::string path, std::function<void(std::str
   getFilesRecursive(fullPath.value(), ospath, files);
   for (auto&& it : files)
   {
-    auto f = m_files.find(mp + it.withoutNative);
-    if (f != m_files.end())
+    MemView<const uint8_t> view;
+    if (contents(mp + it.withoutNative, view, nullptr))
     {
-      func(it.withoutNative, higanbana::MemView<const uint8_t>(f->second.data));
+      func(it.withoutNative, view);
     }
   }
 }
@@ -315,7 +477,6 @@ void FileSystem::getFilesWithinDir(std::string path, std::function<void(std::str
 vector<std::string> FileSystem::getFilesWithinDir(std::string path)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
   const auto mountpoint = mountPoint(path);
   auto fullPath = mountpoint + path;
   std::vector<FileInfo> natfiles;
@@ -331,8 +492,20 @@ vector<std::string> FileSystem::getFilesWithinDir(std::string path)
 vector<std::string> FileSystem::recursiveList(std::string path, std::string filter)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
   const auto mp = mountPoint(path);
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+  {
+    vector<std::string> outFiles;
+    auto& archive = *mounted->archive;
+    for (size_t i = 0; i < archive.entryCount(); ++i)
+    {
+      auto name = archive.name(i);
+      if (name.compare(0, relative.size(), relative) == 0 && name.find(filter) != std::string_view::npos)
+        outFiles.emplace_back(mp + std::string(name));
+    }
+    return outFiles;
+  }
   const auto osPath = mountPointOSPath(path);
   auto fullPath = resolveNativePath(path).value();
   std::vector<FileInfo> files;
@@ -349,35 +522,189 @@ vector<std::string> FileSystem::recursiveList(std::string path, std::string filt
 MemoryBlob FileSystem::readFile(std::string path)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
+  ensureInitialLoad();
   MemoryBlob blob;
-  if (!m_initialLoadComplete)
-    initialLoad();
-  if (fileExists(path))
-  {
-    FS_ILOG("Reading... %s\n", path.c_str());
-    std::lock_guard<std::mutex> guard(m_lock);
-    auto& file = m_files[path];
-    blob = MemoryBlob(file.data);
-  }
+  MemView<const uint8_t> view;
+  FS_ILOG("Reading... %s\n", path.c_str());
+  contents(path, view, &blob);
   return blob;
 }
 
 higanbana::MemView<const uint8_t> FileSystem::viewToFile(std::string path)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  if (!m_initialLoadComplete)
-    initialLoad();
+  ensureInitialLoad();
   higanbana::MemView<const uint8_t> view;
-  if (fileExists(path))
+  contents(path, view, nullptr);
+  return view;
+}
+
+FileRead::FileRead()
+{
+}
+
+FileRead::FileRead(std::shared_ptr<FileReadState> state)
+  : m_state(std::move(state))
+{
+}
+
+bool FileRead::ready() const
+{
+  return !m_state || m_state->ready();
+}
+
+bool FileRead::failed() const
+{
+  return !m_state || m_state->status.load(std::memory_order_acquire) == FileReadState::Failed;
+}
+
+MemoryBlob FileRead::get()
+{
+  if (!m_state)
+    return MemoryBlob();
+  m_state->wait();
+  if (m_state->status.load(std::memory_order_acquire) == FileReadState::Failed)
+    return MemoryBlob();
+  return MemoryBlob(m_state->owner, m_state->data, m_state->size);
+}
+
+AsyncFileReader& FileSystem::reader()
+{
+  std::call_once(m_readerOnce, [this]{ m_reader = std::make_unique<AsyncFileReader>(); });
+  return *m_reader;
+}
+
+// null when there is nothing to read, the returned state is already complete then.
+std::shared_ptr<FileReadState> FileSystem::prepareRead(const std::string& path)
+{
+  auto read = std::make_shared<FileReadState>();
+  std::string_view relative;
+  if (archiveOf(path, relative))
   {
-    std::lock_guard<std::mutex> guard(m_lock);
-    view = higanbana::MemView<const uint8_t>(m_files[path].data);
+    // already mapped, nothing to wait for
+    MemView<const uint8_t> view;
+    MemoryBlob blob;
+    read->status = contents(path, view, &blob) ? FileReadState::Done : FileReadState::Failed;
+    read->data = blob.data();
+    read->size = blob.size();
+    read->owner = std::make_shared<MemoryBlob>(std::move(blob));
+    return read;
   }
-  return view;
+  auto& shard = shardOf(path);
+  bool mapNow = false;
+  {
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto found = shard.files.find(path);
+    if (found == shard.files.end())
+    {
+      read->status = FileReadState::Failed;
+      return read;
+    }
+    auto& file = found->second;
+    if (file.owner)
+    {
+      read->owner = file.owner;
+      read->data = file.data;
+      read->size = file.size;
+      read->status = FileReadState::Done;
+      return read;
+    }
+    read->nativePath = file.nativePath;
+    mapNow = m_loadMode == LoadMode::MapOnDemand && file.size >= MapThreshold;
+  }
+  // Big files get mapped as on first access, the kernel's readahead does the async read.
+  // Copying them through the reader would only pay for fresh memory the mapping doesn't need.
+  if (mapNow)
+  {
+    if (auto mapped = MappedFile::open(read->nativePath.c_str()))
+    {
+      mapped->prefetch();
+      std::unique_lock<std::shared_mutex> guard(shard.lock);
+      auto found = shard.files.find(path);
+      if (found != shard.files.end())
+      {
+        auto& file = found->second;
+        if (!file.owner)
+        {
+          file.data = mapped->data();
+          file.size = mapped->size();
+          file.owner = std::move(mapped);
+        }
+        read->owner = file.owner;
+        read->data = file.data;
+        read->size = file.size;
+        read->status = FileReadState::Done;
+        return read;
+      }
+    }
+  }
+  read->onComplete = [this, path](FileReadState& state)
+  {
+    if (!state.owner)
+      return;
+    auto& shard = shardOf(path);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    auto found = shard.files.find(path);
+    // a sync load or a write got there first, keep theirs
+    if (found != shard.files.end() && !found->second.owner)
+    {
+      found->second.owner = state.owner;
+      found->second.data = state.data;
+      found->second.size = state.size;
+    }
+  };
+  return read;
 }
 
+FileRead FileSystem::readFileAsync(std::string path)
+{
+  HIGAN_CPU_FUNCTION_SCOPE();
+  ensureInitialLoad();
+  auto read = prepareRead(path);
+  if (!read->ready())
+    reader().submit(read);
+  return FileRead(read);
+}
+
+vector<FileRead> FileSystem::readFilesAsync(const vector<std::string>& paths)
+{
+  HIGAN_CPU_FUNCTION_SCOPE();
+  ensureInitialLoad();
+  vector<FileRead> reads;
+  vector<std::shared_ptr<FileReadState>> toSubmit;
+  for (auto&& path : paths)
+  {
+    auto read = prepareRead(path);
+    if (!read->ready())
+      toSubmit.push_back(read);
+    reads.emplace_back(std::move(read));
+  }
+  if (!toSubmit.empty())
+    reader().submit(MemView<std::shared_ptr<FileReadState>>(toSubmit));
+  return reads;
+}
+
+#if JGPU_COROUTINES
+namespace
+{
+css::Task<MemoryBlob> waitForRead(FileRead read)
+{
+  co_return read.get();
+}
+}
+
+// read is in flight before the task gets scheduled
+css::Task<MemoryBlob> FileSystem::readFileTask(std::string path)
+{
+  return waitForRead(readFileAsync(std::move(path)));
+}
+#endif
+
 size_t FileSystem::timeModified(std::string path)
 {
+  std::string_view relative;
+  if (auto mounted = archiveOf(path, relative))
+    return mounted->timeModified;
   auto fullPath = system_fs::path(resolveNativePath(path).value()).string();
   return system_fs::last_write_time(fullPath).time_since_epoch().count();
 }
@@ -391,7 +718,14 @@ bool FileSystem::writeFile(std::string path, higanbana::MemView<const uint8_t> v
 bool FileSystem::writeFile(std::string path, const uint8_t* ptr, size_t size)
 {
   HIGAN_CPU_FUNCTION_SCOPE();
-  std::lock_guard<std::mutex> guard(m_lock);
+  std::string_view relative;
+  if (archiveOf(path, relative))
+  {
+    HIGAN_LOGi("Filesystem: %s is inside a packed archive, those are read only\n", path.c_str());
+    return false;
+  }
+  auto& shard = shardOf(path);
+  std::unique_lock<std::shared_mutex> guard(shard.lock);
   auto fullPath = system_fs::path(resolveNativePath(path).value());
 
   std::vector<uint8_t> fdata(size);
@@ -419,22 +753,73 @@ bool FileSystem::writeFile(std::string path, const uint8_t* ptr, size_t size)
     HIGAN_ASSERT(false, "no disk space !?!?!?!?");
     return false;
   }
-  auto file = fopen(fullPath.string().c_str(), "wb");
+  // written next to it and renamed over, rewriting in place would pull the pages from under mapped views.
+  auto tempPath = fullPath;
+  tempPath += ".tmp";
+  auto file = fopen(tempPath.string().c_str(), "wb");
+  if (!file)
+  {
+    FS_LOG("failed to write file %s\n", fullPath.string().c_str());
+    return false;
+  }
   FS_LOG("writing out file %s\n", fullPath.string().c_str());
   size_t leftToWrite = size;
   size_t offset = 0;
   while (leftToWrite > 0)
   {
-    offset = fwrite(ptr + offset, sizeof(uint8_t), leftToWrite, file);
-    leftToWrite -= offset;
+    auto written = fwrite(ptr + offset, sizeof(uint8_t), leftToWrite, file);
+    if (written == 0)
+      break;
+    offset += written;
+    leftToWrite -= written;
   }
-
   fclose(file);
-  system_fs::resize_file(fullPath, size);
-  m_files[path].data = std::move(fdata);
+  std::error_code error;
+  if (leftToWrite > 0)
+  {
+    FS_LOG("failed to write file %s\n", fullPath.string().c_str());
+    system_fs::remove(tempPath, error);
+    return false;
+  }
+  auto& cached = shard.files[path];
+  // our own mapping would keep windows from replacing the file, blobs still holding it keep theirs.
+  // on failure the next access loads whatever is on disk.
+  cached.nativePath = fullPath.string();
+  cached.owner.reset();
+  cached.data = nullptr;
+  system_fs::rename(tempPath, fullPath, error);
+  if (error)
+  {
+    HIGAN_LOGi("Filesystem: couldn't replace %s: %s\n", fullPath.string().c_str(), error.message().c_str());
+    system_fs::remove(tempPath, error);
+    return false;
+  }
+  auto contents = std::make_shared<std::vector<uint8_t>>(std::move(fdata));
+  cached.data = contents->data();
+  cached.size = contents->size();
+  cached.owner = std::move(contents);
   return true;
 }
 
+void FileSystem::watchNativeLocked(const std::string& path) {
+  if (!m_watcher)
+  {
+    m_watcher = std::make_unique<FileWatcher>();
+    m_watching.store(m_watcher->valid(), std::memory_order_release);
+  }
+  std::string_view relative;
+  auto nativePath = resolveNativePath(path);
+  if (m_watching.load(std::memory_order_relaxed) && nativePath && !archiveOf(path, relative))
+  {
+    if (!m_watcher->watch(nativePath.value(), path))
+    {
+      HIGAN_LOGi("Filesystem: couldn't watch %s, polling it instead\n", nativePath.value().c_str());
+      m_polledPaths.push_back(path);
+      m_hasPolledPaths.store(true, std::memory_order_release);
+    }
+  }
+}
+
 void FileSystem::addWatchDependency(std::string watchedPath, std::string notifyPath) {
   HIGAN_CPU_FUNCTION_SCOPE();
   if (fileExists(watchedPath))
@@ -453,6 +838,7 @@ void FileSystem::addWatchDependency(std::string watchedPath, std::string notifyP
     }
     else {
       m_dependencies[watchedPath].push_back(notifyPath);
+      watchNativeLocked(watchedPath);
     }
   }
 }
@@ -473,14 +859,83 @@ WatchFile FileSystem::watchFile(std::string path, std::optional<vector<std::stri
 
     WatchFile w = WatchFile(std::make_shared<std::atomic<bool>>());
     m_watchedFiles[path] = w;
-    m_dependencies[path];
+    if (m_dependencies.find(path) == m_dependencies.end())
+    {
+      m_dependencies[path];
+      watchNativeLocked(path);
+    }
     return w;
   }
   return WatchFile{};
 }
 
+void FileSystem::reloadWatchedLocked(const std::string& path)
+{
+  auto dependency = m_dependencies.find(path);
+  if (dependency == m_dependencies.end())
+    return;
+  size_t oldTime = 0;
+  {
+    auto& shard = shardOf(path);
+    std::shared_lock<std::shared_mutex> shardGuard(shard.lock);
+    auto found = shard.files.find(path);
+    if (found != shard.files.end())
+      oldTime = found->second.timeModified;
+  }
+  std::string_view relative;
+  auto nativePath = resolveNativePath(path);
+  // files in archives don't change
+  if (archiveOf(path, relative) || !nativePath)
+    return;
+  auto fullPath = nativePath.value();
+  auto mp = mountPoint(path);
+  std::error_code error;
+  auto newTime = static_cast<size_t>(system_fs::last_write_time(fullPath, error).time_since_epoch().count());
+  // deleted, or a touch that didn't move the time
+  if (error || newTime <= oldTime)
+    return;
+  size_t opt;
+  FileInfo info = {fullPath, path.substr(mp.size())};
+  loadFileFromHDD(info, mp, opt);
+  auto origFile = m_watchedFiles.find(path);
+  if (origFile != m_watchedFiles.end()) {
+    origFile->second.update();
+  }
+  for (auto& informPaths : dependency->second){
+    auto watchFile = m_watchedFiles.find(informPaths);
+    if (watchFile != m_watchedFiles.end()) {
+      watchFile->second.update();
+    }
+  }
+}
+
 void FileSystem::updateWatchedFiles()
 {
+  if (m_watching.load(std::memory_order_acquire))
+  {
+    if (!m_watcher->pending() && !m_hasPolledPaths.load(std::memory_order_acquire))
+      return;
+    HIGAN_CPU_FUNCTION_SCOPE();
+    vector<std::string> changed;
+    vector<std::string> unwatched;
+    m_watcher->drain(changed, unwatched);
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto&& path : unwatched)
+    {
+      HIGAN_LOGi("Filesystem: directory of %s was removed, polling it instead\n", path.c_str());
+      m_polledPaths.push_back(path);
+      m_hasPolledPaths.store(true, std::memory_order_release);
+    }
+    for (auto&& path : changed)
+      reloadWatchedLocked(path);
+    if (!m_polledPaths.empty())
+    {
+      if (rollingUpdate >= static_cast<int>(m_polledPaths.size()))
+        rollingUpdate = 0;
+      reloadWatchedLocked(m_polledPaths[rollingUpdate++]);
+    }
+    return;
+  }
   HIGAN_CPU_FUNCTION_SCOPE();
   std::lock_guard<std::mutex> guard(m_lock);
   if (m_dependencies.empty())
@@ -496,26 +951,6 @@ void FileSystem::updateWatchedFiles()
   {
     current++;
   }
-  auto oldTime = m_files[current->first].timeModified;
-  auto fullPath = resolveNativePath(current->first).value();
-  auto mp = mountPoint(current->first);
-  std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
-  auto newTime = static_cast<size_t>(system_fs::last_write_time(fullPath).time_since_epoch().count());
-  if (newTime > oldTime)
-  {
-    size_t opt;
-    FileInfo info = {fullPath, current->first.substr(mp.size())};
-    loadFileFromHDD(info, mp, opt);
-    auto origFile = m_watchedFiles.find(current->first);
-    if (origFile != m_watchedFiles.end()) {
-      origFile->second.update();
-    }
-    for (auto& informPaths : current->second){
-      auto watchFile = m_watchedFiles.find(informPaths);
-      if (watchFile != m_watchedFiles.end()) {
-        watchFile->second.update();
-      }
-    }
-  }
+  reloadWatchedLocked(current->first);
   rollingUpdate++;
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #include "higanbana/core/system/memview.hpp"
 #include "higanbana/core/datastructures/hashmap.hpp"
 #include "higanbana/core/datastructures/vector.hpp"
+#include "higanbana/core/filesystem/async_file_reader.hpp"
+#include "higanbana/core/filesystem/file_watcher.hpp"
 #include <cstdio>
 #include <string>
 #include <memory>
@@ -9,9 +11,15 @@
 #include <atomic>
 #include <optional>
 #include <functional>
+#include <shared_mutex>
+#if JGPU_COROUTINES
+#include <css/task.hpp>
+#endif
 
 namespace higanbana
 {
+  class AssetArchive;
+
   class WatchFile
   {
     std::shared_ptr<std::atomic<bool>> m_updated = nullptr;
@@ -55,40 +63,90 @@ namespace higanbana
     std::string withoutNative;
   };
 
+  // Shares the bytes with whoever owns them (FileSystem's cache or a mapped file) instead of copying.
+  // Treat the contents as read only, other blobs of the same file see the same memory.
   class MemoryBlob
   {
   private:
-    std::vector<uint8_t> m_data;
+    std::shared_ptr<void> m_owner;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
   public:
     MemoryBlob();
     MemoryBlob(std::vector<uint8_t> data);
+    MemoryBlob(std::shared_ptr<void> owner, uint8_t* data, size_t size);
     uint8_t* data() noexcept;
     size_t size() const noexcept;
     const uint8_t* cdata() const noexcept;
   };
 
+  // Handle to a read started by FileSystem::readFileAsync.
+  class FileRead
+  {
+    std::shared_ptr<FileReadState> m_state;
+  public:
+    FileRead();
+    FileRead(std::shared_ptr<FileReadState> state);
+    bool ready() const;
+    // missing file or read error, valid once ready
+    bool failed() const;
+    // waits for the read, empty blob on failure
+    MemoryBlob get();
+  };
+
   class FileSystem
   {
   private:
 
+    // contents stay null until first access with LoadMode::MapOnDemand
     struct FileObj
     {
-      size_t timeModified;
-      vector<uint8_t> data;
+      size_t timeModified = 0;
+      std::string nativePath;
+      std::shared_ptr<void> owner; // vector<uint8_t> or MappedFile
+      uint8_t* data = nullptr;
+      size_t size = 0;
+    };
+    // Read mostly, lookups of already loaded files only take a shared lock of their own shard.
+    struct FileShard
+    {
+      std::shared_mutex lock;
+      std::unordered_map<std::string, FileObj> files;
     };
-    //std::string m_resolvedFullPath;
-    std::unordered_map<std::string, FileObj> m_files;
+    static constexpr size_t FileShardCount = 64;
+    FileShard m_files[FileShardCount];
+    FileShard& shardOf(const std::string& path);
     std::unordered_set<std::string> m_dirs;
 
     // watch
     std::unordered_map<std::string, vector<std::string>> m_dependencies;
     std::unordered_map<std::string, WatchFile> m_watchedFiles;
     int rollingUpdate = 0;
-
-    // 
+    // created by the first watch, once m_watching is set updateWatchedFiles stops polling
+    std::unique_ptr<FileWatcher> m_watcher;
+    std::atomic<bool> m_watching = false;
+    // paths the watcher refused or lost with their directory, still polled one per update
+    vector<std::string> m_polledPaths;
+    std::atomic<bool> m_hasPolledPaths = false;
+    void watchNativeLocked(const std::string& path);
+    void reloadWatchedLocked(const std::string& path);
+
+    // watch state
     std::mutex m_lock;
 
-    bool m_initialLoadComplete = false;
+    std::atomic<bool> m_initialLoadComplete = false;
+    std::mutex m_initialLoadLock;
+    void ensureInitialLoad();
+
+    // packed archives mounted with mountArchive, looked up before the loose files
+    struct MountedArchive
+    {
+      std::string mountPoint;
+      std::shared_ptr<AssetArchive> archive;
+      size_t timeModified = 0;
+    };
+    vector<MountedArchive> m_archives;
+    MountedArchive* archiveOf(std::string_view path, std::string_view& relative);
 
     std::string mountPointOSPath(std::string_view filepath);
     std::optional<std::unordered_map<std::string, std::string>> tryExtractMappings(std::string mappingjsonpath);
@@ -99,13 +157,38 @@ namespace higanbana
       TryFirstMappingFile,
       UseMappingFile
     };
+    // ReadEverything reads all files to memory in initialLoad.
+    // MapOnDemand only lists them, first access maps big files and reads small ones.
+    enum class LoadMode {
+      ReadEverything,
+      MapOnDemand
+    };
+    static constexpr size_t MapThreshold = 64 * 1024;
+  private:
+    LoadMode m_loadMode = LoadMode::ReadEverything;
+    MemView<const uint8_t> contentsLocked(FileObj& file);
+    bool contents(const std::string& path, MemView<const uint8_t>& view, MemoryBlob* blob);
+  public:
 
     FileSystem();
-    FileSystem(std::string relativeOffset, MappingMode mode, const char* mappingFileName = "");
+    FileSystem(std::string relativeOffset, MappingMode mode, const char* mappingFileName = "", LoadMode loadMode = LoadMode::ReadEverything);
+    FileSystem(std::unordered_map<std::string, std::string> mappings, LoadMode loadMode = LoadMode::ReadEverything);
     void initialLoad();
+    // Files of an AssetArchive show up under mountPoint ("/packed/..."), taking over loose files mapped there.
+    // Read only. Mount before other threads start using the FileSystem.
+    bool mountArchive(std::string mountPoint, std::string archiveNativePath);
     bool fileExists(std::string path);
+    // no copies, both stay valid until the file is reloaded or written. The blob outlives that.
     MemoryBlob readFile(std::string path);
     higanbana::MemView<const uint8_t> viewToFile(std::string path);
+    // Starts reading right away, contents land in the cache as if readFile had loaded them.
+    // Files already in memory are ready immediately, with MapOnDemand so are big files,
+    // they are mapped and the os reads them ahead.
+    FileRead readFileAsync(std::string path);
+    vector<FileRead> readFilesAsync(const vector<std::string>& paths);
+#if JGPU_COROUTINES
+    css::Task<MemoryBlob> readFileTask(std::string path);
+#endif
     void loadDirectoryContentsRecursive(std::string path);
     void getFilesWithinDir(std::string path, std::function<void(std::string&, MemView<const uint8_t>)> func);
     vector<std::string> getFilesWithinDir(std::string path);
@@ -121,11 +204,19 @@ namespace higanbana
 
     WatchFile watchFile(std::string path, std::optional<vector<std::string>> optionalTriggers = {});
     void addWatchDependency(std::string watchedPath, std::string notifyPath);
+    // Reloads changed watched files and flags whoever watches them or depends on them.
+    // With a working FileWatcher it is one atomic load when nothing changed, otherwise it stats one file per call.
     void updateWatchedFiles();
 
     std::optional<std::string> resolveNativePath(std::string_view filepath);
   private:
     bool loadFileFromHDD(FileInfo& path, std::string mountpoint, size_t& size);
+    std::shared_ptr<FileReadState> prepareRead(const std::string& path);
+    AsyncFileReader& reader();
+
+    // last so that reads in flight finish before the cache goes away
+    std::once_flag m_readerOnce;
+    std::unique_ptr<AsyncFileReader> m_reader;
   };
 
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "higanbana/core/filesystem/mapped_file.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace higanbana
+{
+std::shared_ptr<MappedFile> MappedFile::open(const char* nativePath)
+{
+  auto mapped = std::make_shared<MappedFile>();
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  HANDLE file = CreateFileA(nativePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return nullptr;
+  mapped->m_file = file;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+    return nullptr;
+  if (size.QuadPart == 0)
+    return mapped;
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (mapping == nullptr)
+    return nullptr;
+  mapped->m_mapping = mapping;
+  void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if (view == nullptr)
+    return nullptr;
+  mapped->m_data = reinterpret_cast<uint8_t*>(view);
+  mapped->m_size = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = ::open(nativePath, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+  if (info.st_size > 0)
+  {
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+      ::close(fd);
+      return nullptr;
+    }
+    mapped->m_data = reinterpret_cast<uint8_t*>(view);
+    mapped->m_size = static_cast<size_t>(info.st_size);
+  }
+  // the mapping keeps the file alive
+  ::close(fd);
+#endif
+  return mapped;
+}
+
+void MappedFile::prefetch() const
+{
+  if (!m_data)
+    return;
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  WIN32_MEMORY_RANGE_ENTRY range = {m_data, m_size};
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  madvise(m_data, m_size, MADV_WILLNEED);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file)
+    CloseHandle(m_file);
+#else
+  if (m_data)
+    munmap(m_data, m_size);
+#endif
+}
+}
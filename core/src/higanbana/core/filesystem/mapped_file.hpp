@@ -0,0 +1,33 @@
+#pragma once
+#include "higanbana/core/platform/definitions.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace higanbana
+{
+  // Read only view of a whole file, mapped copy-on-write so writes through it never reach the disk.
+  // The file should be replaced (write + rename) rather than rewritten in place while mapped,
+  // truncating a mapped file makes touching the lost pages fault.
+  class MappedFile
+  {
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+  public:
+    // nullptr if the file can't be opened, empty files map to an empty view.
+    static std::shared_ptr<MappedFile> open(const char* nativePath);
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // asks the os to start reading the whole file in, returns before it's done
+    void prefetch() const;
+    uint8_t* data() const noexcept { return m_data; }
+    size_t size() const noexcept { return m_size; }
+  };
+}
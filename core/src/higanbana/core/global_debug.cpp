@@ -166,6 +166,8 @@ void log_sys(const char* prefix, const char* format, ...)
 
 void log_immideateAssert(const char *fn, int ln, const char* format, ...)
 {
+  // queued messages first, they are the context for this one
+  higanbana::log::flush();
   va_list args;
   char buf[1024];
   int n = snprintf(buf, sizeof(buf), "%s(%d): ASSERT!!!\n", fn, ln);
@@ -191,6 +193,8 @@ void log_immideateAssert(const char *fn, int ln, const char* format, ...)
 
 void log_immideate(const char *fn, int ln, const char* format, ...)
 {
+  // queued messages first, they are the context for this one
+  higanbana::log::flush();
   va_list args;
   char buf[1024];
   int n = snprintf(buf, sizeof(buf), "%s(%d): ", fn, ln);
@@ -1,15 +1,27 @@
 #pragma once
 
 #include "higanbana/core/platform/definitions.hpp"
+#include "higanbana/core/system/deferred_log.hpp"
 
 #include <string>
 
-#define HIGAN_DEBUG_LOG(msg, ...) log_adv(__FILE__, __LINE__, msg, ##__VA_ARGS__)
-#define HIGAN_LOG(msg, ...) log_sys("Output", msg, ##__VA_ARGS__)
+// Queued and printed by the Logger's thread, arguments aren't evaluated when the level is filtered out.
+// "" msg keeps formats string literals, the record only keeps the pointer.
+#define HIGAN_LEVEL_LOG(level, prefix, file, line, msg, ...) \
+  do \
+  { \
+    if (higanbana::log::enabled(level)) \
+      higanbana::log::write(level, prefix, file, line, "" msg, ##__VA_ARGS__); \
+  } while (0)
+#define HIGAN_DEBUG_LOG(msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Debug, nullptr, __FILE__, __LINE__, msg, ##__VA_ARGS__)
+#define HIGAN_LOG(msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Info, "Output", nullptr, 0, msg, ##__VA_ARGS__)
+#define HIGAN_SLOG(prefix, msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Info, "" prefix, nullptr, 0, msg, ##__VA_ARGS__)
+#define HIGAN_WLOG(prefix, msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Warning, "" prefix, nullptr, 0, msg, ##__VA_ARGS__)
+#define HIGAN_ELOG(prefix, msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Error, "" prefix, nullptr, 0, msg, ##__VA_ARGS__)
+#define HIGAN_LOG_UNFORMATTED(msg, ...) HIGAN_LEVEL_LOG(higanbana::log::Level::Info, nullptr, nullptr, 0, msg, ##__VA_ARGS__);
+// printed right away on the calling thread
 #define HIGAN_LOGi(msg, ...) log_im(msg, ##__VA_ARGS__)
 #define HIGAN_ILOG(prefix, msg, ...) log_imSys(prefix, msg, ##__VA_ARGS__)
-#define HIGAN_SLOG(prefix, msg, ...) log_sys(prefix, msg, ##__VA_ARGS__)
-#define HIGAN_LOG_UNFORMATTED(msg, ...) log_def(msg, ##__VA_ARGS__);
 
 #if 1 //defined(DEBUG)
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
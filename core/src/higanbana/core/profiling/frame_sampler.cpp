@@ -0,0 +1,173 @@
+#include "higanbana/core/profiling/frame_sampler.hpp"
+#include "higanbana/core/global_debug.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace higanbana
+{
+namespace profiling
+{
+FrameSampler::FrameSampler(const SamplingOptions& options, uint64_t startTicks)
+  : m_options(options)
+  , m_lastFrameTicks(startTicks)
+{
+  HIGAN_ASSERT(options.windowFrames > 0, "sampling window needs at least one frame");
+  m_frames.resize(options.windowFrames);
+}
+
+void FrameSampler::retire(FrameRecord& frame)
+{
+  if (!frame.valid)
+    return;
+  for (auto&& bin : frame.bins)
+    m_histograms[bin.name].remove(static_cast<int>(bin.bucket), bin.count);
+  m_frameTimes.remove(LatencyHistogram::bucketOf(frame.duration));
+  frame.bins.clear();
+  frame.maxes.clear();
+  frame.valid = false;
+}
+
+bool FrameSampler::endFrame(GlobalProfilingThing* profiling)
+{
+  auto ticks = readTicks();
+  auto nanoseconds = currentNanoseconds();
+  m_records.clear();
+  drainProfilingRings(profiling, m_records, m_droppedWritten);
+
+  double nanosecondsPerTick = 1.0;
+  if (ticks != profiling->startTicks)
+    nanosecondsPerTick = double(nanoseconds - profiling->startNanoseconds) / double(ticks - profiling->startTicks);
+  auto frameDuration = static_cast<int64_t>(double(ticks - m_lastFrameTicks) * nanosecondsPerTick);
+  m_lastFrameTicks = ticks;
+
+  // only cpu brackets, gpu timings arrive frames late and have their own timeline.
+  m_samples.clear();
+  size_t offset = 0;
+  while (offset < m_records.size())
+  {
+    TraceRecord record;
+    memcpy(&record, m_records.data() + offset, sizeof(record));
+    offset += sizeof(record);
+    switch (record.type)
+    {
+      case TraceRecordType::CpuEvents:
+      {
+        offset += 2 * sizeof(uint32_t);
+        for (uint32_t i = 0; i < record.count; ++i, offset += sizeof(CpuEvent))
+        {
+          CpuEvent event;
+          memcpy(&event, m_records.data() + offset, sizeof(event));
+          auto duration = static_cast<int64_t>(double(event.end - event.begin) * nanosecondsPerTick);
+          auto bucket = static_cast<uint64_t>(LatencyHistogram::bucketOf(duration));
+          m_samples.emplace_back((uint64_t(event.name) << 32) | bucket, duration);
+        }
+        break;
+      }
+      case TraceRecordType::GpuEvents: offset += 2 * sizeof(uint32_t) + record.count * sizeof(GpuEvent); break;
+      case TraceRecordType::Dropped: offset += sizeof(uint64_t); break;
+      default: HIGAN_ASSERT(false, "unexpected record from the rings"); return false;
+    }
+  }
+  std::sort(m_samples.begin(), m_samples.end());
+
+  bool overBudget = frameDuration > m_options.frameBudget.count();
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto& frame = m_frames[m_frame % m_frames.size()];
+    retire(frame);
+    for (size_t i = 0; i < m_samples.size();)
+    {
+      auto name = static_cast<uint32_t>(m_samples[i].first >> 32);
+      if (m_histograms.size() <= name)
+        m_histograms.resize(name + 1);
+      int64_t maxDuration = 0;
+      while (i < m_samples.size() && (m_samples[i].first >> 32) == name)
+      {
+        auto key = m_samples[i].first;
+        uint32_t count = 0;
+        for (; i < m_samples.size() && m_samples[i].first == key; ++i, ++count)
+          maxDuration = std::max(maxDuration, m_samples[i].second);
+        auto bucket = static_cast<uint32_t>(key & 0xffffffffu);
+        frame.bins.push_back(SampleBin{name, bucket, count});
+        m_histograms[name].add(static_cast<int>(bucket), count);
+      }
+      frame.maxes.push_back(SampleMax{name, maxDuration});
+    }
+    frame.duration = frameDuration;
+    frame.valid = true;
+    m_frameTimes.add(LatencyHistogram::bucketOf(frameDuration));
+  }
+
+  if (overBudget && !m_options.spikeTracePrefix.empty() && m_spikeTraces < m_options.maxSpikeTraces)
+  {
+    auto path = m_options.spikeTracePrefix + std::to_string(m_frame) + ".htrace";
+    if (writeTraceSnapshot(profiling, path, m_records, ClockSample{ticks, nanoseconds}))
+    {
+      ++m_spikeTraces;
+      HIGAN_LOG("Frame %llu took %.2fms, trace written to %s\n", static_cast<unsigned long long>(m_frame), frameDuration / 1000000.0, path.c_str());
+    }
+  }
+  ++m_frame;
+  return overBudget;
+}
+
+vector<BracketStatistics> FrameSampler::statistics()
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  vector<int64_t> maxes(m_histograms.size(), 0);
+  int64_t frameMax = 0;
+  for (auto&& frame : m_frames)
+  {
+    if (!frame.valid)
+      continue;
+    frameMax = std::max(frameMax, frame.duration);
+    for (auto&& max : frame.maxes)
+      maxes[max.name] = std::max(maxes[max.name], max.max);
+  }
+  vector<BracketStatistics> result;
+  if (m_frameTimes.count() > 0)
+    result.push_back(BracketStatistics{"frame", m_frameTimes.count(), m_frameTimes.percentile(0.5), m_frameTimes.percentile(0.95), m_frameTimes.percentile(0.99), frameMax});
+  for (uint32_t name = 0; name < m_histograms.size(); ++name)
+  {
+    auto& histogram = m_histograms[name];
+    if (histogram.count() == 0)
+      continue;
+    result.push_back(BracketStatistics{internedName(name), histogram.count(), histogram.percentile(0.5), histogram.percentile(0.95), histogram.percentile(0.99), maxes[name]});
+  }
+  return result;
+}
+
+void enableSampling(GlobalProfilingThing* profiling, const SamplingOptions& options)
+{
+  endTraceCapture(profiling);
+  if (!profiling->sampler)
+    profiling->enabledBeforeSampling = profiling->enabled.load(std::memory_order_relaxed);
+  enableProfiling(profiling);
+  profiling->sampler = std::make_unique<FrameSampler>(options, readTicks());
+}
+
+void disableSampling(GlobalProfilingThing* profiling)
+{
+  if (!profiling->sampler)
+    return;
+  profiling->sampler.reset();
+  // nothing drains the rings anymore unless profiling was on for something else
+  profiling->enabled = profiling->enabledBeforeSampling;
+}
+
+bool endProfilingFrame(GlobalProfilingThing* profiling)
+{
+  if (!profiling || !profiling->sampler)
+    return false;
+  return profiling->sampler->endFrame(profiling);
+}
+
+vector<BracketStatistics> samplingStatistics(GlobalProfilingThing* profiling)
+{
+  if (!profiling || !profiling->sampler)
+    return {};
+  return profiling->sampler->statistics();
+}
+}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "higanbana/core/profiling/profiling.hpp"
+#include "higanbana/core/profiling/trace_format.hpp"
+#include "higanbana/core/system/time.hpp"
+
+namespace higanbana
+{
+namespace profiling
+{
+// shared with the trace writer in profiling.cpp
+int64_t currentNanoseconds();
+void drainProfilingRings(GlobalProfilingThing* profiling, vector<uint8_t>& records, vector<uint64_t>& droppedWritten);
+std::string internedName(uint32_t id);
+bool writeTraceSnapshot(GlobalProfilingThing* profiling, const std::string& nativePath, const vector<uint8_t>& eventRecords, ClockSample end);
+
+// Rolling window of per name histograms. Every frame drains the rings, adds the frame's brackets
+// and removes the frame that fell out of the window, so memory only depends on window size and name count.
+class FrameSampler
+{
+  struct SampleBin
+  {
+    uint32_t name;
+    uint32_t bucket;
+    uint32_t count;
+  };
+  struct SampleMax
+  {
+    uint32_t name;
+    int64_t max;
+  };
+  struct FrameRecord
+  {
+    bool valid = false;
+    int64_t duration = 0;
+    vector<SampleBin> bins;
+    vector<SampleMax> maxes;
+  };
+
+  SamplingOptions m_options;
+  vector<FrameRecord> m_frames;
+  uint64_t m_frame = 0;
+  vector<LatencyHistogram> m_histograms; // by name id
+  LatencyHistogram m_frameTimes;
+  uint64_t m_lastFrameTicks;
+  int m_spikeTraces = 0;
+  std::mutex m_lock; // statistics can be read from another thread
+
+  // per frame scratch
+  vector<uint8_t> m_records;
+  vector<uint64_t> m_droppedWritten;
+  vector<std::pair<uint64_t, int64_t>> m_samples; // name << 32 | bucket, duration
+
+  void retire(FrameRecord& frame);
+  public:
+  FrameSampler(const SamplingOptions& options, uint64_t startTicks);
+  bool endFrame(GlobalProfilingThing* profiling);
+  vector<BracketStatistics> statistics();
+};
+}
+}
@@ -1,7 +1,15 @@
 #include "higanbana/core/profiling/profiling.hpp"
+#include "higanbana/core/profiling/trace_format.hpp"
+#include "higanbana/core/profiling/frame_sampler.hpp"
 #include "higanbana/core/filesystem/filesystem.hpp"
 #include "higanbana/core/platform/definitions.hpp"
 
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_map>
 #include <memory>
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
 #include <windows.h>
@@ -13,21 +21,248 @@
 #endif
 #include <WinPixEventRuntime/pix3.h>
 #endif
-#include <nlohmann/json.hpp>
 
 namespace higanbana
 {
 namespace profiling
 {
-GlobalProfilingThing::GlobalProfilingThing(int threadCount) :myIndex(0), enabled(false) {
+GlobalProfilingThing* s_profiling = nullptr;
+thread_local ThreadProfilingState t_profiling;
+
+namespace
+{
+// process wide, ids stay valid between profiling sessions.
+struct NameRegistry
+{
+  std::mutex lock;
+  std::unordered_map<std::string_view, uint32_t> ids;
+  std::deque<std::string> names; // deque so that views into it stay valid
+};
+
+NameRegistry& nameRegistry()
+{
+  static NameRegistry registry;
+  return registry;
+}
+
+uint32_t internLocked(NameRegistry& registry, std::string_view name, const std::string*& interned)
+{
+  auto found = registry.ids.find(name);
+  if (found != registry.ids.end())
+  {
+    interned = &registry.names[found->second];
+    return found->second;
+  }
+  auto id = static_cast<uint32_t>(registry.names.size());
+  registry.names.emplace_back(name);
+  interned = &registry.names.back();
+  registry.ids.emplace(std::string_view(registry.names.back()), id);
+  return id;
+}
+
+uint64_t nextSession()
+{
+  static std::atomic<uint64_t> sessions = 0;
+  return ++sessions;
+}
+
+template <typename T>
+void append(vector<uint8_t>& out, const T& value)
+{
+  auto offset = out.size();
+  out.resize(offset + sizeof(T));
+  memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+void appendBytes(vector<uint8_t>& out, const void* data, size_t size)
+{
+  auto offset = out.size();
+  out.resize(offset + size);
+  memcpy(out.data() + offset, data, size);
+}
+}
+
+uint32_t internNameSlow(const char* name, size_t length)
+{
+  auto& registry = nameRegistry();
+  const std::string* interned = nullptr;
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> guard(registry.lock);
+    id = internLocked(registry, std::string_view(name, length), interned);
+  }
+  nameCacheEntry(name) = NameCacheEntry{name, interned, id};
+  return id;
+}
+
+uint32_t internName(std::string_view name)
+{
+  auto& registry = nameRegistry();
+  const std::string* interned = nullptr;
+  std::lock_guard<std::mutex> guard(registry.lock);
+  return internLocked(registry, name, interned);
+}
+
+int64_t currentNanoseconds()
+{
+  return std::chrono::time_point_cast<std::chrono::nanoseconds>(HighPrecisionClock::now()).time_since_epoch().count();
+}
+
+void drainProfilingRings(GlobalProfilingThing* profiling, vector<uint8_t>& records, vector<uint64_t>& droppedWritten)
+{
+  std::lock_guard<std::mutex> guard(profiling->drainLock);
+  int threads = std::min<int>(profiling->myIndex.load(), static_cast<int>(profiling->allThreadsProfilingData.size()));
+  if (static_cast<int>(droppedWritten.size()) < threads)
+    droppedWritten.resize(threads, 0);
+  for (int i = 0; i < threads; ++i)
+  {
+    auto& data = profiling->allThreadsProfilingData[i];
+    if (!data)
+      continue;
+    data->allBrackets.drain([&](const CpuEvent* events, size_t count)
+    {
+      append(records, TraceRecord{TraceRecordType::CpuEvents, static_cast<uint32_t>(count)});
+      append(records, static_cast<uint32_t>(i));
+      append(records, uint32_t(0));
+      appendBytes(records, events, count * sizeof(CpuEvent));
+    });
+    data->gpuBrackets.drain([&](const GpuEvent* events, size_t count)
+    {
+      append(records, TraceRecord{TraceRecordType::GpuEvents, static_cast<uint32_t>(count)});
+      append(records, static_cast<uint32_t>(i));
+      append(records, uint32_t(0));
+      appendBytes(records, events, count * sizeof(GpuEvent));
+    });
+    auto dropped = data->allBrackets.dropped() + data->gpuBrackets.dropped();
+    if (dropped != droppedWritten[i])
+    {
+      append(records, TraceRecord{TraceRecordType::Dropped, static_cast<uint32_t>(i)});
+      append(records, dropped);
+      droppedWritten[i] = dropped;
+    }
+  }
+}
+
+std::string internedName(uint32_t id)
+{
+  auto& registry = nameRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  return id < registry.names.size() ? registry.names[id] : std::string("unknown");
+}
+
+// Drains the rings into the binary trace format, keeps track of what names the file already has.
+class TraceWriter
+{
+  FILE* m_file = nullptr;
+  size_t m_namesWritten = 0;
+  vector<uint64_t> m_droppedWritten;
+  vector<uint8_t> m_buffer;
+  vector<uint8_t> m_events;
+
+  std::thread m_thread;
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  bool m_stop = false;
+
+  public:
+  bool open(const std::string& nativePath, GlobalProfilingThing* profiling)
+  {
+    m_file = fopen(nativePath.c_str(), "wb");
+    if (!m_file)
+      return false;
+    TraceHeader header{};
+    memcpy(header.magic, TraceMagic, sizeof(TraceMagic));
+    header.version = TraceVersion;
+    fwrite(&header, sizeof(header), 1, m_file);
+    m_buffer.clear();
+    append(m_buffer, TraceRecord{TraceRecordType::Clock, 0});
+    append(m_buffer, ClockSample{profiling->startTicks, profiling->startNanoseconds});
+    fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+    return true;
+  }
+
+  // names first so that everything the events reference is in the file before them.
+  void write(const vector<uint8_t>& eventRecords, ClockSample clock)
+  {
+    m_buffer.clear();
+    {
+      auto& registry = nameRegistry();
+      std::lock_guard<std::mutex> guard(registry.lock);
+      for (; m_namesWritten < registry.names.size(); ++m_namesWritten)
+      {
+        auto& name = registry.names[m_namesWritten];
+        append(m_buffer, TraceRecord{TraceRecordType::Name, static_cast<uint32_t>(name.size())});
+        append(m_buffer, static_cast<uint32_t>(m_namesWritten));
+        appendBytes(m_buffer, name.data(), name.size());
+      }
+    }
+    append(m_buffer, TraceRecord{TraceRecordType::Clock, 0});
+    append(m_buffer, clock);
+    fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+    if (!eventRecords.empty())
+      fwrite(eventRecords.data(), 1, eventRecords.size(), m_file);
+    fflush(m_file);
+  }
+
+  void flush(GlobalProfilingThing* profiling)
+  {
+    m_events.clear();
+    drainProfilingRings(profiling, m_events, m_droppedWritten);
+    write(m_events, ClockSample{readTicks(), currentNanoseconds()});
+  }
+
+  void start(GlobalProfilingThing* profiling, std::chrono::milliseconds interval)
+  {
+    m_thread = std::thread([this, profiling, interval]()
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while (!m_stop)
+      {
+        m_wake.wait_for(lock, interval, [this]{ return m_stop; });
+        flush(profiling);
+      }
+    });
+  }
+
+  void close()
+  {
+    if (m_thread.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+      }
+      m_wake.notify_one();
+      m_thread.join();
+    }
+    if (m_file)
+      fclose(m_file);
+    m_file = nullptr;
+  }
+
+  ~TraceWriter()
+  {
+    close();
+  }
+};
+
+GlobalProfilingThing::GlobalProfilingThing(int threadCount)
+  : myIndex(0)
+  , enabled(false)
+  , session(nextSession())
+  , startTicks(readTicks())
+  , startNanoseconds(currentNanoseconds())
+{
   allThreadsProfilingData.resize(threadCount);
 }
-GlobalProfilingThing* s_profiling = nullptr;
-thread_local ThreadProfileData* my_profile_data = nullptr;
-thread_local int my_thread_id = 0;
-thread_local int64_t previousBegin = std::numeric_limits<int64_t>::min();
-thread_local int64_t seen = 0;
-thread_local int64_t nextDuration = 0;
+
+GlobalProfilingThing::~GlobalProfilingThing()
+{
+  writer.reset();
+  sampler.reset();
+  if (s_profiling == this)
+    s_profiling = nullptr;
+}
 
 std::unique_ptr<GlobalProfilingThing> initializeProfiling(int threadCount) {
   auto profiling = std::make_unique<GlobalProfilingThing>(threadCount);
@@ -35,141 +270,117 @@ std::unique_ptr<GlobalProfilingThing> initializeProfiling(int threadCount) {
   return profiling;
 }
 void enableProfiling() {
-  for (auto&& data : s_profiling->allThreadsProfilingData)
+  enableProfiling(s_profiling);
+}
+void enableProfiling(GlobalProfilingThing* profiling) {
+  std::lock_guard<std::mutex> guard(profiling->drainLock);
+  for (auto&& data : profiling->allThreadsProfilingData)
   {
-    data.reset();
+    if (data)
+    {
+      data->allBrackets.discard();
+      data->gpuBrackets.discard();
+    }
   }
-  s_profiling->enabled = true;
+  profiling->enabled = true;
 }
 void disableProfiling() {
   s_profiling->enabled = false;
   s_profiling = nullptr;
 }
 
-int64_t getCurrentTime() {
-  int64_t value = std::chrono::time_point_cast<std::chrono::nanoseconds>(HighPrecisionClock::now()).time_since_epoch().count();
-  if (value == previousBegin) {
-    value = previousBegin + seen*100000;
-    seen++;
-    nextDuration = 0;
-  }
-  else {
-    nextDuration = 0;
-    seen = 0;
-    previousBegin = value;
+ThreadProfileData* registerProfilingThread(GlobalProfilingThing* profiling)
+{
+  int newIdx = profiling->myIndex.fetch_add(1);
+  auto& state = t_profiling;
+  state.session = profiling->session;
+  state.data = nullptr;
+  // more threads than asked for, those go unprofiled.
+  if (newIdx >= static_cast<int>(profiling->allThreadsProfilingData.size()))
+    return nullptr;
+  state.threadId = newIdx;
+  auto data = std::make_unique<ThreadProfileData>();
+  state.data = data.get();
+  {
+    std::lock_guard<std::mutex> guard(profiling->drainLock);
+    profiling->allThreadsProfilingData[newIdx] = std::move(data);
   }
-
-  return value;
+  return state.data;
 }
 
-ProfilingScope::ProfilingScope(const char* str)
-  : name(str)
-  , start(getCurrentTime())
+void pixBegin(const char* name)
 {
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
-  PIXBeginEvent(0ull, "%s", str);
+  PIXBeginEvent(0ull, "%s", name);
 #endif
-  if (!s_profiling || !s_profiling->enabled)
-    return;
-  if (!my_profile_data)
-  {
-    int newIdx = s_profiling->myIndex.fetch_add(1);
-    my_thread_id = newIdx;
-    s_profiling->allThreadsProfilingData[newIdx] = ThreadProfileData();
-    my_profile_data = &s_profiling->allThreadsProfilingData[newIdx];
-  }
-  // start
+  (void)name;
 }
-  ProfilingScope::~ProfilingScope(){
+
+void pixEnd()
+{
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
   PIXEndEvent();
 #endif
-  if (!s_profiling || !s_profiling->enabled)
-    return;
-  // end
-  int64_t duration = getCurrentTime() - start;
-  if (my_profile_data->canWriteProfile())
-    my_profile_data->allBrackets.push_back(ProfileData{name, start, duration + nextDuration});
 }
 
 void writeGpuBracketData(int gpuid, int queue, std::string_view view, int64_t time, int64_t dur)
 {
-  if (!s_profiling || !s_profiling->enabled)
+  auto data = currentProfileData();
+  if (!data)
     return;
-  if (!my_profile_data)
-  {
-    int newIdx = s_profiling->myIndex.fetch_add(1);
-    my_thread_id = newIdx;
-    s_profiling->allThreadsProfilingData[newIdx] = ThreadProfileData();
-    my_profile_data = &s_profiling->allThreadsProfilingData[newIdx];
-  }
-  if (my_profile_data->canWriteProfile())
-    my_profile_data->gpuBrackets.push_back(GPUProfileData{gpuid, queue, std::string(view), time, dur});
+  data->gpuBrackets.push(GpuEvent{time, dur, internName(view), static_cast<uint16_t>(gpuid), static_cast<uint16_t>(queue)});
 }
 
-nlohmann::json writeEvent(std::string_view view, int64_t time, int64_t dur, int tid)
+bool writeProfilingTrace(GlobalProfilingThing* profiling, const std::string& nativePath)
 {
-  nlohmann::json j;
-  // "name": "myFunction", "cat": "foo", "ph": "B", "ts": 123, "pid": 2343, "tid": 2347
-  j["name"] = view;
-  j["cat"] = "foo";
-  j["ph"] = "X";
-  j["ts"] = double(time) / 1000.0;
-  j["pid"] = "higanbana";
-  j["dur"] = std::max(double(0.001), double(dur) / 1000.0);
-  j["tid"] = "Thread " + std::to_string(tid);
+  TraceWriter writer;
+  if (!writer.open(nativePath, profiling))
+    return false;
+  writer.flush(profiling);
+  writer.close();
+  return true;
+}
 
-  return j;
+void writeProfilingData(higanbana::FileSystem& fs, GlobalProfilingThing* profiling)
+{
+  auto path = fs.resolveNativePath("/data/profiling.htrace");
+  if (!path || !profiling)
+    return;
+  writeProfilingTrace(profiling, path.value());
 }
-nlohmann::json writeEventGPU(std::string_view view, int64_t time, int64_t dur, int tid, int queue)
+
+bool writeTraceSnapshot(GlobalProfilingThing* profiling, const std::string& nativePath, const vector<uint8_t>& eventRecords, ClockSample end)
 {
-  nlohmann::json j;
-  // "name": "myFunction", "cat": "foo", "ph": "B", "ts": 123, "pid": 2343, "tid": 2347
-  j["name"] = view;
-  j["cat"] = "foo";
-  j["ph"] = "X";
-  j["ts"] = double(time) / 1000.0;
-  j["pid"] = "higanbana";
-  j["dur"] = double(dur) / 1000.0;
-  j["tid"] = "GPU " + std::to_string(tid) + " Queue " + std::to_string(queue);
+  TraceWriter writer;
+  if (!writer.open(nativePath, profiling))
+    return false;
+  writer.write(eventRecords, end);
+  writer.close();
+  return true;
+}
 
-  return j;
+bool beginTraceCapture(GlobalProfilingThing* profiling, const std::string& nativePath, std::chrono::milliseconds flushInterval)
+{
+  endTraceCapture(profiling);
+  // switching from sampling straight to a capture keeps recording
+  bool enabled = profiling->enabled.load(std::memory_order_relaxed);
+  disableSampling(profiling);
+  profiling->enabled = enabled;
+  auto writer = std::make_unique<TraceWriter>();
+  if (!writer->open(nativePath, profiling))
+    return false;
+  writer->start(profiling, flushInterval);
+  profiling->writer = std::move(writer);
+  return true;
 }
 
-void writeProfilingData(higanbana::FileSystem& fs, GlobalProfilingThing* profiling)
+void endTraceCapture(GlobalProfilingThing* profiling)
 {
-  nlohmann::json j;
-  higanbana::vector<nlohmann::json> events;
-  // last 5 seconds
-  //auto lastEvent = s_allThreadsProfilingData[0].allBrackets[s_allThreadsProfilingData[0].allBrackets.end_ind()];
-  if (!my_profile_data)
-    return;
-  if (profiling->allThreadsProfilingData[0].allBrackets.size() == 0)
-    return;
-  auto lastEvent = profiling->allThreadsProfilingData[0].allBrackets.back();
-  auto lastSeconds = (lastEvent.begin + lastEvent.duration) - 3ull * 1000ull * 1000ull * 1000ull;
-  for (int i = 0; i < profiling->myIndex; ++i)
+  if (profiling->writer)
   {
-    higanbana::profiling::ProfileData previousEvent;
-    int eventCount = 0;
-    profiling->allThreadsProfilingData[i].canWriteProfilingData->store(false, std::memory_order::seq_cst);
-    auto& cpuBrackets = profiling->allThreadsProfilingData[i].allBrackets;
-    for (const auto& event : cpuBrackets){
-    //cpuBrackets.forEach([&](const ProfileData& event) {
-      //if (event.begin > lastSeconds)
-        events.push_back(writeEvent(event.name, event.begin, event.duration, i));
-    }//);
-    auto& gpuBrackets =  profiling->allThreadsProfilingData[i].gpuBrackets;
-    for (const auto& event : gpuBrackets){
-    //gpuBrackets.forEach([&](const GPUProfileData& event) {
-      //if (event.begin > lastSeconds)
-        events.push_back(writeEventGPU(event.name, event.begin, event.duration, event.gpuID, event.queue));
-    }//);
-    profiling->allThreadsProfilingData[i].canWriteProfilingData->store(true);
+    profiling->writer->close();
+    profiling->writer.reset();
   }
-  j["traceEvents"] = events;
-  std::string output = j.dump();
-  fs.writeFile("/data/profiling.trace", higanbana::makeByteView(output.data(), output.size()));
 }
 }
-}
\ No newline at end of file
+}
@@ -1,11 +1,21 @@
 #pragma once
 
 #include "higanbana/core/datastructures/vector.hpp"
+#include "higanbana/core/platform/definitions.hpp"
 #include "higanbana/core/system/HighResClock.hpp"
 #include "higanbana/core/system/ringbuffer.hpp"
 #include <atomic>
-#include <string>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace higanbana
 {
@@ -13,66 +23,271 @@ namespace higanbana
 
 namespace profiling
 {
+// rdtsc on x86, steady clock nanoseconds elsewhere. Trace clock records map ticks to nanoseconds.
+inline uint64_t readTicks() noexcept
+{
+#if defined(HIGANBANA_PLATFORM_WINDOWS) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
 
-struct ProfileData
+// Layouts are written to the trace as is, see trace_format.hpp.
+struct CpuEvent
 {
-  std::string name;
-  int64_t begin;
-  int64_t duration;
+  uint64_t begin; // ticks
+  uint64_t end;   // ticks
+  uint32_t name;
+  uint32_t reserved;
 };
 
-struct GPUProfileData
+struct GpuEvent
 {
-  int gpuID;
-  int queue;
-  std::string name;
-  int64_t begin;
-  int64_t duration;
+  int64_t begin;    // nanoseconds
+  int64_t duration; // nanoseconds
+  uint32_t name;
+  uint16_t gpu;
+  uint16_t queue;
 };
 
-class ThreadProfileData
+// Fixed size single producer ring, owning thread pushes and the trace writer drains.
+// Full ring drops the event instead of waiting for the writer.
+template <typename Event, size_t Capacity>
+class EventRing
 {
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity needs to be power of two.");
+  std::unique_ptr<Event[]> m_events = std::make_unique<Event[]>(Capacity);
+  // producer line, the cached tail keeps pushes off the consumer's cache line until the ring looks full.
+  alignas(64) std::atomic<uint64_t> m_head = 0;
+  uint64_t m_cachedTail = 0;
+  std::atomic<uint64_t> m_dropped = 0;
+  alignas(64) std::atomic<uint64_t> m_tail = 0;
   public:
-  ThreadProfileData():canWriteProfilingData(std::make_shared<std::atomic_bool>(true)) {}
-  //RingBuffer<ProfileData, 10240*2> allBrackets;
-  //RingBuffer<GPUProfileData, 10240> gpuBrackets;
-  vector<ProfileData> allBrackets;
-  vector<GPUProfileData> gpuBrackets;
-  inline void reset() {
-    allBrackets.clear();
-    gpuBrackets.clear();
+  inline void push(const Event& event) noexcept
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_cachedTail >= Capacity)
+    {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head - m_cachedTail >= Capacity)
+      {
+        m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    m_events[head & (Capacity - 1)] = event;
+    m_head.store(head + 1, std::memory_order_release);
+  }
+
+  // consumer side, func gets contiguous spans of events.
+  template <typename Func>
+  inline size_t drain(Func&& func)
+  {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+    auto count = head - tail;
+    while (tail != head)
+    {
+      auto index = tail & (Capacity - 1);
+      auto span = std::min<uint64_t>(head - tail, Capacity - index);
+      func(&m_events[index], static_cast<size_t>(span));
+      tail += span;
+    }
+    m_tail.store(tail, std::memory_order_release);
+    return static_cast<size_t>(count);
+  }
+
+  inline void discard() noexcept
+  {
+    m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  inline uint64_t dropped() const noexcept
+  {
+    return m_dropped.load(std::memory_order_relaxed);
   }
-  bool hasReset = false;
-  std::shared_ptr<std::atomic_bool> canWriteProfilingData;
-  inline bool canWriteProfile() const { return canWriteProfilingData->load(std::memory_order::seq_cst);}
 };
 
+class ThreadProfileData
+{
+  public:
+  static constexpr size_t CpuCapacity = 1 << 15;
+  static constexpr size_t GpuCapacity = 1 << 12;
+  EventRing<CpuEvent, CpuCapacity> allBrackets;
+  EventRing<GpuEvent, GpuCapacity> gpuBrackets;
+};
+
+class TraceWriter;
+class FrameSampler;
+
 struct GlobalProfilingThing {
   GlobalProfilingThing(int threadCount);
-  std::vector<ThreadProfileData> allThreadsProfilingData;
+  ~GlobalProfilingThing();
+  std::vector<std::unique_ptr<ThreadProfileData>> allThreadsProfilingData;
   std::atomic<int> myIndex;
   std::atomic<bool> enabled;
+  std::mutex drainLock;  // one consumer for the rings at a time
+  uint64_t session;  // unique per instance, threads register again when it changes
+  uint64_t startTicks;
+  int64_t startNanoseconds;
+  std::unique_ptr<TraceWriter> writer;
+  std::unique_ptr<FrameSampler> sampler;
+  bool enabledBeforeSampling = false;  // restored by disableSampling
 };
 extern GlobalProfilingThing* s_profiling;
-extern thread_local ThreadProfileData* my_profile_data;
-extern thread_local int my_thread_id;
 
-class ProfilingScope
+// Names are interned once per process, the per thread cache makes repeated names a pointer compare.
+// Literals and __FUNCTION__ live forever so their pointer alone is the key,
+// anything else (c_str() of a temporary) also compares the content on a cache hit.
+constexpr size_t NameCacheSize = 256;
+struct NameCacheEntry
 {
   const char* name;
-  //timepoint begin;
-  int64_t start;
+  const std::string* interned;
+  uint32_t id;
+};
+
+// everything a bracket touches per thread in one place.
+struct ThreadProfilingState
+{
+  uint64_t session = 0;  // threads register again when it changes
+  ThreadProfileData* data = nullptr;
+  int threadId = 0;
+  NameCacheEntry nameCache[NameCacheSize] = {};
+};
+extern thread_local ThreadProfilingState t_profiling;
+uint32_t internNameSlow(const char* name, size_t length);
+uint32_t internName(std::string_view name);
+
+inline NameCacheEntry& nameCacheEntry(const char* name)
+{
+  return t_profiling.nameCache[(reinterpret_cast<uintptr_t>(name) >> 4) & (NameCacheSize - 1)];
+}
+
+inline uint32_t internLiteral(const char* name, size_t length)
+{
+  auto& entry = nameCacheEntry(name);
+  if (entry.name == name)
+    return entry.id;
+  return internNameSlow(name, length);
+}
+
+inline uint32_t internTransient(std::string_view name)
+{
+  auto& entry = nameCacheEntry(name.data());
+  // empty views can be null just like an unused entry
+  if (entry.interned && entry.name == name.data() && *entry.interned == name)
+    return entry.id;
+  return internNameSlow(name.data(), name.size());
+}
+
+ThreadProfileData* registerProfilingThread(GlobalProfilingThing* profiling);
+inline ThreadProfileData* currentProfileData()
+{
+  auto profiling = s_profiling;
+  if (!profiling || !profiling->enabled.load(std::memory_order_relaxed))
+    return nullptr;
+  auto& state = t_profiling;
+  if (state.session != profiling->session)
+    return registerProfilingThread(profiling);
+  return state.data;
+}
+
+void pixBegin(const char* name);
+void pixEnd();
+
+class ProfilingScope
+{
+  ThreadProfileData* data;
+  uint32_t name;
+  uint64_t start;
+
+  inline void begin(const char* str)
+  {
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+    pixBegin(str);
+#endif
+    (void)str;
+    if (data)
+      start = readTicks();
+  }
 
   public:
-  ProfilingScope(const char* name);
-  ProfilingScope(std::string name);
-  ~ProfilingScope();
+  // string literals and __FUNCTION__, don't pass char buffers that get rewritten.
+  template <size_t N>
+  inline ProfilingScope(const char (&str)[N])
+    : data(currentProfileData())
+  {
+    if (data)
+      name = internLiteral(str, N - 1);
+    begin(str);
+  }
+  inline ProfilingScope(std::string_view str)
+    : data(currentProfileData())
+  {
+    if (data)
+      name = internTransient(str);
+    begin(str.data());
+  }
+  // a copy would push the same bracket again
+  ProfilingScope(const ProfilingScope&) = delete;
+  ProfilingScope& operator=(const ProfilingScope&) = delete;
+  inline ~ProfilingScope()
+  {
+    // coroutines can resume on another worker, the rings are single producer so the ending thread's ring gets it
+    if (data)
+    {
+      if (auto current = currentProfileData())
+        current->allBrackets.push(CpuEvent{start, readTicks(), name, 0});
+    }
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+    pixEnd();
+#endif
+  }
 };
+
 void writeGpuBracketData(int gpuid, int queue, std::string_view view, int64_t time, int64_t dur);
-//nlohmann::json writeEvent(std::string_view view, int64_t time, int64_t dur, int tid);
+// one shot, drains everything buffered so far into a binary trace. "/data/profiling.htrace"
 void writeProfilingData(higanbana::FileSystem& fs, GlobalProfilingThing* profiling);
+bool writeProfilingTrace(GlobalProfilingThing* profiling, const std::string& nativePath);
+// background thread appends the rings to nativePath every flushInterval until stopped.
+bool beginTraceCapture(GlobalProfilingThing* profiling, const std::string& nativePath, std::chrono::milliseconds flushInterval = std::chrono::milliseconds(20));
+void endTraceCapture(GlobalProfilingThing* profiling);
+
+// Always-on mode: brackets are folded into per name latency histograms over the last windowFrames frames
+// instead of being kept. Frames over frameBudget get their brackets written to
+// "<spikeTracePrefix><frame>.htrace", at most maxSpikeTraces of them, none if the prefix is empty.
+// Sampling and trace capture both consume the rings, starting one stops the other.
+struct SamplingOptions
+{
+  int windowFrames = 120;
+  std::chrono::nanoseconds frameBudget = std::chrono::milliseconds(33);
+  std::string spikeTracePrefix;
+  int maxSpikeTraces = 8;
+};
+
+// nanoseconds over the window, "frame" is the whole frame time.
+struct BracketStatistics
+{
+  std::string name;
+  uint64_t count;
+  int64_t p50;
+  int64_t p95;
+  int64_t p99;
+  int64_t max;
+};
+
+void enableSampling(GlobalProfilingThing* profiling, const SamplingOptions& options = SamplingOptions());
+void disableSampling(GlobalProfilingThing* profiling);
+// once per frame from the frame thread, returns true if the frame went over budget.
+bool endProfilingFrame(GlobalProfilingThing* profiling);
+vector<BracketStatistics> samplingStatistics(GlobalProfilingThing* profiling);
+
 std::unique_ptr<GlobalProfilingThing> initializeProfiling(int threadCount);
 void enableProfiling();
+// enables the given instance even when it isn't the current one
+void enableProfiling(GlobalProfilingThing* profiling);
 void disableProfiling();
 }
 }
@@ -86,5 +301,5 @@ void disableProfiling();
 #else
 #define HIGAN_CPU_BRACKET(name)
 #define HIGAN_CPU_FUNCTION_SCOPE()
-#define HIGAN_GPU_BRACKET_FULL(gpuid, queue, view, time, dur) 
-#endif
\ No newline at end of file
+#define HIGAN_GPU_BRACKET_FULL(gpuid, queue, view, time, dur)
+#endif
@@ -0,0 +1,188 @@
+#include "higanbana/core/profiling/trace_format.hpp"
+#include "higanbana/core/profiling/profiling.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace higanbana
+{
+namespace profiling
+{
+namespace
+{
+struct TraceReader
+{
+  const uint8_t* ptr;
+  size_t left;
+
+  template <typename T>
+  bool read(T& value)
+  {
+    if (left < sizeof(T))
+      return false;
+    memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    left -= sizeof(T);
+    return true;
+  }
+
+  bool view(size_t bytes, const uint8_t*& out)
+  {
+    if (left < bytes)
+      return false;
+    out = ptr;
+    ptr += bytes;
+    left -= bytes;
+    return true;
+  }
+};
+
+// Calls func(record, payload reader) for every complete record.
+template <typename Func>
+void forEachRecord(MemView<const uint8_t> trace, Func&& func)
+{
+  TraceReader reader{trace.data() + sizeof(TraceHeader), trace.size() - sizeof(TraceHeader)};
+  TraceRecord record;
+  while (reader.read(record))
+  {
+    size_t payload = 0;
+    switch (record.type)
+    {
+      case TraceRecordType::Clock: payload = sizeof(ClockSample); break;
+      case TraceRecordType::Name: payload = sizeof(uint32_t) + record.count; break;
+      case TraceRecordType::CpuEvents: payload = 2 * sizeof(uint32_t) + record.count * sizeof(CpuEvent); break;
+      case TraceRecordType::GpuEvents: payload = 2 * sizeof(uint32_t) + record.count * sizeof(GpuEvent); break;
+      case TraceRecordType::Dropped: payload = sizeof(uint64_t); break;
+      default: return;
+    }
+    const uint8_t* data;
+    if (!reader.view(payload, data))
+      return;
+    func(record, TraceReader{data, payload});
+  }
+}
+
+void appendEscaped(std::string& out, std::string_view str)
+{
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out += buffer;
+    }
+    else
+      out += c;
+  }
+}
+
+void appendEvent(std::string& out, bool& first, std::string_view name, double ts, double dur, const char* tid)
+{
+  char buffer[128];
+  out += first ? "\n" : ",\n";
+  first = false;
+  out += "{\"name\":\"";
+  appendEscaped(out, name);
+  snprintf(buffer, sizeof(buffer), "\",\"ph\":\"X\",\"pid\":\"higanbana\",\"ts\":%.3f,\"dur\":%.3f,\"tid\":\"", ts, dur);
+  out += buffer;
+  out += tid;
+  out += "\"}";
+}
+}
+
+bool convertTraceToChromeJson(MemView<const uint8_t> trace, std::string& json)
+{
+  TraceHeader header;
+  if (trace.size() < sizeof(TraceHeader))
+    return false;
+  memcpy(&header, trace.data(), sizeof(header));
+  if (memcmp(header.magic, TraceMagic, sizeof(TraceMagic)) != 0 || header.version != TraceVersion)
+    return false;
+
+  // first pass, names and the clock samples for tick rate
+  std::vector<std::string> names;
+  bool haveClock = false;
+  ClockSample firstClock{}, lastClock{};
+  forEachRecord(trace, [&](const TraceRecord& record, TraceReader reader)
+  {
+    if (record.type == TraceRecordType::Clock)
+    {
+      reader.read(lastClock);
+      if (!haveClock)
+        firstClock = lastClock;
+      haveClock = true;
+    }
+    else if (record.type == TraceRecordType::Name)
+    {
+      uint32_t id;
+      reader.read(id);
+      if (names.size() <= id)
+        names.resize(id + 1);
+      names[id].assign(reinterpret_cast<const char*>(reader.ptr), record.count);
+    }
+  });
+  double nanosecondsPerTick = 1.0;
+  if (lastClock.ticks != firstClock.ticks)
+    nanosecondsPerTick = double(lastClock.nanoseconds - firstClock.nanoseconds) / double(lastClock.ticks - firstClock.ticks);
+  auto microseconds = [&](uint64_t ticks)
+  {
+    return double(static_cast<int64_t>(ticks - firstClock.ticks)) * nanosecondsPerTick / 1000.0;
+  };
+  auto nameOf = [&](uint32_t id) -> std::string_view
+  {
+    return id < names.size() ? std::string_view(names[id]) : std::string_view("unknown");
+  };
+
+  json.clear();
+  json += "{\"traceEvents\":[";
+  bool first = true;
+  char tid[64];
+  forEachRecord(trace, [&](const TraceRecord& record, TraceReader reader)
+  {
+    uint32_t thread = 0, pad = 0;
+    if (record.type == TraceRecordType::CpuEvents)
+    {
+      reader.read(thread);
+      reader.read(pad);
+      snprintf(tid, sizeof(tid), "Thread %u", thread);
+      for (uint32_t i = 0; i < record.count; ++i)
+      {
+        CpuEvent event;
+        reader.read(event);
+        auto begin = microseconds(event.begin);
+        appendEvent(json, first, nameOf(event.name), begin, std::max(0.001, microseconds(event.end) - begin), tid);
+      }
+    }
+    else if (record.type == TraceRecordType::GpuEvents)
+    {
+      reader.read(thread);
+      reader.read(pad);
+      for (uint32_t i = 0; i < record.count; ++i)
+      {
+        GpuEvent event;
+        reader.read(event);
+        snprintf(tid, sizeof(tid), "GPU %u Queue %u", unsigned(event.gpu), unsigned(event.queue));
+        appendEvent(json, first, nameOf(event.name), double(event.begin - firstClock.nanoseconds) / 1000.0, double(event.duration) / 1000.0, tid);
+      }
+    }
+    else if (record.type == TraceRecordType::Dropped)
+    {
+      uint64_t dropped = 0;
+      reader.read(dropped);
+      snprintf(tid, sizeof(tid), "Thread %u", record.count);
+      std::string name = std::to_string(dropped) + " events dropped";
+      appendEvent(json, first, name, microseconds(lastClock.ticks), 0.001, tid);
+    }
+  });
+  json += "\n]}\n";
+  return true;
+}
+}
+}
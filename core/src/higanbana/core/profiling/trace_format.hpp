@@ -0,0 +1,54 @@
+#pragma once
+#include "higanbana/core/system/memview.hpp"
+#include <cstdint>
+#include <string>
+
+// Binary profiling trace, little endian, appended to while the program runs.
+//
+//   TraceHeader
+//   records: TraceRecord followed by a payload
+//     Clock      payload ClockSample, ticks <-> nanoseconds pairs, first and last one define the tick rate
+//     Name       count = string length, payload uint32 id + characters
+//     CpuEvents  count = events, payload uint32 thread + uint32 pad + CpuEvent[count]
+//     GpuEvents  count = events, payload uint32 thread + uint32 pad + GpuEvent[count]
+//     Dropped    count = thread, payload uint64 events dropped on that thread so far
+namespace higanbana
+{
+namespace profiling
+{
+constexpr char TraceMagic[8] = {'H', 'G', 'N', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t TraceVersion = 1;
+
+struct TraceHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+enum class TraceRecordType : uint32_t
+{
+  Clock = 1,
+  Name = 2,
+  CpuEvents = 3,
+  GpuEvents = 4,
+  Dropped = 5,
+};
+
+struct TraceRecord
+{
+  TraceRecordType type;
+  uint32_t count;
+};
+
+struct ClockSample
+{
+  uint64_t ticks;
+  int64_t nanoseconds;
+};
+
+// Chrome trace event json, load with chrome://tracing or perfetto. False if this isn't a trace,
+// a trace cut short by a crash converts up to the last complete record.
+bool convertTraceToChromeJson(MemView<const uint8_t> trace, std::string& json);
+}
+}
@@ -1,4 +1,6 @@
 #include "higanbana/core/sort/radix_sort.hpp"
+#include "higanbana/core/system/cpu_features.hpp"
+#include <immintrin.h>
 
 namespace higanbana
 {
@@ -67,4 +69,109 @@ void radix_sort_12bits(vector<unsigned>& data) {
     std::copy(copy.begin(), copy.end(), data.begin());
   }
 }
-}
\ No newline at end of file
+}
+namespace higanbana
+{
+namespace
+{
+template <typename Bits>
+Bits transformBits(Bits bits, RadixKeyTransform transform) {
+  constexpr Bits sign = Bits(1) << (sizeof(Bits) * 8 - 1);
+  switch (transform) {
+    case RadixKeyTransform::Signed:
+      return bits ^ sign;
+    case RadixKeyTransform::Float:
+      return bits ^ ((bits & sign) ? ~Bits(0) : sign);
+    default:
+      return bits;
+  }
+}
+
+template <typename Bits>
+void histogram_scalar(const unsigned char* keys, size_t size, unsigned* counts, unsigned bitOffset, Bits mask, RadixKeyTransform transform) {
+  for (size_t i = 0; i < size; i++) {
+    Bits bits;
+    memcpy(&bits, keys + i * sizeof(Bits), sizeof(Bits));
+    counts[(transformBits(bits, transform) >> bitOffset) & mask]++;
+  }
+}
+
+// 4 interleaved histograms so that runs of the same digit don't wait on the previous increment.
+constexpr unsigned SubHistogramMaxBits = 11;
+
+HIGAN_TARGET_AVX2 void histogram_avx2_32(const uint32_t* keys, size_t size, unsigned* counts, unsigned bitCount, unsigned bitOffset, RadixKeyTransform transform) {
+  const unsigned countsSize = 1u << bitCount;
+  alignas(32) uint32_t sub[4][1u << SubHistogramMaxBits];
+  for (int h = 0; h < 4; h++)
+    memset(sub[h], 0, countsSize * sizeof(uint32_t));
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>(countsSize - 1));
+  const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(bitOffset));
+  const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+  alignas(32) uint32_t digits[8];
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    if (transform == RadixKeyTransform::Signed)
+      v = _mm256_xor_si256(v, sign);
+    else if (transform == RadixKeyTransform::Float)
+      v = _mm256_xor_si256(v, _mm256_or_si256(_mm256_srai_epi32(v, 31), sign));
+    v = _mm256_and_si256(_mm256_srl_epi32(v, shift), mask);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(digits), v);
+    sub[0][digits[0]]++;
+    sub[1][digits[1]]++;
+    sub[2][digits[2]]++;
+    sub[3][digits[3]]++;
+    sub[0][digits[4]]++;
+    sub[1][digits[5]]++;
+    sub[2][digits[6]]++;
+    sub[3][digits[7]]++;
+  }
+  for (unsigned d = 0; d < countsSize; d++)
+    counts[d] = sub[0][d] + sub[1][d] + sub[2][d] + sub[3][d];
+  histogram_scalar<uint32_t>(reinterpret_cast<const unsigned char*>(keys + i), size - i, counts, bitOffset, countsSize - 1, transform);
+}
+
+HIGAN_TARGET_AVX2 void histogram_avx2_64(const uint64_t* keys, size_t size, unsigned* counts, unsigned bitCount, unsigned bitOffset, RadixKeyTransform transform) {
+  const unsigned countsSize = 1u << bitCount;
+  alignas(32) uint32_t sub[4][1u << SubHistogramMaxBits];
+  for (int h = 0; h < 4; h++)
+    memset(sub[h], 0, countsSize * sizeof(uint32_t));
+  const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(countsSize - 1));
+  const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(bitOffset));
+  const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+  alignas(32) uint64_t digits[4];
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    if (transform == RadixKeyTransform::Signed)
+      v = _mm256_xor_si256(v, sign);
+    else if (transform == RadixKeyTransform::Float)
+      v = _mm256_xor_si256(v, _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), v), sign));
+    v = _mm256_and_si256(_mm256_srl_epi64(v, shift), mask);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(digits), v);
+    sub[0][digits[0]]++;
+    sub[1][digits[1]]++;
+    sub[2][digits[2]]++;
+    sub[3][digits[3]]++;
+  }
+  for (unsigned d = 0; d < countsSize; d++)
+    counts[d] = sub[0][d] + sub[1][d] + sub[2][d] + sub[3][d];
+  histogram_scalar<uint64_t>(reinterpret_cast<const unsigned char*>(keys + i), size - i, counts, bitOffset, countsSize - 1, transform);
+}
+}
+
+void radix_histogram(const void* keys, size_t size, unsigned* counts, unsigned bitCount, unsigned bitOffset, RadixKeyTransform transform, size_t keyBytes) {
+  if (bitCount <= SubHistogramMaxBits && cpuFeatures().avx2) {
+    if (keyBytes == 4)
+      histogram_avx2_32(static_cast<const uint32_t*>(keys), size, counts, bitCount, bitOffset, transform);
+    else
+      histogram_avx2_64(static_cast<const uint64_t*>(keys), size, counts, bitCount, bitOffset, transform);
+    return;
+  }
+  memset(counts, 0, (size_t(1) << bitCount) * sizeof(unsigned));
+  if (keyBytes == 4)
+    histogram_scalar<uint32_t>(static_cast<const unsigned char*>(keys), size, counts, bitOffset, (1u << bitCount) - 1, transform);
+  else
+    histogram_scalar<uint64_t>(static_cast<const unsigned char*>(keys), size, counts, bitOffset, (uint64_t(1) << bitCount) - 1, transform);
+}
+}
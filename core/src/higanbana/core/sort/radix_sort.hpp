@@ -1,8 +1,64 @@
 #pragma once
 #include "higanbana/core/datastructures/vector.hpp"
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
 
 namespace higanbana
 {
   void radix_sort_8bits(vector<unsigned>& data);
   void radix_sort_12bits(vector<unsigned>& data);
-}
\ No newline at end of file
+
+  // How keys are turned into unsigned bits that sort in the same order.
+  enum class RadixKeyTransform
+  {
+    None,
+    Signed, // flip sign bit
+    Float   // flip sign bit of positives, every bit of negatives
+  };
+
+  template <typename Key>
+  struct RadixKey;
+
+  template <>
+  struct RadixKey<uint32_t>
+  {
+    using Bits = uint32_t;
+    static constexpr RadixKeyTransform transform = RadixKeyTransform::None;
+    static Bits bits(uint32_t key) { return key; }
+  };
+
+  template <>
+  struct RadixKey<uint64_t>
+  {
+    using Bits = uint64_t;
+    static constexpr RadixKeyTransform transform = RadixKeyTransform::None;
+    static Bits bits(uint64_t key) { return key; }
+  };
+
+  template <>
+  struct RadixKey<int32_t>
+  {
+    using Bits = uint32_t;
+    static constexpr RadixKeyTransform transform = RadixKeyTransform::Signed;
+    static Bits bits(int32_t key) { return static_cast<uint32_t>(key) ^ 0x80000000u; }
+  };
+
+  template <>
+  struct RadixKey<float>
+  {
+    using Bits = uint32_t;
+    static constexpr RadixKeyTransform transform = RadixKeyTransform::Float;
+    static Bits bits(float key)
+    {
+      uint32_t u;
+      memcpy(&u, &key, sizeof(u));
+      return u ^ (static_cast<uint32_t>(static_cast<int32_t>(u) >> 31) | 0x80000000u);
+    }
+  };
+
+  // Digit histograms, counts has 1 << bitCount entries and is overwritten.
+  // keys are read as raw 32/64bit words, transform is applied before taking the digit.
+  // Uses AVX2 when the cpu has it.
+  void radix_histogram(const void* keys, size_t size, unsigned* counts, unsigned bitCount, unsigned bitOffset, RadixKeyTransform transform, size_t keyBytes);
+}
@@ -50,6 +50,16 @@ css::Task<void> radix_sort_count(unsigned* ptr, unsigned size, unsigned* counts,
 }
 
 css::Task<void> radix_sort_write_val(unsigned* output, unsigned* ptr, unsigned size, unsigned* counts, unsigned bitCount, unsigned bitOffset) {
+  if (bitCount <= radix_detail::WriteCombineMaxBits && size >= radix_detail::WriteCombineMinSize) {
+    // counts are where each digit of this split ends, the write combined scatter goes forward from where they begin
+    unsigned splitCounts[1 << radix_detail::WriteCombineMaxBits];
+    radix_histogram(ptr, size, splitCounts, bitCount, bitOffset, RadixKey<unsigned>::transform, sizeof(unsigned));
+    for (unsigned i = 0; i < (1u << bitCount); i++) {
+      counts[i] -= splitCounts[i];
+    }
+    co_await radix_detail::scatter_digits_write_combined<unsigned, radix_detail::NoValue>(ptr, nullptr, size, output, nullptr, counts, bitCount, bitOffset);
+    co_return;
+  }
   unsigned mask = ((1 << bitCount) - 1) << bitOffset;
 
   // write copy 
@@ -62,5 +72,28 @@ css::Task<void> radix_sort_write_val(unsigned* output, unsigned* ptr, unsigned s
 
   co_return;
 }
+
+css::Task<void> radix_sort_scan_digits(unsigned* counts, unsigned countsSize, unsigned splits, unsigned digitBegin, unsigned digitEnd, unsigned* rangeTotal) {
+  // exclusive sum in digit major order, same digit in earlier splits comes first to keep the sort stable
+  unsigned sum = 0;
+  for (unsigned i = digitBegin; i < digitEnd; i++) {
+    for (unsigned t = 0; t < splits; t++) {
+      unsigned count = counts[t * countsSize + i];
+      counts[t * countsSize + i] = sum;
+      sum += count;
+    }
+  }
+  *rangeTotal = sum;
+  co_return;
+}
+
+css::Task<void> radix_sort_add_offset(unsigned* counts, unsigned countsSize, unsigned splits, unsigned digitBegin, unsigned digitEnd, unsigned offset) {
+  for (unsigned t = 0; t < splits; t++) {
+    for (unsigned i = digitBegin; i < digitEnd; i++) {
+      counts[t * countsSize + i] += offset;
+    }
+  }
+  co_return;
+}
 }
 #endif
\ No newline at end of file
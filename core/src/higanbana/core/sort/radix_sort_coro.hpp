@@ -1,18 +1,26 @@
 #pragma once
 #include "higanbana/core/datastructures/vector.hpp"
+#include "higanbana/core/global_debug.hpp"
+#include "higanbana/core/sort/radix_sort.hpp"
+#include "higanbana/core/allocators/thread_caching_allocator.hpp"
 #if JGPU_COROUTINES
 #include <css/task.hpp>
+#include <cstdint>
+#include <type_traits>
+#include <emmintrin.h>
 
 namespace higanbana
 {
 css::Task<void> radix_sort_8bits_task(vector<unsigned>& data);
 css::Task<void> radix_sort_count(unsigned* ptr, unsigned size, unsigned* counts, unsigned bitCount, unsigned bitOffset);
 css::Task<void> radix_sort_write_val(unsigned* output, unsigned* ptr, unsigned size, unsigned* counts, unsigned bitCount, unsigned bitOffset);
+css::Task<void> radix_sort_scan_digits(unsigned* counts, unsigned countsSize, unsigned splits, unsigned digitBegin, unsigned digitEnd, unsigned* rangeTotal);
+css::Task<void> radix_sort_add_offset(unsigned* counts, unsigned countsSize, unsigned splits, unsigned digitBegin, unsigned digitEnd, unsigned offset);
 
 template<unsigned radixBits, unsigned taskSplit>
 css::Task<void> radix_sort_task(vector<unsigned>& data) {
   auto copy = data;
-  unsigned* counts = reinterpret_cast<unsigned*>(css::s_stealPool->localAllocate(taskSplit * (1 << radixBits) * sizeof(unsigned)));
+  unsigned* counts = reinterpret_cast<unsigned*>(ThreadCachingHeap::allocate(taskSplit * (1 << radixBits) * sizeof(unsigned)));
   
   for (unsigned bitOffset = 0; bitOffset < 32; bitOffset += radixBits) {
     unsigned bitsToHandle = std::min(32u - bitOffset, radixBits);
@@ -46,7 +54,7 @@ css::Task<void> radix_sort_task(vector<unsigned>& data) {
     // write output
     std::copy(copy.begin(), copy.end(), data.begin());
   }
-  css::s_stealPool->localFree(counts, taskSplit * (1 << radixBits) * sizeof(unsigned));
+  ThreadCachingHeap::deallocate(counts);
   co_return;
 }
 
@@ -57,7 +65,7 @@ css::Task<void> radix_sort_task_fast(vector<unsigned>& data) {
   vector<unsigned>* read = &data;
   vector<unsigned>* output = &copy;
   const size_t dataSize = data.size();
-  unsigned* counts = reinterpret_cast<unsigned*>(css::s_stealPool->localAllocate(taskSplit * (1 << radixBits) * sizeof(unsigned)));
+  unsigned* counts = reinterpret_cast<unsigned*>(ThreadCachingHeap::allocate(taskSplit * (1 << radixBits) * sizeof(unsigned)));
   
   for (unsigned bitOffset = 0; bitOffset < 32; bitOffset += radixBits) {
     unsigned bitsToHandle = std::min(32u - bitOffset, radixBits);
@@ -101,11 +109,247 @@ css::Task<void> radix_sort_task_fast(vector<unsigned>& data) {
     std::swap(read, output);
     //std::copy(copy.begin(), copy.end(), data.begin());
   }
-  css::s_stealPool->localFree(counts, taskSplit * (1 << radixBits) * sizeof(unsigned));
+  ThreadCachingHeap::deallocate(counts);
   // write output
   if (read != originalPtr)
     std::copy(read->begin(), read->end(), originalPtr->begin());
   co_return;
 }
+
+namespace radix_detail
+{
+struct NoValue {};
+
+// Counts digits of one split. uniformDigit gets the digit if every key had the same one, -1 if not, -2 for empty split.
+template<typename Key>
+css::Task<void> count_digits(const Key* keys, size_t size, unsigned* counts, unsigned bitCount, unsigned bitOffset, int* uniformDigit) {
+  using Bits = typename RadixKey<Key>::Bits;
+  radix_histogram(keys, size, counts, bitCount, bitOffset, RadixKey<Key>::transform, sizeof(Bits));
+  *uniformDigit = -2;
+  if (size > 0) {
+    unsigned first = static_cast<unsigned>((RadixKey<Key>::bits(keys[0]) >> bitOffset) & ((Bits(1) << bitCount) - 1));
+    *uniformDigit = counts[first] == size ? static_cast<int>(first) : -1;
+  }
+  co_return;
+}
+
+// Stable scatter of one split, offsets are exclusive and get bumped as elements are written.
+template<typename Key, typename Value>
+css::Task<void> scatter_digits(const Key* keys, const Value* values, size_t size, Key* outKeys, Value* outValues, unsigned* offsets, unsigned bitCount, unsigned bitOffset) {
+  using Bits = typename RadixKey<Key>::Bits;
+  const Bits mask = (Bits(1) << bitCount) - 1;
+  for (size_t i = 0; i < size; i++) {
+    unsigned index = offsets[(RadixKey<Key>::bits(keys[i]) >> bitOffset) & mask]++;
+    outKeys[index] = keys[i];
+    if constexpr (!std::is_same_v<Value, NoValue>) {
+      outValues[index] = values[i];
+    }
+  }
+  co_return;
+}
+
+// Software write combining for big splits. Keys collect into a cache line sized buffer per digit,
+// full lines go out with streaming stores so the scatter doesn't pull destination lines into cache
+// just to overwrite them. Buffers start at the destination's position inside its line, so every full
+// buffer is one aligned line. Values ride along in matching buffers and are copied normally.
+constexpr size_t WriteCombineLine = 64;
+constexpr unsigned WriteCombineMaxBits = 8; // 256 lines of buffers fit in L1
+constexpr size_t WriteCombineMinSize = 1 << 16;
+
+template<typename Key, typename Value>
+css::Task<void> scatter_digits_write_combined(const Key* keys, const Value* values, size_t size, Key* outKeys, Value* outValues, unsigned* offsets, unsigned bitCount, unsigned bitOffset) {
+  using Bits = typename RadixKey<Key>::Bits;
+  constexpr unsigned perLine = static_cast<unsigned>(WriteCombineLine / sizeof(Key));
+  constexpr size_t valueLineBytes = std::is_same_v<Value, NoValue> ? 0 : perLine * sizeof(Value);
+  const Bits mask = (Bits(1) << bitCount) - 1;
+  const unsigned countsSize = 1u << bitCount;
+  const size_t bytes = WriteCombineLine + countsSize * (WriteCombineLine + valueLineBytes + 2);
+  char* memory = reinterpret_cast<char*>(ThreadCachingHeap::allocate(bytes));
+  Key* keyLines = reinterpret_cast<Key*>((reinterpret_cast<uintptr_t>(memory) + WriteCombineLine - 1) & ~uintptr_t(WriteCombineLine - 1));
+  Value* valueLines = reinterpret_cast<Value*>(reinterpret_cast<char*>(keyLines) + countsSize * WriteCombineLine);
+  uint8_t* fill = reinterpret_cast<uint8_t*>(valueLines) + countsSize * valueLineBytes;
+  uint8_t* start = fill + countsSize;
+  for (unsigned d = 0; d < countsSize; d++) {
+    start[d] = fill[d] = static_cast<uint8_t>((reinterpret_cast<uintptr_t>(outKeys + offsets[d]) % WriteCombineLine) / sizeof(Key));
+  }
+
+  auto flush = [&](unsigned d) {
+    unsigned count = fill[d] - start[d];
+    unsigned dst = offsets[d] - count;
+    Key* line = keyLines + d * perLine;
+    if (start[d] == 0 && count == perLine) {
+      const __m128i* src = reinterpret_cast<const __m128i*>(line);
+      __m128i* out = reinterpret_cast<__m128i*>(outKeys + dst);
+      for (unsigned i = 0; i < WriteCombineLine / sizeof(__m128i); i++) {
+        _mm_stream_si128(out + i, _mm_load_si128(src + i));
+      }
+    }
+    else {
+      std::copy(line + start[d], line + fill[d], outKeys + dst);
+    }
+    if constexpr (!std::is_same_v<Value, NoValue>) {
+      Value* valueLine = valueLines + d * perLine;
+      std::copy(valueLine + start[d], valueLine + fill[d], outValues + dst);
+    }
+    start[d] = fill[d] = 0;
+  };
+
+  for (size_t i = 0; i < size; i++) {
+    unsigned d = static_cast<unsigned>((RadixKey<Key>::bits(keys[i]) >> bitOffset) & mask);
+    unsigned slot = fill[d]++;
+    keyLines[d * perLine + slot] = keys[i];
+    if constexpr (!std::is_same_v<Value, NoValue>) {
+      valueLines[d * perLine + slot] = values[i];
+    }
+    offsets[d]++;
+    if (slot + 1 == perLine) {
+      flush(d);
+    }
+  }
+  for (unsigned d = 0; d < countsSize; d++) {
+    if (fill[d] != start[d])
+      flush(d);
+  }
+  // streaming stores aren't ordered with the rest, make them visible before the task completes
+  _mm_sfence();
+  ThreadCachingHeap::deallocate(memory);
+  co_return;
+}
+
+template<typename Key, typename Value>
+css::Task<void> copy_range(const Key* keys, const Value* values, size_t size, Key* outKeys, Value* outValues) {
+  std::copy(keys, keys + size, outKeys);
+  if constexpr (!std::is_same_v<Value, NoValue>) {
+    std::copy(values, values + size, outValues);
+  }
+  co_return;
+}
+
+// LSD radix sort over raw arrays, scratch arrays need to hold size elements.
+// Every phase is split to taskSplit tasks, including the prefix sum over digit columns.
+// Passes where all keys share the digit don't move anything and are skipped.
+template<unsigned radixBits, unsigned taskSplit, typename Key, typename Value>
+css::Task<void> radix_sort_task_impl(Key* keys, Value* values, Key* keyScratch, Value* valueScratch, size_t size) {
+  static_assert(radixBits > 0 && radixBits <= 16, "radixBits needs to be between 1 and 16.");
+  constexpr unsigned keyBits = sizeof(typename RadixKey<Key>::Bits) * 8;
+  HIGAN_ASSERT(size <= 0xffffffffull, "radix sort counts are 32bit, %zu elements is too many.", size);
+  if (size < 2)
+    co_return;
+  const size_t countsBytes = taskSplit * (1 << radixBits) * sizeof(unsigned);
+  unsigned* counts = reinterpret_cast<unsigned*>(ThreadCachingHeap::allocate(countsBytes));
+  int uniformDigit[taskSplit];
+  unsigned rangeTotals[taskSplit];
+
+  Key* readKeys = keys;
+  Key* writeKeys = keyScratch;
+  Value* readValues = values;
+  Value* writeValues = valueScratch;
+  const size_t splitTo = (size + taskSplit - 1) / taskSplit;
+  vector<css::Task<void>> runningTasks;
+  runningTasks.reserve(taskSplit);
+
+  for (unsigned bitOffset = 0; bitOffset < keyBits; bitOffset += radixBits) {
+    unsigned bitsToHandle = std::min(keyBits - bitOffset, radixBits);
+    unsigned countsSize = (1 << bitsToHandle);
+
+    for (unsigned t = 0; t < taskSplit; t++) {
+      size_t begin = std::min(t * splitTo, size);
+      size_t portion = std::min(splitTo, size - begin);
+      runningTasks.emplace_back(count_digits(readKeys + begin, portion, counts + t * countsSize, bitsToHandle, bitOffset, &uniformDigit[t]));
+    }
+    for (auto&& task : runningTasks) {
+      co_await task;
+    }
+    runningTasks.clear();
+
+    int digit = -2;
+    bool uniform = true;
+    for (unsigned t = 0; t < taskSplit && uniform; t++) {
+      if (uniformDigit[t] == -2)
+        continue;
+      uniform = uniformDigit[t] >= 0 && (digit == -2 || digit == uniformDigit[t]);
+      digit = uniformDigit[t];
+    }
+    if (uniform)
+      continue;
+
+    // prefix sum, each task scans a range of digit columns, then ranges are offset by the totals before them
+    unsigned digitsPerTask = (countsSize + taskSplit - 1) / taskSplit;
+    for (unsigned t = 0; t < taskSplit; t++) {
+      unsigned digitBegin = std::min(t * digitsPerTask, countsSize);
+      unsigned digitEnd = std::min(digitBegin + digitsPerTask, countsSize);
+      runningTasks.emplace_back(radix_sort_scan_digits(counts, countsSize, taskSplit, digitBegin, digitEnd, &rangeTotals[t]));
+    }
+    for (auto&& task : runningTasks) {
+      co_await task;
+    }
+    runningTasks.clear();
+    unsigned sum = 0;
+    for (unsigned t = 0; t < taskSplit; t++) {
+      unsigned digitBegin = std::min(t * digitsPerTask, countsSize);
+      unsigned digitEnd = std::min(digitBegin + digitsPerTask, countsSize);
+      if (t > 0)
+        runningTasks.emplace_back(radix_sort_add_offset(counts, countsSize, taskSplit, digitBegin, digitEnd, sum));
+      sum += rangeTotals[t];
+    }
+    for (auto&& task : runningTasks) {
+      co_await task;
+    }
+    runningTasks.clear();
+
+    for (unsigned t = 0; t < taskSplit; t++) {
+      size_t begin = std::min(t * splitTo, size);
+      size_t portion = std::min(splitTo, size - begin);
+      if (bitsToHandle <= WriteCombineMaxBits && portion >= WriteCombineMinSize)
+        runningTasks.emplace_back(scatter_digits_write_combined(readKeys + begin, readValues + begin, portion, writeKeys, writeValues, counts + t * countsSize, bitsToHandle, bitOffset));
+      else
+        runningTasks.emplace_back(scatter_digits(readKeys + begin, readValues + begin, portion, writeKeys, writeValues, counts + t * countsSize, bitsToHandle, bitOffset));
+    }
+    for (auto&& task : runningTasks) {
+      co_await task;
+    }
+    runningTasks.clear();
+    std::swap(readKeys, writeKeys);
+    std::swap(readValues, writeValues);
+  }
+  ThreadCachingHeap::deallocate(counts);
+
+  // write output
+  if (readKeys != keys) {
+    for (unsigned t = 0; t < taskSplit; t++) {
+      size_t begin = std::min(t * splitTo, size);
+      size_t portion = std::min(splitTo, size - begin);
+      runningTasks.emplace_back(copy_range(readKeys + begin, readValues + begin, portion, keys + begin, values + begin));
+    }
+    for (auto&& task : runningTasks) {
+      co_await task;
+    }
+    runningTasks.clear();
+  }
+  co_return;
+}
+}
+
+// Sorts uint32_t, uint64_t, int32_t or float keys, scratch is resized to keys.size() and used instead of allocating a copy.
+template<unsigned radixBits = 8, unsigned taskSplit = 8, typename Key>
+css::Task<void> radix_sort_task_keys(vector<Key>& keys, vector<Key>& scratch) {
+  scratch.resize(keys.size());
+  radix_detail::NoValue none;
+  co_await radix_detail::radix_sort_task_impl<radixBits, taskSplit, Key, radix_detail::NoValue>(keys.data(), &none, scratch.data(), &none, keys.size());
+}
+
+template<unsigned radixBits = 8, unsigned taskSplit = 8>
+css::Task<void> radix_sort_task_u64(vector<uint64_t>& keys, vector<uint64_t>& scratch) {
+  co_await radix_sort_task_keys<radixBits, taskSplit>(keys, scratch);
+}
+
+// Sorts keys and moves values along, for example draw sort keys with an index payload. Stable.
+template<unsigned radixBits = 8, unsigned taskSplit = 8, typename Key, typename Value>
+css::Task<void> radix_sort_task_pairs(vector<Key>& keys, vector<Value>& values, vector<Key>& keyScratch, vector<Value>& valueScratch) {
+  HIGAN_ASSERT(keys.size() == values.size(), "every key needs a value, %zu keys and %zu values.", keys.size(), values.size());
+  keyScratch.resize(keys.size());
+  valueScratch.resize(values.size());
+  co_await radix_detail::radix_sort_task_impl<radixBits, taskSplit, Key, Value>(keys.data(), values.data(), keyScratch.data(), valueScratch.data(), keys.size());
+}
 }
 #endif
\ No newline at end of file
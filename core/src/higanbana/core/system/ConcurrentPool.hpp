@@ -0,0 +1,122 @@
+#pragma once
+#include "higanbana/core/global_debug.hpp"
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+namespace higanbana
+{
+  // Lock-free pool of reusable T slots addressed by index.
+  // Slots are allocated in chunks that live as long as the pool, so after warmup acquire/release never touch the heap.
+  // Objects are constructed once per slot and reused as is, caller resets whatever state it cares about.
+  // Free slots form a Treiber stack, the tag in the upper 32 bits of head prevents ABA.
+  template <typename T, uint32_t ChunkSize = 256, uint32_t MaxChunks = 4096>
+  class ConcurrentPool
+  {
+    static constexpr uint32_t Empty = 0xffffffffu;
+
+    struct Slot
+    {
+      T value;
+      std::atomic<uint32_t> next = Empty;
+    };
+
+    std::atomic<uint64_t> m_head;
+    std::atomic<Slot*>    m_chunks[MaxChunks];
+    std::atomic<uint32_t> m_chunkCount;
+    std::mutex            m_growLock;
+
+    Slot& slot(uint32_t index)
+    {
+      return m_chunks[index / ChunkSize].load(std::memory_order_acquire)[index % ChunkSize];
+    }
+
+    static uint64_t pack(uint64_t oldHead, uint32_t index)
+    {
+      return (((oldHead >> 32) + 1) << 32) | index;
+    }
+
+    void grow()
+    {
+      std::lock_guard<std::mutex> guard(m_growLock);
+      if (static_cast<uint32_t>(m_head.load(std::memory_order_acquire)) != Empty)
+        return; // someone else refilled while we were waiting
+      uint32_t chunk = m_chunkCount.load(std::memory_order_relaxed);
+      HIGAN_ASSERT(chunk < MaxChunks, "ConcurrentPool ran out of chunks, %u slots in use.", chunk * ChunkSize);
+      Slot* slots = new Slot[ChunkSize];
+      uint32_t base = chunk * ChunkSize;
+      for (uint32_t i = 0; i < ChunkSize - 1; ++i)
+      {
+        slots[i].next.store(base + i + 1, std::memory_order_relaxed);
+      }
+      m_chunks[chunk].store(slots, std::memory_order_release);
+      m_chunkCount.store(chunk + 1, std::memory_order_release);
+      // push the whole chain at once
+      uint64_t head = m_head.load(std::memory_order_relaxed);
+      do
+      {
+        slots[ChunkSize - 1].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+      } while (!m_head.compare_exchange_weak(head, pack(head, base), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+  public:
+    ConcurrentPool()
+      : m_head(Empty)
+      , m_chunkCount(0)
+    {
+      for (auto& it : m_chunks)
+        it.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ConcurrentPool(const ConcurrentPool&) = delete;
+    ConcurrentPool& operator=(const ConcurrentPool&) = delete;
+
+    ~ConcurrentPool()
+    {
+      uint32_t count = m_chunkCount.load();
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        delete[] m_chunks[i].load();
+      }
+    }
+
+    T& operator[](uint32_t index)
+    {
+      return slot(index).value;
+    }
+
+    uint32_t acquire()
+    {
+      uint64_t head = m_head.load(std::memory_order_acquire);
+      while (true)
+      {
+        uint32_t index = static_cast<uint32_t>(head);
+        if (index == Empty)
+        {
+          grow();
+          head = m_head.load(std::memory_order_acquire);
+          continue;
+        }
+        uint32_t next = slot(index).next.load(std::memory_order_relaxed);
+        if (m_head.compare_exchange_weak(head, pack(head, next), std::memory_order_acq_rel, std::memory_order_acquire))
+          return index;
+      }
+    }
+
+    void release(uint32_t index)
+    {
+      Slot& s = slot(index);
+      uint64_t head = m_head.load(std::memory_order_relaxed);
+      do
+      {
+        s.next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+      } while (!m_head.compare_exchange_weak(head, pack(head, index), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // slots allocated so far
+    size_t capacity() const
+    {
+      return static_cast<size_t>(m_chunkCount.load()) * ChunkSize;
+    }
+  };
+}
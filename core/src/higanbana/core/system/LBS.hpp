@@ -12,9 +12,19 @@
 #include <cassert>
 #include <mutex>
 #include <condition_variable>
+#include <shared_mutex>
+#include <new>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
 
 // optional include, just dont enable "debug"
 #include "higanbana/core/global_debug.hpp"
+#include "higanbana/core/system/WorkStealingDeque.hpp"
+#include "higanbana/core/system/ConcurrentPool.hpp"
+#include "higanbana/core/system/HighResClock.hpp"
+#include "higanbana/core/thread/cpu_info.hpp"
+#include "higanbana/core/thread/this_thread.hpp"
 
 //#define DEBUGTEXT
 //#define DEADLOCKCHECK // this should be cheap to keep on, not
@@ -52,12 +62,181 @@ namespace higanbana
     }
   };
 
+  using RequirementId = uint32_t;
+
+  // Requirement names are interned once when a task is described, the solver only deals with dense ids.
+  class RequirementTable
+  {
+    mutable std::shared_mutex                        m_lock;
+    std::unordered_map< std::string, RequirementId > m_ids;
+    std::deque< std::string >                        m_names; // deque so that name pointers stay valid
+  public:
+    RequirementId intern(const std::string& name)
+    {
+      {
+        std::shared_lock<std::shared_mutex> lock(m_lock);
+        auto it = m_ids.find(name);
+        if (it != m_ids.end())
+          return it->second;
+      }
+      std::unique_lock<std::shared_mutex> lock(m_lock);
+      auto it = m_ids.find(name);
+      if (it != m_ids.end())
+        return it->second;
+      auto id = static_cast<RequirementId>(m_names.size());
+      m_names.push_back(name);
+      m_ids[name] = id;
+      return id;
+    }
+
+    void intern(const Requirements& reqs, std::vector<RequirementId>& ids)
+    {
+      ids.clear();
+      for (auto& it : reqs.m_regs)
+        ids.push_back(intern(it));
+    }
+
+    const char* name(RequirementId id) const
+    {
+      std::shared_lock<std::shared_mutex> lock(m_lock);
+      return m_names[id].c_str();
+    }
+  };
+
   struct TaskInfo
   {
-    TaskInfo() :m_post({}) {}
-    TaskInfo(std::string name, Requirements post) : m_name(name), m_post(post) {}
-    std::string m_name;
-    Requirements m_post;
+    RequirementId m_nameId = 0;
+    std::vector<RequirementId> m_post;
+  };
+
+  struct TaskShared;
+
+  // Type erased bool(TaskShared&, size_t& iterID, size_t& iterations) with inline storage so that describing a task doesn't allocate.
+  // Callables bigger than the inline storage fall back to heap.
+  class TaskFunction
+  {
+  public:
+    static constexpr size_t InlineSize = 64;
+
+    TaskFunction() = default;
+    TaskFunction(const TaskFunction&) = delete;
+    TaskFunction& operator=(const TaskFunction&) = delete;
+    ~TaskFunction()
+    {
+      reset();
+    }
+
+    template <typename Func>
+    void assign(Func&& func)
+    {
+      using F = std::decay_t<Func>;
+      reset();
+      if constexpr (fitsInline<F>())
+        m_callable = new (m_storage) F(std::forward<Func>(func));
+      else
+        m_callable = new F(std::forward<Func>(func));
+      m_ops = &Ops<F>::table;
+    }
+
+    void copyFrom(const TaskFunction& other)
+    {
+      reset();
+      if (other.m_ops)
+      {
+        m_callable = other.m_ops->clone(other.m_callable, m_storage);
+        m_ops = other.m_ops;
+      }
+    }
+
+    void reset()
+    {
+      if (m_ops)
+      {
+        m_ops->destroy(m_callable, m_callable == m_storage);
+        m_ops = nullptr;
+        m_callable = nullptr;
+      }
+    }
+
+    explicit operator bool() const
+    {
+      return m_ops != nullptr;
+    }
+
+    inline bool operator()(TaskShared& shared, size_t& iterID, size_t& iterations)
+    {
+      return m_ops->invoke(m_callable, shared, iterID, iterations);
+    }
+
+  private:
+    struct Table
+    {
+      bool (*invoke)(void*, TaskShared&, size_t&, size_t&);
+      void (*destroy)(void*, bool isInline);
+      void* (*clone)(const void*, void* storage);
+    };
+
+    template <typename F>
+    static constexpr bool fitsInline()
+    {
+      return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t);
+    }
+
+    template <typename F>
+    struct Ops
+    {
+      static bool invoke(void* f, TaskShared& shared, size_t& iterID, size_t& iterations)
+      {
+        return (*static_cast<F*>(f))(shared, iterID, iterations);
+      }
+      static void destroy(void* f, bool isInline)
+      {
+        if (isInline)
+          static_cast<F*>(f)->~F();
+        else
+          delete static_cast<F*>(f);
+      }
+      static void* clone(const void* f, void* storage)
+      {
+        if constexpr (fitsInline<F>())
+          return new (storage) F(*static_cast<const F*>(f));
+        else
+          return new F(*static_cast<const F*>(f));
+      }
+      static constexpr Table table = { &invoke, &destroy, &clone };
+    };
+
+    alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+    void*        m_callable = nullptr;
+    const Table* m_ops = nullptr;
+  };
+
+  // State shared between all splits of a Task, travels with the task so that queueing doesn't need a global map.
+  // Lives in a pool owned by LBS, returned there when the last split referencing it dies.
+  struct TaskShared
+  {
+    std::atomic<size_t>   m_workCounter = 0;
+    std::atomic<uint32_t> m_refs = 0;
+    std::atomic<size_t>   m_grain = 0; // iterations per chunk for adaptive tasks
+    TaskInfo              m_info;
+    TaskFunction          m_work;
+    uint32_t              m_poolIndex = 0;
+    ConcurrentPool<TaskShared>* m_pool = nullptr;
+
+    void addRef()
+    {
+      m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+      if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        m_work.reset();
+        m_info.m_post.clear(); // keeps capacity for the next user
+        m_pool->release(m_poolIndex);
+      }
+    }
   };
 
   static thread_local int t_threadid;
@@ -79,54 +258,94 @@ namespace higanbana
       m_originalIterations(m_iterations),
       m_originalIterID(m_iterID),
       m_ppt(1),
-      m_sharedWorkCounter(std::shared_ptr<std::atomic<size_t>>(new std::atomic<size_t>()))
+      m_shared(nullptr)
     {
-      genWorkFunc<1>([](size_t) {});
     };
-    Task(size_t id, size_t start, size_t iterations) :
+    Task(size_t id, size_t start, size_t iterations, TaskShared* shared) :
       m_id(id),
       m_iterations(iterations),
       m_iterID(start),
       m_originalIterations(m_iterations),
       m_originalIterID(m_iterID),
       m_ppt(1),
-      m_sharedWorkCounter(std::shared_ptr<std::atomic<size_t>>(new std::atomic<size_t>()))
+      m_shared(shared)
     {
-      genWorkFunc<1>([](size_t) {});
-      m_sharedWorkCounter->store(m_iterations);
+      m_shared->addRef();
     };
-
-  private:
-    Task(size_t id, size_t start, size_t iterations, std::shared_ptr < std::atomic<size_t> > sharedWorkCount) :
-      m_id(id),
-      m_iterations(iterations),
-      m_iterID(start),
-      m_originalIterations(m_iterations),
-      m_originalIterID(m_iterID),
-      m_ppt(1),
-      m_sharedWorkCounter(sharedWorkCount)
+    Task(const Task& other) :
+      m_id(other.m_id),
+      m_iterations(other.m_iterations),
+      m_iterID(other.m_iterID),
+      m_originalIterations(other.m_originalIterations),
+      m_originalIterID(other.m_originalIterID),
+      m_ppt(other.m_ppt),
+      m_reschedule(other.m_reschedule),
+      m_shared(other.m_shared)
     {
-      genWorkFunc<1>([](size_t) {});
-    };
-  public:
+      if (m_shared)
+        m_shared->addRef();
+    }
+    Task(Task&& other) noexcept :
+      m_id(other.m_id),
+      m_iterations(other.m_iterations),
+      m_iterID(other.m_iterID),
+      m_originalIterations(other.m_originalIterations),
+      m_originalIterID(other.m_originalIterID),
+      m_ppt(other.m_ppt),
+      m_reschedule(other.m_reschedule),
+      m_shared(other.m_shared)
+    {
+      other.m_shared = nullptr;
+      other.m_iterations = 0;
+    }
+    Task& operator=(const Task& other)
+    {
+      Task copy(other);
+      return *this = std::move(copy);
+    }
+    Task& operator=(Task&& other) noexcept
+    {
+      if (this != &other)
+      {
+        if (m_shared)
+          m_shared->release();
+        m_id = other.m_id;
+        m_iterations = other.m_iterations;
+        m_iterID = other.m_iterID;
+        m_originalIterations = other.m_originalIterations;
+        m_originalIterID = other.m_originalIterID;
+        m_ppt = other.m_ppt;
+        m_reschedule = other.m_reschedule;
+        m_shared = other.m_shared;
+        other.m_shared = nullptr;
+        other.m_iterations = 0;
+      }
+      return *this;
+    }
+    ~Task()
+    {
+      if (m_shared)
+        m_shared->release();
+    }
 
     size_t m_id;
     size_t m_iterations;
     size_t m_iterID;
     size_t m_originalIterations;
     size_t m_originalIterID;
-    int m_ppt;
+    int m_ppt; // 0 means adaptive, chunk size is in m_shared->m_grain
     bool m_reschedule = false;
-    std::shared_ptr < std::atomic<size_t> > m_sharedWorkCounter;
+    TaskShared* m_shared;
 
-    std::function<bool(size_t&, size_t&)> f_work;
+    static constexpr size_t UnsampledGrain = std::numeric_limits<size_t>::max();
+    static constexpr size_t AdaptiveBlock = 16;
 
     // Generates ppt sized for -loop lambda inside this work.
     template<size_t ppt, typename Func>
     void genWorkFunc(Func&& func)
     {
       m_ppt = ppt;
-      f_work = [func](size_t& iterID, size_t& iterations) -> bool
+      m_shared->m_work.assign([func = std::forward<Func>(func)](TaskShared&, size_t& iterID, size_t& iterations) -> bool
       {
         if (iterations == 0)
         {
@@ -151,27 +370,101 @@ namespace higanbana
           iterations -= ppt;
         }
         return iterations == 0;
-      };
+      });
+    }
+
+    // Adaptive version, chunk size is decided at runtime.
+    // First call runs doubling batches until it has a sample of the per iteration cost,
+    // then chunk size is picked so that one chunk takes about targetNanoseconds.
+    // Splitting is blocked until the sample exists.
+    template<typename Func>
+    void genAdaptiveWorkFunc(Func&& func, uint64_t targetNanoseconds)
+    {
+      m_ppt = 0;
+      m_shared->m_grain.store(UnsampledGrain, std::memory_order_relaxed);
+      m_shared->m_work.assign([func = std::forward<Func>(func), targetNanoseconds](TaskShared& shared, size_t& iterID, size_t& iterations) -> bool
+      {
+        if (iterations == 0)
+        {
+          return true;
+        }
+        size_t grain = shared.m_grain.load(std::memory_order_relaxed);
+        if (grain == UnsampledGrain)
+        {
+          const uint64_t sampleNanoseconds = std::max<uint64_t>(targetNanoseconds / 8, 1000);
+          size_t done = 0;
+          size_t batch = 1;
+          uint64_t elapsed = 0;
+          auto start = HighPrecisionClock::now();
+          while (iterations > 0)
+          {
+            size_t count = std::min(batch, iterations);
+            for (size_t i = 0; i < count; ++i)
+            {
+              func(iterID);
+              ++iterID;
+            }
+            iterations -= count;
+            done += count;
+            elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(HighPrecisionClock::now() - start).count());
+            if (elapsed >= sampleNanoseconds)
+              break;
+            batch *= 2;
+          }
+          uint64_t perIteration = std::max<uint64_t>(elapsed / done, 1);
+          shared.m_grain.store(std::max<size_t>(static_cast<size_t>(targetNanoseconds / perIteration), 1), std::memory_order_relaxed);
+          return iterations == 0;
+        }
+        size_t begin = iterID;
+        size_t end = begin + std::min(grain, iterations);
+        size_t i = begin;
+        // fixed size blocks so that the compiler can still vectorize like with constant ppt
+        for (; i + AdaptiveBlock <= end; i += AdaptiveBlock)
+        {
+          for (size_t k = 0; k < AdaptiveBlock; ++k)
+          {
+            func(i + k);
+          }
+        }
+        for (; i < end; ++i)
+        {
+          func(i);
+        }
+        iterID = end;
+        iterations -= end - begin;
+        return iterations == 0;
+      });
+    }
+
+    // iterations done per doWork, also the size under which task isn't split anymore.
+    inline size_t grain() const
+    {
+      if (m_ppt > 0 || !m_shared)
+        return static_cast<size_t>(m_ppt);
+      return m_shared->m_grain.load(std::memory_order_relaxed);
     }
 
     // does ppt amount of work
     inline bool doWork()
     {
-      return f_work(m_iterID, m_iterations);
+      if (!m_shared || m_iterations == 0)
+        return true;
+      return m_shared->m_work(*m_shared, m_iterID, m_iterations);
     }
 
     inline bool canSplit()
     {
-      return (m_iterations > static_cast<size_t>(m_ppt));
+      return m_iterations > grain();
     }
 
     // It is decided to split, this accomplishes that part.
+    // The work function stays in the shared state, split only takes a reference.
     inline Task split()
     {
       auto iters = m_iterations / 2;
       auto newStart = m_iterID + iters;
-      Task splittedWork(m_id, newStart, iters + m_iterations % 2, m_sharedWorkCounter);
-      splittedWork.f_work = f_work;
+      Task splittedWork(m_id, newStart, iters + m_iterations % 2, m_shared);
+      splittedWork.m_ppt = m_ppt;
       m_iterations = iters;
       return splittedWork;
     }
@@ -180,8 +473,8 @@ namespace higanbana
   class ThreadData
   {
   public:
-    ThreadData() :m_ID(0), m_task(Task()), m_localQueueSize(std::make_shared<std::atomic<int64_t>>(0)) { }
-    ThreadData(int id) :m_ID(id), m_task(Task()), m_localQueueSize(std::make_shared<std::atomic<int64_t>>(0)) {  }
+    ThreadData() :m_ID(0), m_task(Task()), m_localDeque(std::make_unique<WorkStealingDeque<uint32_t>>()) { }
+    ThreadData(int id) :m_ID(id), m_task(Task()), m_localDeque(std::make_unique<WorkStealingDeque<uint32_t>>()) {  }
 
     ThreadData(const ThreadData&) = delete;
     ThreadData(ThreadData&&) = default;
@@ -191,9 +484,12 @@ namespace higanbana
 
     //void setGlobalID() { G_ID = m_ID;}
     int m_ID = 0;
+    int m_cpu = -1; // logical cpu the thread is pinned to, -1 if not pinned
+    // other threads in the order they are stolen from, nearby cores first.
+    std::vector<int> m_stealOrder;
     Task m_task;
-    std::shared_ptr<std::atomic<int64_t>> m_localQueueSize;
-    std::deque< Task > m_localDeque;
+    // owner pushes and pops from bottom, others steal from top. Holds indexes to LBS task pool.
+    std::unique_ptr<WorkStealingDeque<uint32_t>> m_localDeque;
   };
 
   namespace desc
@@ -208,6 +504,14 @@ namespace higanbana
     };
   }
 
+  // Pinning is opt in, every instance pins to the same cpus so pools sharing the machine would stack on them.
+  enum class ThreadPlacement
+  {
+    Automatic, // pin when there are enough cpus for every thread
+    Pinned,
+    Free
+  };
+
   class LBS
   {
   public:
@@ -219,23 +523,49 @@ namespace higanbana
     };
   private:
     // for threads to sleep on same condition variable
+    // m_workEpoch is bumped on every queued task, sleepers wait for it to change.
     std::condition_variable m_cv;
     std::mutex              m_sleeping;
+    std::atomic<uint64_t>   m_workEpoch;
 
-    // condition variables per thread
-    std::vector< std::shared_ptr < std::condition_variable > > m_cvs;
+    // Task storage, declared before everything that holds Tasks so that it dies last.
+    // Queues only pass m_taskPool indexes around.
+    ConcurrentPool< TaskShared >                 m_sharedPool;
+    ConcurrentPool< Task >                       m_taskPool;
 
     // Thread related data
     std::vector< ThreadData >                    m_allThreads;
     std::vector< std::thread >                   m_threads;
-    std::vector< std::shared_ptr< std::mutex > > m_mutexes;
+
+    // Tasks queued from threads outside this LBS, workers push into their own deque instead.
+    // Ring buffer that only grows, so steady state doesn't allocate.
+    std::mutex                                   m_injectMutex;
+    std::vector< uint32_t >                      m_injected;
+    size_t                                       m_injectedHead = 0;
+    std::atomic< int64_t >                       m_injectedSize;
 
     // Requirements data
-    std::mutex                                            m_wfrMutex;                // only one mutex :D to rule them all
-    std::unordered_map< std::string, bool >               m_fullfilled;              // fulfilled Tasks
-    std::unordered_map< size_t, TaskInfo >                m_taskInfos;               // take infos from here when task finished
-    std::vector< std::pair< Requirements, std::string > > m_waitingPostRequirements; // When requirement is filled -> move string to m_fulfilled
-    std::vector< std::pair< Requirements, Task > >         m_waitingPreRequirements;  // Put task in here if preR isn't fulfilled
+    // Waiter is either a task waiting for its pre requirements or a finished task waiting for its post requirements.
+    // Every unfulfilled requirement lists its waiters, so fulfilling one only touches its dependents.
+    struct Waiter
+    {
+      size_t        unfulfilled = 0;
+      bool          isPost = false; // post waiters fulfill nameId when done, pre waiters get scheduled
+      RequirementId nameId = 0;
+      Task          task;
+    };
+    struct RequirementState
+    {
+      bool                fulfilled = false;
+      std::vector<size_t> waiters;
+    };
+    RequirementTable                   m_requirements;            // names to ids, has its own lock
+    std::mutex                         m_wfrMutex;                // only guards solver state below, queueing doesn't touch it.
+    std::vector< RequirementState >    m_states;                  // indexed by RequirementId
+    std::vector< Waiter >              m_waiters;
+    std::vector< size_t >              m_freeWaiters;
+    std::vector< size_t >              m_wakeScratch;             // reused so that waking doesn't allocate
+    std::vector< RequirementId >       m_fulfillScratch;
     //END
 
     // global condition for making threads quit.
@@ -259,59 +589,35 @@ namespace higanbana
     };
     waiting2 m_waiting;
     std::atomic<bool> m_mainthreadsleeping;
+
+    // which LBS and worker the current thread belongs to, used to pick the deque to push into.
+    static inline thread_local LBS* t_owner = nullptr;
+    static inline thread_local int t_workerIndex = -1;
   public:
+    static constexpr std::chrono::nanoseconds DefaultChunkTime = std::chrono::microseconds(50);
 
     LBS()
-      : StopCondition(false)
-      , m_nextTaskID(1)
-      , idle_threads(0)
-      , m_mainthreadsleeping(false)
+      : LBS(static_cast<int>(std::thread::hardware_concurrency()))
     {
-      int procs = std::thread::hardware_concurrency();
-      // control the amount of threads made.
-      //procs = 1;
-      for (int i = 0; i < procs; i++)
-      {
-        m_allThreads.emplace_back(i);
-        ThreadStatus.push_back(std::make_pair(RUNNINGLOGIC, i));
-      }
-      for (int i = 0; i < static_cast<int>(m_allThreads.size()); i++)
-      {
-        std::shared_ptr<std::mutex> temp(new std::mutex());
-        m_mutexes.push_back(std::move(temp));
-        std::shared_ptr<std::condition_variable> temp2(new std::condition_variable());
-        m_cvs.push_back(std::move(temp2));
-      }
-      for (auto&& it : m_allThreads)
-      {
-        m_threads.push_back(std::thread(&LBS::loop, this, it.m_ID));
-      }
-#ifdef DEBUGTEXT
-      HIGAN_LOGi("LBS: Initializing with %d threads\n", procs);
-#endif
     }
-    LBS(int threadCount)
-      : StopCondition(false)
+    LBS(int threadCount, ThreadPlacement placement = ThreadPlacement::Free)
+      : m_workEpoch(0)
+      , m_injected(1024)
+      , m_injectedSize(0)
+      , StopCondition(false)
       , m_nextTaskID(1)
       , idle_threads(0)
       , m_mainthreadsleeping(false)
     {
-      int procs = threadCount;
+      int procs = std::max(threadCount, 1);
       // control the amount of threads made.
       //procs = 1;
       for (int i = 0; i < procs; ++i)
       {
-        //ThreadData wtf(i);
         m_allThreads.emplace_back(i);
         ThreadStatus.push_back(std::make_pair(RUNNINGLOGIC, i));
       }
-      for (size_t i = 0; i < static_cast<size_t>(procs); ++i)
-      {
-        std::shared_ptr<std::mutex> temp(new std::mutex());
-        m_mutexes.push_back(std::move(temp));
-        std::shared_ptr<std::condition_variable> temp2(new std::condition_variable());
-        m_cvs.push_back(std::move(temp2));
-      }
+      placeThreads(placement);
       for (auto& it : m_allThreads)
       {
         m_threads.push_back(std::thread(&LBS::loop, this, it.m_ID));
@@ -323,16 +629,16 @@ namespace higanbana
 
     ~LBS() // you do not simply delete this
     {
-      StopCondition.store(true);
-      for (size_t i = 0; i < m_threads.size(); i++)
       {
-          addTask(static_cast<int>(i%m_threads.size()), "EndThread", [](size_t) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); return; }); // mm
+        std::lock_guard<std::mutex> guard(m_sleeping);
+        StopCondition.store(true);
       }
+      m_cv.notify_all();
       for (auto& it : m_threads)
       {
-        while (!it.joinable()) { notifyAll(); }
         it.join();
       }
+      // whatever was left unfinished dies with the pools
     }
 
     size_t threadCount() const
@@ -348,7 +654,7 @@ namespace higanbana
 #endif
       //notifyAll();
       std::unique_lock<std::mutex> lkk(*m_waiting.m);
-      internalAddTask<1>(0, "WakePrincess", req, {}, 0, 1, [&](size_t)
+      internalAddTask<1>("WakePrincess", req, {}, 0, 1, [this](size_t)
       {
         std::lock_guard<std::mutex> np(*m_waiting.m);
 #ifdef DEBUGTEXT
@@ -377,240 +683,338 @@ namespace higanbana
     template<typename Func>
     void addTask(std::string name, Func&& func)
     {
-      internalAddTaskWithoutRequirements<1>(0, name, 0, 1, std::forward<Func>(func));
+      internalAddTaskWithoutRequirements<1>(name, 0, 1, std::forward<Func>(func));
     }
 
     template<typename Func>
     void addTask(std::string name, Requirements pre, Requirements post, Func&& func)
     {
-      internalAddTask<1>(0, name, pre, post, 0, 1, std::forward<Func>(func));
+      internalAddTask<1>(name, pre, post, 0, 1, std::forward<Func>(func));
     }
 
     template <typename Func>
     void addTask(const desc::Task& desc, Func&& func)
     {
-      internalAddTask<1>(0, desc.name, desc.pre, desc.post, 0, 1, std::forward<Func>(func));
+      internalAddTask<1>(desc.name, desc.pre, desc.post, 0, 1, std::forward<Func>(func));
     }
 
     template <size_t size, typename Func>
     void addParallelFor(const desc::Task& desc, size_t start_iter, size_t iterations, Func&& func)
     {
-      internalAddTask<size>(0, desc.name, desc.pre, desc.post, start_iter, iterations, std::forward<Func>(func));
+      internalAddTask<size>(desc.name, desc.pre, desc.post, start_iter, iterations, std::forward<Func>(func));
     }
     template <size_t size, typename Func>
     void addParallelFor(std::string name, Requirements pre, Requirements post, size_t start_iter, size_t iterations, Func&& func)
     {
-      internalAddTask<size>(0, name, pre, post, start_iter, iterations, std::forward<Func>(func));
+      internalAddTask<size>(name, pre, post, start_iter, iterations, std::forward<Func>(func));
+    }
+
+    // Like addParallelFor but chunk size is measured at runtime from the first iterations,
+    // cheap loops get big chunks and expensive loops small ones. Aims for chunks taking targetTime.
+    template <typename Func>
+    void addParallelForAuto(const desc::Task& desc, size_t start_iter, size_t iterations, Func&& func, std::chrono::nanoseconds targetTime = DefaultChunkTime)
+    {
+      addParallelForAuto(desc.name, desc.pre, desc.post, start_iter, iterations, std::forward<Func>(func), targetTime);
+    }
+    template <typename Func>
+    void addParallelForAuto(const std::string& name, const Requirements& pre, const Requirements& post, size_t start_iter, size_t iterations, Func&& func, std::chrono::nanoseconds targetTime = DefaultChunkTime)
+    {
+      Task newTask = describeTask(name, post, start_iter, iterations);
+      newTask.genAdaptiveWorkFunc(std::forward<Func>(func), static_cast<uint64_t>(targetTime.count()));
+      submitTask(std::move(newTask), pre);
     }
   private:
 
     // Informs all the threads about new work.
+    // Sleepers register in idle_threads before checking the epoch, so either they see the bump or we see them.
     inline void notifyAll()
     {
-      for (auto& it : m_cvs)
+      m_workEpoch.fetch_add(1);
+      if (idle_threads.load() > 0)
       {
-        it->notify_one();
+        {
+          std::lock_guard<std::mutex> guard(m_sleeping);
+        }
+        m_cv.notify_all();
       }
     }
 
-    template<typename Func>
-    inline void addTask(int ThreadID, std::string name, Func&& func)
+    // Workers push to their own deque without locks, everyone else goes through the injection queue.
+    inline void schedule(Task&& task)
+    {
+      uint32_t index = m_taskPool.acquire();
+      m_taskPool[index] = std::move(task);
+      if (t_owner == this)
+      {
+        m_allThreads[t_workerIndex].m_localDeque->push(index);
+      }
+      else
+      {
+        std::lock_guard<std::mutex> guard(m_injectMutex);
+        size_t count = static_cast<size_t>(m_injectedSize.load(std::memory_order_relaxed));
+        if (count == m_injected.size())
+        {
+          // full, unroll to a bigger buffer
+          std::vector<uint32_t> bigger(m_injected.size() * 2);
+          for (size_t i = 0; i < count; ++i)
+            bigger[i] = m_injected[(m_injectedHead + i) % m_injected.size()];
+          m_injected = std::move(bigger);
+          m_injectedHead = 0;
+        }
+        m_injected[(m_injectedHead + count) % m_injected.size()] = index;
+        m_injectedSize.store(static_cast<int64_t>(count + 1), std::memory_order_relaxed);
+      }
+      notifyAll();
+    }
+
+    // Moves task out of the pool slot and frees the slot.
+    inline void takeTask(uint32_t index, Task& out)
     {
-      internalAddTaskWithoutRequirements<1>(ThreadID, name, 0, 1, std::forward<Func>(func));
+      out = std::move(m_taskPool[index]);
+      m_taskPool.release(index);
+    }
+
+    inline bool takeInjected(uint32_t& index)
+    {
+      if (m_injectedSize.load(std::memory_order_relaxed) == 0)
+        return false;
+      std::lock_guard<std::mutex> guard(m_injectMutex);
+      auto count = m_injectedSize.load(std::memory_order_relaxed);
+      if (count == 0)
+        return false;
+      index = m_injected[m_injectedHead];
+      m_injectedHead = (m_injectedHead + 1) % m_injected.size();
+      m_injectedSize.store(count - 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Creates a task with fresh shared state from the pool.
+    inline Task createTask(size_t id, size_t start, size_t iterations, RequirementId nameId)
+    {
+      uint32_t index = m_sharedPool.acquire();
+      TaskShared& shared = m_sharedPool[index];
+      shared.m_poolIndex = index;
+      shared.m_pool = &m_sharedPool;
+      shared.m_workCounter.store(iterations);
+      shared.m_info.m_nameId = nameId;
+      return Task(id, start, iterations, &shared);
+    }
+
+    inline bool stealFromOthers(ThreadData& p, uint32_t& task)
+    {
+      for (int other : p.m_stealOrder)
+      {
+        if (m_allThreads[other].m_localDeque->steal(task))
+          return true;
+      }
+      return false;
+    }
+
+    static const SystemCpuInfo& topology()
+    {
+      static SystemCpuInfo info;
+      return info;
+    }
+
+    // Picks a cpu for each thread and the order they steal from each other.
+    // Steal order is SMT sibling, same L3, same numa node, rest. Ties start from the next thread
+    // so that everyone doesn't hammer thread 0. Without pinning distances mean nothing and it's plain round robin.
+    void placeThreads(ThreadPlacement placement)
+    {
+      const int count = static_cast<int>(m_allThreads.size());
+      auto& info = topology();
+      bool pin = placement == ThreadPlacement::Pinned
+        || (placement == ThreadPlacement::Automatic && !info.logical.empty() && static_cast<size_t>(count) <= info.logical.size());
+      std::vector<LogicalCpu> cpus = pin ? info.placement(count) : std::vector<LogicalCpu>();
+      for (int i = 0; i < count; ++i)
+      {
+        auto& p = m_allThreads[i];
+        p.m_cpu = cpus.empty() ? -1 : cpus[i].cpu;
+        p.m_stealOrder.clear();
+        for (int k = 1; k < count; ++k)
+          p.m_stealOrder.push_back((i + k) % count);
+        if (!cpus.empty())
+        {
+          std::stable_sort(p.m_stealOrder.begin(), p.m_stealOrder.end(), [&](int a, int b)
+          {
+            return SystemCpuInfo::distance(cpus[i], cpus[a]) < SystemCpuInfo::distance(cpus[i], cpus[b]);
+          });
+        }
+      }
     }
 
     template<size_t ppt, typename Func>
-    inline void internalAddTaskWithoutRequirements(int ThreadID, std::string name, size_t start_iter, size_t iterations, Func&& func)
+    inline void internalAddTaskWithoutRequirements(const std::string& name, size_t start_iter, size_t iterations, Func&& func)
     {
-      // need a temporary storage for tasks that haven't had requirements filled
       size_t newId = m_nextTaskID.fetch_add(1);
       assert(newId < m_nextTaskID);
 #ifdef DEBUGTEXT
       HIGAN_LOGi("T%d: internalAddTaskWithoutRequirements name \"%s\" id: %d\n", std::this_thread::get_id(), name.c_str(), newId);
 #endif
-      Task newTask(newId, start_iter, iterations);
-      // add to queue
+      Task newTask = createTask(newId, start_iter, iterations, m_requirements.intern(name));
       newTask.genWorkFunc<ppt>(std::forward<Func>(func));
-      {
-        ThreadData& worker = m_allThreads.at(ThreadID);
-
-        std::lock(m_wfrMutex, *m_mutexes[ThreadID]);
-        std::unique_lock<std::mutex> u1(m_wfrMutex, std::adopt_lock);
-        std::unique_lock<std::mutex> u2(*m_mutexes[ThreadID], std::adopt_lock);
-
-        worker.m_localDeque.push_front(std::move(newTask));
-        worker.m_localQueueSize->store(worker.m_localDeque.size(), std::memory_order_relaxed);
-        TaskInfo asd(name, {});
-        m_taskInfos.insert({ newId, std::move(asd) });
-        u1.unlock();
-        u2.unlock();
-      }
-      notifyAll();
+      schedule(std::move(newTask));
     }
 
     template<size_t ppt, typename Func>
-    inline void internalAddTask(int ThreadID, std::string name, Requirements pre, Requirements post, size_t start_iter, size_t iterations, Func&& func)
+    inline void internalAddTask(const std::string& name, const Requirements& pre, const Requirements& post, size_t start_iter, size_t iterations, Func&& func)
+    {
+      Task newTask = describeTask(name, post, start_iter, iterations);
+      newTask.genWorkFunc<ppt>(std::forward<Func>(func));
+      submitTask(std::move(newTask), pre);
+    }
+
+    inline Task describeTask(const std::string& name, const Requirements& post, size_t start_iter, size_t iterations)
     {
-      // need a temporary storage for tasks that haven't had requirements filled
       size_t newId = m_nextTaskID.fetch_add(1);
       assert(newId < m_nextTaskID);
 #ifdef DEBUGTEXT
       HIGAN_LOGi("T%d: internalAddTask name \"%s\" id: %d\n", std::this_thread::get_id(), name.c_str(), newId);
 #endif
-      Task newTask(newId, start_iter, iterations);
-      newTask.genWorkFunc<ppt>(std::forward<Func>(func));
-      {
-        std::lock(m_wfrMutex, *m_mutexes[ThreadID]);
-        std::unique_lock<std::mutex> u1(m_wfrMutex, std::adopt_lock);
-        std::unique_lock<std::mutex> u2(*m_mutexes[ThreadID], std::adopt_lock);
-        m_fullfilled[name] = false;
-        if (checkRequirements(pre))
-        {
-          //HIGAN_LOG("T%d: internalAddTask name %s, ready\n", std::this_thread::get_id(), name.c_str());
+      Task newTask = createTask(newId, start_iter, iterations, m_requirements.intern(name));
+      m_requirements.intern(post, newTask.m_shared->m_info.m_post);
+      return newTask;
+    }
 
-          TaskInfo asd(name, post);
-          m_taskInfos.insert({ newId, std::move(asd) });
-          ThreadData& worker = m_allThreads.at(ThreadID);
-          worker.m_localDeque.push_front(std::move(newTask));
-          worker.m_localQueueSize->store(worker.m_localDeque.size(), std::memory_order_relaxed);
-        }
-        else  // wtf add to WAITING FOR REQUIREMENTS
+    // queues the task or parks it until pre requirements are done.
+    inline void submitTask(Task&& newTask, const Requirements& pre)
+    {
+      // need a temporary storage for tasks that haven't had requirements filled
+      // scratch keeps its capacity, describing a task shouldn't allocate
+      static thread_local std::vector<RequirementId> preIds;
+      m_requirements.intern(pre, preIds);
+      {
+        std::lock_guard<std::mutex> guard(m_wfrMutex);
+        state(newTask.m_shared->m_info.m_nameId).fulfilled = false;
+        if (!allFulfilled(preIds))
         {
-          //HIGAN_LOG("T%d: internalAddTask name %s, waiting\n", std::this_thread::get_id(), name.c_str());
-          TaskInfo asd(name, post);
-          m_taskInfos.insert({ newId, std::move(asd) });
-          m_waitingPreRequirements.push_back({ std::move(pre), std::move(newTask) });
+          //HIGAN_LOG("T%d: internalAddTask waiting\n", std::this_thread::get_id());
+          Waiter waiter;
+          waiter.task = std::move(newTask);
+          addWaiter(preIds, std::move(waiter));
+          return;
         }
-        u1.unlock();
-        u2.unlock();
       }
-      notifyAll();
+      //HIGAN_LOG("T%d: internalAddTask ready\n", std::this_thread::get_id());
+      schedule(std::move(newTask));
     }
 
-    // generic checker, kind of done, NEEDS MUTEX GUARDED OUTSIDE
-    // internal "Requirements" could have array of integers than strings, faster and simpler.
-    // although doubtly any single task ever has that many requirements
-    bool checkRequirements(Requirements& data)
+    // NEEDS m_wfrMutex GUARDED OUTSIDE for all the solver functions.
+    inline RequirementState& state(RequirementId id)
     {
-      // check and remove
-      if (data.m_regs.size() == 0)
-      {
-        return true;
-      }
-      std::vector<std::string>::iterator newEnd;
+      if (id >= m_states.size())
+        m_states.resize(id + 1);
+      return m_states[id];
+    }
+
+    bool allFulfilled(const std::vector<RequirementId>& reqs)
+    {
+      for (auto id : reqs)
       {
-        newEnd = std::remove_if(data.m_regs.begin(), data.m_regs.end(), [&](const std::string& req)
-        {
-          auto it = m_fullfilled.find(req);
-          if (it != m_fullfilled.end())
-          {
-            if (it->second)
-            {
-              return true;
-            }
-          }
+        if (!state(id).fulfilled)
           return false;
-        });
       }
-      data.m_regs.erase(newEnd, data.m_regs.end());
-      return data.m_regs.size() == 0;
+      return true;
     }
 
-    // Checks and does all postTask related work.
-    // Includes adding new tasks that are waiting for the reported task.
-    void postTaskWork(size_t taskID)
+    // registers the waiter to every unfulfilled requirement, caller has checked that there is atleast one.
+    void addWaiter(const std::vector<RequirementId>& reqs, Waiter&& waiter)
     {
-#ifdef DEBUGTEXT
-      HIGAN_LOGi("T%d: postTaskWork id %llu\n", std::this_thread::get_id(), taskID);
-#endif
-      std::string taskname;
+      size_t slot = m_waiters.size();
+      if (!m_freeWaiters.empty())
       {
-        std::lock_guard<std::mutex> guard(m_wfrMutex);
-        auto it = m_taskInfos.find(taskID);
-        if (it == m_taskInfos.end()) return;
-
-        auto& data = it->second;
-        bool checkReq = false;
-        checkReq = checkRequirements(data.m_post);
-        if (checkReq)
-        {
-          // everything was finished!!!
-          taskname = data.m_name;
-          m_taskInfos.erase(it->first);
-        }
-        else
-        {
-          m_waitingPostRequirements.push_back({ std::move(data.m_post),std::move(data.m_name) });
-          m_taskInfos.erase(it->first);
-        }
+        slot = m_freeWaiters.back();
+        m_freeWaiters.pop_back();
       }
-      if (taskname.length() == 0)
+      else
       {
-        return;
+        m_waiters.emplace_back();
       }
-      informTaskFinished(taskname);
+      waiter.unfulfilled = 0;
+      for (auto id : reqs)
+      {
+        auto& st = state(id);
+        if (!st.fulfilled)
+        {
+          st.waiters.push_back(slot);
+          waiter.unfulfilled++;
+        }
+      }
+      m_waiters[slot] = std::move(waiter);
     }
 
-    // Does bunch of stuff. Basically looks if there are tasks, and adds them.
-    void informTaskFinished(std::string name)
+    // Marks requirement done and wakes exactly its dependents, finished post waiters cascade further.
+    // Woken tasks are scheduled right away, queueing never takes m_wfrMutex so this is safe.
+    void fulfill(RequirementId id)
     {
-#ifdef DEBUGTEXT
-      HIGAN_LOGi("T%d: informTaskFinished name %s\n", std::this_thread::get_id(), name.c_str());
-#endif
-      std::vector<Task> addable;
+      auto& finished = m_fulfillScratch;
+      finished.clear();
+      finished.push_back(id);
+      while (!finished.empty())
       {
-        std::lock_guard<std::mutex> guard(m_wfrMutex);
-        m_fullfilled[name] = true;
-        bool cont = true;
-        while (cont)
+        auto current = finished.back();
+        finished.pop_back();
+        auto& st = state(current);
+        st.fulfilled = true;
+        // copy instead of move so that both vectors keep their capacity
+        m_wakeScratch.assign(st.waiters.begin(), st.waiters.end());
+        st.waiters.clear();
+        for (auto slot : m_wakeScratch)
         {
-          cont = false;
-          for (auto it = m_waitingPostRequirements.begin(); it != m_waitingPostRequirements.end(); it++)
+          auto& waiter = m_waiters[slot];
+          if (--waiter.unfulfilled != 0)
+            continue;
+          if (waiter.isPost)
           {
-            if (checkRequirements(it->first))
-            {
-              m_fullfilled[it->second] = true;
-              cont = true;
-              m_waitingPostRequirements.erase(it);
-              break;
-            }
+            finished.push_back(waiter.nameId);
           }
-        }
-        bool cond = true;
-        while (cond)
-        {
-          cond = false;
-          for (auto it = m_waitingPreRequirements.begin(); it != m_waitingPreRequirements.end(); it++)
+          else
           {
-            if (checkRequirements(it->first))
-            {
-              addable.push_back(std::move(it->second));
-              m_waitingPreRequirements.erase(it);
-              cond = true;
-              break;
-            }
+            schedule(std::move(waiter.task));
           }
+          m_freeWaiters.push_back(slot);
         }
       }
+    }
+
+    // Checks and does all postTask related work.
+    // Includes adding new tasks that are waiting for the reported task.
+    void postTaskWork(Task& task)
+    {
 #ifdef DEBUGTEXT
-      HIGAN_LOGi("T%d: informTaskFinished name %s Exited reason success, added %llu tasks\n", std::this_thread::get_id(), name.c_str(), addable.size());
+      HIGAN_LOGi("T%d: postTaskWork id %llu\n", std::this_thread::get_id(), task.m_id);
 #endif
+      auto& data = task.m_shared->m_info;
       {
-        ThreadData& worker = m_allThreads.at(0);
-        std::lock_guard<std::mutex> guard(*m_mutexes.at(0));
-        for (auto& it : addable)
+        std::lock_guard<std::mutex> guard(m_wfrMutex);
+        if (allFulfilled(data.m_post))
+        {
+          // everything was finished!!!
+          fulfill(data.m_nameId);
+        }
+        else
         {
-          worker.m_localDeque.push_front(std::move(it));
-          worker.m_localQueueSize->store(worker.m_localDeque.size(), std::memory_order_relaxed);
-          notifyAll();
+          Waiter waiter;
+          waiter.isPost = true;
+          waiter.nameId = data.m_nameId;
+          addWaiter(data.m_post, std::move(waiter));
         }
       }
+#ifdef DEBUGTEXT
+      HIGAN_LOGi("T%d: postTaskWork name %s done\n", std::this_thread::get_id(), m_requirements.name(data.m_nameId));
+#endif
     }
 
     // Main Worker loop, Meat of LBS algorithm is in here.
     void loop(int i)
     {
+      t_owner = this;
+      t_workerIndex = i;
       ThreadData& p = m_allThreads.at(i);
+      if (p.m_cpu >= 0 && !thread::this_thread::pinToCpu(p.m_cpu))
+      {
+        HIGAN_LOGi("LBS: couldn't pin thread %d to cpu %d\n", i, p.m_cpu);
+      }
       //p.setGlobalID();
       stealOrWait(p);
       while (!StopCondition)
@@ -618,13 +1022,11 @@ namespace higanbana
         // can we split work?
         if (p.m_task.canSplit())
         {
-          if (p.m_localQueueSize->load() == 0)
+          if (p.m_localDeque->empty())
           { // Queue didn't have anything, adding.
-            {
-              std::lock_guard<std::mutex> guard(*m_mutexes.at(p.m_ID));
-              p.m_localDeque.push_back(p.m_task.split()); // push back
-              p.m_localQueueSize->store(p.m_localDeque.size(), std::memory_order_relaxed);
-            }
+            uint32_t index = m_taskPool.acquire();
+            m_taskPool[index] = p.m_task.split();
+            p.m_localDeque->push(index);
             notifyAll();
             continue;
           }
@@ -645,14 +1047,7 @@ namespace higanbana
       t_reSchedule = false;
       bool rdy = false;
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
-      auto it = m_taskInfos.find(p.m_task.m_id);
-      const char* name = "";
-      if (it != m_taskInfos.end())
-      {
-        name = it->second.m_name.c_str();
-        //PIXBeginEvent()
-
-      }
+      const char* name = p.m_task.m_shared ? m_requirements.name(p.m_task.m_shared->m_info.m_nameId) : "";
 #if defined(PROFILING)
       {
       HIGAN_CPU_BRACKET(name);
@@ -667,21 +1062,19 @@ namespace higanbana
 #endif
       ThreadStatus[p.m_ID].first = RUNNINGLOGIC;
       auto amountOfWork = p.m_task.m_iterID - currentIterID;
-      if (t_reSchedule)
-        p.m_task.m_sharedWorkCounter->operator++();
+      if (t_reSchedule && p.m_task.m_shared)
+        p.m_task.m_shared->m_workCounter++;
       didWorkFor(p.m_task, amountOfWork);
       if (rdy && t_reSchedule)
       {
         t_reSchedule = false;
-        auto nTask = Task(p.m_task.m_id, p.m_task.m_originalIterID, p.m_task.m_originalIterations);
-        nTask.f_work = p.m_task.f_work;
-        {
-          ThreadData& worker = m_allThreads.at(0);
-          std::lock_guard<std::mutex> guard(*m_mutexes.at(0));
-          worker.m_localDeque.push_front(std::move(nTask));
-          worker.m_localQueueSize->store(worker.m_localDeque.size(), std::memory_order_relaxed);
-        }
-        notifyAll();
+        auto& old = *p.m_task.m_shared;
+        auto nTask = createTask(p.m_task.m_id, p.m_task.m_originalIterID, p.m_task.m_originalIterations, old.m_info.m_nameId);
+        nTask.m_ppt = p.m_task.m_ppt;
+        nTask.m_shared->m_grain.store(old.m_grain.load());
+        nTask.m_shared->m_info.m_post = old.m_info.m_post;
+        nTask.m_shared->m_work.copyFrom(old.m_work);
+        schedule(std::move(nTask));
       }
       if (rdy)
       {
@@ -696,50 +1089,20 @@ namespace higanbana
 #ifdef DEBUGTEXT
       HIGAN_LOGi("T%d: stealOrWait\n", std::this_thread::get_id());
 #endif
-      size_t id = p.m_task.m_id;
-      while (id == p.m_task.m_id)
+      while (!StopCondition)
       {
-        // check my own deque
-        if (p.m_localQueueSize->load() != 0)
+        uint64_t epoch = m_workEpoch.load();
+        uint32_t task = 0;
+        // own deque first, then outside work, then others deques.
+        if (p.m_localDeque->pop(task) || takeInjected(task) || stealFromOthers(p, task))
         {
-          // try to take work from own deque, backside.
-          std::shared_ptr<std::mutex>& woot = m_mutexes.at(p.m_ID);
-          std::lock_guard<std::mutex> guard(*woot);
-          if (!p.m_localDeque.empty())
-          {
-            p.m_task = std::move(p.m_localDeque.back());
-            p.m_localDeque.pop_back();
-            p.m_localQueueSize->store(p.m_localDeque.size(), std::memory_order_relaxed);
-            return;
-          }
-        }
-        // check others deque
-        for (auto &it : m_allThreads)
-        {
-          if (it.m_ID == p.m_ID) // skip itself
-            continue;
-          if (it.m_localQueueSize->load() != 0) // this should reduce unnecessary lock_guards, and cheap.
-          {
-            std::lock_guard<std::mutex> guard(*m_mutexes.at(it.m_ID));
-            if (!it.m_localDeque.empty()) // double check as it might be empty now.
-            {
-              p.m_task = it.m_localDeque.front();
-              it.m_localDeque.pop_front();
-              it.m_localQueueSize->store(it.m_localDeque.size(), std::memory_order_relaxed);
-              return;
-            }
-          }
+          takeTask(task, p.m_task);
+          return;
         }
         // if all else fails, wait for more work.
         ThreadStatus[p.m_ID].first = WAITINGFORWORK;
-        if (!StopCondition) // this probably doesn't fix the random deadlock
         {
-          if (p.m_localQueueSize->load() != 0)
-          {
-            continue;
-          }
-
-          std::unique_lock<std::mutex> lk(*m_mutexes[p.m_ID]);
+          std::unique_lock<std::mutex> lk(m_sleeping);
 #ifdef DEBUGTEXT
           HIGAN_LOGi("T%d: Sleep, idle: %d\n", std::this_thread::get_id(), idle_threads.load());
 #endif
@@ -747,7 +1110,7 @@ namespace higanbana
           checkDeadlock(p.m_ID);
 #endif
           idle_threads++;
-          m_cvs[p.m_ID]->wait(lk);
+          m_cv.wait(lk, [&]() { return StopCondition.load() || m_workEpoch.load() != epoch; });
           idle_threads--;
 #ifdef DEBUGTEXT
           HIGAN_LOGi("T%d: Woke Up, idle: %d\n", std::this_thread::get_id(), idle_threads.load());
@@ -755,7 +1118,7 @@ namespace higanbana
         }
         ThreadStatus[p.m_ID].first = RUNNINGLOGIC;
       }
-  }
+    }
 
     // Reports the amount of task done and does post task work if was last.
     inline void didWorkFor(Task& task, size_t amount) // Task specific counter this time
@@ -769,11 +1132,11 @@ namespace higanbana
       HIGAN_LOGi("T%d: didWorkFor id,amount %llu,%llu\n", std::this_thread::get_id(), task.m_id, amount);
 #endif
       //HIGAN_LOG("T%d: didWorkFor id,amount %llu,%llu\n", std::this_thread::get_id(), id, amount);
-      if (task.m_sharedWorkCounter->fetch_sub(amount) - amount <= 0) // be careful with the fetch_sub command
+      if (task.m_shared->m_workCounter.fetch_sub(amount) - amount <= 0) // be careful with the fetch_sub command
       {
         // task got finished, responsibility to report this.
         // todo: write postrequirement code here.
-        postTaskWork(task.m_id);
+        postTaskWork(task);
       }
       }
 
@@ -787,7 +1150,7 @@ namespace higanbana
           std::cerr << "hurr ! \n";
           for (auto& it : m_allThreads)
           {
-            if (!it.m_localDeque.empty())
+            if (!it.m_localDeque->empty())
             {
               if (it.m_ID != myID)
               {
@@ -801,35 +1164,15 @@ namespace higanbana
             }
           }
           std::cerr << "LBS: suspecting deadlock...\n";
-          if (m_waitingPostRequirements.size() != 0)
+          std::lock_guard<std::mutex> guard(m_wfrMutex);
+          for (size_t id = 0; id < m_states.size(); ++id)
           {
-            std::cerr << "LBS: we have some tasks in m_waitingPostRequirements\n";
-            for (size_t i = 0; i < m_waitingPostRequirements.size(); ++i)
-            {
-              std::cerr << m_waitingPostRequirements[i].second << std::endl;
-            }
+            if (m_states[id].waiters.empty())
+              continue;
+            std::cerr << "LBS: " << m_states[id].waiters.size() << " waiting for: " << m_requirements.name(static_cast<RequirementId>(id)) << "\n";
           }
-          if (m_waitingPreRequirements.size() != 0)
-          {
-            std::cerr << "LBS: we have some tasks in m_waitingPostRequirements\n";
-            for (size_t i = 0; i < m_waitingPreRequirements.size(); ++i)
-            {
-              std::cerr << i << ". waiting for: ";
-              for (size_t k = 0; k < m_waitingPreRequirements[i].first.m_regs.size(); ++k)
-              {
-                std::cerr << m_waitingPreRequirements[i].first.m_regs[i] << " ";
-              }
-              std::cerr << "\n";
-            }
-          }
-          /*
-          std::cerr << "LBS: fulllfilled tasks:\n";
-          for (auto it = m_fullfilled.begin(); it != m_fullfilled.end(); ++it)
-          {
-            std::cerr << it->first << " " << (it->second ? "true" : "false") << std::endl;
-          }*/
           return;
         }
       }
     };
-};
+};
\ No newline at end of file
@@ -1,10 +1,11 @@
 #pragma once
-#include "higanbana/core/entity/bitfield.hpp"
 #include "higanbana/core/global_debug.hpp"
 
-#include <mutex>
+#include <atomic>
 #include <memory>
 #include <algorithm>
+#include <cstdint>
+#include <utility>
 
 namespace higanbana
 {
@@ -14,241 +15,390 @@ namespace higanbana
     int64_t size;
   };
 
-  // 1 block is 128size, so 32*128 * 64KB == 256MB of space available. wastes 128/8 == 16bytes. so 32 blocks are 512bytes.
-  template <int64_t internalPageCount>
-  class RangeBlockAllocatorInternal
+  // Contiguous block ranges out of a bitmap, set bit means that the block is free for taking.
+  // Searches go a 64bit word at a time, and every 64 words have a summary of the longest free run,
+  // free blocks at the start and at the end so that groups that can't fit the request are skipped whole.
+  // allocate and release are lock-free, words are claimed with CAS and summaries are republished after.
+  class RangeBlockAllocatorInternal2
   {
-    constexpr static int64_t s_pageBlockCount = internalPageCount;
-    constexpr static int64_t s_pageCount = 128 * s_pageBlockCount;
+    constexpr static int64_t WordBits = 64;
+    constexpr static int64_t GroupWords = 64;
+    constexpr static int64_t GroupBits = WordBits * GroupWords;
 
-    Bitfield<s_pageBlockCount> m_blocks; // 16*128 pages, enough? hopefully. atleast simple.
-    std::mutex   m_mutex; // access control
-                                           // should be procted by the mutex outside of this function
-    int m_blockSize = 0;
-    int64_t m_size = 0;
+    // 13 bits for each run length, top 25 bits for the epoch of the summary.
+    struct Summary
+    {
+      int64_t maxRun;
+      int64_t prefix; // free blocks at the low end
+      int64_t suffix; // free blocks at the high end
+    };
+    constexpr static int RunBits = 13;
+    constexpr static uint64_t RunMask = (1ull << RunBits) - 1;
+    constexpr static int EpochShift = RunBits * 3;
+    constexpr static uint64_t EpochMask = (1ull << (64 - EpochShift)) - 1;
 
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_groups;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_epochs;
+    int64_t m_wordCount = 0;
+    int64_t m_groupCount = 0;
+    int64_t m_size = 0;
+    std::atomic<int64_t> m_freespace = 0;
   public:
-
-    RangeBlockAllocatorInternal(int blockSize, size_t amountOfBlocks)
-      : m_blockSize(blockSize)
-      , m_size(blockSize * amountOfBlocks)
+    RangeBlockAllocatorInternal2()
     {}
+    RangeBlockAllocatorInternal2(size_t size)
+      : m_wordCount((static_cast<int64_t>(size) + WordBits - 1) / WordBits)
+      , m_groupCount((m_wordCount + GroupWords - 1) / GroupWords)
+      , m_size(static_cast<int64_t>(size))
+      , m_freespace(static_cast<int64_t>(size))
+    {
+      m_words = std::make_unique<std::atomic<uint64_t>[]>(m_wordCount);
+      m_groups = std::make_unique<std::atomic<uint64_t>[]>(m_groupCount);
+      m_epochs = std::make_unique<std::atomic<uint32_t>[]>(m_groupCount);
+      for (int64_t i = 0; i < m_wordCount; ++i)
+      {
+        auto bitsLeft = m_size - i * WordBits;
+        m_words[i] = bitsLeft >= WordBits ? ~0ull : (1ull << bitsLeft) - 1;
+      }
+      for (int64_t g = 0; g < m_groupCount; ++g)
+      {
+        m_epochs[g] = 0;
+        m_groups[g] = pack(computeGroup(g), 0);
+      }
+    }
+    RangeBlockAllocatorInternal2(RangeBlockAllocatorInternal2&& other) noexcept
+    {
+      *this = std::move(other);
+    }
+    RangeBlockAllocatorInternal2& operator=(RangeBlockAllocatorInternal2&& other) noexcept
+    {
+      m_words = std::move(other.m_words);
+      m_groups = std::move(other.m_groups);
+      m_epochs = std::move(other.m_epochs);
+      m_wordCount = std::exchange(other.m_wordCount, 0);
+      m_groupCount = std::exchange(other.m_groupCount, 0);
+      m_size = std::exchange(other.m_size, 0);
+      m_freespace = other.m_freespace.exchange(0);
+      return *this;
+    }
 
-    FixedRangeBlock allocate(size_t amount)
+    FixedRangeBlock allocate(size_t blocks)
     {
-      if (static_cast<size_t>(m_size) < amount)
+      int64_t inputBlocks = static_cast<int64_t>(blocks);
+      if (inputBlocks <= 0 || m_size < inputBlocks)
       {
         return FixedRangeBlock{ -1, -1 };
       }
-      std::lock_guard<std::mutex> guard(m_mutex);
-      auto blocks = amountInBlocks(amount);
-      auto startIndex = checkIfFreeContiguousMemory(blocks);
-      if (startIndex != -1 && startIndex + blocks < amountInBlocks(m_size))
+      // another thread can take the range between search and claim, then just search again.
+      while (m_freespace.load(std::memory_order_relaxed) >= inputBlocks)
       {
-        markUsedPages(startIndex, blocks);
-        return FixedRangeBlock{ startIndex * m_blockSize, blocks * m_blockSize };
+        auto startIndex = checkIfFreeContiguousMemory(inputBlocks);
+        if (startIndex == -1)
+          break;
+        if (markUsedPages(startIndex, inputBlocks))
+        {
+          m_freespace -= inputBlocks;
+          return FixedRangeBlock{ startIndex , inputBlocks };
+        }
       }
       return FixedRangeBlock{ -1, -1 };
     }
 
     void release(FixedRangeBlock range)
     {
-      auto startBlock = amountInBlocks(range.offset);
-      auto size = amountInBlocks(range.size);
-      freeBlocks(startBlock, size);
+      HIGAN_ASSERT(range.offset >= 0 && range.offset + range.size <= m_size, "not enough pages available");
+      forEachWord(range.offset, range.size, [this](int64_t word, uint64_t mask)
+      {
+        auto old = m_words[word].fetch_or(mask);
+        HIGAN_ASSERT((old & mask) == 0, "Releasing blocks that were already free.");
+        (void)old;
+        return true;
+      });
+      publishGroups(range.offset, range.size);
+      m_freespace += range.size;
     }
 
-  private:
+    size_t size() const noexcept
+    {
+      return max_size() - freespace();
+    }
 
-    int64_t amountInBlocks(size_t amount)
+    size_t max_size() const noexcept
     {
-      auto blocks = amount / m_blockSize;
-      blocks += ((amount % m_blockSize != 0) ? 1 : 0);
-      return blocks;
+      return m_size;
     }
 
-    void freeBlocks(int64_t startBlock, int64_t blockCount)
+    size_t freespace() const noexcept
     {
-      HIGAN_ASSERT(startBlock + blockCount <= s_pageCount, "not enough implementation pages available");
+      return static_cast<size_t>(m_freespace.load());
+    }
 
-      for (int64_t i = startBlock; i < startBlock + blockCount; ++i)
+    size_t largestFreeBlockSize()
+    {
+      int64_t largestSize = 0;
+      int64_t run = 0; // free run continuing from previous groups
+      for (int64_t g = 0; g < m_groupCount; ++g)
       {
-        m_blocks.clearIdxBit(i);
+        auto summary = unpack(m_groups[g].load());
+        largestSize = std::max({largestSize, run + summary.prefix, summary.maxRun});
+        run = summary.prefix == GroupBits ? run + GroupBits : summary.suffix;
       }
+      return std::max(largestSize, run);
     }
 
-    int64_t checkIfFreeContiguousMemory(uint64_t blockCount)
+    size_t countContinuosFreeBlocks()
     {
-      HIGAN_ASSERT(blockCount <= s_pageCount, "Too many pages... %u > %u", blockCount, s_pageCount);
-
-      // just do the idiot way and forloop the whole bitfield
-      // TODO: profile if horribly slow. and wave hands harder
-      size_t continuosPages = 0;
-      for (size_t i = 0; i < s_pageCount; ++i)
+      int64_t blocks = 0;
+      uint64_t carry = 0; // was the last block of previous word free
+      for (int64_t i = 0; i < m_wordCount; ++i)
       {
-        if (m_blocks.checkIdxBit(i))
-        {
-          continuosPages = 0;
-        }
-        else
-        {
-          ++continuosPages;
-        }
-        if (continuosPages == blockCount)
-        {
-          return i - continuosPages + 1; // this might have one off
-        }
+        uint64_t word = m_words[i].load(std::memory_order_relaxed);
+        uint64_t starts = word & ~((word << 1) | carry);
+        blocks += popcount(starts);
+        carry = word >> (WordBits - 1);
       }
-      return -1; // Invalid!
+      return blocks;
     }
 
-    // should be procted by the mutex outside of this function
-    void markUsedPages(int64_t startIndex, int64_t size)
+  private:
+    static int64_t popcount(uint64_t value) noexcept
     {
-      HIGAN_ASSERT(startIndex + size <= s_pageCount, "not enough pages available");
-      for (int64_t i = startIndex; i < startIndex + size; ++i)
-      {
-        m_blocks.setIdxBit(i);
-      }
+#ifdef HIGANBANA_PLATFORM_WINDOWS
+      return static_cast<int64_t>(__popcnt64(value));
+#else
+      return __builtin_popcountll(value);
+#endif
     }
-  };
 
-  //using RangeBlockAllocator = RangeBlockAllocatorInternal<32>;
+    // free bits from bit 0 upwards
+    static int64_t lowRun(uint64_t word) noexcept
+    {
+      if (word == ~0ull)
+        return WordBits;
+#ifdef HIGANBANA_PLATFORM_WINDOWS
+      unsigned long index;
+      _BitScanForward64(&index, ~word);
+      return index;
+#else
+      return __builtin_ctzll(~word);
+#endif
+    }
 
-  class RangeBlockAllocatorInternal2
-  {
-    DynamicBitfield m_blocks; // uses this invertly, setBit means that it's free for taking.
-    int64_t m_size = 0;
-    int64_t m_freespace = 0;
-  public:
-    RangeBlockAllocatorInternal2()
-    {}
-    RangeBlockAllocatorInternal2(size_t size)
-      : m_blocks(size)
-      , m_size(size)
-      , m_freespace(size)
+    // free bits from bit 63 downwards
+    static int64_t highRun(uint64_t word) noexcept
     {
-      m_blocks.initFull();
+      if (word == ~0ull)
+        return WordBits;
+#ifdef HIGANBANA_PLATFORM_WINDOWS
+      unsigned long index;
+      _BitScanReverse64(&index, ~word);
+      return WordBits - 1 - index;
+#else
+      return __builtin_clzll(~word);
+#endif
     }
 
-    FixedRangeBlock allocate(size_t blocks)
+    // mask of bit positions that start count free bits inside the word, log2(count) steps.
+    static uint64_t runStarts(uint64_t word, int64_t count) noexcept
     {
-      int64_t inputBlocks = static_cast<int64_t>(blocks);
-      if (m_size< inputBlocks)
-      {
-        return FixedRangeBlock{ -1, -1 };
-      }
-      auto startIndex = checkIfFreeContiguousMemory(inputBlocks);
-      if (startIndex != -1 && startIndex + static_cast<int64_t>(inputBlocks) <= m_size)
+      int64_t length = 1;
+      while (length < count && word != 0)
       {
-        m_freespace -= inputBlocks;
-        markUsedPages(startIndex, inputBlocks);
-        return FixedRangeBlock{ startIndex , inputBlocks };
+        auto shift = std::min(length, count - length);
+        word &= word >> shift;
+        length += shift;
       }
-      return FixedRangeBlock{ -1, -1 };
+      return word;
     }
 
-    void release(FixedRangeBlock range)
+    // doubles the run length while runs that long exist, then binary searches the rest.
+    static int64_t longestRun(uint64_t word) noexcept
     {
-      HIGAN_ASSERT(range.offset + range.size <= m_size, "not enough pages available");
-      for (int64_t i = range.offset; i < range.offset + range.size; ++i)
+      if (word == 0)
+        return 0;
+      int64_t length = 1;
+      while (length < WordBits)
       {
-        m_blocks.setBit(i);
+        uint64_t longer = word & (word >> length);
+        if (longer == 0)
+          break;
+        word = longer;
+        length *= 2;
       }
-      m_freespace += range.size;
+      for (int64_t step = length / 2; step > 0; step /= 2)
+      {
+        uint64_t longer = word & (word >> step);
+        if (longer != 0)
+        {
+          word = longer;
+          length += step;
+        }
+      }
+      return length;
     }
 
-    size_t size() const noexcept
+    static uint64_t pack(Summary summary, uint64_t epoch) noexcept
     {
-      return max_size() - freespace();
+      return static_cast<uint64_t>(summary.maxRun)
+        | (static_cast<uint64_t>(summary.prefix) << RunBits)
+        | (static_cast<uint64_t>(summary.suffix) << (RunBits * 2))
+        | ((epoch & EpochMask) << EpochShift);
     }
 
-    size_t max_size() const noexcept
+    static Summary unpack(uint64_t packed) noexcept
     {
-      return m_size;
+      return Summary{
+        static_cast<int64_t>(packed & RunMask),
+        static_cast<int64_t>((packed >> RunBits) & RunMask),
+        static_cast<int64_t>((packed >> (RunBits * 2)) & RunMask)};
     }
 
-    size_t freespace() const noexcept
+    Summary computeGroup(int64_t group) const noexcept
     {
-      return static_cast<size_t>(m_freespace);
+      Summary summary{0, 0, 0};
+      bool allFree = true;
+      int64_t run = 0;
+      auto first = group * GroupWords;
+      for (int64_t i = first; i < first + GroupWords; ++i)
+      {
+        uint64_t word = i < m_wordCount ? m_words[i].load() : 0;
+        auto low = lowRun(word);
+        if (allFree)
+          summary.prefix += low;
+        if (word == ~0ull)
+        {
+          run += WordBits;
+          continue;
+        }
+        allFree = false;
+        summary.maxRun = std::max(summary.maxRun, run + low);
+        if (popcount(word) > summary.maxRun)
+          summary.maxRun = std::max(summary.maxRun, longestRun(word));
+        run = highRun(word);
+      }
+      summary.maxRun = std::max(summary.maxRun, run);
+      summary.suffix = run;
+      return summary;
     }
 
-    size_t largestFreeBlockSize()
+    // Recomputes group summaries after words changed. The writer with the newest epoch read the words last,
+    // so its summary wins and older ones are dropped, once writers are done the summary is exact.
+    void publishGroups(int64_t offset, int64_t count)
     {
-      int64_t largestSize = 0;
-      int64_t continuosPages = 0;
-      for (int64_t i = 0; i < m_size; ++i)
+      auto lastGroup = (offset + count - 1) / GroupBits;
+      for (int64_t g = offset / GroupBits; g <= lastGroup; ++g)
       {
-        if (!m_blocks.checkBit(i))
+        uint64_t epoch = (m_epochs[g].fetch_add(1) + 1) & EpochMask;
+        uint64_t packed = pack(computeGroup(g), epoch);
+        uint64_t current = m_groups[g].load();
+        while (isNewer(epoch, current >> EpochShift))
         {
-          largestSize = std::max(largestSize, continuosPages);
-          continuosPages = 0;
-        }
-        else
-        {
-          ++continuosPages;
+          if (m_groups[g].compare_exchange_weak(current, packed))
+            break;
         }
       }
-      return largestSize;
     }
 
-    size_t countContinuosFreeBlocks()
+    static bool isNewer(uint64_t epoch, uint64_t stored) noexcept
     {
-      int64_t blocks = 0;
-      int64_t continuosPages = 0;
-      for (int64_t i = 0; i < m_size; ++i)
+      auto diff = (epoch - stored) & EpochMask;
+      return diff != 0 && diff < (EpochMask >> 1);
+    }
+
+    template <typename Func>
+    bool forEachWord(int64_t offset, int64_t count, Func&& func)
+    {
+      auto end = offset + count;
+      for (auto word = offset / WordBits; word * WordBits < end; ++word)
+      {
+        auto begin = std::max(offset, word * WordBits) - word * WordBits;
+        auto last = std::min(end, (word + 1) * WordBits) - word * WordBits;
+        uint64_t mask = (last - begin == WordBits) ? ~0ull : ((1ull << (last - begin)) - 1) << begin;
+        if (!func(word, mask))
+          return false;
+      }
+      return true;
+    }
+
+    int64_t findInGroup(int64_t group, int64_t blockCount) const noexcept
+    {
+      int64_t run = 0;
+      auto first = group * GroupWords;
+      auto last = std::min(first + GroupWords, m_wordCount);
+      for (int64_t i = first; i < last; ++i)
       {
-        if (!m_blocks.checkBit(i))
+        uint64_t word = m_words[i].load(std::memory_order_relaxed);
+        if (word == ~0ull)
         {
-          if (continuosPages > 0)
-            blocks++;
-          continuosPages = 0;
+          run += WordBits;
+          if (run >= blockCount)
+            return (i + 1) * WordBits - run;
+          continue;
         }
-        else
+        if (run + lowRun(word) >= blockCount)
+          return i * WordBits - run;
+        if (blockCount <= WordBits)
         {
-          ++continuosPages;
+          auto starts = runStarts(word, blockCount);
+          if (blockCount < WordBits && starts != 0)
+            return i * WordBits + lowRun(~starts);
         }
+        run = highRun(word);
       }
-      return blocks;
+      return -1;
     }
 
-  private:
     int64_t checkIfFreeContiguousMemory(int64_t blockCount)
     {
       HIGAN_ASSERT(blockCount <= m_size, "Too many pages... %u > %u", blockCount, m_size);
 
-      // just do the idiot way and forloop the whole bitfield
-      // TODO: profile if horribly slow. and wave hands harder
-      int64_t continuosPages = 0;
-      for (int64_t i = 0; i < m_size; ++i)
+      int64_t run = 0; // free run continuing from previous groups
+      for (int64_t g = 0; g < m_groupCount; ++g)
       {
-        if (!m_blocks.checkBit(i))
-        {
-          continuosPages = 0;
-        }
-        else
+        auto summary = unpack(m_groups[g].load(std::memory_order_relaxed));
+        if (run + summary.prefix >= blockCount)
+          return g * GroupBits - run;
+        if (summary.maxRun >= blockCount)
         {
-          ++continuosPages;
-        }
-        if (continuosPages == blockCount)
-        {
-          return i - continuosPages+1; // this might have one off
+          auto found = findInGroup(g, blockCount);
+          if (found != -1)
+            return found;
         }
+        run = summary.prefix == GroupBits ? run + GroupBits : summary.suffix;
       }
       return -1; // Invalid!
     }
 
-    // should be procted by the mutex outside of this function
-    void markUsedPages(int64_t startIndex, int64_t size)
+    // Claims the range word by word, if some other thread got there first the claimed words are given back.
+    bool markUsedPages(int64_t startIndex, int64_t size)
     {
       HIGAN_ASSERT(startIndex + size <= m_size, "not enough pages available");
-      for (int64_t i = startIndex; i < startIndex + size; ++i)
+      int64_t claimedUntil = startIndex;
+      bool claimed = forEachWord(startIndex, size, [&](int64_t word, uint64_t mask)
+      {
+        uint64_t current = m_words[word].load(std::memory_order_relaxed);
+        do
+        {
+          if ((current & mask) != mask)
+            return false;
+        } while (!m_words[word].compare_exchange_weak(current, current & ~mask));
+        claimedUntil = std::min((word + 1) * WordBits, startIndex + size);
+        return true;
+      });
+      if (!claimed && claimedUntil > startIndex)
       {
-        m_blocks.clearBit(i);
+        forEachWord(startIndex, claimedUntil - startIndex, [this](int64_t word, uint64_t mask)
+        {
+          m_words[word].fetch_or(mask);
+          return true;
+        });
       }
+      if (claimedUntil > startIndex)
+        publishGroups(startIndex, claimed ? size : claimedUntil - startIndex);
+      return claimed;
     }
   };
 
   using RangeBlockAllocator = RangeBlockAllocatorInternal2;
 }
-
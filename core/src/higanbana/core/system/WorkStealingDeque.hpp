@@ -0,0 +1,157 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
+
+namespace higanbana
+{
+  // Chase-Lev work stealing deque, memory orderings from
+  // "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+  // Only the owning thread may push/pop, any thread may steal.
+  // Storage grows on demand, retired buffers are kept alive until the deque dies
+  // because a thief might still be reading from them.
+  template <typename T>
+  class WorkStealingDeque
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque stores T in atomics, T needs to be trivially copyable.");
+
+    class Buffer
+    {
+    public:
+      Buffer(int64_t capacity)
+        : m_mask(capacity - 1)
+        , m_data(new std::atomic<T>[capacity])
+      {
+      }
+
+      int64_t capacity() const
+      {
+        return m_mask + 1;
+      }
+
+      void put(int64_t index, T value)
+      {
+        m_data[index & m_mask].store(value, std::memory_order_relaxed);
+      }
+
+      T get(int64_t index) const
+      {
+        return m_data[index & m_mask].load(std::memory_order_relaxed);
+      }
+
+      Buffer* grow(int64_t bottom, int64_t top) const
+      {
+        Buffer* bigger = new Buffer(capacity() * 2);
+        for (int64_t i = top; i != bottom; ++i)
+        {
+          bigger->put(i, get(i));
+        }
+        return bigger;
+      }
+
+    private:
+      int64_t m_mask;
+      std::unique_ptr<std::atomic<T>[]> m_data;
+    };
+
+    alignas(64) std::atomic<int64_t> m_top;
+    alignas(64) std::atomic<int64_t> m_bottom;
+    alignas(64) std::atomic<Buffer*> m_buffer;
+    std::vector<std::unique_ptr<Buffer>> m_retired;
+
+  public:
+    // capacity needs to be power of two
+    WorkStealingDeque(int64_t capacity = 1024)
+      : m_top(0)
+      , m_bottom(0)
+      , m_buffer(new Buffer(capacity))
+    {
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    ~WorkStealingDeque()
+    {
+      delete m_buffer.load(std::memory_order_relaxed);
+    }
+
+    // Approximate when called outside owner thread.
+    int64_t size() const
+    {
+      int64_t b = m_bottom.load(std::memory_order_relaxed);
+      int64_t t = m_top.load(std::memory_order_relaxed);
+      return b > t ? b - t : 0;
+    }
+
+    bool empty() const
+    {
+      return size() == 0;
+    }
+
+    // Owner only.
+    void push(T value)
+    {
+      int64_t b = m_bottom.load(std::memory_order_relaxed);
+      int64_t t = m_top.load(std::memory_order_acquire);
+      Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+      if (b - t > buf->capacity() - 1)
+      {
+        Buffer* bigger = buf->grow(b, t);
+        m_retired.emplace_back(buf);
+        m_buffer.store(bigger, std::memory_order_release);
+        buf = bigger;
+      }
+      buf->put(b, value);
+      std::atomic_thread_fence(std::memory_order_release);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Takes from the same end as push, returns false if empty.
+    bool pop(T& out)
+    {
+      int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+      Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+      m_bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = m_top.load(std::memory_order_relaxed);
+      if (t > b)
+      {
+        // was empty
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+      }
+      out = buf->get(b);
+      if (t == b)
+      {
+        // last element, race against thieves
+        bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+      }
+      return true;
+    }
+
+    // Any thread. Takes the oldest element, returns false if empty or lost a race.
+    bool steal(T& out)
+    {
+      int64_t t = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = m_bottom.load(std::memory_order_acquire);
+      if (t >= b)
+      {
+        return false;
+      }
+      Buffer* buf = m_buffer.load(std::memory_order_acquire);
+      T value = buf->get(t);
+      if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      {
+        return false;
+      }
+      out = value;
+      return true;
+    }
+  };
+}
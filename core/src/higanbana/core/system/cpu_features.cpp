@@ -0,0 +1,72 @@
+#include "higanbana/core/system/cpu_features.hpp"
+#include <cstdint>
+
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace higanbana
+{
+  namespace
+  {
+    void cpuid(int leaf, int subleaf, uint32_t regs[4])
+    {
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+      int r[4];
+      __cpuidex(r, leaf, subleaf);
+      for (int i = 0; i < 4; ++i)
+        regs[i] = static_cast<uint32_t>(r[i]);
+#else
+      __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    uint64_t xgetbv0()
+    {
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+      return _xgetbv(0);
+#else
+      uint32_t eax, edx;
+      __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+      return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+    CpuFeatures probe()
+    {
+      CpuFeatures f;
+      uint32_t regs[4];
+      cpuid(0, 0, regs);
+      const uint32_t maxLeaf = regs[0];
+      if (maxLeaf < 1)
+        return f;
+      cpuid(1, 0, regs);
+      f.sse42 = (regs[2] >> 20) & 1;
+      f.popcnt = (regs[2] >> 23) & 1;
+      const bool osxsave = (regs[2] >> 27) & 1;
+      const bool avx = (regs[2] >> 28) & 1;
+      // ymm state needs to be enabled by the os, zmm/opmask state too for avx512
+      const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+      const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+      const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+      if (maxLeaf < 7)
+        return f;
+      cpuid(7, 0, regs);
+      f.bmi2 = (regs[1] >> 8) & 1;
+      f.avx2 = avx && ymmEnabled && ((regs[1] >> 5) & 1);
+      f.avx512f = zmmEnabled && ((regs[1] >> 16) & 1);
+      f.avx512bw = f.avx512f && ((regs[1] >> 30) & 1);
+      f.avx512vl = f.avx512f && ((regs[1] >> 31) & 1);
+      f.avx512vpopcntdq = f.avx512f && ((regs[2] >> 14) & 1);
+      return f;
+    }
+  }
+
+  const CpuFeatures& cpuFeatures()
+  {
+    static const CpuFeatures features = probe();
+    return features;
+  }
+}
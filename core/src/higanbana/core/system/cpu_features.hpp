@@ -0,0 +1,30 @@
+#pragma once
+#include "higanbana/core/platform/definitions.hpp"
+
+// Lets single functions use instructions above the build baseline, call them only after checking cpuFeatures().
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  #define HIGAN_TARGET_AVX2
+  #define HIGAN_TARGET_AVX512
+#else
+  #define HIGAN_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+  #define HIGAN_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512vpopcntdq,avx2,bmi,bmi2,popcnt")))
+#endif
+
+namespace higanbana
+{
+  // Instruction sets the cpu has and the os has enabled register state for.
+  struct CpuFeatures
+  {
+    bool sse42 = false;
+    bool popcnt = false;
+    bool bmi2 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+    bool avx512vpopcntdq = false;
+  };
+
+  // Probed once on first call.
+  const CpuFeatures& cpuFeatures();
+}
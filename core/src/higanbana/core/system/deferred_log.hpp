@@ -0,0 +1,152 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+// Capture side of the deferred log. The HIGAN_LOG family copies the format pointer and the raw arguments into
+// a queue slot and the Logger's thread does the printf later. Formats and prefixes have to be string literals,
+// char* arguments are copied since nothing says they live long enough.
+namespace higanbana
+{
+  namespace log
+  {
+    enum class Level : uint32_t
+    {
+      Debug,
+      Info,
+      Warning,
+      Error,
+      Count
+    };
+
+    // effective mask, zero while no Logger is around to print
+    extern std::atomic<uint32_t> s_enabledLevels;
+
+    inline bool enabled(Level level)
+    {
+      return (s_enabledLevels.load(std::memory_order_relaxed) >> static_cast<uint32_t>(level)) & 1u;
+    }
+    void setLevelEnabled(Level level, bool enable);
+    // waits until everything logged before the call is printed, no-op without a Logger
+    void flush();
+    // messages lost to a full queue since start
+    uint64_t droppedCount();
+    // replaces stdout (and the debugger output on windows), called on the log thread with whole batches
+    void setOutput(std::function<void(std::string_view)> output);
+
+    using FormatFunction = int(*)(const char* format, const uint8_t* args, char* out, size_t outSize);
+
+    struct RecordHeader
+    {
+      Level level;
+      int line;
+      const char* file;
+      const char* prefix;
+      const char* format;
+      FormatFunction formatter;
+    };
+    static constexpr size_t RecordSize = 256;
+    static constexpr size_t ArgsCapacity = RecordSize - sizeof(RecordHeader) - sizeof(uint64_t);
+
+    namespace detail
+    {
+      template <typename T>
+      using Stored = std::decay_t<T>;
+      template <typename T>
+      constexpr bool isString = std::is_same_v<Stored<T>, const char*> || std::is_same_v<Stored<T>, char*>;
+      template <typename T>
+      constexpr size_t fixedSize = isString<T> ? sizeof(uint32_t) + 1 : sizeof(Stored<T>);
+
+      template <typename T>
+      void put(uint8_t*& ptr, size_t& stringBudget, const T& value)
+      {
+        if constexpr (isString<T>)
+        {
+          const char* str = value;
+          if (!str)
+            str = "(null)";
+          uint32_t length = static_cast<uint32_t>(std::min(strlen(str), stringBudget));
+          stringBudget -= length;
+          memcpy(ptr, &length, sizeof(length));
+          memcpy(ptr + sizeof(length), str, length);
+          ptr[sizeof(length) + length] = 0;
+          ptr += sizeof(length) + length + 1;
+        }
+        else
+        {
+          static_assert(std::is_arithmetic_v<Stored<T>> || std::is_enum_v<Stored<T>> || std::is_pointer_v<Stored<T>>,
+            "deferred log arguments are printf arguments, pass .c_str() for strings");
+          Stored<T> stored = value;
+          memcpy(ptr, &stored, sizeof(stored));
+          ptr += sizeof(stored);
+        }
+      }
+
+      template <typename T>
+      auto get(const uint8_t*& ptr)
+      {
+        if constexpr (isString<T>)
+        {
+          uint32_t length;
+          memcpy(&length, ptr, sizeof(length));
+          const char* str = reinterpret_cast<const char*>(ptr + sizeof(length));
+          ptr += sizeof(length) + length + 1;
+          return str;
+        }
+        else
+        {
+          Stored<T> value;
+          memcpy(&value, ptr, sizeof(value));
+          ptr += sizeof(value);
+          return value;
+        }
+      }
+
+      template <typename... Args>
+      int format(const char* format, const uint8_t* args, char* out, size_t outSize)
+      {
+        // braced init evaluates left to right, same order as written
+        std::tuple<decltype(get<Args>(args))...> values{get<Args>(args)...};
+        return std::apply([&](auto... values) {
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-security"
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+          return snprintf(out, outSize, format, values...);
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+        }, values);
+      }
+
+      // slot to fill, arguments go right after the header. nullptr when the queue is full
+      RecordHeader* beginRecord();
+      void commitRecord(RecordHeader* header);
+    }
+
+    template <typename... Args>
+    void write(Level level, const char* prefix, const char* file, int line, const char* format, const Args&... args)
+    {
+      constexpr size_t fixed = (size_t(0) + ... + detail::fixedSize<Args>);
+      static_assert(fixed <= ArgsCapacity, "too many log arguments for one record");
+      RecordHeader* header = detail::beginRecord();
+      if (!header)
+        return;
+      *header = {level, line, file, prefix, format, &detail::format<Args...>};
+      uint8_t* ptr = reinterpret_cast<uint8_t*>(header + 1);
+      size_t stringBudget = ArgsCapacity - fixed;
+      (detail::put(ptr, stringBudget, args), ...);
+      (void)ptr;
+      (void)stringBudget;
+      detail::commitRecord(header);
+    }
+  }
+}
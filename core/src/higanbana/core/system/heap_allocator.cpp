@@ -4,123 +4,124 @@
 namespace higanbana
 {
 HeapAllocator::HeapAllocator()
-: m_baseBlock({0,0}), mbs(1), sli(1), sli_count(1 << sli) {
+: m_baseBlock({0,0}), sli(1), sli_count(1 << sli), mbs(1) {
+  initialize();
 }
 HeapAllocator::HeapAllocator(RangeBlock initialBlock, size_t minimumBlockSize, int sli)
-: m_baseBlock(initialBlock), mbs(minimumBlockSize), sli(sli), sli_count(1 << sli), m_usedSize(0) {
+: m_baseBlock(initialBlock), sli(sli), sli_count(1 << sli), mbs(minimumBlockSize) {
+  HIGAN_ASSERT(sli > 0 && sli <= 6, "second level bitmaps are 64bits, sli was %d", sli);
   initialize();
-  int fl, sl;
-  mapping(m_baseBlock.size, fl, sl);
-  insert(initialBlock, fl, sl);
 }
 
 HeapAllocator::HeapAllocator(size_t size, size_t minimumBlockSize, int sli)
-: m_baseBlock({0, size}), mbs(minimumBlockSize), sli(sli), sli_count(1 << sli), m_usedSize(0) {
+: m_baseBlock({0, size}), sli(sli), sli_count(1 << sli), mbs(minimumBlockSize) {
+  HIGAN_ASSERT(sli > 0 && sli <= 6, "second level bitmaps are 64bits, sli was %d", sli);
   initialize();
+}
+
+uint32_t HeapAllocator::search_suitable_block(uint64_t size, uint64_t alignment) noexcept {
+  // good fit, the head of the first class above the rounded up size always fits.
   int fl, sl;
-  mapping(m_baseBlock.size, fl, sl);
-  insert(m_baseBlock, fl, sl);
+  mapping_search(size, fl, sl);
+  auto index = find_free_class(fl, sl);
+  if (index != InvalidNode && alignmentPadding(nodes[index].offset, alignment) + size <= nodes[index].size)
+    return index;
+  if (alignment > 1) {
+    mapping_search(size + alignment - 1, fl, sl);
+    index = find_free_class(fl, sl);
+    if (index != InvalidNode)
+      return index;
+  }
+  // Heap is nearly full, the only candidates left are in the classes the rounding skipped over.
+  // Everything above them is empty by now, so this walk is bounded by those few lists.
+  mapping(size, fl, sl);
+  for (; fl < levels(); ++fl, sl = 0) {
+    uint64_t slMap = slBitmaps[fl] & (~0ull << sl);
+    while (slMap != 0) {
+      auto cl = ffs(slMap);
+      remove_bit(slMap, cl);
+      for (auto it = freeHeads[fl * sli_count + cl]; it != InvalidNode; it = nodes[it].nextFree)
+        if (alignmentPadding(nodes[it].offset, alignment) + size <= nodes[it].size)
+          return it;
+    }
+  }
+  return InvalidNode;
 }
 
 std::optional<RangeBlock> HeapAllocator::allocate(size_t size, size_t alignment) noexcept {
-  auto origSize = size;
   size = std::max(size, size_t(mbs));
   alignment = roundUpMultiple(mbs, alignment);
-  //alignment = std::max(alignment, size_t(mbs));
-  int fl, sl, fl2, sl2;
-  mapping(size, fl, sl);
-  auto found_block = search_suitable_block(size, fl, sl);
-
-  if (found_block) {
-    auto overAlign = found_block.offset % alignment;
+  auto index = search_suitable_block(size, alignment);
+  if (index == InvalidNode)
+    return {};
+  remove(index);
 
-    if (overAlign > 0 && found_block.size < size + alignment) {
-      // we got a block that was too small, need to find a new one
-      insert(found_block, fl, sl);
-      size += alignment;
-      mapping(size, fl, sl);
-      found_block = search_suitable_block(size, fl, sl);
-      if (!found_block)
-        return {};
-      overAlign = found_block.offset % alignment;
-    }
-
-    if (overAlign != 0 && found_block.size >= size) {
-      // fix alignment
-      auto overAlignmentFix = alignment - overAlign;
-      auto smallFixBlock = RangeBlock{found_block.offset, overAlignmentFix};
-      found_block.offset += smallFixBlock.size;
-      found_block.size -= smallFixBlock.size;
-      HIGAN_ASSERT(found_block.offset % alignment == 0, "Alignment failure...");
-      // guaranteed that nothing will merge with this block.
-      mapping(smallFixBlock.size, fl2, sl2);
-      insert(smallFixBlock, fl2, sl2);
-    }
-    if (found_block.size > size) {
-      auto remaining_block = split(found_block, size);
-      mapping(remaining_block.size, fl2, sl2);
-      insert(remaining_block, fl2, sl2);
-    }
-    HIGAN_ASSERT(found_block.offset % alignment == 0, "Alignment failure...");
-    HIGAN_ASSERT(found_block.size >= origSize, "Allocation failure...");
-    m_usedSize += found_block.size;
-    return found_block;
+  auto padding = alignmentPadding(nodes[index].offset, alignment);
+  if (padding > 0) {
+    // previous physical block is in use, otherwise it would have been merged with this one.
+    split_front(index, padding);
+  }
+  if (nodes[index].size > size) {
+    split(index, size);
   }
-  return {};
+  auto& node = nodes[index];
+  HIGAN_ASSERT(node.offset % alignment == 0, "Alignment failure...");
+  HIGAN_ASSERT(node.size == size, "Allocation failure...");
+  m_usedSize += node.size;
+  return RangeBlock{node.offset, node.size, index};
 }
 
 size_t HeapAllocator::findLargestAllocation() const noexcept {
-  auto bestPossibility = fls(control.flBitmap);
+  auto bestPossibility = fls(flBitmap);
   if (bestPossibility < 0)
     return 0;
-  auto contr = control.sizeclasses[bestPossibility];
-  auto another = fls(contr.slBitmap);
-  return contr.freeBlocks[another].back().size;
+  auto another = fls(slBitmaps[bestPossibility]);
+  uint64_t largest = 0;
+  for (auto it = freeHeads[bestPossibility * sli_count + another]; it != InvalidNode; it = nodes[it].nextFree)
+    largest = std::max(largest, nodes[it].size);
+  return largest;
 }
 
 void HeapAllocator::resize(size_t newSize) noexcept {
   HIGAN_ASSERT(newSize > max_size(), "currently unable resize to smaller.");
-  auto offset = max_size();
-  auto sizeToAdd = newSize - offset;
-  free(RangeBlock{offset, sizeToAdd});
+  auto sizeToAdd = newSize - max_size();
+  auto offset = m_baseBlock.offset + max_size();
+  m_baseBlock.size = newSize;
+  growLevels(newSize);
+  if (m_lastNode != InvalidNode && nodes[m_lastNode].free) {
+    remove(m_lastNode);
+    nodes[m_lastNode].size += sizeToAdd;
+    insert(m_lastNode);
+    return;
+  }
+  auto last = m_lastNode;
+  auto index = createNode(offset, sizeToAdd, last, InvalidNode);
+  if (last != InvalidNode)
+    nodes[last].nextPhys = index;
+  m_lastNode = index;
+  insert(index);
 }
 
 void HeapAllocator::free(RangeBlock block) noexcept {
-  // immediately merge with existing free blocks.
-  //HIGAN_ASSERT(block.size != 0, "Invalid free.");
-
-  // check if this memory doesn't exist yet, error out if it does.
-#if 0
-  for (auto&& sizeClass : control.sizeclasses)
-  {
-    auto cb = block.offset, ce = block.offset+block.size;
-    for (auto&& freeBlocks : sizeClass.freeBlocks)
-    {
-      for (auto&& fb : freeBlocks)
-      {
-        auto b = fb.offset, e = fb.offset+fb.size;
-        HIGAN_ASSERT(cb != b, "No same beginnings");
-        if (cb > b)
-          HIGAN_ASSERT(cb >= e, "block must be to left");
-        if (ce > e)
-          HIGAN_ASSERT(ce >= b, "block must be to left");
-      }
-    }
-  }
-#endif
-
   if (block.size == 0)
     return;
+  auto index = block.node;
+  HIGAN_ASSERT(index < nodes.size() && !nodes[index].free && nodes[index].offset == block.offset && nodes[index].size == block.size,
+    "Invalid free, block {%zu, %zu} wasn't allocated from this heap.", size_t(block.offset), size_t(block.size));
   m_usedSize -= block.size;
-  int fl, sl;
-  auto size = block.size;
-  auto big_free_block = merge(block);
-  while (big_free_block.size != size)  // while loop here
-  {
-    size = big_free_block.size;
-    big_free_block = merge(big_free_block);
+
+  // immediately merge with free physical neighbours, there can be at most one on each side.
+  auto next = nodes[index].nextPhys;
+  if (next != InvalidNode && nodes[next].free) {
+    remove(next);
+    merge_next(index);
+  }
+  auto prev = nodes[index].prevPhys;
+  if (prev != InvalidNode && nodes[prev].free) {
+    remove(prev);
+    merge_next(prev);
+    index = prev;
   }
-  mapping(big_free_block.size, fl, sl);
-  insert(big_free_block, fl, sl);
+  insert(index);
+}
 }
-}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <optional>
 #include <algorithm>
+#include <cstdint>
 
 #include "higanbana/core/datastructures/vector.hpp"
 #include "higanbana/core/global_debug.hpp"
@@ -10,18 +11,25 @@ namespace higanbana
 struct RangeBlock {
   uint64_t offset;
   uint64_t size;
+  // HeapAllocator bookkeeping, index of the node that owns this range. Pass blocks back to free() unmodified.
+  uint32_t node = ~0u;
   operator bool() const { return size != 0; }
 };
+
+// TLSF over offset ranges, the memory itself is never touched so every block is a node in a side table.
+// Nodes link to their physical neighbours and to the other free blocks of their size class,
+// so allocate, free and coalescing are all O(1).
 class HeapAllocator {
-  struct TLSFSizeClass {
-    size_t sizeClass;
-    uint64_t slBitmap;
-    vector<vector<RangeBlock>> freeBlocks;
-  };
+  static constexpr uint32_t InvalidNode = ~0u;
 
-  struct TLSFControl {
-    uint64_t flBitmap;
-    vector<TLSFSizeClass> sizeclasses;
+  struct Node {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t prevPhys;  // neighbour at lower offset
+    uint32_t nextPhys;  // neighbour at higher offset
+    uint32_t prevFree;  // free list links, also used to chain unused nodes
+    uint32_t nextFree;
+    bool free;
   };
 
   RangeBlock m_baseBlock;
@@ -30,7 +38,12 @@ class HeapAllocator {
   unsigned sli_count;  // second level index, typically 5
   uint64_t mbs;        // minimum block size
   uint64_t min_fli;
-  TLSFControl control;
+  uint64_t flBitmap;
+  vector<uint64_t> slBitmaps;  // one per first level
+  vector<uint32_t> freeHeads;  // first free node of every fl/sl class
+  vector<Node> nodes;
+  uint32_t m_unusedNodes;      // chain of recycled nodes
+  uint32_t m_lastNode;         // node at the end of the range, used by resize
   size_t m_usedSize;
 
   inline int fls(uint64_t size) const noexcept {
@@ -55,163 +68,182 @@ class HeapAllocator {
 #endif
   }
 
-  inline void mapping(size_t size, int& fl, int& sl) noexcept {
-    fl = fls(size);
-    sl = ((size ^ (1ull << fl)) >> (fl - sli));
-    fl = first_level_index(fl);
-    // printf("%zu -> fl %u sl %u\n", size, fl, sl);
+  // First level 0 covers [0, 2^(min_fli+1)) linearly, every level after that is one power of two split in sli_count.
+  inline void mapping(uint64_t size, int& fl, int& sl) const noexcept {
+    int top = fls(size);
+    if (top <= static_cast<int>(min_fli)) {
+      int shift = static_cast<int>(min_fli) + 1 - static_cast<int>(sli);
+      fl = 0;
+      sl = static_cast<int>(shift >= 0 ? size >> shift : size << -shift);
+      return;
+    }
+    fl = top - static_cast<int>(min_fli);
+    int shift = top - static_cast<int>(sli);
+    sl = static_cast<int>((shift >= 0 ? size >> shift : size << -shift) ^ sli_count);
+  }
+
+  // Rounds size up to the next class boundary so that every block in the returned class is large enough.
+  inline void mapping_search(uint64_t size, int& fl, int& sl) const noexcept {
+    int top = fls(size);
+    int shift = top > static_cast<int>(min_fli) ? top - static_cast<int>(sli) : static_cast<int>(min_fli) + 1 - static_cast<int>(sli);
+    if (shift > 0)
+      size += (1ull << shift) - 1;
+    mapping(size, fl, sl);
   }
 
-  inline int first_level_index(int fli) noexcept {
-    if (fli < min_fli )
-      return 0;
-    return fli - min_fli;
+  inline int levels() const noexcept {
+    return static_cast<int>(slBitmaps.size());
   }
 
   inline void initialize() noexcept {
-    fli = fls(m_baseBlock.size);
-    mbs = std::min(m_baseBlock.size, mbs);
+    mbs = std::max<uint64_t>(std::min<uint64_t>(m_baseBlock.size, mbs), 1);
     min_fli = fls(mbs);
-    control.flBitmap = 0;
-    for (int i = min_fli; i <= fli; ++i) {
-      size_t sizeClass = 1 << i;
-      vector<vector<RangeBlock>> vectors;
-      for (int k = 0; k < sli_count; ++k) {
-        vectors.push_back(vector<RangeBlock>());
-      }
-      control.sizeclasses.push_back(TLSFSizeClass{sizeClass, 0, vectors});
+    flBitmap = 0;
+    m_unusedNodes = InvalidNode;
+    m_lastNode = InvalidNode;
+    m_usedSize = 0;
+    slBitmaps.clear();
+    freeHeads.clear();
+    nodes.clear();
+    growLevels(m_baseBlock.size);
+    if (m_baseBlock.size > 0) {
+      m_lastNode = createNode(m_baseBlock.offset, m_baseBlock.size, InvalidNode, InvalidNode);
+      insert(m_lastNode);
     }
   }
 
-  inline void remove_bit(uint64_t& value, int index) noexcept { value = value ^ (1 << index); }
-
-  inline void set_bit(uint64_t& value, int index) noexcept { value |= (1 << index); }
-
-  inline void insert(RangeBlock block, int fl, int sl) noexcept {
-    HIGAN_ASSERT(fl < control.sizeclasses.size() && fl >= 0, "fl should be valid, was fl:%d, sizeclasses %zu", fl, control.sizeclasses.size());
-    auto& sizeClass = control.sizeclasses[fl];
-    HIGAN_ASSERT(sl < sizeClass.freeBlocks.size() && sl >= 0, "sl should be valid, was fl:%d sl:%d freeBlocks %zu", fl, sl, sizeClass.freeBlocks.size());
-    auto& secondLv = sizeClass.freeBlocks[sl];
-    secondLv.push_back(block);
-    set_bit(sizeClass.slBitmap, sl);
-    set_bit(control.flBitmap, fl);
-  }
-
-  inline int findLargeEnoughBlockWithinFree(const vector<RangeBlock>& freeblocks, size_t size) {
-    for (int i = 0; i < freeblocks.size(); ++i)
-      if (freeblocks[i].size > size)
-        return i;
-    return 0;
-  }
-
-  inline RangeBlock search_suitable_block(size_t size, int fl, int sl) noexcept {
-    // first step, assume we got something at fl / sl location
-    if (control.sizeclasses.size() <= fl)
-      return {};
-    auto& secondLevel = control.sizeclasses[fl];
-    auto& freeblocks = secondLevel.freeBlocks[sl];
-    auto candidate = findLargeEnoughBlockWithinFree(freeblocks, size);
-    if (!freeblocks.empty() && freeblocks[candidate].size >= size) {
-      auto block = freeblocks[candidate];
-      freeblocks.erase(freeblocks.begin() + candidate);
-      // remove bitmap bit
-      if (freeblocks.empty()) remove_bit(secondLevel.slBitmap, sl);
-      if (secondLevel.slBitmap == 0) remove_bit(control.flBitmap, fl);
-      return block;
+  inline void growLevels(uint64_t size) noexcept {
+    fli = std::max(fls(size), 0);
+    int needed = std::max(static_cast<int>(fli) - static_cast<int>(min_fli), 0) + 1;
+    while (levels() < needed) {
+      slBitmaps.push_back(0);
+      for (unsigned k = 0; k < sli_count; ++k)
+        freeHeads.push_back(InvalidNode);
+    }
+  }
+
+  inline void remove_bit(uint64_t& value, int index) noexcept { value &= ~(1ull << index); }
+
+  inline void set_bit(uint64_t& value, int index) noexcept { value |= (1ull << index); }
+
+  inline uint32_t createNode(uint64_t offset, uint64_t size, uint32_t prevPhys, uint32_t nextPhys) noexcept {
+    uint32_t index = m_unusedNodes;
+    if (index != InvalidNode) {
+      m_unusedNodes = nodes[index].nextFree;
     }
     else {
-      sl = ffs(secondLevel.slBitmap);
-      candidate = 0;
-      if (sl >= 0)
-        candidate = findLargeEnoughBlockWithinFree(secondLevel.freeBlocks[sl], size);
-      if (sl >= 0 && secondLevel.freeBlocks[sl][candidate].size >= size) { // somethings still in this size class
-        auto& freeblocks2 = secondLevel.freeBlocks[sl];
-        auto block = freeblocks2[candidate];
-        freeblocks2.erase(freeblocks2.begin() + candidate);
-        // remove bitmap bit
-        if (freeblocks2.empty())
-          remove_bit(secondLevel.slBitmap, sl);
-        if (secondLevel.slBitmap == 0) remove_bit(control.flBitmap, fl);
-        return block;
-      }
-      else {
-        // second step, scan bitmaps for empty slots
-        // create mask to ignore first bits, could be wrong
-        auto mask = ~((1 << (fl+1)) - 1);
-        auto fl2 = ffs(control.flBitmap & mask);
-        if (fl2 >= 0) {
-          auto& secondLevel2 = control.sizeclasses[fl2];
-          HIGAN_ASSERT(secondLevel2.sizeClass >= size && secondLevel2.slBitmap != 0, "bitmap expected to have something");
-          auto sl2 = ffs(secondLevel2.slBitmap);
-          HIGAN_ASSERT(!secondLevel2.freeBlocks[sl2].empty(), "freeblocks expected to contain something");
-          candidate = (sl2 >= 0) ? findLargeEnoughBlockWithinFree(secondLevel2.freeBlocks[sl2], size) : 0;
-          if (sl2 >= 0 && secondLevel2.freeBlocks[sl2][candidate].size >= size) {
-            auto& freeblocks3 = secondLevel2.freeBlocks[sl2];
-            auto block = freeblocks3[candidate];
-            freeblocks3.erase(freeblocks3.begin() + candidate);
-            // remove bitmap bit
-            if (freeblocks3.empty())
-              remove_bit(secondLevel2.slBitmap, sl2);
-            if (secondLevel2.slBitmap == 0) remove_bit(control.flBitmap, fl2);
-            return block;
-          }
-        }
-      }
+      index = static_cast<uint32_t>(nodes.size());
+      nodes.push_back(Node{});
     }
+    nodes[index] = Node{offset, size, prevPhys, nextPhys, InvalidNode, InvalidNode, false};
+    return index;
+  }
+
+  inline void releaseNode(uint32_t index) noexcept {
+    nodes[index].size = 0;
+    nodes[index].free = false;
+    nodes[index].nextFree = m_unusedNodes;
+    m_unusedNodes = index;
+  }
+
+  inline void insert(uint32_t index) noexcept {
+    auto& node = nodes[index];
+    int fl, sl;
+    mapping(node.size, fl, sl);
+    HIGAN_ASSERT(fl < levels() && fl >= 0, "fl should be valid, was fl:%d, levels %d", fl, levels());
+    HIGAN_ASSERT(sl < static_cast<int>(sli_count) && sl >= 0, "sl should be valid, was fl:%d sl:%d", fl, sl);
+    auto& head = freeHeads[fl * sli_count + sl];
+    node.free = true;
+    node.prevFree = InvalidNode;
+    node.nextFree = head;
+    if (head != InvalidNode)
+      nodes[head].prevFree = index;
+    head = index;
+    set_bit(slBitmaps[fl], sl);
+    set_bit(flBitmap, fl);
+  }
 
-    return {};
-  }
-
-  inline RangeBlock split(RangeBlock& block, size_t size) noexcept {
-    auto new_size = block.size - size;
-    RangeBlock new_block = {block.offset + size, new_size};
-    block.size = size;
-    return new_block;
-  }
-
-  inline RangeBlock merge(RangeBlock block) noexcept {
-    auto otf = block.offset;
-    auto otf2 = block.offset + block.size;
-    // oh no, nail in the coffin. BRUTEFORCE, we got not boundary tagging
-    // possible sped up by using bitmaps to avoid checking empty vectors
-    auto fl = 0;
-
-    // scan through only the memory where blocks reside using bitfields
-    auto flBM = control.flBitmap;
-    while (flBM != 0) {
-      auto fl = ffs(flBM);
-      remove_bit(flBM, fl);
-
-      auto& secondLevel = control.sizeclasses[fl];
-      // use the bitmap to only check relevant vectors
-      auto slBM = secondLevel.slBitmap;
-      while (slBM != 0) {
-        auto sl = ffs(slBM);
-        remove_bit(slBM, sl);
-
-        auto& freeBlocks = secondLevel.freeBlocks[sl];
-
-        auto iter = std::find_if(
-            freeBlocks.begin(), freeBlocks.end(), [otf, otf2](RangeBlock b) {
-              return (b.offset + b.size == otf) || (b.offset == otf2);
-            });
-        if (iter != freeBlocks.end()) {
-          auto rb = *iter;
-          freeBlocks.erase(iter);
-          if (freeBlocks.empty()) remove_bit(secondLevel.slBitmap, sl);
-          if (secondLevel.slBitmap == 0) remove_bit(control.flBitmap, fl);
-
-          if (rb.offset + rb.size == otf) {
-            rb.size += block.size;
-            return rb;
-          } else if (rb.offset == otf2) {
-            block.size += rb.size;
-            return block;
-          }
-        }
+  inline void remove(uint32_t index) noexcept {
+    auto& node = nodes[index];
+    HIGAN_ASSERT(node.free, "only free nodes are in the free lists");
+    if (node.prevFree != InvalidNode)
+      nodes[node.prevFree].nextFree = node.nextFree;
+    if (node.nextFree != InvalidNode)
+      nodes[node.nextFree].prevFree = node.prevFree;
+    int fl, sl;
+    mapping(node.size, fl, sl);
+    auto& head = freeHeads[fl * sli_count + sl];
+    if (head == index) {
+      head = node.nextFree;
+      if (head == InvalidNode) {
+        remove_bit(slBitmaps[fl], sl);
+        if (slBitmaps[fl] == 0) remove_bit(flBitmap, fl);
       }
     }
-    return block;
+    node.free = false;
+  }
+
+  // First non empty class at or above fl/sl.
+  inline uint32_t find_free_class(int fl, int sl) const noexcept {
+    if (fl >= levels())
+      return InvalidNode;
+    uint64_t slMap = sl < 64 ? slBitmaps[fl] & (~0ull << sl) : 0;
+    if (slMap == 0) {
+      uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+      if (flMap == 0)
+        return InvalidNode;
+      fl = ffs(flMap);
+      slMap = slBitmaps[fl];
+    }
+    sl = ffs(slMap);
+    return freeHeads[fl * sli_count + sl];
+  }
+
+  inline static uint64_t alignmentPadding(uint64_t offset, uint64_t alignment) noexcept {
+    auto overAlign = offset % alignment;
+    return overAlign == 0 ? 0 : alignment - overAlign;
+  }
+
+  uint32_t search_suitable_block(uint64_t size, uint64_t alignment) noexcept;
+
+  // Cuts the tail of node off into a new free node.
+  inline void split(uint32_t index, uint64_t size) noexcept {
+    auto& node = nodes[index];
+    HIGAN_ASSERT(node.size > size, "nothing to split");
+    auto tail = createNode(nodes[index].offset + size, nodes[index].size - size, index, nodes[index].nextPhys);
+    auto& head = nodes[index];
+    head.size = size;
+    if (head.nextPhys != InvalidNode)
+      nodes[head.nextPhys].prevPhys = tail;
+    else
+      m_lastNode = tail;
+    head.nextPhys = tail;
+    insert(tail);
+  }
+
+  // Cuts the head of node off into a new free node, used for alignment padding.
+  inline void split_front(uint32_t index, uint64_t size) noexcept {
+    auto front = createNode(nodes[index].offset, size, nodes[index].prevPhys, index);
+    auto& node = nodes[index];
+    if (node.prevPhys != InvalidNode)
+      nodes[node.prevPhys].nextPhys = front;
+    node.prevPhys = front;
+    node.offset += size;
+    node.size -= size;
+    insert(front);
+  }
+
+  // Absorbs the physical neighbour after index, both already taken out of the free lists.
+  inline void merge_next(uint32_t index) noexcept {
+    auto next = nodes[index].nextPhys;
+    auto& node = nodes[index];
+    node.size += nodes[next].size;
+    node.nextPhys = nodes[next].nextPhys;
+    if (node.nextPhys != InvalidNode)
+      nodes[node.nextPhys].prevPhys = index;
+    else
+      m_lastNode = index;
+    releaseNode(next);
   }
 
  public:
@@ -233,4 +265,4 @@ class HeapAllocator {
     return m_usedSize;
   }
 };
-}
\ No newline at end of file
+}
@@ -1,56 +1,300 @@
 #include "higanbana/core/system/logger.hpp"
 
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
 using namespace higanbana;
 
-Logger::Logger() : m_readerIndex(0), m_writerIndex(1), unhandled_buffer_size(0)
+namespace higanbana
 {
-  buffer.forEach([](logdata& data) {
-    data.m_array.fill('\0');
-  });
-}
-Logger::~Logger()
+namespace log
 {
-  update();
-}
+std::atomic<uint32_t> s_enabledLevels = 0;
 
-void Logger::handleFazMesg(LogMessage &mesg)
+namespace
 {
-  std::lock_guard<std::mutex> lk(writeLock);
-  if (unhandled_buffer_size >= RINGBUFFERSIZE - 1)
-  {
-    // force flush
-    update();
-    return;
-  }
-  if (m_writerIndex >= RINGBUFFERSIZE)
-    m_writerIndex = 0;
-  int n = static_cast<int>(strlen(mesg.m_data));
-  size_t dataSize = static_cast<size_t>(std::min(n, MAXLOGLENGTH - 1));
-  memcpy(&buffer[m_writerIndex].m_array, mesg.m_data, dataSize);
-  buffer[m_writerIndex].m_array[dataSize] = 0;
-  buffer[m_writerIndex].m_size = dataSize;
-  unhandled_buffer_size++; m_writerIndex++;
-#ifdef HIGANBANA_PLATFORM_WINDOWS
-  //OutputDebugString(mesg.m_data);
-#endif
-  //std::cerr.write(mesg.m_data, dataSize);
-}
+constexpr uint32_t AllLevels = (1u << static_cast<uint32_t>(Level::Count)) - 1;
 
-void Logger::update()
+// Bounded MPSC queue of fixed size records, each slot's sequence says whose turn it is (Vyukov).
+// Producers only race on the head, a full queue drops the message instead of waiting.
+struct alignas(64) Slot
+{
+  std::atomic<uint64_t> sequence;
+  RecordHeader header;
+  uint8_t args[ArgsCapacity];
+};
+static_assert(sizeof(Slot) == RecordSize, "arguments have to follow the header directly");
+static_assert(offsetof(Slot, args) == offsetof(Slot, header) + sizeof(RecordHeader), "arguments have to follow the header directly");
+
+class LogQueue
 {
-  while (unhandled_buffer_size >= 0)
+public:
+  static constexpr uint64_t Capacity = 4096;
+
+  LogQueue()
+    : m_slots(new Slot[Capacity])
+  {
+    for (uint64_t i = 0; i < Capacity; ++i)
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  RecordHeader* begin()
+  {
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    while (true)
+    {
+      Slot& slot = m_slots[pos & (Capacity - 1)];
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(sequence - pos);
+      if (diff == 0)
+      {
+        if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          return &slot.header;
+      }
+      else if (diff < 0)
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      else
+        pos = m_head.load(std::memory_order_relaxed);
+    }
+  }
+
+  void commit(RecordHeader* header)
+  {
+    auto slot = reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(header) - offsetof(Slot, header));
+    // still the position we claimed, nobody else touches the slot until we publish it
+    uint64_t claimed = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(claimed + 1, std::memory_order_release);
+    if (m_sleeping.load(std::memory_order_relaxed))
+      m_wakeup.notify_one();
+  }
+
+  void start()
+  {
+    std::lock_guard<std::mutex> guard(m_lifetimeLock);
+    if (m_users++ == 0)
+    {
+      m_stop = false;
+      m_thread = std::thread([this]{ loop(); });
+      s_enabledLevels.store(m_configuredLevels, std::memory_order_relaxed);
+    }
+  }
+
+  void stop()
+  {
+    std::lock_guard<std::mutex> guard(m_lifetimeLock);
+    if (--m_users == 0)
+    {
+      s_enabledLevels.store(0, std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> sleepGuard(m_sleepLock);
+        m_stop = true;
+      }
+      m_wakeup.notify_one();
+      m_thread.join();
+    }
+  }
+
+  void setLevelEnabled(Level level, bool enable)
+  {
+    std::lock_guard<std::mutex> guard(m_lifetimeLock);
+    uint32_t bit = 1u << static_cast<uint32_t>(level);
+    m_configuredLevels = enable ? (m_configuredLevels | bit) : (m_configuredLevels & ~bit);
+    if (m_users > 0)
+      s_enabledLevels.store(m_configuredLevels, std::memory_order_relaxed);
+  }
+
+  void flush()
+  {
+    if (std::this_thread::get_id() == m_threadId.load(std::memory_order_relaxed))
+      return;
+    std::unique_lock<std::mutex> guard(m_lifetimeLock);
+    if (m_users == 0)
+      return;
+    uint64_t target = m_head.load(std::memory_order_acquire);
+    guard.unlock();
+    m_wakeup.notify_one();
+    while (m_printed.load(std::memory_order_acquire) < target)
+    {
+      m_wakeup.notify_one();
+      std::this_thread::yield();
+    }
+  }
+
+  uint64_t dropped() const
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  void setOutput(std::function<void(std::string_view)> output)
+  {
+    std::lock_guard<std::mutex> guard(m_outputLock);
+    m_output = std::move(output);
+  }
+
+private:
+  bool drain(std::string& out)
+  {
+    char buffer[1024];
+    bool any = false;
+    while (true)
+    {
+      Slot& slot = m_slots[m_tail & (Capacity - 1)];
+      if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1)
+        break;
+      auto& header = slot.header;
+      if (header.prefix)
+        out += "[" + std::string(header.prefix) + "] ";
+      if (header.file)
+        out += std::string(header.file) + "(" + std::to_string(header.line) + "): ";
+      int written = header.formatter(header.format, slot.args, buffer, sizeof(buffer));
+      if (written > 0)
+        out.append(buffer, std::min<size_t>(static_cast<size_t>(written), sizeof(buffer) - 1));
+      slot.sequence.store(m_tail + Capacity, std::memory_order_release);
+      ++m_tail;
+      any = true;
+    }
+    return any;
+  }
+
+  void print(std::string& out)
   {
-    if (m_readerIndex >= RINGBUFFERSIZE)
+    if (out.empty())
+      return;
+    std::lock_guard<std::mutex> guard(m_outputLock);
+    if (m_output)
     {
-      m_readerIndex = 0;
+      m_output(out);
+      out.clear();
+      return;
     }
-    //TODO: this has had problems
 #ifdef HIGANBANA_PLATFORM_WINDOWS
-    OutputDebugStringA(buffer[m_readerIndex].m_array.data());
+    OutputDebugStringA(out.c_str());
 #endif
-    if (buffer[m_readerIndex].m_size < 300)
-      std::cout.write(buffer[m_readerIndex].m_array.data(), buffer[m_readerIndex].m_size);
-    unhandled_buffer_size--;
-    m_readerIndex++;
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    out.clear();
   }
-}
\ No newline at end of file
+
+  void loop()
+  {
+    m_threadId = std::this_thread::get_id();
+    std::string out;
+    uint64_t reportedDrops = m_dropped.load(std::memory_order_relaxed);
+    while (true)
+    {
+      bool any = drain(out);
+      uint64_t drops = m_dropped.load(std::memory_order_relaxed);
+      if (drops != reportedDrops)
+      {
+        out += "[Log] queue was full, dropped " + std::to_string(drops - reportedDrops) + " messages\n";
+        reportedDrops = drops;
+      }
+      print(out);
+      m_printed.store(m_tail, std::memory_order_release);
+      if (any)
+        continue;
+      std::unique_lock<std::mutex> guard(m_sleepLock);
+      if (m_stop)
+        break;
+      m_sleeping.store(true, std::memory_order_relaxed);
+      // producers only look at m_sleeping without a fence, a missed wakeup costs at most the timeout
+      m_wakeup.wait_for(guard, std::chrono::milliseconds(10));
+      m_sleeping.store(false, std::memory_order_relaxed);
+    }
+    drain(out);
+    print(out);
+    m_printed.store(m_tail, std::memory_order_release);
+    m_threadId = std::thread::id();
+  }
+
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(64) std::atomic<uint64_t> m_head = 0;
+  std::atomic<uint64_t> m_dropped = 0;
+  alignas(64) uint64_t m_tail = 0; // log thread only
+  std::atomic<uint64_t> m_printed = 0;
+  std::atomic<bool> m_sleeping = false;
+  std::atomic<std::thread::id> m_threadId;
+
+  std::mutex m_sleepLock;
+  std::condition_variable m_wakeup;
+  bool m_stop = false;
+
+  std::mutex m_outputLock;
+  std::function<void(std::string_view)> m_output;
+
+  std::mutex m_lifetimeLock;
+  int m_users = 0;
+  uint32_t m_configuredLevels = AllLevels;
+  std::thread m_thread;
+};
+
+// never destroyed, logging from static destructors stays safe
+LogQueue& queue()
+{
+  static LogQueue* s_queue = new LogQueue();
+  return *s_queue;
+}
+}
+
+void setLevelEnabled(Level level, bool enable)
+{
+  queue().setLevelEnabled(level, enable);
+}
+
+void flush()
+{
+  queue().flush();
+}
+
+void setOutput(std::function<void(std::string_view)> output)
+{
+  queue().setOutput(std::move(output));
+}
+
+uint64_t droppedCount()
+{
+  return queue().dropped();
+}
+
+namespace detail
+{
+RecordHeader* beginRecord()
+{
+  return queue().begin();
+}
+
+void commitRecord(RecordHeader* header)
+{
+  queue().commit(header);
+}
+}
+}
+}
+
+Logger::Logger()
+{
+  log::queue().start();
+}
+
+Logger::~Logger()
+{
+  log::queue().stop();
+}
+
+void Logger::handleFazMesg(LogMessage &mesg)
+{
+  if (log::enabled(log::Level::Info))
+    log::write(log::Level::Info, nullptr, nullptr, 0, "%s", mesg.m_data);
+}
+
+void Logger::update()
+{
+}
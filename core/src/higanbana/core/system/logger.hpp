@@ -1,6 +1,7 @@
 #pragma once
 #include "higanbana/core/system/ringbuffer.hpp"
 #include "higanbana/core/system/fazmesg.hpp"
+#include "higanbana/core/system/deferred_log.hpp"
 #ifdef HIGANBANA_PLATFORM_WINDOWS
 #include <Windows.h>
 #endif
@@ -10,32 +11,18 @@
 #include <atomic>
 #include <mutex>
 
-#define MAXLOGLENGTH 500
-#define RINGBUFFERSIZE 300
-
 namespace higanbana
 {
-
-  class logdata
-  {
-  public:
-    logdata() :m_size(0) {}
-    size_t m_size;
-    std::array<char, MAXLOGLENGTH> m_array;
-  };
-
+  // While a Logger exists, a background thread formats and prints everything the HIGAN_LOG macros queued.
+  // Without one the macros are filtered out before their arguments are evaluated.
   class Logger : public FazMesg<LogMessage>
   {
   public:
     Logger();
     ~Logger();
+    // already formatted messages from sendMessage
     void handleFazMesg(LogMessage &mesg);
+    // output happens on the log thread, kept for callers that pump it every frame
     void update();
-  private:
-    std::mutex writeLock;
-    std::atomic<int> m_readerIndex;
-    std::atomic<int> m_writerIndex;
-    std::atomic<int> unhandled_buffer_size;
-    RingBuffer< logdata, RINGBUFFERSIZE> buffer;
   };
-}
\ No newline at end of file
+}
@@ -1,5 +1,9 @@
 #include "higanbana/core/system/time.hpp"
 #include "higanbana/core/global_debug.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <intrin.h>
+#endif
 
 namespace higanbana
 {
@@ -26,6 +30,58 @@ float3 TimeStatistics::minAvegMaxMS(){
   return{ static_cast<float>(count) / static_cast<float>(valuesStored.size())* 0.000001f, low*0.000001f, high*0.000001f };
 }
 
+int LatencyHistogram::bucketOf(int64_t nanoseconds) {
+  if (nanoseconds < SubBuckets)
+    return nanoseconds < 0 ? 0 : static_cast<int>(nanoseconds);
+  auto value = static_cast<uint64_t>(nanoseconds);
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  int msb = static_cast<int>(index);
+#else
+  int msb = 63 - __builtin_clzll(value);
+#endif
+  if (msb > MaxBit)
+    return BucketCount - 1;
+  int sub = static_cast<int>((value >> (msb - SubBucketBits)) & (SubBuckets - 1));
+  return (msb - SubBucketBits + 1) * SubBuckets + sub;
+}
+
+int64_t LatencyHistogram::bucketLowerBound(int bucket) {
+  if (bucket < SubBuckets)
+    return bucket;
+  int msb = bucket / SubBuckets + SubBucketBits - 1;
+  int sub = bucket % SubBuckets;
+  return static_cast<int64_t>(SubBuckets + sub) << (msb - SubBucketBits);
+}
+
+void LatencyHistogram::add(int bucket, uint32_t count) {
+  m_counts[bucket] += count;
+  m_total += count;
+}
+
+void LatencyHistogram::remove(int bucket, uint32_t count) {
+  HIGAN_ASSERT(m_counts[bucket] >= count, "removing more than was added");
+  m_counts[bucket] -= count;
+  m_total -= count;
+}
+
+int64_t LatencyHistogram::percentile(double percentile) const {
+  if (m_total == 0)
+    return 0;
+  auto rank = static_cast<uint64_t>(percentile * static_cast<double>(m_total - 1));
+  uint64_t seen = 0;
+  for (int i = 0; i < BucketCount; ++i) {
+    seen += m_counts[i];
+    if (seen > rank) {
+      auto low = bucketLowerBound(i);
+      auto high = i + 1 < BucketCount ? bucketLowerBound(i + 1) : low * 2;
+      return low + (high - low - 1) / 2;
+    }
+  }
+  return bucketLowerBound(BucketCount - 1);
+}
+
 Timer::Timer() 
   : start(HighPrecisionClock::now())
 {
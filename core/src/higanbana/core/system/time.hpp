@@ -21,6 +21,29 @@ namespace higanbana
     float3 minAvegMaxMS();
   };
 
+  // Log-linear nanosecond histogram, 16 buckets per power of two so any percentile is within ~6%.
+  // Values past ~18 minutes land in the last bucket. Counts can be removed again for rolling windows.
+  class LatencyHistogram
+  {
+  public:
+    static constexpr int SubBucketBits = 4;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int MaxBit = 40;
+    static constexpr int BucketCount = (MaxBit - SubBucketBits + 2) * SubBuckets;
+
+    static int bucketOf(int64_t nanoseconds);
+    static int64_t bucketLowerBound(int bucket);
+
+    void add(int bucket, uint32_t count = 1);
+    void remove(int bucket, uint32_t count = 1);
+    uint64_t count() const { return m_total; }
+    // bucket middle in nanoseconds, 0 when empty. percentile in [0, 1]
+    int64_t percentile(double percentile) const;
+  private:
+    uint32_t m_counts[BucketCount] = {};
+    uint64_t m_total = 0;
+  };
+
   class Timer 
   {
   public:
@@ -0,0 +1,263 @@
+#include "higanbana/core/thread/cpu_info.hpp"
+#include <algorithm>
+#include <map>
+#include <cctype>
+
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <sched.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#endif
+
+namespace higanbana
+{
+namespace
+{
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+// GetLogicalProcessorInformation only describes the calling thread's processor group, cpus are numbered
+// group * 64 + bit so that pinToCpu can find the group again.
+void probe(std::vector<Numa>& numas)
+{
+  PSYSTEM_LOGICAL_PROCESSOR_INFORMATION info = nullptr;
+  DWORD infoLen = 0;
+  if (!GetLogicalProcessorInformation(info, &infoLen)){
+    auto error = GetLastError();
+    if (error == ERROR_INSUFFICIENT_BUFFER) {
+      info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION>(malloc(infoLen));
+      if (GetLogicalProcessorInformation(info, &infoLen)) {
+        DWORD byteOffset = 0;
+        PSYSTEM_LOGICAL_PROCESSOR_INFORMATION ptr = info;
+        std::vector<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION> ptrs;
+        std::vector<uint64_t> nodeMasks;
+        while (byteOffset + sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) <= infoLen) {
+          ptrs.push_back(ptr);
+          switch(ptr->Relationship) {
+            case RelationNumaNode:
+            {
+              GROUP_AFFINITY affi{};
+              if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(ptr->NumaNode.NodeNumber), &affi)) {
+                numas.push_back({ptr->NumaNode.NodeNumber, affi.Group});
+                nodeMasks.push_back(static_cast<uint64_t>(affi.Mask));
+              }
+              break;
+            }
+            default:
+              break;
+          }
+          byteOffset += sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+          ptr++;
+        }
+
+        GROUP_AFFINITY current{};
+        GetThreadGroupAffinity(GetCurrentThread(), &current);
+        for (size_t node = 0; node < numas.size(); ++node) {
+          auto& numa = numas[node];
+          // masks below are from the current group only, other groups' nodes stay empty
+          if (numa.processor != current.Group)
+            continue;
+          for (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION pt : ptrs) {
+            if (pt->Relationship != RelationCache || pt->Cache.Level != 3)
+              continue;
+            // every node sees every L3, keep the ones on this node
+            uint64_t mask = static_cast<uint64_t>(pt->ProcessorMask) & nodeMasks[node];
+            if (mask == 0)
+              continue;
+            L3CacheCpuGroup group{};
+            group.mask = mask;
+            numa.coreGroups.push_back(group);
+          }
+          for (auto& l3ca : numa.coreGroups)
+            for (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION pt : ptrs) {
+              if (pt->Relationship != RelationProcessorCore)
+                continue;
+              uint64_t mask = static_cast<uint64_t>(pt->ProcessorMask);
+              if ((l3ca.mask & mask) != mask)
+                continue;
+              CpuCore core{};
+              numa.cores++;
+              while (mask != 0) {
+                unsigned long index = 0;
+                _BitScanForward64(&index, mask);
+                core.logicalCores.push_back(static_cast<int>(numa.processor * 64 + index));
+                numa.threads++;
+                mask ^= 1ull << index;
+              }
+              l3ca.cores.push_back(core);
+            }
+        }
+      }
+      free(info);
+    }
+  }
+}
+#else
+// "0-3,8,10-11" style lists used all over /sys
+std::vector<int> readCpuList(const std::string& path)
+{
+  std::vector<int> cpus;
+  std::ifstream file(path);
+  std::string list;
+  if (!file || !std::getline(file, list))
+    return cpus;
+  size_t pos = 0;
+  while (pos < list.size())
+  {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos)
+      end = list.size();
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    if (!range.empty())
+    {
+      int first = std::stoi(range);
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int i = first; i <= last; ++i)
+        cpus.push_back(i);
+    }
+    pos = end + 1;
+  }
+  return cpus;
+}
+
+int readInt(const std::string& path, int fallback)
+{
+  std::ifstream file(path);
+  int value = fallback;
+  if (file)
+    file >> value;
+  return value;
+}
+
+void probe(std::vector<Numa>& numas)
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return;
+
+  const std::string cpuRoot = "/sys/devices/system/cpu/cpu";
+  std::map<int, int> nodeOf;
+  std::error_code ec;
+  for (auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+  {
+    auto name = entry.path().filename().string();
+    if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])))
+      continue;
+    int node = std::stoi(name.substr(4));
+    for (int cpu : readCpuList(entry.path().string() + "/cpulist"))
+      nodeOf[cpu] = node;
+  }
+
+  // node -> l3 key -> core key -> logical cpus, keys are the first cpu sharing the resource.
+  std::map<int, std::map<int, std::map<int, std::vector<int>>>> tree;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+  {
+    if (!CPU_ISSET(cpu, &allowed))
+      continue;
+    std::string base = cpuRoot + std::to_string(cpu);
+    auto siblings = readCpuList(base + "/topology/thread_siblings_list");
+    int coreKey = siblings.empty() ? cpu : siblings.front();
+    int l3Key = -1;
+    for (int index = 0; index < 8 && l3Key < 0; ++index)
+    {
+      std::string cache = base + "/cache/index" + std::to_string(index);
+      if (readInt(cache + "/level", -1) != 3)
+        continue;
+      auto shared = readCpuList(cache + "/shared_cpu_list");
+      if (!shared.empty())
+        l3Key = shared.front();
+    }
+    if (l3Key < 0) // no L3 information, treat the package as one
+      l3Key = -2 - readInt(base + "/topology/physical_package_id", 0);
+    auto node = nodeOf.find(cpu);
+    tree[node != nodeOf.end() ? node->second : 0][l3Key][coreKey].push_back(cpu);
+  }
+
+  for (auto& [node, l3s] : tree)
+  {
+    Numa numa{};
+    numa.number = static_cast<uint32_t>(node);
+    for (auto& [l3Key, cores] : l3s)
+    {
+      L3CacheCpuGroup group{};
+      group.mask = 0;
+      for (auto& [coreKey, threads] : cores)
+      {
+        CpuCore core{};
+        core.logicalCores = threads;
+        for (int cpu : threads)
+        {
+          if (cpu < 64)
+            group.mask |= 1ull << cpu;
+        }
+        numa.cores++;
+        numa.threads += threads.size();
+        group.cores.push_back(core);
+      }
+      numa.coreGroups.push_back(group);
+    }
+    numas.push_back(numa);
+  }
+}
+#endif
+}
+
+SystemCpuInfo::SystemCpuInfo()
+{
+  probe(numas);
+  int core = 0;
+  int l3 = 0;
+  for (int numa = 0; numa < static_cast<int>(numas.size()); ++numa)
+  {
+    for (auto& group : numas[numa].coreGroups)
+    {
+      for (auto& cpuCore : group.cores)
+      {
+        for (int cpu : cpuCore.logicalCores)
+          logical.push_back(LogicalCpu{cpu, core, l3, numa});
+        core++;
+      }
+      l3++;
+    }
+  }
+}
+
+std::vector<LogicalCpu> SystemCpuInfo::placement(size_t threadCount) const
+{
+  std::vector<LogicalCpu> order;
+  if (logical.empty())
+    return order;
+  // logical is sorted by core, nth pass takes the nth SMT thread of every core.
+  for (int smt = 0; order.size() < logical.size(); ++smt)
+  {
+    int seen = -1;
+    int index = 0;
+    for (auto& cpu : logical)
+    {
+      index = cpu.core == seen ? index + 1 : 0;
+      seen = cpu.core;
+      if (index == smt)
+        order.push_back(cpu);
+    }
+  }
+  // more threads than cpus, keep wrapping around
+  for (size_t i = logical.size(); i < threadCount; ++i)
+    order.push_back(order[i % logical.size()]);
+  order.resize(threadCount);
+  return order;
+}
+
+int SystemCpuInfo::distance(const LogicalCpu& a, const LogicalCpu& b)
+{
+  if (a.core == b.core)
+    return 0;
+  if (a.l3 == b.l3)
+    return 1;
+  if (a.numa == b.numa)
+    return 2;
+  return 3;
+}
+};
@@ -1,6 +1,8 @@
 #pragma once
-#include <windows.h>
+#include "higanbana/core/platform/definitions.hpp"
 #include <vector>
+#include <cstdint>
+#include <cstddef>
 
 namespace higanbana
 {
@@ -17,103 +19,35 @@ struct L3CacheCpuGroup
 
 struct Numa
 {
-  DWORD number = 0;
-  WORD processor = 0;
+  uint32_t number = 0;
+  uint16_t processor = 0;
   size_t cores = 0;
   size_t threads = 0;
   std::vector<L3CacheCpuGroup> coreGroups;
 };
 
+// Where a logical cpu lives, ids are dense indexes into the probed topology.
+struct LogicalCpu
+{
+  int cpu = 0;
+  int core = 0;
+  int l3 = 0;
+  int numa = 0;
+};
+
 class SystemCpuInfo {
   public:
   std::vector<Numa> numas;
-  SystemCpuInfo() {
-    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION info = nullptr;
-    DWORD infoLen = 0;
-    if (!GetLogicalProcessorInformation(info, &infoLen)){
-      auto error = GetLastError();
-      if (error == ERROR_INSUFFICIENT_BUFFER) {
-        info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION>(malloc(infoLen));
-        if (GetLogicalProcessorInformation(info, &infoLen)) {
-          DWORD byteOffset = 0;
-          PSYSTEM_LOGICAL_PROCESSOR_INFORMATION ptr = info;
-          std::vector<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION> ptrs;
-          while (byteOffset + sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) <= infoLen) {
-            ptrs.push_back(ptr);
-            switch(ptr->Relationship) {
-              case RelationNumaNode:
-              {
-                GROUP_AFFINITY affi;
-                bool woot = GetNumaNodeProcessorMaskEx(ptr->NumaNode.NodeNumber, &affi);
-                numas.push_back({ptr->NumaNode.NodeNumber, affi.Group});
-                break;
-              }
-              default:
-                break;
-            }
-            byteOffset += sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
-            ptr++;
-          }
+  // flattened view of numas, only cpus this process is allowed to run on.
+  std::vector<LogicalCpu> logical;
 
-          for (auto& numa : numas) {
-            for (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION pt : ptrs) {
-              switch(pt->Relationship) {
-                case RelationProcessorCore:
-                {
-                  break;
-                }
-                case RelationCache:
-                {
-                  if (pt->Cache.Level == 3) {
-                    L3CacheCpuGroup group{};
-                    group.mask = static_cast<uint64_t>(pt->ProcessorMask);
-                    numa.coreGroups.push_back(group);
-                  }
-                  break;
-                }
-                case RelationProcessorPackage:
-                {
-                  break;
-                }
-                default:
-                  break;
-              }
-            }
-            for (auto& l3ca : numa.coreGroups)
-              for (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION pt : ptrs) {
-                auto res = l3ca.mask & pt->ProcessorMask;
-                if (res != pt->ProcessorMask)
-                  continue;
-                switch(pt->Relationship) {
-                  case RelationProcessorCore:
-                  {
-                    CpuCore core{};
-                    auto mask = pt->ProcessorMask;
-                    numa.cores++;
-                    while(mask != 0) {
-                      unsigned long index = -1;
-                      if (_BitScanForward(&index, mask)!=0) {
-                        core.logicalCores.push_back(static_cast<int>(index));
-                        numa.threads++;
-                        unsigned long unsetMask = 1 << index;
-                        mask ^= unsetMask;
-                      }
-                      else{
-                        break;
-                      }
-                    }
-                    l3ca.cores.push_back(core);
-                    break;
-                  }
-                  default:
-                    break;
-                }
-              }
-          }
-        }
-        free(info);
-      }
-    }
-  }
+  SystemCpuInfo();
+
+  // logical cpus to pin workers to, one per physical core first, SMT siblings after that.
+  // Cores are taken node by node and L3 by L3 so that small pools stay close together.
+  std::vector<LogicalCpu> placement(size_t threadCount) const;
+
+  // 0 same core, 1 same L3, 2 same numa node, 3 anywhere else.
+  static int distance(const LogicalCpu& a, const LogicalCpu& b);
+};
 };
-};
\ No newline at end of file
@@ -1,4 +1,12 @@
 #include "higanbana/core/thread/this_thread.hpp"
+#include "higanbana/core/platform/definitions.hpp"
+
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace higanbana
 {
@@ -14,6 +22,24 @@ int id()
 {
   return myIndex;
 }
+bool pinToCpu(int cpu)
+{
+#if defined(HIGANBANA_PLATFORM_WINDOWS)
+  if (cpu < 0)
+    return false;
+  GROUP_AFFINITY affinity{};
+  affinity.Group = static_cast<WORD>(cpu / 64);
+  affinity.Mask = KAFFINITY(1) << (cpu % 64);
+  return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+}
 }
 }
-}
\ No newline at end of file
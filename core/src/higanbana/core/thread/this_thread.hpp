@@ -7,6 +7,9 @@ namespace thread
 namespace this_thread
 {
 int id();
+// Restricts the calling thread to one logical cpu, returns false if the os refused.
+// On Windows cpus are numbered processor group * 64 + index in the group, like SystemCpuInfo reports them.
+bool pinToCpu(int cpu);
+}
 }
 }
-}
\ No newline at end of file
@@ -11,26 +11,53 @@ namespace higanbana
     }
     void BarrierSolver::addBuffer(int drawCallIndex, ViewResourceHandle buffer, ResourceState access)
     {
-      m_bufferCache[buffer.resourceHandle()].state = ResourceState(backend::AccessUsage::Unknown, backend::AccessStage::Common, backend::TextureLayout::Undefined, QueueType::Unknown);
-      m_bufferCache[buffer.resourceHandle()].lastBarrierIndex = -1; 
+      auto& cached = m_bufferCache[buffer.resourceHandle()];
+      if (cached.epoch != m_epoch)
+      {
+        cached.state = ResourceState(backend::AccessUsage::Unknown, backend::AccessStage::Common, backend::TextureLayout::Undefined, QueueType::Unknown);
+        cached.lastBarrierIndex = -1;
+        cached.epoch = m_epoch;
+        m_uniqueBuffers.push_back(buffer.resourceHandle());
+      }
       m_jobs.push_back(DependencyPacket{drawCallIndex, buffer, access});
-      m_uniqueBuffers.insert(buffer.resourceHandle());
+    }
+    void BarrierSolver::touchSubresource(SmallTexture& texture, uint32_t subresource)
+    {
+      if (texture.stateEpochs[subresource] != m_epoch)
+      {
+        texture.states[subresource] = ResourceState(backend::AccessUsage::Unknown, backend::AccessStage::Common, backend::TextureLayout::Undefined, QueueType::Unknown);
+        texture.stateEpochs[subresource] = m_epoch;
+        texture.touched.push_back(subresource);
+      }
     }
     void BarrierSolver::addTexture(int drawCallIndex, ViewResourceHandle texture, ResourceState access)
     {
-      const ResourceState exampleState = ResourceState(backend::AccessUsage::Unknown, backend::AccessStage::Common, backend::TextureLayout::Undefined, QueueType::Unknown);
-      auto& states = m_imageCache[texture.resourceHandle()].states;
-      auto& gstate = (*m_textureStates)[texture.resourceHandle()];
-      auto size = gstate.states.size();
-      m_imageCache[texture.resourceHandle()].mips = gstate.mips;
-      if (states.size() != size)
-        states.resize(size);
-      for (auto&& state : states) {
-        state = exampleState;
+      auto& cached = m_imageCache[texture.resourceHandle()];
+      if (cached.epoch != m_epoch)
+      {
+        auto& gstate = (*m_textureStates)[texture.resourceHandle()];
+        auto size = gstate.states.size();
+        cached.mips = gstate.mips;
+        if (cached.states.size() != size)
+        {
+          cached.states.resize(size);
+          cached.stateEpochs.clear();
+          cached.stateEpochs.resize(size, 0);
+        }
+        cached.touched.clear();
+        cached.epoch = m_epoch;
+        m_uniqueTextures.push_back(texture.resourceHandle());
+        // queue transfer checks look at the first subresource
+        touchSubresource(cached, 0);
+      }
+      for (auto mip = texture.startMip(); mip < texture.startMip() + texture.mipSize(); ++mip)
+      {
+        for (auto slice = texture.startArr(); slice < texture.startArr() + texture.arrSize(); ++slice)
+        {
+          touchSubresource(cached, slice * cached.mips + mip);
+        }
       }
-        
       m_jobs.push_back(DependencyPacket{drawCallIndex, texture, access});
-      m_uniqueTextures.insert(texture.resourceHandle());
     }
     void BarrierSolver::reset(HandleVector<ResourceState>* buffers, HandleVector<TextureResourceState>* textures)
     {
@@ -42,9 +69,17 @@ namespace higanbana
       m_drawBarries.clear();
       bufferBarriers.clear();
       imageBarriers.clear();
-      // should not need to clear caches...
-      //m_bufferCache.clear();
-      //m_imageCache.clear();
+      m_unresolvedBuffers.clear();
+      m_unresolvedImages.clear();
+      m_lastBufferStates.clear();
+      // caches stay, new epoch makes their contents stale
+      if (++m_epoch == 0)
+      {
+        // wrapped around, old stamps could look current again
+        m_bufferCache.clear();
+        m_imageCache.clear();
+        m_epoch = 1;
+      }
       drawCallsAdded = 0;
     }
 
@@ -187,8 +222,10 @@ namespace higanbana
                   // fix all the state
                   if (!acquire)
                   {
-                    for (auto&& state : resource.states)
+                    for (uint32_t i = 0; i < static_cast<uint32_t>(resource.states.size()); ++i)
                     {
+                      touchSubresource(resource, i);
+                      auto& state = resource.states[i];
                       state.queue_index = job.nextAccess.queue_index;
                       state.stage = AccessStage::Common;
                     }
@@ -290,6 +327,21 @@ namespace higanbana
         currentInfo.drawcall = drawIndex;
         m_drawBarries.push_back(currentInfo);
       }
+
+      for (int i = 0; i < static_cast<int>(bufferBarriers.size()); ++i)
+      {
+        if (bufferBarriers[i].before.usage == AccessUsage::Unknown)
+          m_unresolvedBuffers.push_back(i);
+      }
+      for (int i = 0; i < static_cast<int>(imageBarriers.size()); ++i)
+      {
+        if (imageBarriers[i].before.usage == AccessUsage::Unknown)
+          m_unresolvedImages.push_back(i);
+      }
+      for (auto&& obj : m_uniqueBuffers)
+      {
+        m_lastBufferStates.push_back(LastBufferState{obj, m_bufferCache[obj].state});
+      }
     }
 
     void BarrierSolver::globalBarrierPass2()
@@ -297,54 +349,50 @@ namespace higanbana
       // patch list
       //HIGAN_LOGi("globalBarrierPass2\n");
       //HIGAN_LOGi("Patch list\n");
-      for (auto&& buffer : bufferBarriers)
+      for (auto&& barrierIndex : m_unresolvedBuffers)
       {
-        if (buffer.before.usage == AccessUsage::Unknown)
-        {
-          buffer.before = (*m_bufferStates)[buffer.handle];
-        }
+        auto& buffer = bufferBarriers[barrierIndex];
+        buffer.before = (*m_bufferStates)[buffer.handle];
       }
-      for (auto&& image : imageBarriers)
+      for (auto&& barrierIndex : m_unresolvedImages)
       {
+        auto& image = imageBarriers[barrierIndex];
         //HIGAN_LOGi("\t checking... tex %d before usage: \"%10s\" stage: \"%14s\" layout: \"%16s\"\n", image.handle.id, toString(image.before.usage), toString(image.before.stage), toString(image.before.layout));
-        if (image.before.usage == AccessUsage::Unknown)
+        auto& ginfo = (*m_textureStates)[image.handle];
+        auto refState = ginfo.states[image.startArr * ginfo.mips + image.startMip];
+        refState.queue_index = QueueType::Unknown;
+        for (int slice = image.startArr; slice < image.startArr + image.arrSize; ++slice)
         {
-          auto& ginfo = (*m_textureStates)[image.handle];
-          auto refState = ginfo.states[image.startArr * ginfo.mips + image.startMip];
-          refState.queue_index = QueueType::Unknown;
-          for (int slice = image.startArr; slice < image.startArr + image.arrSize; ++slice)
+          for (int mip = image.startMip; mip < image.startMip + image.mipSize; ++mip)
           {
-            for (int mip = image.startMip; mip < image.startMip + image.mipSize; ++mip)
+            int index = slice * ginfo.mips + mip;
+            if ((refState.layout != ginfo.states[index].layout)
+            || (refState.stage != ginfo.states[index].stage)
+            || (refState.usage != ginfo.states[index].usage))
             {
-              int index = slice * ginfo.mips + mip;
-              if ((refState.layout != ginfo.states[index].layout)
-              || (refState.stage != ginfo.states[index].stage)
-              || (refState.usage != ginfo.states[index].usage))
-              {
-                HIGAN_ASSERT(false, "oh no");
-              }
+              HIGAN_ASSERT(false, "oh no");
             }
           }
-          /*
-          HIGAN_LOGi("\ttex %d barrier slice [%d - %d] mip [%d - %d]\n", image.handle.id, image.startArr, image.startArr+image.arrSize, image.startMip, image.startMip+image.mipSize);
-          HIGAN_LOGi("\t\tbefore usage: \"%10s\" stage: \"%14s\" layout: \"%16s\"\n", toString(image.before.usage), toString(image.before.stage), toString(image.before.layout));
-          HIGAN_LOGi("\t\tafter  usage: \"%10s\" stage: \"%14s\" layout: \"%16s\"\n", toString(refState.usage), toString(refState.stage), toString(refState.layout)); */
-          image.before = refState;
         }
+        /*
+        HIGAN_LOGi("\ttex %d barrier slice [%d - %d] mip [%d - %d]\n", image.handle.id, image.startArr, image.startArr+image.arrSize, image.startMip, image.startMip+image.mipSize);
+        HIGAN_LOGi("\t\tbefore usage: \"%10s\" stage: \"%14s\" layout: \"%16s\"\n", toString(image.before.usage), toString(image.before.stage), toString(image.before.layout));
+        HIGAN_LOGi("\t\tafter  usage: \"%10s\" stage: \"%14s\" layout: \"%16s\"\n", toString(refState.usage), toString(refState.stage), toString(refState.layout)); */
+        image.before = refState;
       }
 
       // update global state
-      for (auto&& obj : m_uniqueBuffers)
+      for (auto&& last : m_lastBufferStates)
       {
-        (*m_bufferStates)[obj] = m_bufferCache[obj].state;
+        (*m_bufferStates)[last.handle] = last.state;
       }
       //HIGAN_LOGi("update global state\n");
       for (auto&& obj : m_uniqueTextures)
       {
         auto& globalState = (*m_textureStates)[obj].states;
-        auto& localState = m_imageCache[obj].states;
-        int globalSize = static_cast<int>(globalState.size());
-        for (int i = 0; i < globalSize; ++i)
+        auto& cached = m_imageCache[obj];
+        auto& localState = cached.states;
+        for (auto&& i : cached.touched)
         {
           if (localState[i].usage != AccessUsage::Unknown) {
             /*
@@ -44,9 +44,13 @@ namespace higanbana
       HandleVector<ResourceState>* m_bufferStates;
       HandleVector<TextureResourceState>* m_textureStates;
 
-      // todo, couldn't these be bitfields?
-      unordered_set<ResourceHandle> m_uniqueBuffers;
-      unordered_set<ResourceHandle> m_uniqueTextures;
+      // every reset starts a new epoch, cache entries stamped with an older one are treated as untouched.
+      // Resetting is O(1) and the stamp doubles as the uniqueness check.
+      uint32_t m_epoch = 1;
+
+      // resources touched in this epoch, in first use order
+      vector<ResourceHandle> m_uniqueBuffers;
+      vector<ResourceHandle> m_uniqueTextures;
 
       // actual jobs used to generate DAG
       vector<DependencyPacket> m_jobs;
@@ -72,18 +76,36 @@ namespace higanbana
       vector<BufferBarrier> bufferBarriers;
       vector<ImageBarrier> imageBarriers;
 
+      // first uses whose "before" state is only known after the previous lists, found in the local pass
+      // so that the ordered global pass only touches these and the last states of unique resources.
+      vector<int> m_unresolvedBuffers;
+      vector<int> m_unresolvedImages;
+      struct LastBufferState
+      {
+        ResourceHandle handle;
+        ResourceState state;
+      };
+      vector<LastBufferState> m_lastBufferStates;
+
       struct SmallBuffer
       {
         ResourceState state;
         int lastBarrierIndex;
+        uint32_t epoch = 0;
       };
 
       struct SmallTexture
       {
         uint mips;
+        uint32_t epoch = 0;
         vector<ResourceState> states;
+        vector<uint32_t> stateEpochs;
+        // subresources touched in this epoch, only these are written back to the global state
+        vector<uint32_t> touched;
       };
 
+      void touchSubresource(SmallTexture& texture, uint32_t subresource);
+
       HandleVector<SmallBuffer> m_bufferCache;
       HandleVector<SmallTexture> m_imageCache;
     public:
@@ -107,7 +129,9 @@ namespace higanbana
       // only builds the graph of dependencies.
       // void resolveGraph(); //... hmm, not implementing for now.
       // void printStuff(std::function<void(std::string)> func);
+      // independent of other solvers, lists can be solved in parallel
       void localBarrierPass1(bool allowCommonOptimization);
+      // reads and updates the global state tables, has to run in submission order
       void globalBarrierPass2();
       void reset(HandleVector<ResourceState>* buffers, HandleVector<TextureResourceState>* textures);
 
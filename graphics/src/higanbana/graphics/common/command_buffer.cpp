@@ -0,0 +1,164 @@
+#include "higanbana/graphics/common/command_buffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    namespace commandpages
+    {
+      namespace
+      {
+        constexpr size_t ThreadCacheMax = 64;
+        constexpr size_t RefillCount = 16;
+
+        std::atomic<size_t> s_allocatedPages = 0;
+        // trivially destructible so it's still readable while other thread_locals are destroyed
+        thread_local bool t_exited = false;
+
+        CommandBufferPage* newPage(size_t capacity)
+        {
+          auto page = static_cast<CommandBufferPage*>(::operator new(sizeof(CommandBufferPage) + capacity));
+          page->next = nullptr;
+          page->capacity = capacity;
+          s_allocatedPages++;
+          return page;
+        }
+
+        void deletePage(CommandBufferPage* page)
+        {
+          ::operator delete(page);
+        }
+
+        // index of the pooled size class, -1 for dedicated pages
+        int sizeClass(size_t capacity)
+        {
+          if (capacity == SmallPageSize)
+            return 0;
+          if (capacity == PageSize)
+            return 1;
+          return -1;
+        }
+
+        constexpr size_t ClassSizes[] = {SmallPageSize, PageSize};
+        constexpr int SizeClasses = 2;
+
+        struct SharedPages
+        {
+          std::mutex lock;
+          std::vector<CommandBufferPage*> pages[SizeClasses];
+          ~SharedPages()
+          {
+            for (auto&& list : pages)
+              for (auto&& page : list)
+                deletePage(page);
+          }
+        };
+
+        SharedPages& sharedPages()
+        {
+          static SharedPages shared;
+          return shared;
+        }
+
+        struct ThreadPages
+        {
+          std::vector<CommandBufferPage*> pages[SizeClasses];
+          // worker threads exit before the pool, hand leftovers to everyone else
+          ~ThreadPages()
+          {
+            t_exited = true;
+            auto& shared = sharedPages();
+            std::lock_guard<std::mutex> guard(shared.lock);
+            for (int i = 0; i < SizeClasses; ++i)
+              shared.pages[i].insert(shared.pages[i].end(), pages[i].begin(), pages[i].end());
+          }
+        };
+
+        ThreadPages& threadPages()
+        {
+          // construct shared first so it outlives every thread cache
+          sharedPages();
+          thread_local ThreadPages cache;
+          return cache;
+        }
+      }
+
+      CommandBufferPage* acquire(size_t minCapacity)
+      {
+        if (minCapacity > PageSize)
+          return newPage(minCapacity);
+        int index = minCapacity > SmallPageSize ? 1 : 0;
+        if (t_exited)
+          return newPage(ClassSizes[index]);
+        auto& cache = threadPages().pages[index];
+        if (cache.empty())
+        {
+          auto& shared = sharedPages();
+          std::lock_guard<std::mutex> guard(shared.lock);
+          auto& sharedList = shared.pages[index];
+          auto count = std::min(RefillCount, sharedList.size());
+          cache.insert(cache.end(), sharedList.end() - count, sharedList.end());
+          sharedList.resize(sharedList.size() - count);
+        }
+        if (cache.empty())
+          return newPage(ClassSizes[index]);
+        auto page = cache.back();
+        cache.pop_back();
+        page->next = nullptr;
+        return page;
+      }
+
+      void release(CommandBufferPage* page)
+      {
+        if (!page)
+          return;
+        if (t_exited)
+        {
+          // static lists destroyed after this thread's cache
+          while (page)
+          {
+            auto next = page->next;
+            deletePage(page);
+            page = next;
+          }
+          return;
+        }
+        auto& cache = threadPages();
+        while (page)
+        {
+          auto next = page->next;
+          int index = sizeClass(page->capacity);
+          if (index >= 0)
+            cache.pages[index].push_back(page);
+          else
+            deletePage(page);
+          page = next;
+        }
+        for (int i = 0; i < SizeClasses; ++i)
+        {
+          auto& list = cache.pages[i];
+          if (list.size() > ThreadCacheMax)
+          {
+            // lists are often freed on the submitting thread, give recording threads a chance at them
+            auto& shared = sharedPages();
+            std::lock_guard<std::mutex> guard(shared.lock);
+            auto keep = list.begin() + ThreadCacheMax / 2;
+            shared.pages[i].insert(shared.pages[i].end(), keep, list.end());
+            list.erase(keep, list.end());
+          }
+        }
+      }
+
+      size_t allocatedPages()
+      {
+        return s_allocatedPages.load(std::memory_order_relaxed);
+      }
+    }
+  }
+}
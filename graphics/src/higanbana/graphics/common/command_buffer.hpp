@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 #include <cstddef>
@@ -8,8 +9,6 @@
 #include <higanbana/core/datastructures/vector.hpp>
 #include <higanbana/core/global_debug.hpp>
 
-#define VERIFY_PACKETS_ONE_BY_BY 0
-
 // #define SIZE_DEBUG
 namespace higanbana
 {
@@ -52,6 +51,8 @@ namespace higanbana
       RaytracingWriteGpuAddrToInstanceGPU,
       BuildBLASTriangle,
       BuildTLAS,
+      // internal, iterators skip to the next page and never return these
+      NextPage,
       EndOfPackets,
     };
 
@@ -70,14 +71,34 @@ namespace higanbana
       }
     };
 
-    class CommandBuffer
+    // Packets are recorded into a chain of pages, a packet with its data never crosses a page.
+    struct CommandBufferPage
     {
-      vector<uint8_t> m_data;
-      size_t m_totalSize;
-      size_t m_usedSize;
-      size_t m_packetBeingCreated;
-      size_t m_packets = 0;
+      CommandBufferPage* next;
+      size_t capacity;
+
+      uint8_t* data()
+      {
+        return reinterpret_cast<uint8_t*>(this + 1);
+      }
+    };
 
+    // Small and default sized pages are recycled, every thread keeps a small cache in front of a shared freelist.
+    // Pages go back to the pool when a CommandBuffer is reset or destroyed, so after the first frames recording doesn't allocate.
+    namespace commandpages
+    {
+      constexpr size_t SmallPageSize = 4 * 1024;
+      constexpr size_t PageSize = 64 * 1024;
+      // at least minCapacity usable bytes rounded up to a size class, larger than PageSize requests get a dedicated page
+      CommandBufferPage* acquire(size_t minCapacity);
+      // releases the whole chain starting from page
+      void release(CommandBufferPage* page);
+      // pages ever allocated from the os, for tracking steady state allocations
+      size_t allocatedPages();
+    }
+
+    class CommandBuffer
+    {
     public:
       // commandbuffer header
       struct PacketHeader
@@ -95,31 +116,67 @@ namespace higanbana
         }
       };
     private:
+      // room always left at the end of a page for the NextPage packet
+      static constexpr size_t LinkSize = sizeof(PacketHeader) + sizeof(uint8_t*);
+
+      CommandBufferPage* m_first = nullptr;
+      CommandBufferPage* m_current = nullptr;
+      size_t m_currentUsed = 0;
+      uint8_t* m_packetBeingCreated = nullptr;
+      size_t m_totalSize = 0;
+      size_t m_usedSize = 0;
+      size_t m_packets = 0;
+
+      static PacketHeader* followLinks(PacketHeader* header)
+      {
+        while (header->type == PacketType::NextPage)
+        {
+          uint8_t* next;
+          memcpy(&next, header + 1, sizeof(next));
+          header = reinterpret_cast<PacketHeader*>(next);
+        }
+        return header;
+      }
 
       PacketHeader packetBeingCreated()
       {
         PacketHeader headr;
-        memcpy(&headr, m_data.data()+m_packetBeingCreated, sizeof(PacketHeader));
+        memcpy(&headr, m_packetBeingCreated, sizeof(PacketHeader));
         return headr;
       }
 
-      void doubleSize()
+      // moves the packet being created to a new page, leaving a link to it in its place
+      void nextPage(size_t size)
       {
-        auto newSize = m_totalSize * 4;
-        m_data.resize(newSize);
-        m_totalSize = newSize;
+        uint8_t* top = m_current->data() + m_currentUsed;
+        size_t carried = static_cast<size_t>(top - m_packetBeingCreated);
+        // first page may be small, lists that outgrow it continue on full pages
+        auto page = commandpages::acquire(std::max(carried + size + LinkSize, commandpages::PageSize));
+        memcpy(page->data(), m_packetBeingCreated, carried);
+
+        PacketHeader link = {};
+        link.type = PacketType::NextPage;
+        uint8_t* target = page->data();
+        memcpy(m_packetBeingCreated, &link, sizeof(PacketHeader));
+        memcpy(m_packetBeingCreated + sizeof(PacketHeader), &target, sizeof(target));
+
+        m_current->next = page;
+        m_current = page;
+        m_currentUsed = carried;
+        m_packetBeingCreated = page->data();
+        m_totalSize += page->capacity;
       }
 
       uint8_t* allocate(size_t size)
       {
-        auto current = m_usedSize;
-        while (m_usedSize + size >= m_totalSize)
+        if (m_currentUsed + size + LinkSize > m_current->capacity)
         {
-          doubleSize();
+          nextPage(size);
         }
+        uint8_t* ptr = m_current->data() + m_currentUsed;
+        m_currentUsed += size;
         m_usedSize += size;
-        //printf("allocated %zu size %zu\n", current, size);
-        return &m_data.at(current);
+        return ptr;
       }
 
       PacketHeader beginNewPacket(PacketType type)
@@ -132,9 +189,10 @@ namespace higanbana
 
       void newHeader()
       {
+        // nothing is carried if the header itself doesn't fit
+        m_packetBeingCreated = m_current->data() + m_currentUsed;
         uint8_t* ptr = allocate(sizeof(PacketHeader));
-        size_t offset = reinterpret_cast<size_t>(ptr) - reinterpret_cast<size_t>(m_data.data());
-        m_packetBeingCreated = offset;
+        m_packetBeingCreated = ptr;
         PacketHeader header = {};
         header.type = PacketType::EndOfPackets;
     #if defined(size_debug)
@@ -146,30 +204,42 @@ namespace higanbana
 
       void endNewPacket(PacketHeader header)
       {
-        // patch old packet
-        size_t currentTop = m_usedSize;
-        size_t thisPacket = m_packetBeingCreated;
-        size_t diff = currentTop - thisPacket;
+        // patch old packet, whole packet is always on the current page
+        uint8_t* currentTop = m_current->data() + m_currentUsed;
+        size_t diff = static_cast<size_t>(currentTop - m_packetBeingCreated);
         header.offsetFromThis = static_cast<unsigned>(diff);
     #if defined(SIZE_DEBUG)
         header.length = m_usedSize - header.length;
     #endif
-        memcpy(m_data.data()+m_packetBeingCreated, &header, sizeof(PacketHeader));
+        memcpy(m_packetBeingCreated, &header, sizeof(PacketHeader));
         m_packets++;
         // create new EOP
         newHeader();
       }
 
-      void initialize()
+      void initialize(size_t size)
       {
-        if (m_totalSize < sizeof(PacketHeader))
-        {
-          m_data.resize(sizeof(PacketHeader));
-          m_totalSize = m_data.size();
-        }
+        m_first = commandpages::acquire(size);
+        m_current = m_first;
+        m_currentUsed = 0;
+        m_usedSize = 0;
+        m_packets = 0;
+        m_totalSize = m_first->capacity;
         newHeader();
       }
 
+      void releasePages()
+      {
+        commandpages::release(m_first);
+        m_first = nullptr;
+        m_current = nullptr;
+        m_currentUsed = 0;
+        m_packetBeingCreated = nullptr;
+        m_totalSize = 0;
+        m_usedSize = 0;
+        m_packets = 0;
+      }
+
     public:
       class CommandBufferIterator
       {
@@ -180,14 +250,14 @@ namespace higanbana
         CommandBufferIterator& operator=(const CommandBufferIterator&) = default;
 
         CommandBufferIterator(PacketHeader* start)
-            : m_current{ start }
+            : m_current{ followLinks(start) }
         {
         }
 
         CommandBufferIterator& operator++(int)
         {
           size_t nextHeaderAddr = reinterpret_cast<size_t>(m_current) + m_current->offsetFromThis;
-          m_current = reinterpret_cast<PacketHeader*>(nextHeaderAddr);
+          m_current = followLinks(reinterpret_cast<PacketHeader*>(nextHeaderAddr));
           return *this;
         }
 
@@ -196,57 +266,64 @@ namespace higanbana
           return m_current;
         }
 
-        bool operator==(const CommandBufferIterator& it)
+        bool operator==(const CommandBufferIterator& it) const
         {
           return m_current == it.m_current;
         }
 
-        bool operator!=(const CommandBufferIterator& it)
+        bool operator!=(const CommandBufferIterator& it) const
         {
           return !operator==(it);
         }
       };
+      // size is the minimum capacity of the first page, small hints get a small page. growing never copies recorded packets
       CommandBuffer(size_t size = 10)
-        : m_data(size)
-        , m_totalSize(size)
-        , m_usedSize(0)
       {
         // minimum requirements is one packet which indicates end of packets.
-        initialize();
+        initialize(size);
         HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
       }
 
       CommandBuffer(CommandBuffer&& other) noexcept
-        : m_data(std::move(other.m_data))
-        , m_totalSize(std::move(other.m_totalSize))
-        , m_usedSize(std::move(other.m_usedSize))
-        , m_packetBeingCreated(std::move(other.m_packetBeingCreated))
+        : m_first(other.m_first)
+        , m_current(other.m_current)
+        , m_currentUsed(other.m_currentUsed)
+        , m_packetBeingCreated(other.m_packetBeingCreated)
+        , m_totalSize(other.m_totalSize)
+        , m_usedSize(other.m_usedSize)
         , m_packets(other.m_packets)
       {
-        HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
-        other.m_data.clear();
-        other.m_totalSize = 0;
-        other.m_usedSize = 0;
-        other.m_packetBeingCreated = 0;
-        other.m_packets = 0;
+        HIGAN_ASSERT(!m_first || packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
+        other.m_first = nullptr;
+        other.releasePages();
       }
 
       CommandBuffer& operator=(CommandBuffer&& other) noexcept
       {
-        m_data = std::move(other.m_data);
-        m_totalSize = std::move(other.m_totalSize);
-        m_usedSize = std::move(other.m_usedSize);
-        m_packetBeingCreated = std::move(other.m_packetBeingCreated);
+        if (this == &other)
+          return *this;
+        releasePages();
+        m_first = other.m_first;
+        m_current = other.m_current;
+        m_currentUsed = other.m_currentUsed;
+        m_packetBeingCreated = other.m_packetBeingCreated;
+        m_totalSize = other.m_totalSize;
+        m_usedSize = other.m_usedSize;
         m_packets = other.m_packets;
-        HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
-        other.m_data.clear();
-        other.m_totalSize = 0;
-        other.m_usedSize = 0;
-        other.m_packetBeingCreated = 0;
-        other.m_packets = 0;
+        HIGAN_ASSERT(!m_first || packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
+        other.m_first = nullptr;
+        other.releasePages();
         return *this;
       }
 
+      CommandBuffer(const CommandBuffer&) = delete;
+      CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+      ~CommandBuffer()
+      {
+        releasePages();
+      }
+
       size_t size() const
       {
         return m_packets;
@@ -259,22 +336,34 @@ namespace higanbana
 
       size_t maxSizeBytes() const
       {
-        return m_data.size();
+        return m_totalSize;
       }
-      CommandBufferIterator begin()
+      CommandBufferIterator begin() const
       {
-        return CommandBufferIterator(reinterpret_cast<PacketHeader*>(&m_data[0]));
+        return CommandBufferIterator(reinterpret_cast<PacketHeader*>(m_first->data()));
       }
 
-      CommandBufferIterator end()
+      CommandBufferIterator end() const
       {
-        return CommandBufferIterator(reinterpret_cast<PacketHeader*>(m_data.data()+m_packetBeingCreated));
+        return CommandBufferIterator(reinterpret_cast<PacketHeader*>(m_packetBeingCreated));
       }
 
+      // keeps the first page, rest go back to the pool for other lists to grow into
       void reset()
       {
+        if (!m_first)
+        {
+          initialize(0);
+          return;
+        }
+        commandpages::release(m_first->next);
+        m_first->next = nullptr;
+        m_current = m_first;
+        m_currentUsed = 0;
         m_usedSize = 0;
-        initialize();
+        m_packets = 0;
+        m_totalSize = m_first->capacity;
+        newHeader();
       }
 
       template <typename Object>
@@ -288,14 +377,15 @@ namespace higanbana
       uint8_t* allocateElements(PacketVectorHeader<Object>& hdr, size_t elements, PacketType& packetBegin)
       {
         auto offsetWithinStruct = reinterpret_cast<size_t>(&hdr) - reinterpret_cast<size_t>(&packetBegin);
-        auto actualHdrAddress = m_packetBeingCreated + sizeof(PacketHeader) + offsetWithinStruct;
         auto ptr = allocate(sizeof(Object) * elements);
+        // packet might have moved to a new page
+        auto actualHdrAddress = m_packetBeingCreated + sizeof(PacketHeader) + offsetWithinStruct;
         hdr.beginOffset = 0;
         hdr.elements = 0;
         if (ptr)
         {
           auto allocPtr = reinterpret_cast<size_t>(ptr);
-          auto packetPtr = reinterpret_cast<size_t>(m_data.data()+actualHdrAddress);
+          auto packetPtr = reinterpret_cast<size_t>(actualHdrAddress);
           hdr.beginOffset = static_cast<uint32_t>(allocPtr - packetPtr); // how many bytes from packetvectorheader to start of allocPtr
           hdr.elements = static_cast<uint32_t>(elements);
         }
@@ -308,63 +398,41 @@ namespace higanbana
         static_assert(std::is_standard_layout<Packet>::value, "Packets have to be in standard layout...");
         //static_assert(std::is_trivially_copyable<Packet>::value, "Packets have to be trivially copyable..."); 
         auto hdr = beginNewPacket(Packet::type);
-        auto ptr = allocate(sizeof(Packet));
-        size_t offset = reinterpret_cast<size_t>(ptr) - reinterpret_cast<size_t>(m_data.data());
+        allocate(sizeof(Packet));
         Packet packet = {};
         Packet::constructor(*this, packet, std::forward<Args>(args)...);
-        memcpy(m_data.data()+offset, &packet, sizeof(Packet));
+        // packet data always follows its header, wherever the header ended up
+        memcpy(m_packetBeingCreated + sizeof(PacketHeader), &packet, sizeof(Packet));
         endNewPacket(hdr);
       }
 
       template <typename Func>
       void foreach(Func&& func)
       {
-        PacketHeader* header = reinterpret_cast<PacketHeader*>(&m_data[0]);
-    #if defined(SIZE_DEBUG)
-        printf("%zu header info: %d %zu %u\n",reinterpret_cast<size_t>(header), header->type, header->length, header->offsetFromThis);
-    #endif
-        while (header->type != PacketType::EndOfPackets)
+        for (auto iter = begin(); (*iter)->type != PacketType::EndOfPackets; iter++)
         {
-          func(header->type);
-          size_t nextHeaderAddr = reinterpret_cast<size_t>(header) + header->offsetFromThis;
-          header = reinterpret_cast<PacketHeader*>(nextHeaderAddr);
+          PacketHeader* header = *iter;
     #if defined(SIZE_DEBUG)
           printf("%zu header info: %d %zu %u\n",reinterpret_cast<size_t>(header), header->type, header->length, header->offsetFromThis);
     #endif
+          func(header->type);
         }
       }
 
+      // copies packets one by one, they are repacked into this buffer's pages
       void append(const CommandBuffer& other)
       {
-        HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "sanity check");
-        auto newSize = m_data.size() + other.sizeBytes();
-        m_data.resize(newSize);
-#if VERIFY_PACKETS_ONE_BY_BY
-        auto copy = m_data;
-        for (int i = 0; i < m_usedSize; ++i)
-        {
-          HIGAN_ASSERT(copy[i] == m_data[i], "Data should be equal");
-        }
-#endif
         HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "Enforced EOP");
-        memcpy(m_data.data()+m_packetBeingCreated, other.m_data.data(), other.sizeBytes());
-#if VERIFY_PACKETS_ONE_BY_BY
-        auto copyOther = other.m_data;
-        for (int i = 0; i < other.m_usedSize; ++i)
-        {
-          auto offset = m_packetBeingCreated + i;
-          HIGAN_ASSERT(copyOther[i] == m_data[offset], "Data should be equal");
-        }
-        for (int i = 0; i < m_packetBeingCreated; ++i)
+        for (auto iter = other.begin(); (*iter)->type != PacketType::EndOfPackets; iter++)
         {
-          HIGAN_ASSERT(copy[i] == m_data[i], "Data should be equal");
+          PacketHeader* header = *iter;
+          size_t bytes = header->offsetFromThis;
+          allocate(bytes - sizeof(PacketHeader));
+          memcpy(m_packetBeingCreated, header, bytes);
+          m_packets++;
+          newHeader();
         }
-#endif
-        m_packetBeingCreated = m_packetBeingCreated + other.m_packetBeingCreated; 
         HIGAN_ASSERT(packetBeingCreated().type == PacketType::EndOfPackets, "Enforced EOP");
-        m_usedSize += other.m_usedSize - sizeof(PacketHeader);
-        m_totalSize += other.m_usedSize - sizeof(PacketHeader);
-        m_packets += other.m_packets;
       }
     };
   }
@@ -3,6 +3,9 @@
 #include "higanbana/graphics/vk/vkresources.hpp"
 #include "higanbana/graphics/vk/vkdevice.hpp"
 #include "higanbana/graphics/vk/vksubsystem.hpp"
+#include "higanbana/graphics/null/nullresources.hpp"
+#include "higanbana/graphics/null/nulldevice.hpp"
+#include "higanbana/graphics/null/nullsubsystem.hpp"
 #if defined(HIGANBANA_PLATFORM_WINDOWS)
 #include "higanbana/graphics/dx12/dx12resources.hpp"
 #include "higanbana/graphics/dx12/dx12device.hpp"
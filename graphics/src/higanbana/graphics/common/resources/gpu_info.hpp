@@ -19,6 +19,7 @@ struct GpuInfo
   bool canMeshshader = false;
   bool canVariableRate = false;
   bool forceCompileShaders = false;
+  PipelineCompilation pipelineCompilation = PipelineCompilation::WaitOnBind; // Vulkan only
   GraphicsApi api = GraphicsApi::All;
   uint32_t apiVersion = 0;
   std::string apiVersionStr = "";
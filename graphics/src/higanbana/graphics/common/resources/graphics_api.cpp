@@ -6,6 +6,8 @@ namespace higanbana
   {
     if (api == GraphicsApi::DX12)
       return "DX12";
+    if (api == GraphicsApi::Null)
+      return "Null";
     return "Vulkan";
   }
   const char* toString(VendorID id)
@@ -9,6 +9,7 @@ namespace higanbana
 	  All,
     Vulkan,
     DX12,
+    Null, // cpu only, never part of All
   };
 
   const char* toString(GraphicsApi api);
@@ -55,6 +56,12 @@ namespace higanbana
     Unsequenced
   };
 
+  enum class PipelineCompilation
+  {
+    WaitOnBind, // built on worker threads, recording waits for the pipelines it binds
+    SkipUntilReady // draws and dispatches on unfinished pipelines are dropped, reloads keep using the old pipeline
+  };
+
   enum class PresentMode
   {
     Unknown,
@@ -12,6 +12,7 @@ namespace higanbana
     SubsystemData::SubsystemData(GraphicsApi allowedApi, const char* appName, bool debugLayer, unsigned appVersion, const char* engineName, unsigned engineVersion)
       : implDX12(nullptr)
       , implVulkan(nullptr)
+      , implNull(nullptr)
       , appName(appName)
       , appVersion(appVersion)
       , engineName(engineName)
@@ -27,6 +28,11 @@ namespace higanbana
       {
         implVulkan = std::make_shared<VulkanSubsystem>(appName, appVersion, engineName, engineVersion, debugLayer);
       }
+      // only on request, it would otherwise compete with real gpus
+      if (allowedApi == GraphicsApi::Null)
+      {
+        implNull = std::make_shared<NullSubsystem>();
+      }
     }
     vector<GpuInfo> SubsystemData::availableGpus(GraphicsApi api, VendorID id, QueryDevicesMode mode)
     {
@@ -56,6 +62,11 @@ namespace higanbana
               m_cachedInfos.push_back(it);
           }
         }
+        if (implNull && (api == GraphicsApi::Null || api == GraphicsApi::All))
+        {
+          for (auto&& it : implNull->availableGpus(VendorID::All))
+            m_cachedInfos.push_back(it);
+        }
       }
 
       // craft filtered version of all devices here as per request
@@ -89,11 +100,16 @@ namespace higanbana
           cop.api = GraphicsApi::Vulkan;
           infos.push_back(cop);
         }
+        if (implNull && info.api == GraphicsApi::Null) {
+          devices.push_back(implNull->createGpuDevice(fs, info));
+          infos.push_back(info);
+        }
       }
       return GpuGroup({devices, infos});
     }
     GraphicsSurface SubsystemData::createSurface(Window & window, GpuInfo gpu)
     {
+      if (implNull && gpu.api == GraphicsApi::Null) return implNull->createSurface(window);
       if (implDX12 && (gpu.api == GraphicsApi::DX12 || gpu.api == GraphicsApi::All)) return implDX12->createSurface(window);
       return implVulkan->createSurface(window);
     }
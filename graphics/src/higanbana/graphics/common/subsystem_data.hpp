@@ -17,6 +17,7 @@ namespace higanbana
     {
       std::shared_ptr<prototypes::SubsystemImpl> implDX12;
       std::shared_ptr<prototypes::SubsystemImpl> implVulkan;
+      std::shared_ptr<prototypes::SubsystemImpl> implNull;
       const char* appName;
       unsigned appVersion;
       const char* engineName;
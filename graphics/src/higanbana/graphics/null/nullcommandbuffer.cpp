@@ -0,0 +1,56 @@
+#include "higanbana/graphics/null/nullresources.hpp"
+#include "higanbana/graphics/common/barrier_solver.hpp"
+#include <higanbana/core/profiling/profiling.hpp>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    void NullCommandBuffer::reserveConstants(size_t)
+    {
+    }
+
+    void NullCommandBuffer::fillWith(std::shared_ptr<prototypes::DeviceImpl>, MemView<backend::CommandBuffer*>& buffers, BarrierSolver& solver)
+    {
+      HIGAN_CPU_BRACKET("compile to Null CmdList");
+      // same walk as the real backends so the solver's per draw work is part of the cost
+      int drawIndex = 0;
+      size_t barrierInfoIndex = 0;
+      auto& barrierInfos = solver.barrierInfos();
+      m_packets = 0;
+      m_barriers = 0;
+      for (auto&& list : buffers)
+      {
+        for (auto iter = list->begin(); (*iter)->type != PacketType::EndOfPackets; iter++)
+        {
+          if (barrierInfoIndex < barrierInfos.size() && barrierInfos[barrierInfoIndex].drawcall == drawIndex)
+          {
+            auto barriers = solver.runBarrier(barrierInfos[barrierInfoIndex]);
+            m_barriers += barriers.buffers.size() + barriers.textures.size();
+            barrierInfoIndex++;
+          }
+          ++m_packets;
+          drawIndex++;
+        }
+      }
+    }
+
+    bool NullCommandBuffer::readbackTimestamps(std::shared_ptr<prototypes::DeviceImpl>, vector<GraphNodeTiming>&)
+    {
+      // no gpu, no gpu timings
+      return false;
+    }
+
+    void NullCommandBuffer::beginConstantsDmaList(std::shared_ptr<prototypes::DeviceImpl>)
+    {
+    }
+
+    void NullCommandBuffer::addConstants(CommandBufferImpl*)
+    {
+    }
+
+    void NullCommandBuffer::endConstantsDmaList()
+    {
+    }
+  }
+}
@@ -0,0 +1,434 @@
+#include "higanbana/graphics/null/nulldevice.hpp"
+#include "higanbana/graphics/common/graphicssurface.hpp"
+#include "higanbana/graphics/common/raytracing_descriptors.hpp"
+#include "higanbana/graphics/common/shader_arguments_descriptor.hpp"
+#include "higanbana/graphics/common/heap_descriptor.hpp"
+#include "higanbana/graphics/common/helpers/memory_requirements.hpp"
+#include "higanbana/graphics/common/helpers/heap_allocation.hpp"
+#include "higanbana/graphics/common/helpers/shared_handle.hpp"
+#include "higanbana/graphics/desc/device_stats.hpp"
+#include "higanbana/graphics/desc/formats.hpp"
+#include <higanbana/core/system/bitpacking.hpp>
+#include <higanbana/core/math/utils.hpp>
+#include <higanbana/core/profiling/profiling.hpp>
+#include <higanbana/core/global_debug.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    NullDevice::NullDevice(GpuInfo info, std::chrono::nanoseconds simulatedLatency)
+      : m_info(info)
+      , m_simulatedLatency(simulatedLatency)
+    {
+    }
+
+    uint64_t NullDevice::submitCount()
+    {
+      std::lock_guard<std::mutex> guard(m_queueLock);
+      return m_submits;
+    }
+
+    DeviceStatistics NullDevice::statsOfResourcesInUse()
+    {
+      DeviceStatistics stats = {};
+      if (m_constants)
+      {
+        stats.maxConstantsUploadMemory = m_constants->max_size();
+        stats.constantsUploadMemoryInUse = m_constants->size_allocated();
+      }
+      std::lock_guard<std::mutex> guard(m_resourceLock);
+      stats.gpuMemoryAllocated = m_heapMemory;
+      stats.gpuTotalMemory = static_cast<uint64_t>(std::max<int64_t>(m_info.memory, 0));
+      return stats;
+    }
+
+    std::shared_ptr<prototypes::SwapchainImpl> NullDevice::createSwapchain(GraphicsSurface& surface, SwapchainDescriptor descriptor)
+    {
+      auto native = std::static_pointer_cast<NullGraphicsSurface>(surface.native());
+      return std::make_shared<NullSwapchain>(native->size, descriptor);
+    }
+
+    void NullDevice::adjustSwapchain(std::shared_ptr<prototypes::SwapchainImpl> sc, SwapchainDescriptor descriptor)
+    {
+      std::static_pointer_cast<NullSwapchain>(sc)->adjust(descriptor);
+    }
+
+    int NullDevice::fetchSwapchainTextures(std::shared_ptr<prototypes::SwapchainImpl> sc, vector<ResourceHandle>&)
+    {
+      return std::static_pointer_cast<NullSwapchain>(sc)->bufferCount();
+    }
+
+    int NullDevice::tryAcquirePresentableImage(std::shared_ptr<prototypes::SwapchainImpl> swapchain)
+    {
+      return std::static_pointer_cast<NullSwapchain>(swapchain)->acquire();
+    }
+
+    int NullDevice::acquirePresentableImage(std::shared_ptr<prototypes::SwapchainImpl> swapchain)
+    {
+      return std::static_pointer_cast<NullSwapchain>(swapchain)->acquire();
+    }
+
+    void NullDevice::releaseHandle(ResourceHandle handle)
+    {
+      std::lock_guard<std::mutex> guard(m_resourceLock);
+      if (handle.type == ResourceType::ReadbackBuffer)
+      {
+        m_readbacks[handle] = vector<uint8_t>();
+      }
+      else if (handle.type == ResourceType::MemoryHeap)
+      {
+        m_heapMemory -= m_heapSizes[handle];
+        m_heapSizes[handle] = 0;
+      }
+    }
+
+    void NullDevice::releaseViewHandle(ViewResourceHandle)
+    {
+    }
+
+    void NullDevice::waitGpuIdle()
+    {
+      NullClock::time_point idle;
+      {
+        std::lock_guard<std::mutex> guard(m_queueLock);
+        idle = std::max({m_dmaFree, m_computeFree, m_graphicsFree});
+      }
+      std::this_thread::sleep_until(idle);
+    }
+
+    MemoryRequirements NullDevice::getReqs(ResourceDescriptor desc)
+    {
+      auto& d = desc.desc;
+      MemoryRequirements reqs{};
+      reqs.alignment = 64 * 1024;
+      if (d.dimension == FormatDimension::Buffer)
+      {
+        reqs.alignment = 256;
+        size_t stride = std::max<size_t>(d.stride, 1);
+        reqs.bytes = d.usage == ResourceUsage::RTAccelerationStructure ? d.width : d.width * stride;
+      }
+      else
+      {
+        size_t pixelSize = std::max(formatSizeInfo(d.format).pixelSize, 1);
+        size_t bytes = 0;
+        for (unsigned mip = 0; mip < std::max(d.miplevels, 1u); ++mip)
+        {
+          size_t width = std::max<uint64_t>(d.width >> mip, 1);
+          size_t height = std::max(d.height >> mip, 1u);
+          size_t depth = std::max(d.depth >> mip, 1u);
+          bytes += width * height * depth * pixelSize;
+        }
+        reqs.bytes = bytes * std::max(d.arraySize, 1u) * std::max(d.msCount, 1u);
+      }
+      reqs.bytes = static_cast<size_t>(roundUpMultipleInt(std::max<size_t>(reqs.bytes, 1), reqs.alignment));
+
+      HeapType type = HeapType::Default;
+      if (d.usage == ResourceUsage::Upload)
+        type = HeapType::Upload;
+      else if (d.usage == ResourceUsage::Readback)
+        type = HeapType::Readback;
+      reqs.heapType = packInt64(0, static_cast<int32_t>(type));
+      return reqs;
+    }
+
+    void NullDevice::createRenderpass(ResourceHandle)
+    {
+    }
+
+    void NullDevice::createPipeline(ResourceHandle, GraphicsPipelineDescriptor)
+    {
+    }
+
+    void NullDevice::createPipeline(ResourceHandle, ComputePipelineDescriptor)
+    {
+    }
+
+    void NullDevice::createPipeline(ResourceHandle, RaytracingPipelineDescriptor)
+    {
+    }
+
+    void NullDevice::createHeap(ResourceHandle handle, HeapDescriptor desc)
+    {
+      std::lock_guard<std::mutex> guard(m_resourceLock);
+      m_heapSizes[handle] = desc.desc.sizeInBytes;
+      m_heapMemory += desc.desc.sizeInBytes;
+    }
+
+    void NullDevice::createBuffer(ResourceHandle, ResourceDescriptor&)
+    {
+    }
+
+    void NullDevice::createBuffer(ResourceHandle, HeapAllocation, ResourceDescriptor&)
+    {
+    }
+
+    void NullDevice::createBufferView(ViewResourceHandle, ResourceHandle, ResourceDescriptor&, ShaderViewDescriptor&)
+    {
+    }
+
+    void NullDevice::createTexture(ResourceHandle, ResourceDescriptor&)
+    {
+    }
+
+    void NullDevice::createTexture(ResourceHandle, HeapAllocation, ResourceDescriptor&)
+    {
+    }
+
+    void NullDevice::createTextureView(ViewResourceHandle, ResourceHandle, ResourceDescriptor&, ShaderViewDescriptor&)
+    {
+    }
+
+    void NullDevice::createShaderArgumentsLayout(ResourceHandle, ShaderArgumentsLayoutDescriptor&)
+    {
+    }
+
+    void NullDevice::createShaderArguments(ResourceHandle, ShaderArgumentsDescriptor&)
+    {
+    }
+
+    std::shared_ptr<TimelineSemaphoreImpl> NullDevice::createSharedSemaphore()
+    {
+      return createTimelineSemaphore();
+    }
+
+    std::shared_ptr<SharedHandle> NullDevice::openSharedHandle(std::shared_ptr<TimelineSemaphoreImpl>)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+      return nullptr;
+    }
+
+    std::shared_ptr<SharedHandle> NullDevice::openSharedHandle(HeapAllocation)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+      return nullptr;
+    }
+
+    std::shared_ptr<SharedHandle> NullDevice::openSharedHandle(ResourceHandle)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+      return nullptr;
+    }
+
+    std::shared_ptr<SharedHandle> NullDevice::openForInteropt(ResourceHandle)
+    {
+      return nullptr;
+    }
+
+    std::shared_ptr<TimelineSemaphoreImpl> NullDevice::createSemaphoreFromHandle(std::shared_ptr<SharedHandle>)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+      return nullptr;
+    }
+
+    void NullDevice::createHeapFromHandle(ResourceHandle, std::shared_ptr<SharedHandle>)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+    }
+
+    void NullDevice::createBufferFromHandle(ResourceHandle, std::shared_ptr<SharedHandle>, HeapAllocation, ResourceDescriptor&)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+    }
+
+    void NullDevice::createTextureFromHandle(ResourceHandle, std::shared_ptr<SharedHandle>, ResourceDescriptor&)
+    {
+      HIGAN_ASSERT(false, "Null backend doesn't share resources with other devices.");
+    }
+
+    size_t NullDevice::availableDynamicMemory()
+    {
+      // dynamic data isn't kept, nothing runs out
+      return 256 * 1024 * 1024;
+    }
+
+    void NullDevice::dynamic(ViewResourceHandle, MemView<uint8_t>, FormatType)
+    {
+    }
+
+    void NullDevice::dynamic(ViewResourceHandle, MemView<uint8_t>, unsigned)
+    {
+    }
+
+    void NullDevice::dynamicImage(ViewResourceHandle, MemView<uint8_t>, unsigned)
+    {
+    }
+
+    void NullDevice::readbackBuffer(ResourceHandle readback, size_t bytes)
+    {
+      std::lock_guard<std::mutex> guard(m_resourceLock);
+      m_readbacks[readback] = vector<uint8_t>(bytes, 0);
+    }
+
+    MemView<uint8_t> NullDevice::mapReadback(ResourceHandle readback)
+    {
+      std::lock_guard<std::mutex> guard(m_resourceLock);
+      return MemView<uint8_t>(m_readbacks[readback]);
+    }
+
+    void NullDevice::unmapReadback(ResourceHandle)
+    {
+    }
+
+    std::shared_ptr<CommandBufferImpl> NullDevice::createDMAList()
+    {
+      return std::make_shared<NullCommandBuffer>(QueueType::Dma);
+    }
+
+    std::shared_ptr<CommandBufferImpl> NullDevice::createComputeList()
+    {
+      return std::make_shared<NullCommandBuffer>(QueueType::Compute);
+    }
+
+    std::shared_ptr<CommandBufferImpl> NullDevice::createGraphicsList()
+    {
+      return std::make_shared<NullCommandBuffer>(QueueType::Graphics);
+    }
+
+    std::shared_ptr<SemaphoreImpl> NullDevice::createSemaphore()
+    {
+      return std::make_shared<NullSemaphore>();
+    }
+
+    std::shared_ptr<FenceImpl> NullDevice::createFence()
+    {
+      return std::make_shared<NullFence>();
+    }
+
+    std::shared_ptr<TimelineSemaphoreImpl> NullDevice::createTimelineSemaphore()
+    {
+      return std::make_shared<NullTimelineSemaphore>();
+    }
+
+    std::shared_ptr<ConstantsAllocator> NullDevice::createConstantsAllocator(size_t size)
+    {
+      m_constants = std::make_shared<NullConstantsAllocator>(size);
+      return m_constants;
+    }
+
+    void NullDevice::submit(NullClock::time_point& queueFree,
+      MemView<std::shared_ptr<CommandBufferImpl>>,
+      MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+      MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+      MemView<TimelineSemaphoreInfo> waitTimelines,
+      MemView<TimelineSemaphoreInfo> signalTimelines,
+      std::optional<std::shared_ptr<FenceImpl>>   fence)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      // work starts once the queue is free and everything waited on is done
+      NullClock::time_point start = NullClock::now();
+      for (auto&& sema : waitTimelines)
+      {
+        auto native = static_cast<NullTimelineSemaphore*>(sema.semaphore);
+        // not signaled yet means a later submit will, which can't finish before this one starts anyway
+        if (auto ready = native->readyAt(sema.value))
+          start = std::max(start, ready.value());
+      }
+      for (auto&& sema : wait)
+      {
+        if (sema)
+          start = std::max(start, std::static_pointer_cast<NullSemaphore>(sema)->readyAt.get());
+      }
+
+      NullClock::time_point done;
+      {
+        std::lock_guard<std::mutex> guard(m_queueLock);
+        done = std::max(start, queueFree) + m_simulatedLatency;
+        queueFree = done;
+        ++m_submits;
+      }
+
+      for (auto&& sema : signal)
+      {
+        if (sema)
+          std::static_pointer_cast<NullSemaphore>(sema)->readyAt.set(done);
+      }
+      for (auto&& sema : signalTimelines)
+      {
+        static_cast<NullTimelineSemaphore*>(sema.semaphore)->signal(sema.value, done);
+      }
+      if (fence && fence.value())
+      {
+        std::static_pointer_cast<NullFence>(fence.value())->readyAt.set(done);
+      }
+    }
+
+    void NullDevice::submitDMA(
+      MemView<std::shared_ptr<CommandBufferImpl>> lists,
+      MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+      MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+      MemView<TimelineSemaphoreInfo> waitTimelines,
+      MemView<TimelineSemaphoreInfo> signalTimelines,
+      std::optional<std::shared_ptr<FenceImpl>>   fence)
+    {
+      submit(m_dmaFree, lists, wait, signal, waitTimelines, signalTimelines, fence);
+    }
+
+    void NullDevice::submitCompute(
+      MemView<std::shared_ptr<CommandBufferImpl>> lists,
+      MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+      MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+      MemView<TimelineSemaphoreInfo> waitTimelines,
+      MemView<TimelineSemaphoreInfo> signalTimelines,
+      std::optional<std::shared_ptr<FenceImpl>>   fence)
+    {
+      submit(m_computeFree, lists, wait, signal, waitTimelines, signalTimelines, fence);
+    }
+
+    void NullDevice::submitGraphics(
+      MemView<std::shared_ptr<CommandBufferImpl>> lists,
+      MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+      MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+      MemView<TimelineSemaphoreInfo> waitTimelines,
+      MemView<TimelineSemaphoreInfo> signalTimelines,
+      std::optional<std::shared_ptr<FenceImpl>>   fence)
+    {
+      submit(m_graphicsFree, lists, wait, signal, waitTimelines, signalTimelines, fence);
+    }
+
+    void NullDevice::waitFence(std::shared_ptr<FenceImpl> fence)
+    {
+      std::this_thread::sleep_until(std::static_pointer_cast<NullFence>(fence)->readyAt.get());
+    }
+
+    bool NullDevice::checkFence(std::shared_ptr<FenceImpl> fence)
+    {
+      return std::static_pointer_cast<NullFence>(fence)->readyAt.get() <= NullClock::now();
+    }
+
+    uint64_t NullDevice::completedValue(std::shared_ptr<TimelineSemaphoreImpl> tlSema)
+    {
+      return std::static_pointer_cast<NullTimelineSemaphore>(tlSema)->completed(NullClock::now());
+    }
+
+    void NullDevice::waitTimeline(std::shared_ptr<TimelineSemaphoreImpl> tlSema, uint64_t value)
+    {
+      auto native = std::static_pointer_cast<NullTimelineSemaphore>(tlSema);
+      auto ready = native->readyAt(value);
+      // like a real device, blocks until someone submits the signal
+      while (!ready)
+      {
+        std::this_thread::yield();
+        ready = native->readyAt(value);
+      }
+      std::this_thread::sleep_until(ready.value());
+    }
+
+    void NullDevice::present(std::shared_ptr<prototypes::SwapchainImpl>, std::shared_ptr<SemaphoreImpl>, int)
+    {
+    }
+
+    desc::RaytracingASPreBuildInfo NullDevice::accelerationStructurePrebuildInfo(const desc::RaytracingAccelerationStructureInputs& desc)
+    {
+      // rough guess in the ballpark of what drivers report, enough to size buffers
+      uint64_t primitives = desc.desc.instanceCount;
+      for (auto&& triangles : desc.desc.triangles)
+        primitives += std::max(triangles.indexCount, triangles.vertexCount) / 3;
+      uint64_t bytes = static_cast<uint64_t>(roundUpMultipleInt(std::max<uint64_t>(primitives, 1) * 128, 256));
+      return desc::RaytracingASPreBuildInfo{bytes, bytes / 2, bytes / 4};
+    }
+  }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "higanbana/graphics/null/nullresources.hpp"
+#include "higanbana/graphics/common/resources/gpu_info.hpp"
+#include "higanbana/graphics/common/handle.hpp"
+
+#include <chrono>
+#include <mutex>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    class NullDevice : public prototypes::DeviceImpl
+    {
+    private:
+      GpuInfo m_info;
+      // how long each submit takes on its queue, zero completes at submit
+      std::chrono::nanoseconds m_simulatedLatency;
+
+      // queues run their submits in order, this is when each one becomes idle
+      std::mutex m_queueLock;
+      NullClock::time_point m_dmaFree = {};
+      NullClock::time_point m_computeFree = {};
+      NullClock::time_point m_graphicsFree = {};
+      uint64_t m_submits = 0;
+
+      std::mutex m_resourceLock;
+      HandleVector<vector<uint8_t>> m_readbacks;
+      HandleVector<uint64_t> m_heapSizes;
+      uint64_t m_heapMemory = 0;
+
+      std::shared_ptr<NullConstantsAllocator> m_constants;
+
+      void submit(NullClock::time_point& queueFree,
+        MemView<std::shared_ptr<CommandBufferImpl>> lists,
+        MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+        MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+        MemView<TimelineSemaphoreInfo> waitTimelines,
+        MemView<TimelineSemaphoreInfo> signalTimelines,
+        std::optional<std::shared_ptr<FenceImpl>>   fence);
+    public:
+      NullDevice(GpuInfo info, std::chrono::nanoseconds simulatedLatency = std::chrono::nanoseconds(0));
+
+      std::chrono::nanoseconds simulatedLatency() const { return m_simulatedLatency; }
+      uint64_t submitCount();
+
+      DeviceStatistics statsOfResourcesInUse() override;
+
+      std::shared_ptr<prototypes::SwapchainImpl> createSwapchain(GraphicsSurface& surface, SwapchainDescriptor descriptor) override;
+      void adjustSwapchain(std::shared_ptr<prototypes::SwapchainImpl> sc, SwapchainDescriptor descriptor) override;
+      int fetchSwapchainTextures(std::shared_ptr<prototypes::SwapchainImpl> sc, vector<ResourceHandle>& handles) override;
+      int tryAcquirePresentableImage(std::shared_ptr<prototypes::SwapchainImpl> swapchain) override;
+      int acquirePresentableImage(std::shared_ptr<prototypes::SwapchainImpl> swapchain) override;
+
+      void releaseHandle(ResourceHandle handle) override;
+      void releaseViewHandle(ViewResourceHandle handle) override;
+      void waitGpuIdle() override;
+      MemoryRequirements getReqs(ResourceDescriptor desc) override;
+
+      void createRenderpass(ResourceHandle handle) override;
+      void createPipeline(ResourceHandle handle, GraphicsPipelineDescriptor desc) override;
+      void createPipeline(ResourceHandle handle, ComputePipelineDescriptor desc) override;
+      void createPipeline(ResourceHandle handle, RaytracingPipelineDescriptor desc) override;
+
+      void createHeap(ResourceHandle handle, HeapDescriptor desc) override;
+
+      void createBuffer(ResourceHandle handle, ResourceDescriptor& desc) override;
+      void createBuffer(ResourceHandle handle, HeapAllocation allocation, ResourceDescriptor& desc) override;
+      void createBufferView(ViewResourceHandle handle, ResourceHandle buffer, ResourceDescriptor& desc, ShaderViewDescriptor& viewDesc) override;
+      void createTexture(ResourceHandle handle, ResourceDescriptor& desc) override;
+      void createTexture(ResourceHandle handle, HeapAllocation allocation, ResourceDescriptor& desc) override;
+      void createTextureView(ViewResourceHandle handle, ResourceHandle texture, ResourceDescriptor& desc, ShaderViewDescriptor& viewDesc) override;
+
+      void createShaderArgumentsLayout(ResourceHandle handle, ShaderArgumentsLayoutDescriptor& desc) override;
+      void createShaderArguments(ResourceHandle handle, ShaderArgumentsDescriptor& binding) override;
+
+      std::shared_ptr<TimelineSemaphoreImpl> createSharedSemaphore() override;
+
+      std::shared_ptr<SharedHandle> openSharedHandle(std::shared_ptr<TimelineSemaphoreImpl>) override;
+      std::shared_ptr<SharedHandle> openSharedHandle(HeapAllocation) override;
+      std::shared_ptr<SharedHandle> openSharedHandle(ResourceHandle handle) override;
+      std::shared_ptr<SharedHandle> openForInteropt(ResourceHandle resource) override;
+      std::shared_ptr<TimelineSemaphoreImpl> createSemaphoreFromHandle(std::shared_ptr<SharedHandle>) override;
+      void createHeapFromHandle(ResourceHandle handle, std::shared_ptr<SharedHandle> shared) override;
+      void createBufferFromHandle(ResourceHandle, std::shared_ptr<SharedHandle>, HeapAllocation, ResourceDescriptor&) override;
+      void createTextureFromHandle(ResourceHandle, std::shared_ptr<SharedHandle>, ResourceDescriptor&) override;
+
+      size_t availableDynamicMemory() override;
+      void dynamic(ViewResourceHandle handle, MemView<uint8_t> bytes, FormatType format) override;
+      void dynamic(ViewResourceHandle handle, MemView<uint8_t> bytes, unsigned stride) override;
+      void dynamicImage(ViewResourceHandle handle, MemView<uint8_t> bytes, unsigned rowPitch) override;
+
+      void readbackBuffer(ResourceHandle readback, size_t bytes) override;
+      MemView<uint8_t> mapReadback(ResourceHandle readback) override;
+      void unmapReadback(ResourceHandle readback) override;
+
+      std::shared_ptr<CommandBufferImpl> createDMAList() override;
+      std::shared_ptr<CommandBufferImpl> createComputeList() override;
+      std::shared_ptr<CommandBufferImpl> createGraphicsList() override;
+      std::shared_ptr<SemaphoreImpl>     createSemaphore() override;
+      std::shared_ptr<FenceImpl>         createFence() override;
+      std::shared_ptr<TimelineSemaphoreImpl> createTimelineSemaphore() override;
+      std::shared_ptr<ConstantsAllocator> createConstantsAllocator(size_t size) override;
+
+      void submitDMA(
+        MemView<std::shared_ptr<CommandBufferImpl>> lists,
+        MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+        MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+        MemView<TimelineSemaphoreInfo> waitTimelines,
+        MemView<TimelineSemaphoreInfo> signaltimelines,
+        std::optional<std::shared_ptr<FenceImpl>>   fence) override;
+
+      void submitCompute(
+        MemView<std::shared_ptr<CommandBufferImpl>> lists,
+        MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+        MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+        MemView<TimelineSemaphoreInfo> waitTimelines,
+        MemView<TimelineSemaphoreInfo> signaltimelines,
+        std::optional<std::shared_ptr<FenceImpl>>   fence) override;
+
+      void submitGraphics(
+        MemView<std::shared_ptr<CommandBufferImpl>> lists,
+        MemView<std::shared_ptr<SemaphoreImpl>>     wait,
+        MemView<std::shared_ptr<SemaphoreImpl>>     signal,
+        MemView<TimelineSemaphoreInfo> waitTimelines,
+        MemView<TimelineSemaphoreInfo> signaltimelines,
+        std::optional<std::shared_ptr<FenceImpl>>   fence) override;
+
+      void waitFence(std::shared_ptr<FenceImpl> fence) override;
+      bool checkFence(std::shared_ptr<FenceImpl> fence) override;
+      uint64_t completedValue(std::shared_ptr<TimelineSemaphoreImpl> tlSema) override;
+      void waitTimeline(std::shared_ptr<TimelineSemaphoreImpl> tlSema, uint64_t value) override;
+
+      void present(std::shared_ptr<prototypes::SwapchainImpl> swapchain, std::shared_ptr<SemaphoreImpl> renderingFinished, int index) override;
+
+      desc::RaytracingASPreBuildInfo accelerationStructurePrebuildInfo(const desc::RaytracingAccelerationStructureInputs& desc) override;
+    };
+  }
+}
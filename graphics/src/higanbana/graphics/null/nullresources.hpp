@@ -0,0 +1,253 @@
+#pragma once
+#include "higanbana/graphics/common/prototypes.hpp"
+#include "higanbana/graphics/common/resources.hpp"
+#include "higanbana/graphics/common/command_packets.hpp"
+#include "higanbana/graphics/common/command_buffer.hpp"
+#include "higanbana/graphics/common/allocators.hpp"
+#include "higanbana/graphics/common/resource_descriptor.hpp"
+#include <higanbana/core/system/heap_allocator.hpp>
+#include <higanbana/core/datastructures/deque.hpp>
+#include <higanbana/core/global_debug.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Headless backend, everything happens on the cpu. Commandlists are walked and barriers solved like
+// the real backends do, but nothing is recorded. Queues complete work right away or after a simulated delay.
+namespace higanbana
+{
+  namespace backend
+  {
+    using NullClock = std::chrono::steady_clock;
+
+    // set by submit, read by waits from any thread
+    class NullReadyTime
+    {
+      std::atomic<NullClock::rep> m_ticks = 0;
+    public:
+      void set(NullClock::time_point time)
+      {
+        m_ticks.store(time.time_since_epoch().count(), std::memory_order_release);
+      }
+
+      NullClock::time_point get() const
+      {
+        return NullClock::time_point(NullClock::duration(m_ticks.load(std::memory_order_acquire)));
+      }
+    };
+
+    class NullSemaphore : public SemaphoreImpl
+    {
+    public:
+      NullReadyTime readyAt;
+    };
+
+    class NullFence : public FenceImpl
+    {
+    public:
+      NullReadyTime readyAt;
+    };
+
+    class NullTimelineSemaphore : public TimelineSemaphoreImpl
+    {
+      struct Pending
+      {
+        uint64_t value;
+        NullClock::time_point readyAt;
+      };
+      std::mutex m_lock;
+      uint64_t m_completed = 0;
+      uint64_t m_signaled = 0;
+      deque<Pending> m_pending;
+
+      void retire(NullClock::time_point now)
+      {
+        while (!m_pending.empty() && m_pending.front().readyAt <= now)
+        {
+          m_completed = m_pending.front().value;
+          m_pending.pop_front();
+        }
+      }
+    public:
+      void signal(uint64_t value, NullClock::time_point readyAt)
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        HIGAN_ASSERT(value > m_signaled, "timeline values have to grow, %zu after %zu", value, m_signaled);
+        m_signaled = value;
+        // a queue finishes in order, a later signal can't complete before an earlier one
+        if (!m_pending.empty() && m_pending.back().readyAt > readyAt)
+          readyAt = m_pending.back().readyAt;
+        m_pending.push_back(Pending{value, readyAt});
+      }
+
+      uint64_t completed(NullClock::time_point now)
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        retire(now);
+        return m_completed;
+      }
+
+      // when the value is reached, nullopt if nothing has signaled it yet
+      std::optional<NullClock::time_point> readyAt(uint64_t value)
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (value <= m_completed)
+          return NullClock::time_point{};
+        for (auto&& pending : m_pending)
+          if (pending.value >= value)
+            return pending.readyAt;
+        return {};
+      }
+    };
+
+    class NullGraphicsSurface : public prototypes::GraphicsSurfaceImpl
+    {
+    public:
+      int2 size;
+      NullGraphicsSurface(int2 size)
+        : size(size)
+      {}
+    };
+
+    class NullSwapchain : public prototypes::SwapchainImpl
+    {
+      int2 m_size;
+      SwapchainDescriptor m_descriptor;
+      int m_backbufferIndex = 0;
+    public:
+      NullSwapchain(int2 size, SwapchainDescriptor descriptor)
+        : m_size(size)
+        , m_descriptor(descriptor)
+      {}
+
+      void adjust(SwapchainDescriptor descriptor)
+      {
+        m_descriptor = descriptor;
+        m_backbufferIndex = 0;
+      }
+
+      int bufferCount() const { return m_descriptor.desc.bufferCount; }
+
+      int acquire()
+      {
+        int index = m_backbufferIndex;
+        m_backbufferIndex = (m_backbufferIndex + 1) % bufferCount();
+        return index;
+      }
+
+      ResourceDescriptor desc() override
+      {
+        return ResourceDescriptor()
+          .setWidth(m_size.x)
+          .setHeight(m_size.y)
+          .setFormat(m_descriptor.desc.format)
+          .setUsage(ResourceUsage::RenderTarget)
+          .setDimension(FormatDimension::Texture2D)
+          .setMiplevels(1)
+          .setArraySize(1)
+          .setName("Swapchain Image")
+          .setDepth(1);
+      }
+      int getCurrentPresentableImageIndex() override { return m_backbufferIndex; }
+      std::shared_ptr<SemaphoreImpl> acquireSemaphore() override { return nullptr; }
+      std::shared_ptr<SemaphoreImpl> renderSemaphore() override { return nullptr; }
+      bool HDRSupport() override { return false; }
+      DisplayCurve displayCurve() override { return DisplayCurve::sRGB; }
+      bool outOfDate() override { return false; }
+    };
+
+    class NullLinearConstantsAllocator : public LinearConstantsAllocator
+    {
+      LinearAllocator m_allocator;
+      uint8_t* m_data;
+      RangeBlock m_block;
+    public:
+      NullLinearConstantsAllocator(uint8_t* data, RangeBlock block)
+        : m_allocator(block.size)
+        , m_data(data)
+        , m_block(block)
+      {}
+
+      ConstantsBlock allocate(size_t bytes) override
+      {
+        auto offset = m_allocator.allocate(bytes, 256);
+        if (offset < 0)
+          return ConstantsBlock{0ull, nullptr};
+        return ConstantsBlock{m_block.offset + offset, m_data + m_block.offset + offset};
+      }
+
+      RangeBlock block() const { return m_block; }
+    };
+
+    class NullConstantsAllocator : public ConstantsAllocator
+    {
+      HeapAllocator m_allocator;
+      std::unique_ptr<uint8_t[]> m_data;
+      std::mutex m_allocatorLock;
+    public:
+      NullConstantsAllocator(size_t memoryAmount)
+        : m_allocator(memoryAmount, 16)
+        , m_data(new uint8_t[memoryAmount])
+      {}
+
+      LinearConstantsAllocator* allocate(size_t bytes) override
+      {
+        std::lock_guard<std::mutex> guard(m_allocatorLock);
+        auto dip = m_allocator.allocate(bytes, 256);
+        HIGAN_ASSERT(dip.has_value(), "No space left for constants, %zu bytes total", m_allocator.max_size());
+        return new NullLinearConstantsAllocator(m_data.get(), dip.value());
+      }
+
+      void free(LinearConstantsAllocator* ptr) override
+      {
+        auto nptr = static_cast<NullLinearConstantsAllocator*>(ptr);
+        std::lock_guard<std::mutex> guard(m_allocatorLock);
+        m_allocator.free(nptr->block());
+        delete nptr;
+      }
+
+      size_t size() override
+      {
+        std::lock_guard<std::mutex> guard(m_allocatorLock);
+        return m_allocator.findLargestAllocation();
+      }
+      size_t max_size() override
+      {
+        std::lock_guard<std::mutex> guard(m_allocatorLock);
+        return m_allocator.max_size();
+      }
+      size_t size_allocated() override
+      {
+        std::lock_guard<std::mutex> guard(m_allocatorLock);
+        return m_allocator.size_allocated();
+      }
+    };
+
+    class NullDevice;
+
+    class NullCommandBuffer : public CommandBufferImpl
+    {
+      QueueType m_type;
+      size_t m_packets = 0;
+      size_t m_barriers = 0;
+    public:
+      NullCommandBuffer(QueueType type)
+        : m_type(type)
+      {}
+
+      QueueType type() const { return m_type; }
+      // what the last fillWith walked through
+      size_t packets() const { return m_packets; }
+      size_t barriers() const { return m_barriers; }
+
+      void reserveConstants(size_t expectedTotalBytes) override;
+      void fillWith(std::shared_ptr<prototypes::DeviceImpl> device, MemView<backend::CommandBuffer*>& buffers, BarrierSolver& solver) override;
+      bool readbackTimestamps(std::shared_ptr<prototypes::DeviceImpl> device, vector<GraphNodeTiming>& nodes) override;
+      void beginConstantsDmaList(std::shared_ptr<prototypes::DeviceImpl> device) override;
+      void addConstants(CommandBufferImpl* list) override;
+      void endConstantsDmaList() override;
+    };
+  }
+}
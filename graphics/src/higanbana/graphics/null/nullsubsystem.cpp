@@ -0,0 +1,48 @@
+#include "higanbana/graphics/null/nullsubsystem.hpp"
+#include "higanbana/graphics/common/graphicssurface.hpp"
+#include <higanbana/core/platform/Window.hpp>
+#include <higanbana/core/profiling/profiling.hpp>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    NullSubsystem::NullSubsystem(std::chrono::nanoseconds simulatedLatency)
+      : m_simulatedLatency(simulatedLatency)
+    {
+    }
+
+    std::string NullSubsystem::gfxApi()
+    {
+      return "Null";
+    }
+
+    vector<GpuInfo> NullSubsystem::availableGpus(VendorID)
+    {
+      GpuInfo info{};
+      info.id = 0;
+      info.name = "Null Device";
+      info.memory = 8ll * 1024 * 1024 * 1024;
+      info.vendor = VendorID::Unknown;
+      info.deviceId = 0;
+      info.type = DeviceType::Cpu;
+      info.gpuConstants = false;
+      info.canPresent = true;
+      info.api = GraphicsApi::Null;
+      info.apiVersionStr = "Null";
+      return {info};
+    }
+
+    std::shared_ptr<prototypes::DeviceImpl> NullSubsystem::createGpuDevice(FileSystem&, GpuInfo gpu)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      return std::make_shared<NullDevice>(gpu, m_simulatedLatency);
+    }
+
+    GraphicsSurface NullSubsystem::createSurface(Window&)
+    {
+      // nothing is shown, backbuffers just need a size
+      return GraphicsSurface(std::make_shared<NullGraphicsSurface>(int2(1920, 1080)));
+    }
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "higanbana/graphics/null/nulldevice.hpp"
+#include <higanbana/core/datastructures/vector.hpp>
+
+#include <chrono>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    // One cpu "gpu" that never needs drivers, for benchmarking and testing the frontend.
+    class NullSubsystem : public prototypes::SubsystemImpl
+    {
+      std::chrono::nanoseconds m_simulatedLatency;
+    public:
+      NullSubsystem(std::chrono::nanoseconds simulatedLatency = std::chrono::nanoseconds(0));
+      std::string gfxApi() override;
+      vector<GpuInfo> availableGpus(VendorID vendor) override;
+      std::shared_ptr<prototypes::DeviceImpl> createGpuDevice(FileSystem& fs, GpuInfo gpu) override;
+      GraphicsSurface createSurface(Window& window) override;
+    };
+  }
+}
@@ -188,10 +188,21 @@ namespace higanbana
       }
     }
 
+    std::shared_ptr<std::mutex> ShaderStorage::binaryLock(const std::string& binaryPath)
+    {
+      std::lock_guard<std::mutex> guard(m_binaryLocksLock);
+      auto& lock = m_binaryLocks[binaryPath];
+      if (!lock)
+        lock = std::make_shared<std::mutex>();
+      return lock;
+    }
+
     higanbana::MemoryBlob ShaderStorage::shader(ShaderCreateInfo info)
     {
       auto shaderPath = sourcePathCombiner(info.desc.shaderName, info.desc.type);
       auto dxilPath = binaryPathCombiner(info.desc.shaderName, info.desc.type, info.desc.tgs, info.desc.definitions);
+      auto lock = binaryLock(dxilPath);
+      std::lock_guard<std::mutex> binaryGuard(*lock);
 
       auto func = [&](std::string filename)
       {
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace higanbana
 {
@@ -26,6 +28,10 @@ namespace higanbana
       ShaderBinaryType m_type;
       bool m_compileFirstTime;
       std::shared_ptr<ShaderCompiler> m_compiler;
+      // shader() is called from pipeline build threads, compiles of the same binary take turns and others run in parallel
+      std::mutex m_binaryLocksLock;
+      std::unordered_map<std::string, std::shared_ptr<std::mutex>> m_binaryLocks;
+      std::shared_ptr<std::mutex> binaryLock(const std::string& binaryPath);
     public:
       ShaderStorage(FileSystem& fs, std::shared_ptr<ShaderCompiler> compiler, std::string binaryPath, ShaderBinaryType type, bool forceCompileFirstTime);
       std::string sourcePathCombiner(std::string shaderName, ShaderType type);
@@ -12,12 +12,9 @@ namespace higanbana
 {
   namespace backend
   {
-    void VulkanCommandBuffer::handleRenderpass(VulkanDevice* device, gfxpacket::RenderPassBegin& packet)
+    void VulkanCommandBuffer::ensureRenderpass(VulkanDevice* device, gfxpacket::RenderPassBegin& packet)
     {
-      HIGAN_CPU_FUNCTION_SCOPE();
       // step1. check if renderpass is done, otherwise create renderpass
-      auto& renderpassbegin = packet;
-
       if (!device->allResources().renderpasses[packet.renderpass].valid())
       {
         auto& rp = device->allResources().renderpasses[packet.renderpass];
@@ -195,6 +192,13 @@ namespace higanbana
         rp.native() = rpobj;
         rp.setValid();
       }
+    }
+
+    void VulkanCommandBuffer::handleRenderpass(VulkanDevice* device, gfxpacket::RenderPassBegin& packet)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      ensureRenderpass(device, packet);
+      auto& renderpassbegin = packet;
 
       auto& rp = device->allResources().renderpasses[packet.renderpass];
       // step2. collect and register framebuffer to renderpass
@@ -666,6 +670,8 @@ namespace higanbana
       int drawIndex = 0;
       int framebuffer = 0;
       ResourceHandle boundPipeline;
+      // bound pipeline is still building and the device was told not to wait for it
+      bool skipDraws = false;
       std::string currentBlock;
       bool beganLabel = false;
       bool hasReadback = false;
@@ -792,7 +798,10 @@ namespace higanbana
               {
                 m_oldPipelines.push_back(oldPipe.value());
               }
-              buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, device->allResources().pipelines[packet.pipeline].m_pipeline, m_dispatch);
+              auto& pipe = device->allResources().pipelines[packet.pipeline];
+              skipDraws = !pipe.m_hasPipeline->load();
+              if (!skipDraws)
+                buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipe.m_pipeline, m_dispatch);
               boundPipeline = packet.pipeline;
             }
             break;
@@ -806,7 +815,10 @@ namespace higanbana
               {
                 m_oldPipelines.push_back(oldPipe.value());
               }
-              buffer.bindPipeline(vk::PipelineBindPoint::eCompute, device->allResources().pipelines[packet.pipeline].m_pipeline, m_dispatch);
+              auto& pipe = device->allResources().pipelines[packet.pipeline];
+              skipDraws = !pipe.m_hasPipeline->load();
+              if (!skipDraws)
+                buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipe.m_pipeline, m_dispatch);
               boundPipeline = packet.pipeline;
             }
 
@@ -826,12 +838,16 @@ namespace higanbana
           }
           case PacketType::Draw:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::Draw>();
             buffer.draw(params.vertexCountPerInstance, params.instanceCount, params.startVertex, params.startInstance, m_dispatch);
             break;
           }
           case PacketType::DrawIndexed:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DrawIndexed>();
             if (params.indexbuffer.type == ViewResourceType::BufferIBV && params.indexbuffer != m_boundIndexBuffer)
             {
@@ -850,18 +866,24 @@ namespace higanbana
           }
           case PacketType::DispatchMesh:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DispatchMesh>();
             buffer.drawMeshTasksNV(params.xDim, 0, m_dispatch);
             break;
           }
           case PacketType::Dispatch:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::Dispatch>();
             buffer.dispatch(params.groups.x, params.groups.y, params.groups.z, m_dispatch);
             break;
           }
           case PacketType::DrawIndirect:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DrawIndirect>();
             auto& srv = device->allResources().bufSRV[params.indirectBuffer];
             auto& buf = device->allResources().buf[params.indirectBuffer.resourceHandle()];
@@ -876,6 +898,8 @@ namespace higanbana
           }
           case PacketType::DrawIndexedIndirect:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DrawIndexedIndirect>();
             if (params.indexbuffer.type == ViewResourceType::BufferIBV && params.indexbuffer != m_boundIndexBuffer)
             {
@@ -902,6 +926,8 @@ namespace higanbana
           }
           case PacketType::DispatchIndirect:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DispatchIndirect>();
             auto& srv = device->allResources().bufSRV[params.indirectBuffer];
             auto& buf = device->allResources().buf[params.indirectBuffer.resourceHandle()];
@@ -928,6 +954,8 @@ namespace higanbana
           }
           case PacketType::DispatchMeshIndirect:
           {
+            if (skipDraws)
+              break;
             auto params = header->data<gfxpacket::DispatchMeshIndirect>();
             auto& srv = device->allResources().bufSRV[params.indirectBuffer];
             auto& buf = device->allResources().buf[params.indirectBuffer.resourceHandle()];
@@ -1172,7 +1200,7 @@ namespace higanbana
     {
       HIGAN_CPU_FUNCTION_SCOPE();
       backend::CommandBuffer::PacketHeader* rpbegin = nullptr;
-      // find all renderpasses & compile all missing graphics pipelines
+      // find all renderpasses & start building all missing pipelines, they finish while the earlier commands record
       for (auto&& list : buffers)
       {
         for (auto iter = list->begin(); (*iter)->type != backend::PacketType::EndOfPackets; iter++)
@@ -1183,27 +1211,21 @@ namespace higanbana
             {
               rpbegin = (*iter);
               gfxpacket::RenderPassBegin& packet = (*iter)->data<gfxpacket::RenderPassBegin>();
-              handleRenderpass(device, packet);
+              // only the renderpass, framebuffers are made while recording
+              ensureRenderpass(device, packet);
               break;
             }
             case PacketType::GraphicsPipelineBind:
             {
               gfxpacket::GraphicsPipelineBind& packet = (*iter)->data<gfxpacket::GraphicsPipelineBind>();
-              auto oldPipe = device->updatePipeline(packet.pipeline, rpbegin->data<gfxpacket::RenderPassBegin>());
-              if (oldPipe)
-              {
-                m_oldPipelines.push_back(oldPipe.value());
-              }
+              if (rpbegin)
+                device->queuePipelineCompile(packet.pipeline, rpbegin->data<gfxpacket::RenderPassBegin>());
               break;
             }
             case PacketType::ComputePipelineBind:
             {
               gfxpacket::ComputePipelineBind& packet = (*iter)->data<gfxpacket::ComputePipelineBind>();
-              auto oldPipe = device->updatePipeline(packet.pipeline);
-              if (oldPipe)
-              {
-                m_oldPipelines.push_back(oldPipe.value());
-              }
+              device->queuePipelineCompile(packet.pipeline);
               break;
             }
             case PacketType::RenderpassEnd:
@@ -1279,6 +1301,11 @@ namespace higanbana
           .setPInheritanceInfo(nullptr)));
       }
 
+      if (nat->hasUncompiledPipelines())
+      {
+        preprocess(nat.get(), buffers);
+      }
+
       {
         HIGAN_CPU_BRACKET("compile");
         // add commands to list while also adding barriers
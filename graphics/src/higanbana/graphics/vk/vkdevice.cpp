@@ -17,6 +17,7 @@
 #include <higanbana/core/system/time.hpp>
 
 #include <optional>
+#include <thread>
 
 namespace higanbana
 {
@@ -325,7 +326,10 @@ namespace higanbana
       , m_dmaQueues(false)
       , m_graphicQueues(false)
       , m_info(info)
+      , m_fs(fs)
       , m_shaders(fs, std::shared_ptr<ShaderCompiler>(new DXCompiler(fs)), "/shader_binaries", ShaderBinaryType::SPIRV, info.forceCompileShaders)
+      , m_pipelineCache(device, physDev.getProperties(), fs, "/shader_binaries")
+      , m_pipelineCompiler(std::make_unique<VulkanPipelineCompiler>(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2)))
       , m_freeQueueIndexes({})
       //, m_seqTracker(std::make_shared<SequenceTracker>())
       , m_dynamicUpload(std::make_shared<VulkanUploadHeap>(device, physDev, memoryAddressingFlags(), HIGANBANA_UPLOAD_MEMORY_AMOUNT)) // TODO: implement dynamically adjusted
@@ -849,6 +853,8 @@ namespace higanbana
     {
       HIGAN_CPU_FUNCTION_SCOPE();
       VK_CHECK_RESULT_RAW(m_device.waitIdle());
+      // waits for running builds, they still need their layouts. Queued ones are dropped below.
+      m_pipelineCompiler.reset();
 
       m_device.destroyBuffer(m_shaderDebugBuffer.native());
       m_device.freeMemory(m_shaderDebugBuffer.sharedMem());
@@ -921,6 +927,8 @@ namespace higanbana
       }
       for (auto&& pipe : m_allRes.pipelines.view()) {
         if (pipe) {
+          if (pipe.m_compile)
+            m_device.destroyPipeline(pipe.m_compile->discard());
           if (pipe.m_pipeline)
             m_device.destroyPipeline(pipe.m_pipeline);
           if (pipe.m_pipelineLayout)
@@ -980,6 +988,9 @@ namespace higanbana
       m_device.destroySampler(m_samplers.m_pointSamplerWrap);
       m_device.destroyDescriptorPool(m_descriptors->native());
 
+      m_pipelineCache.save(m_fs);
+      m_pipelineCache.destroy();
+
       m_device.destroy();
     }
 
@@ -1527,198 +1538,278 @@ namespace higanbana
 
     }
 
-    std::optional<vk::Pipeline> VulkanDevice::updatePipeline(ResourceHandle pipeline, gfxpacket::RenderPassBegin& rpbegin)
+    void VulkanDevice::startGraphicsCompile(VulkanPipeline& vp, vk::RenderPass rp)
     {
-      HIGAN_CPU_FUNCTION_SCOPE();
-      if (m_allRes.pipelines[pipeline].m_hasPipeline->load() && !m_allRes.pipelines[pipeline].needsUpdating())
-        return {};
-
-      std::lock_guard<std::mutex> pipelineUpdateLock(m_deviceLock);
-      auto& vp = m_allRes.pipelines[pipeline];
-      if (vp.m_hasPipeline->load() && !vp.needsUpdating())
-        return {};
-
-      Timer pipelineRecreationTime;
-      auto& desc = vp.m_gfxDesc;
-
-      struct ReadyShader
-      {
-        vk::ShaderStageFlagBits stage;
-        vk::ShaderModule module;
-      };
-      vector<ReadyShader> shaders;
-
-      auto& d = desc.desc;
+      auto& d = vp.m_gfxDesc.desc;
 
+      // watches are settled here so the pipeline isn't queued again while it builds
+      vector<bool> forceCompile;
       for (auto&& [shaderType, sourcePath] : d.shaders)
       {
-        bool forceCompile = false;
-        for (auto& shader : vp.m_watchedShaders) {
-          if (shader.second == shaderType) {
-            forceCompile = shader.first.updated();
-            break;
-          }
-        }
-        auto sci = ShaderCreateInfo(sourcePath, shaderType, d.layout);
-        if (forceCompile) sci = sci.compile();
-        auto shader = m_shaders.shader(sci);
-        vk::ShaderModuleCreateInfo si = vk::ShaderModuleCreateInfo()
-          .setCodeSize(shader.size())
-          .setPCode(reinterpret_cast<uint32_t*>(shader.data()));
-        auto module = m_device.createShaderModule(si);
-        VK_CHECK_RESULT(module);
-
-        ReadyShader ss;
-        ss.stage = shaderTypeToVulkan(shaderType);
-        ss.module = module.value;
-        shaders.push_back(ss);
+        bool force = false;
         auto found = std::find_if(vp.m_watchedShaders.begin(), vp.m_watchedShaders.end(), [stype = shaderType](std::pair<WatchFile, ShaderType>& shader) {
-            if (shader.second == stype)
-            {
-              shader.first.react();
-              return true;
-            }
-            return false;
+            return shader.second == stype;
           });
-        if (found == vp.m_watchedShaders.end())
+        if (found != vp.m_watchedShaders.end())
+        {
+          force = found->first.updated();
+          found->first.react();
+        }
+        else
         {
           vp.m_watchedShaders.push_back(std::make_pair(m_shaders.watch(sourcePath, shaderType), shaderType));
         }
+        forceCompile.push_back(force);
       }
 
-      vector<vk::PipelineShaderStageCreateInfo> shaderInfos;
-
-      for (auto&& it : shaders)
-      {
-        shaderInfos.push_back(vk::PipelineShaderStageCreateInfo()
-        .setPName("main")
-        .setStage(it.stage)
-        .setModule(it.module));
-      }
-
-      vector<vk::DynamicState> dynamics = {
-        vk::DynamicState::eViewport, 
-        vk::DynamicState::eScissor,
-        vk::DynamicState::eDepthBounds};
-      auto dynamicsInfo = vk::PipelineDynamicStateCreateInfo()
-        .setDynamicStateCount(dynamics.size()).setPDynamicStates(dynamics.data());
-
-      auto vertexInput = vk::PipelineVertexInputStateCreateInfo();
-
-      auto blendAttachments = getBlendAttachments(desc.desc.blendDesc, desc.desc.numRenderTargets);
-      auto blendInfo = getBlendStateDesc(desc.desc.blendDesc, blendAttachments);
-      auto rasterInfo = getRasterStateDesc(desc.desc.rasterDesc);
-      auto depthInfo = getDepthStencilDesc(desc.desc.dsdesc);
-      auto inputInfo = getInputAssemblyDesc(desc);
-      auto msaainfo = getMultisampleDesc(desc);
-      auto viewport = vk::Viewport();
-      auto scissor = vk::Rect2D();
-      auto viewportInfo = vk::PipelineViewportStateCreateInfo()
-      .setPScissors(&scissor)
-      .setScissorCount(1)
-      .setPViewports(&viewport)
-      .setViewportCount(1);
-
-      auto rp = m_allRes.renderpasses[rpbegin.renderpass].native();
-      vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo()
-        .setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR)
-        .setLayout(vp.m_pipelineLayout)
-        .setStageCount(shaderInfos.size())
-        .setPStages(shaderInfos.data())
-        .setPVertexInputState(&vertexInput)
-        .setPViewportState(&viewportInfo)
-        .setPColorBlendState(&blendInfo)
-        .setPDepthStencilState(&depthInfo)
-        .setPInputAssemblyState(&inputInfo)
-        .setPMultisampleState(&msaainfo)
-        .setPRasterizationState(&rasterInfo)
-        .setPDynamicState(&dynamicsInfo)
-        .setRenderPass(rp)
-        .setSubpass(0); // only 1 ever available
+      auto build = [this, desc = vp.m_gfxDesc, layout = vp.m_pipelineLayout, rp, forceCompile]() mutable -> vk::Pipeline
+      {
+        HIGAN_CPU_BRACKET("build Vulkan graphics pipeline");
+        Timer pipelineRecreationTime;
+        auto& d = desc.desc;
 
-      if (m_dynamicDispatch.vkGetPipelineExecutablePropertiesKHR)
+        struct ReadyShader
+        {
+          vk::ShaderStageFlagBits stage;
+          vk::ShaderModule module;
+        };
+        vector<ReadyShader> shaders;
+
+        int shaderIndex = 0;
+        for (auto&& [shaderType, sourcePath] : d.shaders)
+        {
+          auto sci = ShaderCreateInfo(sourcePath, shaderType, d.layout);
+          if (forceCompile[shaderIndex++]) sci = sci.compile();
+          // ShaderStorage only serializes builds of the same binary
+          auto shader = m_shaders.shader(sci);
+          vk::ShaderModuleCreateInfo si = vk::ShaderModuleCreateInfo()
+            .setCodeSize(shader.size())
+            .setPCode(reinterpret_cast<uint32_t*>(shader.data()));
+          auto module = m_device.createShaderModule(si);
+          VK_CHECK_RESULT(module);
+
+          ReadyShader ss;
+          ss.stage = shaderTypeToVulkan(shaderType);
+          ss.module = module.value;
+          shaders.push_back(ss);
+        }
+
+        vector<vk::PipelineShaderStageCreateInfo> shaderInfos;
+
+        for (auto&& it : shaders)
+        {
+          shaderInfos.push_back(vk::PipelineShaderStageCreateInfo()
+          .setPName("main")
+          .setStage(it.stage)
+          .setModule(it.module));
+        }
+
+        vector<vk::DynamicState> dynamics = {
+          vk::DynamicState::eViewport, 
+          vk::DynamicState::eScissor,
+          vk::DynamicState::eDepthBounds};
+        auto dynamicsInfo = vk::PipelineDynamicStateCreateInfo()
+          .setDynamicStateCount(dynamics.size()).setPDynamicStates(dynamics.data());
+
+        auto vertexInput = vk::PipelineVertexInputStateCreateInfo();
+
+        auto blendAttachments = getBlendAttachments(desc.desc.blendDesc, desc.desc.numRenderTargets);
+        auto blendInfo = getBlendStateDesc(desc.desc.blendDesc, blendAttachments);
+        auto rasterInfo = getRasterStateDesc(desc.desc.rasterDesc);
+        auto depthInfo = getDepthStencilDesc(desc.desc.dsdesc);
+        auto inputInfo = getInputAssemblyDesc(desc);
+        auto msaainfo = getMultisampleDesc(desc);
+        auto viewport = vk::Viewport();
+        auto scissor = vk::Rect2D();
+        auto viewportInfo = vk::PipelineViewportStateCreateInfo()
+        .setPScissors(&scissor)
+        .setScissorCount(1)
+        .setPViewports(&viewport)
+        .setViewportCount(1);
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo()
+          .setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR)
+          .setLayout(layout)
+          .setStageCount(shaderInfos.size())
+          .setPStages(shaderInfos.data())
+          .setPVertexInputState(&vertexInput)
+          .setPViewportState(&viewportInfo)
+          .setPColorBlendState(&blendInfo)
+          .setPDepthStencilState(&depthInfo)
+          .setPInputAssemblyState(&inputInfo)
+          .setPMultisampleState(&msaainfo)
+          .setPRasterizationState(&rasterInfo)
+          .setPDynamicState(&dynamicsInfo)
+          .setRenderPass(rp)
+          .setSubpass(0); // only 1 ever available
+
+        if (m_dynamicDispatch.vkGetPipelineExecutablePropertiesKHR)
+        {
+          pipelineInfo = pipelineInfo.setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR);
+        }
+
+        auto compiled = m_device.createGraphicsPipeline(m_pipelineCache.native(), pipelineInfo);
+
+        for (auto&& it : shaders)
+        {
+          m_device.destroyShaderModule(it.module);
+        }
+
+        // a failed build keeps whatever pipeline was there before
+        if (compiled.result != vk::Result::eSuccess)
+          return nullptr;
+
+        setDebugUtilsObjectNameEXT(compiled.value, desc.desc.shaders.begin()->second.c_str());
+
+        getGfxPipelineInformation(compiled.value, d);
+
+        HIGAN_ILOG("Vulkan", "Graphics Pipeline \"%s\" created in %.2fms", d.shaders.back().second.c_str(), float(pipelineRecreationTime.timeFromLastReset()) / 1000000.f);
+        return compiled.value;
+      };
+
+      vp.m_compile = std::make_shared<VulkanPipelineCompile>(std::move(build));
+      vp.m_compiling->store(true);
+      m_pipelineCompiler->submit(vp.m_compile);
+    }
+
+    void VulkanDevice::startComputeCompile(VulkanPipeline& pipe)
+    {
+      auto sci = ShaderCreateInfo(pipe.m_computeDesc.shader(), ShaderType::Compute, pipe.m_computeDesc.layout)
+        .setComputeGroups(pipe.m_computeDesc.shaderGroups);
+      if (pipe.cs.updated())
+        sci = sci.compile();
+      if (pipe.cs.empty())
       {
-        pipelineInfo = pipelineInfo.setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR);
+        pipe.cs = m_shaders.watch(pipe.m_computeDesc.shader(), ShaderType::Compute);
       }
+      pipe.cs.react();
 
+      auto build = [this, desc = pipe.m_computeDesc, layout = pipe.m_pipelineLayout, sci]() mutable -> vk::Pipeline
+      {
+        HIGAN_CPU_BRACKET("build Vulkan compute pipeline");
+        Timer pipelineRecreationTime;
+        auto shader = m_shaders.shader(sci);
 
-      auto compiled = m_device.createGraphicsPipeline(nullptr, pipelineInfo);
-      VK_CHECK_RESULT(compiled);
+        auto shaderInfo = vk::ShaderModuleCreateInfo().setCodeSize(shader.size()).setPCode(reinterpret_cast<uint32_t*>(shader.data()));
+
+        auto smodule = m_device.createShaderModule(shaderInfo);
+        VK_CHECK_RESULT(smodule);
+
+        auto pipelineDesc = vk::ComputePipelineCreateInfo()
+          .setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR)
+          .setStage(vk::PipelineShaderStageCreateInfo()
+            .setModule(smodule.value)
+            .setPName("main")
+            .setStage(vk::ShaderStageFlagBits::eCompute))
+          .setLayout(layout);
+        auto result = m_device.createComputePipeline(m_pipelineCache.native(), pipelineDesc);
+        m_device.destroyShaderModule(smodule.value);
+
+        // a failed build keeps whatever pipeline was there before
+        if (result.result != vk::Result::eSuccess)
+          return nullptr;
+
+        setDebugUtilsObjectNameEXT(result.value, desc.shader());
+        getComputePipelineInformation(result.value, desc);
+        HIGAN_ILOG("Vulkan", "Compute Pipeline \"%s\" created in %.2fms", desc.shader(), float(pipelineRecreationTime.timeFromLastReset()) / 1000000.f);
+        return result.value;
+      };
 
-      setDebugUtilsObjectNameEXT(compiled.value, desc.desc.shaders.begin()->second.c_str());
+      pipe.m_compile = std::make_shared<VulkanPipelineCompile>(std::move(build));
+      pipe.m_compiling->store(true);
+      m_pipelineCompiler->submit(pipe.m_compile);
+    }
 
-      for (auto&& it : shaders)
+    std::optional<vk::Pipeline> VulkanDevice::finishPipeline(ResourceHandle pipeline, std::unique_lock<std::mutex>& deviceLock)
+    {
+      auto compile = m_allRes.pipelines[pipeline].m_compile;
+      if (!compile)
+        return {};
+      if (!compile->ready())
       {
-        m_device.destroyShaderModule(it.module);
+        if (m_info.pipelineCompilation == PipelineCompilation::SkipUntilReady)
+          return {};
+        // other lists can keep recording meanwhile, builds don't take the device lock
+        HIGAN_CPU_BRACKET("wait for pipeline build");
+        deviceLock.unlock();
+        compile->wait();
+        deviceLock.lock();
+      }
+      auto& vp = m_allRes.pipelines[pipeline];
+      // someone else waited for the same build and already swapped it in
+      if (vp.m_compile != compile)
+        return {};
+      vp.m_compile = nullptr;
+      vp.m_compiling->store(false);
+      auto compiled = compile->result.get();
+      if (!compiled)
+      {
+        // nothing to wait for until the shader changes, draws using it stay skipped
+        if (!vp.m_hasPipeline->load() && !vp.m_buildFailed->exchange(true))
+          m_uncompiledPipelines--;
+        return {};
       }
+
       std::optional<vk::Pipeline> ret;
-      if (vp.m_hasPipeline)
-      {
+      if (vp.m_hasPipeline->load())
         ret = vp.m_pipeline;
-      }
-      vp.m_pipeline = compiled.value;
+      else if (!vp.m_buildFailed->exchange(false))
+        m_uncompiledPipelines--;
+      vp.m_pipeline = compiled;
       vp.m_hasPipeline->store(true);
+      return ret;
+    }
 
-      getGfxPipelineInformation(vp.m_pipeline, d);
-      
-      HIGAN_ILOG("Vulkan", "Graphics Pipeline \"%s\" created in %.2fms", d.shaders.back().second.c_str(), float(pipelineRecreationTime.timeFromLastReset()) / 1000000.f);
+    std::optional<vk::Pipeline> VulkanDevice::updatePipeline(ResourceHandle pipeline, gfxpacket::RenderPassBegin& rpbegin)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      auto& current = m_allRes.pipelines[pipeline];
+      if (current.built() && !current.m_compiling->load() && !current.needsUpdating())
+        return {};
 
-      return ret;
+      std::unique_lock<std::mutex> pipelineUpdateLock(m_deviceLock);
+      auto& vp = m_allRes.pipelines[pipeline];
+      if (!vp.m_compile && (!vp.built() || vp.needsUpdating()))
+        startGraphicsCompile(vp, m_allRes.renderpasses[rpbegin.renderpass].native());
+      return finishPipeline(pipeline, pipelineUpdateLock);
     }
 
     std::optional<vk::Pipeline> VulkanDevice::updatePipeline(ResourceHandle pipeline)
     {
       HIGAN_CPU_FUNCTION_SCOPE();
-      if (m_allRes.pipelines[pipeline].m_hasPipeline->load() && !m_allRes.pipelines[pipeline].cs.updated())
+      auto& current = m_allRes.pipelines[pipeline];
+      if (current.built() && !current.m_compiling->load() && !current.cs.updated())
         return {};
 
-      std::lock_guard<std::mutex> pipelineUpdateLock(m_deviceLock);
+      std::unique_lock<std::mutex> pipelineUpdateLock(m_deviceLock);
       auto& pipe = m_allRes.pipelines[pipeline];
-      if (pipe.m_hasPipeline->load() && !pipe.cs.updated())
-        return {};
-      Timer pipelineRecreationTime;
-
-      auto sci = ShaderCreateInfo(pipe.m_computeDesc.shader(), ShaderType::Compute, pipe.m_computeDesc.layout)
-        .setComputeGroups(pipe.m_computeDesc.shaderGroups);
-      if (pipe.cs.updated())
-        sci = sci.compile();
-      auto shader = m_shaders.shader(sci);
-
-      auto shaderInfo = vk::ShaderModuleCreateInfo().setCodeSize(shader.size()).setPCode(reinterpret_cast<uint32_t*>(shader.data()));
+      if (!pipe.m_compile && (!pipe.built() || pipe.cs.updated()))
+        startComputeCompile(pipe);
+      return finishPipeline(pipeline, pipelineUpdateLock);
+    }
 
-      auto smodule = m_device.createShaderModule(shaderInfo);
-      VK_CHECK_RESULT(smodule);
-      if (pipe.cs.empty())
-      {
-        pipe.cs = m_shaders.watch(pipe.m_computeDesc.shader(), ShaderType::Compute);
-      }
-      pipe.cs.react();
+    void VulkanDevice::queuePipelineCompile(ResourceHandle pipeline, gfxpacket::RenderPassBegin& rpbegin)
+    {
+      auto& current = m_allRes.pipelines[pipeline];
+      if (current.m_compiling->load() || (current.built() && !current.needsUpdating()))
+        return;
 
-      auto pipelineDesc = vk::ComputePipelineCreateInfo()
-        .setFlags(vk::PipelineCreateFlagBits::eCaptureStatisticsKHR)
-        .setStage(vk::PipelineShaderStageCreateInfo()
-          .setModule(smodule.value)
-          .setPName("main")
-          .setStage(vk::ShaderStageFlagBits::eCompute))
-        .setLayout(pipe.m_pipelineLayout);
-      auto result = m_device.createComputePipeline(nullptr, pipelineDesc);
-      m_device.destroyShaderModule(smodule.value);
+      std::lock_guard<std::mutex> pipelineUpdateLock(m_deviceLock);
+      auto& vp = m_allRes.pipelines[pipeline];
+      if (!vp.m_compile && (!vp.built() || vp.needsUpdating()))
+        startGraphicsCompile(vp, m_allRes.renderpasses[rpbegin.renderpass].native());
+    }
 
-      setDebugUtilsObjectNameEXT(result.value, pipe.m_computeDesc.shader());
+    void VulkanDevice::queuePipelineCompile(ResourceHandle pipeline)
+    {
+      auto& current = m_allRes.pipelines[pipeline];
+      if (current.m_compiling->load() || (current.built() && !current.cs.updated()))
+        return;
 
-      std::optional<vk::Pipeline> oldPipe;
-      if (result.result == vk::Result::eSuccess)
-      {
-        if (pipe.m_hasPipeline)
-        {
-          oldPipe = pipe.m_pipeline;
-        }
-        pipe.m_pipeline = result.value;
-        pipe.m_hasPipeline->store(true);
-      }
-      getComputePipelineInformation(pipe.m_pipeline, pipe.m_computeDesc);
-      HIGAN_ILOG("Vulkan", "Compute Pipeline \"%s\" created in %.2fms", pipe.m_computeDesc.shader(), float(pipelineRecreationTime.timeFromLastReset()) / 1000000.f);
-      return oldPipe;
+      std::lock_guard<std::mutex> pipelineUpdateLock(m_deviceLock);
+      auto& pipe = m_allRes.pipelines[pipeline];
+      if (!pipe.m_compile && (!pipe.built() || pipe.cs.updated()))
+        startComputeCompile(pipe);
     }
 
     VulkanQueryPool VulkanDevice::createGraphicsQueryPool(unsigned counters)
@@ -1793,6 +1884,7 @@ namespace higanbana
       m_device.updateDescriptorSets({wds, shaderDebug}, {});
 
       m_allRes.pipelines[handle] = VulkanPipeline(pipelineLayout.value, desc, set[0]);
+      m_uncompiledPipelines++;
     }
 
     void VulkanDevice::createPipeline(ResourceHandle handle, ComputePipelineDescriptor desc)
@@ -1847,6 +1939,7 @@ namespace higanbana
       m_device.updateDescriptorSets({wds, shaderDebug}, {});
 
       m_allRes.pipelines[handle] = VulkanPipeline( pipelineLayout.value, desc, set[0]);
+      m_uncompiledPipelines++;
     }
     void VulkanDevice::createPipeline(ResourceHandle handle, RaytracingPipelineDescriptor desc)
     {
@@ -1978,6 +2071,12 @@ namespace higanbana
         }
         case ResourceType::Pipeline:
         {
+          auto& pipe = m_allRes.pipelines[handle];
+          // the build uses the layout
+          if (pipe.m_compile)
+            m_device.destroyPipeline(pipe.m_compile->discard());
+          if (pipe.m_hasPipeline && !pipe.built())
+            m_uncompiledPipelines--;
           m_device.destroyPipeline(m_allRes.pipelines[handle].m_pipeline);
           m_device.destroyPipelineLayout(m_allRes.pipelines[handle].m_pipelineLayout);
           m_descriptors->freeSets(m_device, makeMemView(m_allRes.pipelines[handle].m_staticSet));
@@ -1,8 +1,10 @@
 #pragma once
 #include "higanbana/graphics/vk/vkresources.hpp"
+#include "higanbana/graphics/vk/vkpipelinecache.hpp"
 #include "higanbana/graphics/common/resources/gpu_info.hpp"
 #include <higanbana/core/datastructures/enum_array.hpp>
 #include <optional>
+#include <memory>
 #include <mutex>
 
 namespace higanbana
@@ -24,7 +26,12 @@ namespace higanbana
       bool                        m_dmaQueues;
       bool                        m_graphicQueues;
       GpuInfo                     m_info;
+      FileSystem&                 m_fs;
       ShaderStorage               m_shaders;
+      VulkanPipelineCache         m_pipelineCache;
+      std::unique_ptr<VulkanPipelineCompiler> m_pipelineCompiler;
+      // pipelines that have never had a native pipeline, recording only looks ahead for compiles while there are some
+      std::atomic<int>            m_uncompiledPipelines = 0;
       int64_t                     m_resourceID = 1;
 
       int                         m_mainQueueIndex;
@@ -116,6 +123,11 @@ namespace higanbana
 
       void getGfxPipelineInformation(vk::Pipeline pipe, higanbana::GraphicsPipelineDescriptor::Desc& d);
       void getComputePipelineInformation(vk::Pipeline pipe, higanbana::ComputePipelineDescriptor& d);
+
+      // called with m_deviceLock held
+      void startGraphicsCompile(VulkanPipeline& vp, vk::RenderPass renderpass);
+      void startComputeCompile(VulkanPipeline& vp);
+      std::optional<vk::Pipeline> finishPipeline(ResourceHandle pipeline, std::unique_lock<std::mutex>& deviceLock);
     public:
       VulkanDevice(
         vk::Device device,
@@ -159,8 +171,14 @@ namespace higanbana
 
       vk::RenderPass createRenderpass(const vk::RenderPassCreateInfo& info);
 
+      // Swaps in the newest finished build and returns the pipeline it replaced. With
+      // PipelineCompilation::SkipUntilReady this doesn't wait, check m_hasPipeline before binding.
       std::optional<vk::Pipeline> updatePipeline(ResourceHandle pipeline, gfxpacket::RenderPassBegin& renderpass);
       std::optional<vk::Pipeline> updatePipeline(ResourceHandle pipeline);
+      // starts the build early so it's hopefully done by the time updatePipeline wants it
+      void queuePipelineCompile(ResourceHandle pipeline, gfxpacket::RenderPassBegin& renderpass);
+      void queuePipelineCompile(ResourceHandle pipeline);
+      bool hasUncompiledPipelines() const { return m_uncompiledPipelines.load() > 0; }
       
       VulkanQueryPool createGraphicsQueryPool(unsigned counters);
       VulkanQueryPool createComputeQueryPool(unsigned counters);
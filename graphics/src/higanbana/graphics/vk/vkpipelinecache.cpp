@@ -0,0 +1,119 @@
+#include "higanbana/graphics/vk/vkpipelinecache.hpp"
+#include <higanbana/core/profiling/profiling.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    VulkanPipelineCache::VulkanPipelineCache(vk::Device device, const vk::PhysicalDeviceProperties& properties, FileSystem& fs, std::string directory)
+      : m_device(device)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      char name[64];
+      snprintf(name, sizeof(name), "/vk_%04x_%04x.pipelinecache", properties.vendorID, properties.deviceID);
+      m_path = directory + name;
+
+      MemoryBlob blob;
+      auto info = vk::PipelineCacheCreateInfo();
+      if (fs.fileExists(m_path))
+      {
+        blob = fs.readFile(m_path);
+        if (compatible(MemView<const uint8_t>(blob.cdata(), blob.size()), properties))
+          info = info.setInitialDataSize(blob.size()).setPInitialData(blob.cdata());
+        else
+          HIGAN_LOGi("Vulkan: pipeline cache \"%s\" is from another driver, starting empty\n", m_path.c_str());
+      }
+      auto cache = m_device.createPipelineCache(info);
+      if (cache.result != vk::Result::eSuccess && info.initialDataSize > 0)
+      {
+        HIGAN_LOGi("Vulkan: driver refused pipeline cache \"%s\", starting empty\n", m_path.c_str());
+        cache = m_device.createPipelineCache(vk::PipelineCacheCreateInfo());
+      }
+      VK_CHECK_RESULT(cache);
+      m_cache = cache.value;
+      HIGAN_LOGi("Vulkan: pipeline cache \"%s\" loaded with %zu bytes\n", m_path.c_str(), size_t(info.initialDataSize));
+    }
+
+    bool VulkanPipelineCache::compatible(MemView<const uint8_t> blob, const vk::PhysicalDeviceProperties& properties)
+    {
+      // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+      constexpr size_t HeaderSize = 16 + VK_UUID_SIZE;
+      if (blob.size() < HeaderSize)
+        return false;
+      uint32_t fields[4];
+      memcpy(fields, blob.data(), sizeof(fields));
+      return fields[0] >= HeaderSize
+        && fields[1] == static_cast<uint32_t>(VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        && fields[2] == properties.vendorID
+        && fields[3] == properties.deviceID
+        && memcmp(blob.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void VulkanPipelineCache::save(FileSystem& fs)
+    {
+      HIGAN_CPU_FUNCTION_SCOPE();
+      if (!m_cache)
+        return;
+      auto data = m_device.getPipelineCacheData(m_cache);
+      if (data.result != vk::Result::eSuccess || data.value.empty())
+        return;
+      if (!fs.writeFile(m_path, data.value.data(), data.value.size()))
+        HIGAN_LOGi("Vulkan: failed to save pipeline cache \"%s\"\n", m_path.c_str());
+    }
+
+    void VulkanPipelineCache::destroy()
+    {
+      if (m_cache)
+        m_device.destroyPipelineCache(m_cache);
+      m_cache = nullptr;
+    }
+
+    VulkanPipelineCompiler::VulkanPipelineCompiler(int threads)
+    {
+      for (int i = 0; i < std::max(threads, 1); ++i)
+        m_threads.emplace_back([this]{ loop(); });
+    }
+
+    VulkanPipelineCompiler::~VulkanPipelineCompiler()
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+      }
+      m_wake.notify_all();
+      for (auto&& thread : m_threads)
+        thread.join();
+    }
+
+    void VulkanPipelineCompiler::loop()
+    {
+      while (true)
+      {
+        std::shared_ptr<VulkanPipelineCompile> compile;
+        {
+          std::unique_lock<std::mutex> guard(m_lock);
+          m_wake.wait(guard, [this]{ return m_stop || !m_queue.empty(); });
+          if (m_stop)
+            return;
+          compile = std::move(m_queue.front());
+          m_queue.pop_front();
+        }
+        // recording may have needed it first and built it already
+        HIGAN_CPU_BRACKET("VulkanPipelineCompiler::build");
+        compile->tryRun();
+      }
+    }
+
+    void VulkanPipelineCompiler::submit(std::shared_ptr<VulkanPipelineCompile> compile)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_queue.push_back(std::move(compile));
+      }
+      m_wake.notify_one();
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "higanbana/graphics/vk/vkresources.hpp"
+#include <higanbana/core/filesystem/filesystem.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace higanbana
+{
+  namespace backend
+  {
+    // vk::PipelineCache kept in a file between runs. Blobs written by another driver or device are
+    // dropped before the driver sees them, the next save replaces them.
+    class VulkanPipelineCache
+    {
+      vk::Device m_device;
+      vk::PipelineCache m_cache;
+      std::string m_path;
+    public:
+      VulkanPipelineCache() {}
+      VulkanPipelineCache(vk::Device device, const vk::PhysicalDeviceProperties& properties, FileSystem& fs, std::string directory);
+
+      static bool compatible(MemView<const uint8_t> blob, const vk::PhysicalDeviceProperties& properties);
+
+      void save(FileSystem& fs);
+      void destroy();
+      vk::PipelineCache native() const { return m_cache; }
+    };
+
+    // Threads that run pipeline builds so recording doesn't stall on the driver compiler.
+    // Destruction waits for running builds, builds still queued are left to VulkanPipelineCompile::discard.
+    class VulkanPipelineCompiler
+    {
+      std::mutex m_lock;
+      std::condition_variable m_wake;
+      std::deque<std::shared_ptr<VulkanPipelineCompile>> m_queue;
+      bool m_stop = false;
+      std::vector<std::thread> m_threads;
+
+      void loop();
+    public:
+      VulkanPipelineCompiler(int threads);
+      ~VulkanPipelineCompiler();
+      void submit(std::shared_ptr<VulkanPipelineCompile> compile);
+    };
+  }
+}
@@ -15,6 +15,8 @@
 #include <higanbana/core/system/heap_allocator.hpp>
 
 #include <algorithm>
+#include <functional>
+#include <future>
 #include <mutex>
 
 #define VK_CHECK_RESULT(value) HIGAN_ASSERT(value.result == vk::Result::eSuccess, "Result was not success: \"%s\"", vk::to_string(value.result).c_str())
@@ -668,11 +670,62 @@ namespace higanbana
       }
     };
 
+    // One pipeline build, run by a VulkanPipelineCompiler thread or by whoever needs it first.
+    struct VulkanPipelineCompile
+    {
+      std::atomic<bool> started = false;
+      std::packaged_task<vk::Pipeline()> task;
+      std::shared_future<vk::Pipeline> result;
+
+      VulkanPipelineCompile(std::function<vk::Pipeline()> build)
+        : task(std::move(build))
+        , result(task.get_future().share())
+      {}
+
+      bool tryRun()
+      {
+        bool expected = false;
+        if (!started.compare_exchange_strong(expected, true))
+          return false;
+        task();
+        return true;
+      }
+
+      bool ready() const
+      {
+        return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+      }
+
+      vk::Pipeline wait()
+      {
+        tryRun();
+        return result.get();
+      }
+
+      // Pipeline to destroy with its owner. A build nobody started is dropped instead of run,
+      // its future is left broken and counts as no pipeline.
+      vk::Pipeline discard()
+      {
+        bool expected = false;
+        if (started.compare_exchange_strong(expected, true))
+        {
+          task = {};
+          return nullptr;
+        }
+        return result.get();
+      }
+    };
+
     class VulkanPipeline
     {
     public:
       vk::Pipeline            m_pipeline;
       std::shared_ptr<std::atomic<bool>> m_hasPipeline;
+      // set while m_compile holds a build that hasn't been swapped in yet
+      std::shared_ptr<std::atomic<bool>> m_compiling;
+      // first build failed, not retried until a shader changes
+      std::shared_ptr<std::atomic<bool>> m_buildFailed;
+      std::shared_ptr<VulkanPipelineCompile> m_compile;
       vk::PipelineLayout      m_pipelineLayout;
       vk::DescriptorSet       m_staticSet;
       GraphicsPipelineDescriptor m_gfxDesc;
@@ -691,10 +744,17 @@ namespace higanbana
         std::for_each(m_watchedShaders.begin(), m_watchedShaders.end(), [](std::pair<WatchFile, ShaderType>& shader){ shader.first.react();});
       }
 
+      bool built() const
+      {
+        return m_hasPipeline->load() || m_buildFailed->load();
+      }
+
       VulkanPipeline() {}
 
       VulkanPipeline(vk::PipelineLayout pipelineLayout, GraphicsPipelineDescriptor gfxDesc, vk::DescriptorSet set)
         : m_hasPipeline(std::make_shared<std::atomic<bool>>(false))
+        , m_compiling(std::make_shared<std::atomic<bool>>(false))
+        , m_buildFailed(std::make_shared<std::atomic<bool>>(false))
         , m_pipelineLayout(pipelineLayout)
         , m_staticSet(set)
         , m_gfxDesc(gfxDesc)
@@ -702,6 +762,8 @@ namespace higanbana
 
       VulkanPipeline(vk::PipelineLayout pipelineLayout, ComputePipelineDescriptor computeDesc, vk::DescriptorSet set)
         : m_hasPipeline(std::make_shared<std::atomic<bool>>(false))
+        , m_compiling(std::make_shared<std::atomic<bool>>(false))
+        , m_buildFailed(std::make_shared<std::atomic<bool>>(false))
         , m_pipelineLayout(pipelineLayout)
         , m_staticSet(set)
         , m_computeDesc(computeDesc)
@@ -710,6 +772,8 @@ namespace higanbana
       VulkanPipeline(vk::Pipeline pipeline, vk::PipelineLayout pipelineLayout, ComputePipelineDescriptor computeDesc, vk::DescriptorSet set)
         : m_pipeline(pipeline)
         , m_hasPipeline(std::make_shared<std::atomic<bool>>(true))
+        , m_compiling(std::make_shared<std::atomic<bool>>(false))
+        , m_buildFailed(std::make_shared<std::atomic<bool>>(false))
         , m_pipelineLayout(pipelineLayout)
         , m_staticSet(set)
         , m_computeDesc(computeDesc)
@@ -1460,6 +1524,7 @@ namespace higanbana
       void handleBinding(VulkanDevice* device, vk::CommandBuffer buffer, gfxpacket::ResourceBindingGraphics& packet, ResourceHandle pipeline);
       void handleBinding(VulkanDevice* device, vk::CommandBuffer buffer, gfxpacket::ResourceBindingCompute& packet, ResourceHandle pipeline);
       void addCommands(VulkanDevice* device, vk::CommandBuffer buffer, MemView<backend::CommandBuffer*>& buffers, BarrierSolver& solver);
+      void ensureRenderpass(VulkanDevice* device, gfxpacket::RenderPassBegin& renderpasspacket);
       void handleRenderpass(VulkanDevice* device, gfxpacket::RenderPassBegin& renderpasspacket);
       void preprocess(VulkanDevice* device, MemView<backend::CommandBuffer*>& list);
       VkUploadBlockGPU allocateConstants(size_t size);
@@ -77,7 +77,9 @@ TextureData& World::getTexture(int index) {
   return rawTextureData[index];
 }
 
-css::Task<void> loadImageAsync(higanbana::FileSystem& fs, TextureData& rtd, std::string filepath) {
+css::Task<void> loadImageAsync(higanbana::FileSystem& fs, TextureData& rtd, std::string filepath, higanbana::FileRead read) {
+  // prefetched, once it is in the decoder reads it from the cache
+  read.get();
   rtd.image = higanbana::textureUtils::loadImageFromFilesystem(fs, filepath, false);
   co_return;
 }
@@ -118,6 +120,28 @@ css::Task<void> World::loadGLTFSceneCgltfTasked(higanbana::Database<2048>& datab
       HIGAN_CPU_BRACKET(gltfFileName.c_str());
       HIGAN_LOGi("cgltf: opened %s successfully\n", file.c_str());
 
+      // every buffer and image starts reading now, entity setup below overlaps the io.
+      auto imagePath = [&](const char* uri) {
+        std::string path = uri;
+        if (path[0] == '.')
+          path = path.substr(2);
+        return parentDir + path;
+      };
+      higanbana::unordered_map<std::string, higanbana::FileRead> prefetched;
+      {
+        HIGAN_CPU_BRACKET("prefetch buffers and images");
+        higanbana::vector<std::string> prefetchPaths;
+        for (auto&& buffer : higanbana::MemView(data->buffers, data->buffers_count))
+          if (buffer.uri)
+            prefetchPaths.push_back(parentDir + buffer.uri);
+        for (auto&& image : higanbana::MemView(data->images, data->images_count))
+          if (image.uri)
+            prefetchPaths.push_back(imagePath(image.uri));
+        auto reads = fs.readFilesAsync(prefetchPaths);
+        for (size_t i = 0; i < reads.size(); ++i)
+          prefetched[prefetchPaths[i]] = reads[i];
+      }
+
       {
         higanbana::unordered_map<cgltf_scene*, higanbana::Id> scenes;
         higanbana::vector<higanbana::Id> sceness;
@@ -160,10 +184,8 @@ css::Task<void> World::loadGLTFSceneCgltfTasked(higanbana::Database<2048>& datab
           }
           higanbana::vector<css::Task<void>> tasks;
           for (int i = 0; i < data->images_count; ++i) {
-            std::string funnystring = data->images[i].uri;
-            if (funnystring[0] == '.')
-              funnystring = funnystring.substr(2);
-            tasks.emplace_back(loadImageAsync(fs, rawTextureData[(*ids)[i]], parentDir + funnystring));
+            auto path = imagePath(data->images[i].uri);
+            tasks.emplace_back(loadImageAsync(fs, rawTextureData[(*ids)[i]], path, prefetched[path]));
           }
           for (auto&& task : tasks)
             co_await task;
@@ -174,6 +196,7 @@ css::Task<void> World::loadGLTFSceneCgltfTasked(higanbana::Database<2048>& datab
           for (auto&& view : higanbana::MemView(data->buffer_views, data->buffer_views_count))
           {
             auto& buf = *view.buffer;
+            prefetched[parentDir+buf.uri].get();
             auto dataView = fs.viewToFile(parentDir+buf.uri);
             std::vector<uint8_t> copy;
             {
@@ -0,0 +1,190 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/filesystem/asset_archive.hpp>
+#include <higanbana/core/filesystem/block_compression.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+using namespace higanbana;
+
+namespace
+{
+std::vector<uint8_t> bytesOf(const std::string& str)
+{
+  return std::vector<uint8_t>(str.begin(), str.end());
+}
+
+// text-ish, compresses well
+std::vector<uint8_t> repetitive(size_t size, int seed)
+{
+  std::mt19937 gen(seed);
+  const char* words[] = {"float4 ", "return ", "SV_Target ", "texture ", "sampler ", ";\n", "main() ", "{ ", "} "};
+  std::vector<uint8_t> out;
+  while (out.size() < size)
+  {
+    const char* word = words[gen() % 9];
+    out.insert(out.end(), word, word + strlen(word));
+  }
+  out.resize(size);
+  return out;
+}
+
+std::vector<uint8_t> noise(size_t size, int seed)
+{
+  std::mt19937 gen(seed);
+  std::vector<uint8_t> out(size);
+  for (auto& byte : out)
+    byte = static_cast<uint8_t>(gen());
+  return out;
+}
+
+struct TempArchive
+{
+  std::filesystem::path path;
+  TempArchive(const char* name)
+    : path(std::filesystem::temp_directory_path() / name)
+  {
+  }
+  ~TempArchive()
+  {
+    std::error_code error;
+    std::filesystem::remove(path, error);
+  }
+};
+}
+
+TEST_CASE("block compression round trips") {
+  for (auto input : {repetitive(200000, 1), noise(70000, 2), std::vector<uint8_t>(100000, 7), bytesOf("tiny"), std::vector<uint8_t>()})
+  {
+    std::vector<uint8_t> compressed(blockCompression::compressBound(input.size()));
+    auto size = blockCompression::compress(input.data(), input.size(), compressed.data(), compressed.size());
+    REQUIRE(size > 0);
+    std::vector<uint8_t> output(input.size());
+    REQUIRE(blockCompression::decompress(compressed.data(), size, output.data(), output.size()));
+    REQUIRE(output == input);
+    // wrong size or truncated input is an error, not a crash
+    if (!input.empty())
+    {
+      std::vector<uint8_t> wrong(input.size() + 1);
+      REQUIRE(!blockCompression::decompress(compressed.data(), size, wrong.data(), wrong.size()));
+      REQUIRE(!blockCompression::decompress(compressed.data(), size - 1, output.data(), output.size()));
+    }
+  }
+  auto text = repetitive(64 * 1024, 3);
+  std::vector<uint8_t> compressed(blockCompression::compressBound(text.size()));
+  REQUIRE(blockCompression::compress(text.data(), text.size(), compressed.data(), compressed.size()) < text.size() / 2);
+  // too small an output fails cleanly
+  REQUIRE(blockCompression::compress(text.data(), text.size(), compressed.data(), 100) == 0);
+}
+
+TEST_CASE("asset archive round trips files") {
+  TempArchive temp("higanbana_test_archive.hpak");
+  auto text = repetitive(300000, 4);
+  auto random = noise(100000, 5);
+  AssetArchiveBuilder builder;
+  builder.add("/shaders/a.hlsl", text, true);
+  builder.add("/shaders/copy_of_a.hlsl", text, true);
+  builder.add("/textures/noise.bin", random, true);
+  builder.add("/empty.txt", {}, true);
+  builder.add("/readme.txt", bytesOf("hello archive"), false);
+  for (int i = 0; i < 300; ++i)
+    builder.add("/many/file" + std::to_string(i), bytesOf("contents " + std::to_string(i)), false);
+  AssetArchiveBuilder::Stats stats;
+  REQUIRE(builder.write(temp.path.string().c_str(), &stats));
+  REQUIRE(stats.files == 305);
+  REQUIRE(stats.deduplicated == 1);
+  REQUIRE(stats.compressed == 1);
+  REQUIRE(stats.storedBytes < stats.bytes);
+
+  auto archive = AssetArchive::open(temp.path.string().c_str());
+  REQUIRE(archive);
+  REQUIRE(archive->entryCount() == 305);
+  REQUIRE(archive->find("/missing") < 0);
+  REQUIRE(archive->find("shaders/a.hlsl") < 0);
+
+  auto a = archive->find("/shaders/a.hlsl");
+  auto copy = archive->find("/shaders/copy_of_a.hlsl");
+  REQUIRE(a >= 0);
+  REQUIRE(copy >= 0);
+  REQUIRE((archive->entry(a).flags & AssetArchive::Compressed));
+  REQUIRE(archive->entry(a).offset == archive->entry(copy).offset);
+  auto blob = archive->contents(a);
+  REQUIRE(std::vector<uint8_t>(blob.cdata(), blob.cdata() + blob.size()) == text);
+  // decompressed once and shared
+  REQUIRE(archive->contents(a).cdata() == blob.cdata());
+
+  // noise didn't compress and is stored aligned inside the mapping
+  auto noiseIndex = archive->find("/textures/noise.bin");
+  REQUIRE(!(archive->entry(noiseIndex).flags & AssetArchive::Compressed));
+  auto noiseBlob = archive->contents(noiseIndex);
+  REQUIRE(std::vector<uint8_t>(noiseBlob.cdata(), noiseBlob.cdata() + noiseBlob.size()) == random);
+  REQUIRE(reinterpret_cast<uintptr_t>(noiseBlob.cdata()) % 64 == 0);
+
+  REQUIRE(archive->contents(archive->find("/empty.txt")).size() == 0);
+  for (int i = 0; i < 300; ++i)
+  {
+    auto index = archive->find("/many/file" + std::to_string(i));
+    REQUIRE(index >= 0);
+    auto contents = archive->contents(index);
+    REQUIRE(std::string(reinterpret_cast<const char*>(contents.cdata()), contents.size()) == "contents " + std::to_string(i));
+  }
+
+  // range reads across chunk borders only need the chunks they touch
+  std::vector<uint8_t> range(100000);
+  size_t offset = AssetArchive::ChunkSize - 1000;
+  REQUIRE(archive->read(a, offset, range.data(), range.size()) == range.size());
+  REQUIRE(std::equal(range.begin(), range.end(), text.begin() + offset));
+  REQUIRE(archive->read(a, text.size() - 10, range.data(), range.size()) == 10);
+  REQUIRE(archive->read(a, text.size(), range.data(), range.size()) == 0);
+}
+
+TEST_CASE("asset archive rejects other files") {
+  TempArchive temp("higanbana_test_not_archive.hpak");
+  REQUIRE(!AssetArchive::open(temp.path.string().c_str()));
+  std::ofstream(temp.path, std::ios::binary) << "definitely not an archive, just some text that is long enough for a header";
+  REQUIRE(!AssetArchive::open(temp.path.string().c_str()));
+}
+
+TEST_CASE("asset archive write leaves nothing behind on failure") {
+  TempArchive temp("higanbana_test_failed_archive.hpak");
+  AssetArchiveBuilder builder;
+  builder.add("/readme.txt", bytesOf("hello archive"), false);
+  builder.addFile("/gone.txt", (temp.path.string() + ".missing"), false);
+  REQUIRE(!builder.write(temp.path.string().c_str()));
+  REQUIRE(!std::filesystem::exists(temp.path));
+  REQUIRE(!std::filesystem::exists(temp.path.string() + ".tmp"));
+}
+
+TEST_CASE("filesystem mounts asset archives") {
+  TempArchive temp("higanbana_test_mounted.hpak");
+  auto text = repetitive(150000, 6);
+  AssetArchiveBuilder builder;
+  builder.add("/shaders/a.hlsl", text, true);
+  builder.add("/shaders/b.hlsl", bytesOf("b"), true);
+  builder.add("/scenes/scene.gltf", bytesOf("{}"), false);
+  REQUIRE(builder.write(temp.path.string().c_str()));
+
+  FileSystem fs(std::unordered_map<std::string, std::string>{});
+  REQUIRE(!fs.mountArchive("/packed", (temp.path.string() + ".missing")));
+  REQUIRE(fs.mountArchive("/packed", temp.path.string()));
+  REQUIRE(fs.fileExists("/packed/shaders/a.hlsl"));
+  REQUIRE(!fs.fileExists("/packed/shaders/c.hlsl"));
+  REQUIRE(!fs.fileExists("/other/shaders/a.hlsl"));
+
+  auto blob = fs.readFile("/packed/shaders/a.hlsl");
+  REQUIRE(std::vector<uint8_t>(blob.cdata(), blob.cdata() + blob.size()) == text);
+  REQUIRE(fs.viewToFile("/packed/shaders/b.hlsl").size() == 1);
+  auto read = fs.readFileAsync("/packed/scenes/scene.gltf");
+  REQUIRE(read.ready());
+  REQUIRE(read.get().size() == 2);
+  REQUIRE(fs.readFileAsync("/packed/missing").failed());
+
+  auto shaders = fs.recursiveList("/packed/shaders", ".hlsl");
+  std::sort(shaders.begin(), shaders.end());
+  REQUIRE(shaders == vector<std::string>{"/packed/shaders/a.hlsl", "/packed/shaders/b.hlsl"});
+  REQUIRE(fs.recursiveList("/packed", ".gltf").size() == 1);
+  REQUIRE(!fs.writeFile("/packed/shaders/a.hlsl", MemView<const uint8_t>(text.data(), text.size())));
+}
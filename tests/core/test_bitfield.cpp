@@ -1,5 +1,6 @@
 #include <catch2/catch_all.hpp>
 #include <higanbana/core/entity/bitfield.hpp>
+#include <vector>
 
 using namespace higanbana;
 
@@ -22,4 +23,53 @@ TEST_CASE( "simple bitfield test" ) {
   REQUIRE( index == 74);
   index = bits.findFirstSetBit(index+1);
   REQUIRE( index == 75);
-}
\ No newline at end of file
+}
+TEST_CASE( "bitfield kernels agree on every simd level" ) {
+  using namespace bitfieldUtils;
+  const SimdLevel best = simdLevel();
+  constexpr size_t buckets = 1000; // not a multiple of any vector width
+  std::vector<DynamicBitfield> fields(5);
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (auto& field : fields) {
+    field.reserveBuckets(buckets);
+    for (size_t i = 0; i < buckets * 128; ++i) {
+      state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+      // full region, empty region and noise so that scans stop at odd places
+      bool bit = i < 300 * 128 || (i >= 600 * 128 && i < 777 * 128 ? false : (state & 3) != 0);
+      if (bit)
+        field.setBit(i);
+    }
+  }
+  size_t refAnd = 0;
+  size_t refOr = 0;
+  for (size_t i = 0; i < buckets * 128; ++i) {
+    bool all = true;
+    for (auto& field : fields)
+      all &= field.checkBit(i);
+    refAnd += all;
+    refOr += fields[0].checkBit(i) || fields[1].checkBit(i);
+  }
+
+  for (auto level : {SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512}) {
+    if (setSimdLevel(level) != level)
+      continue;
+    const __m128i* sources[5];
+    for (size_t s = 0; s < fields.size(); ++s)
+      sources[s] = fields[s].data();
+    DynamicBitfield out;
+    out.reserveBuckets(buckets);
+    intersect(out.data(), sources, fields.size(), buckets);
+    REQUIRE( out.setBits() == refAnd );
+    REQUIRE( popcount(out.data(), buckets) == refAnd );
+    unite(out.data(), fields[0].data(), fields[1].data(), buckets);
+    REQUIRE( out.setBits() == refOr );
+
+    REQUIRE( fields[0].contiguous_full_buckets(0) == 300 );
+    REQUIRE( fields[0].contiguous_full_buckets(3) == 297 );
+    REQUIRE( fields[0].nextPopBucket(600) == 777 );
+    REQUIRE( fields[0].nextPopBucket(601) == 777 );
+    REQUIRE( leadingEmpty(fields[0].data() + 600, 177) == 177 );
+    REQUIRE( leadingFull(fields[0].data(), 299) == 299 );
+  }
+  setSimdLevel(best);
+}
@@ -0,0 +1,80 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/thread/cpu_info.hpp>
+#include <higanbana/core/system/LBS.hpp>
+#include <algorithm>
+#include <set>
+
+namespace
+{
+// 2 nodes, 2 L3 per node, 2 cores per L3, 2 threads per core. cpu n and n+16 are siblings like on linux.
+std::vector<higanbana::LogicalCpu> fakeDualSocket()
+{
+  std::vector<higanbana::LogicalCpu> cpus;
+  for (int core = 0; core < 8; ++core)
+  {
+    cpus.push_back({core, core, core / 2, core / 4});
+    cpus.push_back({core + 16, core, core / 2, core / 4});
+  }
+  return cpus;
+}
+}
+
+TEST_CASE("cpu info probe finds every allowed cpu once")
+{
+  higanbana::SystemCpuInfo info;
+  REQUIRE(!info.logical.empty());
+  std::set<int> seen;
+  for (auto& cpu : info.logical)
+    REQUIRE(seen.insert(cpu.cpu).second);
+  size_t threads = 0;
+  for (auto& numa : info.numas)
+    threads += numa.threads;
+  REQUIRE(threads == info.logical.size());
+}
+
+TEST_CASE("placement fills physical cores before smt siblings")
+{
+  higanbana::SystemCpuInfo info;
+  info.logical = fakeDualSocket();
+  auto order = info.placement(16);
+  REQUIRE(order.size() == 16);
+  for (int i = 0; i < 8; ++i)
+  {
+    REQUIRE(order[i].cpu == i);
+    REQUIRE(order[i + 8].cpu == i + 16);
+  }
+  auto small = info.placement(4);
+  REQUIRE(small.size() == 4);
+  REQUIRE(small.back().numa == 0);
+  auto over = info.placement(20);
+  REQUIRE(over.size() == 20);
+  REQUIRE(over[16].cpu == 0);
+}
+
+TEST_CASE("cpu distance prefers sibling then l3 then node")
+{
+  using higanbana::SystemCpuInfo;
+  auto cpus = fakeDualSocket();
+  REQUIRE(SystemCpuInfo::distance(cpus[0], cpus[1]) == 0);
+  REQUIRE(SystemCpuInfo::distance(cpus[0], cpus[2]) == 1);
+  REQUIRE(SystemCpuInfo::distance(cpus[0], cpus[4]) == 2);
+  REQUIRE(SystemCpuInfo::distance(cpus[0], cpus[8]) == 3);
+}
+
+TEST_CASE("lbs works pinned and unpinned")
+{
+  using namespace higanbana;
+  for (auto placement : {ThreadPlacement::Automatic, ThreadPlacement::Pinned, ThreadPlacement::Free})
+  {
+    LBS lbs(4, placement);
+    constexpr size_t testSize = 10000;
+    std::vector<int> v(testSize, 0);
+    lbs.addParallelFor<16>("fill", {}, {}, 0, testSize, [&v](size_t i)
+    {
+      v[i] = static_cast<int>(i);
+    });
+    lbs.sleepTillKeywords({ "fill" });
+    for (size_t i = 0; i < testSize; ++i)
+      REQUIRE(v[i] == static_cast<int>(i));
+  }
+}
@@ -4,6 +4,7 @@
 #include <higanbana/core/entity/database.hpp>
 
 #include <catch2/catch_all.hpp>
+#include <atomic>
 
 struct Position
 {
@@ -51,3 +52,144 @@ TEST_CASE("entity operations")
   });
   REQUIRE(count == 1);
 }
+
+struct Selected {};
+
+TEST_CASE("entity ids grow past the sizing hint")
+{
+  using namespace higanbana;
+  Database<2> db;
+  auto& mass = db.get<Mass>();
+  auto& selected = db.getTag<Selected>();
+
+  constexpr size_t count = 2048 * 128 + 1000;
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto e = db.createEntity();
+    REQUIRE(e == i);
+    mass.insert(e, Mass{static_cast<float>(e)});
+    if (e % 3 == 0)
+      selected.insert(e);
+  }
+  REQUIRE(db.entityCount() == count);
+
+  size_t seen = 0;
+  size_t expected = 0;
+  query(pack(mass), [&](higanbana::Id id, Mass& m)
+  {
+    REQUIRE(id == expected);
+    REQUIRE(m.mass == static_cast<float>(id));
+    ++expected;
+    ++seen;
+  });
+  REQUIRE(seen == count);
+
+  seen = 0;
+  query(pack(mass), pack(selected), [&](higanbana::Id id, Mass&)
+  {
+    REQUIRE(id % 3 == 0);
+    ++seen;
+  });
+  REQUIRE(seen == (count + 2) / 3);
+
+  seen = 0;
+  queryTag<2048>(pack(selected), [&](higanbana::Id id)
+  {
+    REQUIRE(id % 3 == 0);
+    ++seen;
+  });
+  REQUIRE(seen == (count + 2) / 3);
+
+  // deleted ids are handed out again
+  db.deleteEntity(1234);
+  REQUIRE(!mass.check(1234));
+  REQUIRE(db.createEntity() == 1234);
+  REQUIRE(db.createEntity() == count);
+}
+
+TEST_CASE("sparse component pages are allocated on first write")
+{
+  using namespace higanbana;
+  Database<2048> db;
+  auto& pos = db.get<Position>();
+  auto& mass = db.get<Mass>();
+  REQUIRE(pos.populatedPages() == 0);
+
+  constexpr size_t far = 5'000'000;
+  pos.insert(3, Position{float4(1.f)});
+  pos.insert(far, Position{float4(2.f)});
+  mass.insert(far, Mass{4.f});
+  mass.insert(far + 1, Mass{5.f});
+  REQUIRE(pos.populatedPages() == 2);
+  REQUIRE(mass.populatedPages() == 1);
+  REQUIRE(!pos.hasPage(1));
+  REQUIRE(pos.tryGet(far + 1).has_value() == false);
+
+  int count = 0;
+  query(pack(pos, mass), [&](higanbana::Id id, Position& p, Mass& m)
+  {
+    REQUIRE(id == far);
+    REQUIRE(p.val.x == 2.f);
+    REQUIRE(m.mass == 4.f);
+    count++;
+  });
+  REQUIRE(count == 1);
+
+  pos.remove(far);
+  count = 0;
+  query(pack(pos, mass), [&](higanbana::Id, Position&, Mass&) { count++; });
+  REQUIRE(count == 0);
+}
+
+TEST_CASE("parallel query visits every matching entity once")
+{
+  using namespace higanbana;
+  css::createThreadPool();
+  Database<2048> db;
+  auto& pos = db.get<Position>();
+  auto& mass = db.get<Mass>();
+  auto& selected = db.getTag<Selected>();
+
+  // uneven density so that splitting by bucket count would be unbalanced
+  constexpr size_t count = 200000;
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto e = db.createEntity();
+    mass.insert(e, Mass{0.f});
+    if (i < count / 2 || i % 7 == 0)
+      pos.insert(e, Position{float4(1.f)});
+    if (i % 2 == 0)
+      selected.insert(e);
+  }
+
+  auto splits = splitByPopcount(pos.getBitfield(), 8);
+  REQUIRE(splits.size() == 8);
+  REQUIRE(splits.back() == pos.getBitfield().buckets());
+
+  auto task = queryParallel(pack(pos, mass), [](higanbana::Id, Position&, Mass& m)
+  {
+    m.mass += 1.f;
+  }, 8);
+  task.wait();
+  size_t visited = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    bool expected = i < count / 2 || i % 7 == 0;
+    REQUIRE(mass.get(i).mass == (expected ? 1.f : 0.f));
+    visited += expected;
+  }
+
+  std::atomic<size_t> tagged = 0;
+  std::atomic<size_t> wrong = 0;
+  auto tagTask = queryParallel(pack(pos), pack(selected), [&](higanbana::Id id, Position&)
+  {
+    wrong += id % 2;
+    tagged++;
+  });
+  tagTask.wait();
+  REQUIRE(wrong == 0);
+  size_t serial = 0;
+  query(pack(pos), pack(selected), [&](higanbana::Id, Position&) { serial++; });
+  REQUIRE(tagged == serial);
+  REQUIRE(serial < visited);
+}
@@ -0,0 +1,248 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/filesystem/filesystem.hpp>
+#include <higanbana/core/filesystem/async_file_reader.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace higanbana;
+
+namespace
+{
+struct TempTree
+{
+  std::filesystem::path root;
+  TempTree(const char* name)
+    : root(std::filesystem::temp_directory_path() / name)
+  {
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "sub");
+  }
+  ~TempTree()
+  {
+    std::error_code error;
+    std::filesystem::remove_all(root, error);
+  }
+  void write(const std::string& relative, const std::string& contents)
+  {
+    std::ofstream file(root / relative, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size());
+  }
+};
+
+std::string asString(MemView<const uint8_t> view)
+{
+  return std::string(reinterpret_cast<const char*>(view.data()), view.size());
+}
+}
+
+TEST_CASE("filesystem modes return the same contents") {
+  TempTree tree("higanbana_test_fs_modes");
+  std::string big(FileSystem::MapThreshold * 2, 'x');
+  big[1234] = 'y';
+  tree.write("small.txt", "small file");
+  tree.write("sub/big.bin", big);
+  tree.write("empty.txt", "");
+
+  for (auto mode : {FileSystem::LoadMode::ReadEverything, FileSystem::LoadMode::MapOnDemand})
+  {
+    FileSystem fs({{"/data", tree.root.string()}}, mode);
+    REQUIRE(fs.fileExists("/data/small.txt"));
+    REQUIRE(fs.fileExists("/data/sub/big.bin"));
+    REQUIRE(!fs.fileExists("/data/missing.txt"));
+    REQUIRE(asString(fs.viewToFile("/data/small.txt")) == "small file");
+    REQUIRE(asString(fs.viewToFile("/data/sub/big.bin")) == big);
+    REQUIRE(fs.viewToFile("/data/empty.txt").size() == 0);
+
+    // readFile shares the bytes with the view
+    auto blob = fs.readFile("/data/sub/big.bin");
+    REQUIRE(blob.size() == big.size());
+    REQUIRE(blob.cdata() == fs.viewToFile("/data/sub/big.bin").data());
+  }
+}
+
+TEST_CASE("filesystem map on demand loads on first access") {
+  TempTree tree("higanbana_test_fs_lazy");
+  std::string before(FileSystem::MapThreshold, 'a');
+  std::string after(FileSystem::MapThreshold, 'b');
+  tree.write("lazy.bin", before);
+  tree.write("lazy.txt", "before");
+
+  FileSystem fs({{"/data", tree.root.string()}}, FileSystem::LoadMode::MapOnDemand);
+  fs.initialLoad();
+  // nothing was read yet so the contents on disk at first access win
+  tree.write("lazy.bin", after);
+  tree.write("lazy.txt", "after!");
+  REQUIRE(asString(fs.viewToFile("/data/lazy.bin")) == after);
+  auto blob = fs.readFile("/data/lazy.txt");
+  REQUIRE(asString(MemView<const uint8_t>(blob.cdata(), blob.size())) == "after!");
+}
+
+TEST_CASE("filesystem blobs outlive writes") {
+  TempTree tree("higanbana_test_fs_write");
+  std::string original(FileSystem::MapThreshold * 4, 'o');
+  tree.write("asset.bin", original);
+
+  for (auto mode : {FileSystem::LoadMode::ReadEverything, FileSystem::LoadMode::MapOnDemand})
+  {
+    FileSystem fs({{"/data", tree.root.string()}}, mode);
+    auto blob = fs.readFile("/data/asset.bin");
+    std::string replacement = "replaced";
+    REQUIRE(fs.writeFile("/data/asset.bin", reinterpret_cast<const uint8_t*>(replacement.data()), replacement.size()));
+    REQUIRE(asString(fs.viewToFile("/data/asset.bin")) == replacement);
+    // old blob still sees the contents it was read with
+    REQUIRE(asString(MemView<const uint8_t>(blob.cdata(), blob.size())) == original);
+    REQUIRE(fs.writeFile("/data/asset.bin", reinterpret_cast<const uint8_t*>(original.data()), original.size()));
+  }
+}
+
+TEST_CASE("async file reader backends read whole files") {
+  TempTree tree("higanbana_test_fs_reader");
+  vector<std::string> expected;
+  for (int i = 0; i < 300; ++i)
+  {
+    expected.push_back(std::string(1 + i * 997, static_cast<char>('a' + i % 26)));
+    tree.write("file" + std::to_string(i), expected.back());
+  }
+  for (auto backend : {AsyncFileReader::Backend::IoUring, AsyncFileReader::Backend::Threads})
+  {
+    AsyncFileReader reader(backend, 3);
+    vector<std::shared_ptr<FileReadState>> reads;
+    for (int i = 0; i < 300; ++i)
+    {
+      reads.push_back(std::make_shared<FileReadState>());
+      reads.back()->nativePath = (tree.root / ("file" + std::to_string(i))).string();
+    }
+    auto missing = std::make_shared<FileReadState>();
+    missing->nativePath = (tree.root / "missing").string();
+    reads.push_back(missing);
+    reader.submit(MemView<std::shared_ptr<FileReadState>>(reads));
+    for (int i = 0; i < 300; ++i)
+    {
+      reads[i]->wait();
+      REQUIRE(reads[i]->status == FileReadState::Done);
+      REQUIRE(asString(MemView<const uint8_t>(reads[i]->data, reads[i]->size)) == expected[i]);
+    }
+    missing->wait();
+    REQUIRE(missing->status == FileReadState::Failed);
+  }
+}
+
+TEST_CASE("filesystem async reads fill the cache") {
+  TempTree tree("higanbana_test_fs_async");
+  vector<std::string> paths;
+  for (int i = 0; i < 64; ++i)
+  {
+    tree.write("sub/asset" + std::to_string(i), std::string(FileSystem::MapThreshold + i, static_cast<char>('A' + i % 26)));
+    paths.push_back("/data/sub/asset" + std::to_string(i));
+  }
+  paths.push_back("/data/missing");
+  FileSystem fs({{"/data", tree.root.string()}}, FileSystem::LoadMode::MapOnDemand);
+  auto reads = fs.readFilesAsync(paths);
+  REQUIRE(reads.size() == paths.size());
+  for (int i = 0; i < 64; ++i)
+  {
+    auto blob = reads[i].get();
+    REQUIRE(!reads[i].failed());
+    REQUIRE(blob.size() == FileSystem::MapThreshold + i);
+    REQUIRE(blob.cdata()[i] == 'A' + i % 26);
+    // cached, the sync path sees the same bytes
+    REQUIRE(fs.viewToFile(paths[i]).data() == blob.cdata());
+  }
+  REQUIRE(reads.back().get().size() == 0);
+  REQUIRE(reads.back().failed());
+  // already loaded files complete without io
+  auto again = fs.readFileAsync(paths[0]);
+  REQUIRE(again.ready());
+  REQUIRE(again.get().cdata() == fs.viewToFile(paths[0]).data());
+}
+
+TEST_CASE("filesystem lookups from many threads") {
+  TempTree tree("higanbana_test_fs_threads");
+  for (int i = 0; i < 32; ++i)
+    tree.write("f" + std::to_string(i), std::to_string(i));
+  FileSystem fs({{"/data", tree.root.string()}}, FileSystem::LoadMode::MapOnDemand);
+  fs.initialLoad();
+  std::atomic<int> mismatches = 0;
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      for (int round = 0; round < 200; ++round)
+      {
+        int i = (round * 7 + t) % 32;
+        auto path = "/data/f" + std::to_string(i);
+        auto blob = fs.readFile(path);
+        if (asString(MemView<const uint8_t>(blob.cdata(), blob.size())) != std::to_string(i))
+          mismatches++;
+        if (!fs.fileExists(path))
+          mismatches++;
+      }
+    });
+  }
+  for (auto&& thread : threads)
+    thread.join();
+  REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("filesystem watched files notice changes and dependencies") {
+  TempTree tree("higanbana_test_fs_watch");
+  tree.write("shader.hlsl", "#include \"common.hlsl\"");
+  tree.write("common.hlsl", "v1");
+  tree.write("other.hlsl", "untouched");
+
+  FileSystem fs({{"/data", tree.root.string()}});
+  auto shader = fs.watchFile("/data/shader.hlsl", vector<std::string>{"/data/common.hlsl"});
+  auto other = fs.watchFile("/data/other.hlsl");
+  REQUIRE(!shader.empty());
+  fs.updateWatchedFiles();
+  REQUIRE(!shader.updated());
+  REQUIRE(!other.updated());
+
+  // keep the new write time apart from the old one on coarse clocks
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  tree.write("common.hlsl", "v2");
+  // the watcher thread or the rolling poll gets to it eventually
+  for (int i = 0; i < 200 && !shader.updated(); ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    fs.updateWatchedFiles();
+  }
+  REQUIRE(shader.updated());
+  REQUIRE(!other.updated());
+  REQUIRE(asString(fs.viewToFile("/data/common.hlsl")) == "v2");
+  shader.react();
+  fs.updateWatchedFiles();
+  REQUIRE(!shader.updated());
+}
+
+TEST_CASE("filesystem watched files survive their directory being recreated") {
+  TempTree tree("higanbana_test_fs_rewatch");
+  tree.write("sub/shader.hlsl", "v1");
+
+  FileSystem fs({{"/data", tree.root.string()}});
+  auto shader = fs.watchFile("/data/sub/shader.hlsl");
+  REQUIRE(!shader.empty());
+
+  // what git checkouts and some editors do
+  std::filesystem::remove_all(tree.root / "sub");
+  for (int i = 0; i < 20; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    fs.updateWatchedFiles();
+  }
+  std::filesystem::create_directories(tree.root / "sub");
+  tree.write("sub/shader.hlsl", "v2");
+  for (int i = 0; i < 200 && !shader.updated(); ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    fs.updateWatchedFiles();
+  }
+  REQUIRE(shader.updated());
+  REQUIRE(asString(fs.viewToFile("/data/sub/shader.hlsl")) == "v2");
+}
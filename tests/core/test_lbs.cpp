@@ -0,0 +1,97 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/system/LBS.hpp>
+
+#include <vector>
+#include <string>
+#include <atomic>
+
+TEST_CASE("lbs parallel for from different thread counts")
+{
+  using namespace higanbana;
+  for (int threads : {1, 2, 4, 8})
+  {
+    LBS lbs(threads);
+    constexpr size_t testSize = 100000;
+    std::vector<int> v(testSize, 1);
+    lbs.addParallelFor<64>("clear", {}, {}, 0, testSize, [&v](size_t i)
+    {
+      v[i] = 0;
+    });
+    lbs.addParallelFor<64>("fill", { "clear" }, {}, 0, testSize, [&v](size_t i)
+    {
+      v[i] += static_cast<int>(i);
+    });
+    lbs.sleepTillKeywords({ "fill" });
+    for (size_t i = 0; i < testSize; ++i)
+      REQUIRE(v[i] == static_cast<int>(i));
+  }
+}
+
+TEST_CASE("lbs adaptive parallel for runs every iteration once")
+{
+  using namespace higanbana;
+  for (int threads : {1, 2, 4, 8})
+  {
+    LBS lbs(threads);
+    for (size_t testSize : {size_t(1), size_t(37), size_t(200000)})
+    {
+      std::vector<std::atomic<int>> v(testSize);
+      for (auto& it : v)
+        it = 0;
+      lbs.addParallelForAuto("cheap", {}, {}, 0, testSize, [&v](size_t i)
+      {
+        v[i]++;
+      });
+      lbs.addParallelForAuto(desc::Task("costly", { "cheap" }, {}), 0, (testSize + 15) / 16, [&v](size_t i)
+      {
+        int sum = 0;
+        for (int k = 0; k < 1000; ++k)
+          sum += k ^ static_cast<int>(i);
+        v[i] += 1 + (sum & 0);
+      }, std::chrono::microseconds(20));
+      lbs.sleepTillKeywords({ "costly" });
+      for (size_t i = 0; i < testSize; ++i)
+        REQUIRE(v[i] == (i < (testSize + 15) / 16 ? 2 : 1));
+    }
+  }
+}
+
+TEST_CASE("lbs requirement chains and fan in")
+{
+  using namespace higanbana;
+  LBS lbs(4);
+  std::atomic<int> order = 0;
+  std::vector<int> seen(64, -1);
+  // added in reverse so that every task has to wait
+  for (int i = 63; i > 0; --i)
+  {
+    lbs.addTask("chain" + std::to_string(i), { "chain" + std::to_string(i - 1) }, {}, [&, i](size_t)
+    {
+      seen[i] = order++;
+    });
+  }
+  lbs.addTask("chain0", {}, {}, [&](size_t)
+  {
+    seen[0] = order++;
+  });
+  lbs.sleepTillKeywords({ "chain63" });
+  for (int i = 0; i < 64; ++i)
+    REQUIRE(seen[i] == i);
+
+  std::atomic<int> finished = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    lbs.addTask("leaf" + std::to_string(i), {}, {}, [&](size_t)
+    {
+      finished++;
+    });
+  }
+  int whenJoined = -1;
+  lbs.addTask("join", { "leaf0", "leaf1", "leaf2", "leaf3", "leaf4", "leaf5", "leaf6", "leaf7",
+    "leaf8", "leaf9", "leaf10", "leaf11", "leaf12", "leaf13", "leaf14", "leaf15" }, {}, [&](size_t)
+  {
+    whenJoined = finished.load();
+  });
+  lbs.sleepTillKeywords({ "join" });
+  REQUIRE(whenJoined == 16);
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/system/logger.hpp>
+#include <higanbana/core/global_debug.hpp>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace higanbana;
+
+namespace
+{
+struct CapturedOutput
+{
+  std::mutex lock;
+  std::string text;
+  CapturedOutput()
+  {
+    log::setOutput([this](std::string_view out) {
+      std::lock_guard<std::mutex> guard(lock);
+      text += out;
+    });
+  }
+  ~CapturedOutput()
+  {
+    log::setOutput(nullptr);
+  }
+  std::string get()
+  {
+    log::flush();
+    std::lock_guard<std::mutex> guard(lock);
+    return text;
+  }
+};
+
+int evaluations = 0;
+int counted(int value)
+{
+  ++evaluations;
+  return value;
+}
+}
+
+TEST_CASE("deferred log formats like printf on the log thread") {
+  Logger logger;
+  CapturedOutput output;
+  {
+    std::string temporary = "gone before formatting";
+    HIGAN_LOG("%d %u %zu %.2f %s %c %s\n", -5, 7u, size_t(1) << 40, 2.5f, temporary.c_str(), 'x', "literal");
+    temporary.assign(temporary.size(), '#');
+  }
+  HIGAN_SLOG("Prefix", "%lld\n", -1234567890123ll);
+  HIGAN_LOG_UNFORMATTED("raw %s", "text\n");
+  HIGAN_DEBUG_LOG("debug\n");
+  std::string expected = "[Output] -5 7 1099511627776 2.50 gone before formatting x literal\n"
+    "[Prefix] -1234567890123\n"
+    "raw text\n"
+    + std::string(__FILE__) + "(" + std::to_string(__LINE__ - 4) + "): debug\n";
+  REQUIRE(output.get() == expected);
+
+  // long strings are clipped to what fits in a record instead of dropping the message
+  std::string huge(10000, 'a');
+  HIGAN_LOG_UNFORMATTED("%s|%d\n", huge.c_str(), 42);
+  auto text = output.get().substr(expected.size());
+  REQUIRE(text.size() < log::RecordSize);
+  REQUIRE(text.find("aaaa|42\n") != std::string::npos);
+}
+
+TEST_CASE("filtered log levels don't evaluate arguments") {
+  evaluations = 0;
+  // nobody prints without a Logger
+  HIGAN_LOG("%d\n", counted(1));
+  REQUIRE(evaluations == 0);
+  {
+    Logger logger;
+    CapturedOutput output;
+    log::setLevelEnabled(log::Level::Debug, false);
+    HIGAN_DEBUG_LOG("%d\n", counted(2));
+    HIGAN_WLOG("Test", "%d\n", counted(3));
+    log::setLevelEnabled(log::Level::Debug, true);
+    REQUIRE(evaluations == 1);
+    REQUIRE(output.get() == "[Test] 3\n");
+  }
+  HIGAN_ELOG("Test", "%d\n", counted(4));
+  REQUIRE(evaluations == 1);
+}
+
+TEST_CASE("deferred log from many threads") {
+  Logger logger;
+  CapturedOutput output;
+  const int threads = 4;
+  const int perThread = 20000;
+  auto droppedBefore = log::droppedCount();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t)
+    workers.emplace_back([t] {
+      for (int i = 0; i < perThread; ++i)
+        HIGAN_LOG_UNFORMATTED("%d %d\n", t, i);
+    });
+  for (auto&& worker : workers)
+    worker.join();
+  auto text = output.get();
+  size_t lines = 0;
+  std::vector<int> last(threads, -1);
+  bool ordered = true;
+  for (size_t pos = 0; pos < text.size();)
+  {
+    auto end = text.find('\n', pos);
+    auto line = text.substr(pos, end - pos);
+    pos = end + 1;
+    if (line.rfind("[Log]", 0) == 0)
+      continue;
+    int t = 0, i = 0;
+    REQUIRE(sscanf(line.c_str(), "%d %d", &t, &i) == 2);
+    // each thread's messages stay in order
+    ordered &= i > last[t];
+    last[t] = i;
+    ++lines;
+  }
+  REQUIRE(ordered);
+  REQUIRE(lines + (log::droppedCount() - droppedBefore) == threads * perThread);
+}
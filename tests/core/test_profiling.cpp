@@ -0,0 +1,227 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/profiling/profiling.hpp>
+#include <higanbana/core/profiling/trace_format.hpp>
+#include <higanbana/core/system/time.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace higanbana;
+
+namespace
+{
+std::string readAndConvert(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::string json;
+  REQUIRE(profiling::convertTraceToChromeJson(MemView<const uint8_t>(bytes.data(), bytes.size()), json));
+  return json;
+}
+
+size_t count(const std::string& haystack, const std::string& needle)
+{
+  size_t found = 0;
+  for (auto pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1))
+    ++found;
+  return found;
+}
+
+void leaf()
+{
+  HIGAN_CPU_FUNCTION_SCOPE();
+}
+}
+
+TEST_CASE("profiling brackets end up in the chrome trace") {
+  auto profiler = profiling::initializeProfiling(4);
+  profiling::enableProfiling();
+  {
+    HIGAN_CPU_BRACKET("outer bracket");
+    for (int i = 0; i < 10; ++i)
+      leaf();
+  }
+  std::thread other([]() {
+    HIGAN_CPU_BRACKET("other thread");
+  });
+  other.join();
+  // same buffer with different contents must not reuse the cached name
+  std::string transient = "transient a";
+  { HIGAN_CPU_BRACKET(transient.c_str()); }
+  transient[10] = 'b';
+  { HIGAN_CPU_BRACKET(transient.c_str()); }
+  // null data like a cache entry nothing has used yet
+  { profiling::ProfilingScope empty{std::string_view()}; }
+  static_assert(!std::is_copy_constructible_v<profiling::ProfilingScope>, "copies would push their bracket twice");
+  HIGAN_GPU_BRACKET_FULL(0, 2, "gpu work", 1000, 500);
+
+  auto path = (std::filesystem::temp_directory_path() / "higanbana_test_profiling.htrace").string();
+  REQUIRE(profiling::writeProfilingTrace(profiler.get(), path));
+  auto json = readAndConvert(path);
+  std::remove(path.c_str());
+
+  REQUIRE(count(json, "\"name\":\"outer bracket\"") == 1);
+  REQUIRE(count(json, "\"name\":\"leaf\"") == 10);
+  REQUIRE(count(json, "\"name\":\"other thread\",") == 1);
+  REQUIRE(count(json, "\"name\":\"transient a\"") == 1);
+  REQUIRE(count(json, "\"name\":\"transient b\"") == 1);
+  REQUIRE(count(json, "\"name\":\"\"") == 1);
+  REQUIRE(count(json, "\"tid\":\"Thread 1\"") == 1);
+  REQUIRE(count(json, "\"tid\":\"GPU 0 Queue 2\"") == 1);
+  profiling::disableProfiling();
+}
+
+TEST_CASE("profiling capture flushes in the background") {
+  auto profiler = profiling::initializeProfiling(4);
+  profiling::enableProfiling();
+  auto path = (std::filesystem::temp_directory_path() / "higanbana_test_capture.htrace").string();
+  REQUIRE(profiling::beginTraceCapture(profiler.get(), path, std::chrono::milliseconds(1)));
+  // more than fits in one ring, writer has to keep up
+  constexpr int brackets = 200000;
+  for (int i = 0; i < brackets; ++i) {
+    HIGAN_CPU_BRACKET("captured");
+    if (i % 10000 == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  profiling::endTraceCapture(profiler.get());
+  auto json = readAndConvert(path);
+  std::remove(path.c_str());
+  auto captured = count(json, "\"name\":\"captured\"");
+  auto dropped = json.find("events dropped") != std::string::npos;
+  REQUIRE(captured > 0);
+  REQUIRE((captured == brackets || dropped));
+  profiling::disableProfiling();
+}
+
+TEST_CASE("profiling scope ended on another thread goes to that thread's ring") {
+  auto profiler = profiling::initializeProfiling(4);
+  profiling::enableProfiling();
+  // like a bracket held across co_await that resumes on another worker
+  auto moved = std::make_unique<profiling::ProfilingScope>("moved bracket");
+  constexpr int brackets = 10000;
+  std::thread other([&]() {
+    moved.reset();
+    for (int i = 0; i < brackets; ++i) {
+      HIGAN_CPU_BRACKET("other thread");
+    }
+  });
+  for (int i = 0; i < brackets; ++i) {
+    HIGAN_CPU_BRACKET("this thread");
+  }
+  other.join();
+
+  auto path = (std::filesystem::temp_directory_path() / "higanbana_test_moved_scope.htrace").string();
+  REQUIRE(profiling::writeProfilingTrace(profiler.get(), path));
+  auto json = readAndConvert(path);
+  std::remove(path.c_str());
+  REQUIRE(count(json, "\"name\":\"moved bracket\"") == 1);
+  REQUIRE(count(json, "\"name\":\"this thread\"") == brackets);
+  REQUIRE(count(json, "\"name\":\"other thread\"") == brackets);
+  profiling::disableProfiling();
+}
+
+TEST_CASE("profiling disabled records nothing") {
+  auto profiler = profiling::initializeProfiling(2);
+  {
+    HIGAN_CPU_BRACKET("not recorded");
+  }
+  profiling::enableProfiling();
+  auto path = (std::filesystem::temp_directory_path() / "higanbana_test_disabled.htrace").string();
+  REQUIRE(profiling::writeProfilingTrace(profiler.get(), path));
+  auto json = readAndConvert(path);
+  std::remove(path.c_str());
+  REQUIRE(count(json, "not recorded") == 0);
+  profiling::disableProfiling();
+}
+
+TEST_CASE("latency histogram percentiles stay within bucket precision") {
+  LatencyHistogram histogram;
+  for (int64_t i = 1; i <= 1000; ++i)
+    histogram.add(LatencyHistogram::bucketOf(i * 1000));
+  REQUIRE(histogram.count() == 1000);
+  auto near = [](int64_t value, int64_t expected) {
+    return value >= expected * 94 / 100 && value <= expected * 106 / 100;
+  };
+  REQUIRE(near(histogram.percentile(0.5), 500000));
+  REQUIRE(near(histogram.percentile(0.99), 990000));
+  for (int64_t i = 1; i <= 500; ++i)
+    histogram.remove(LatencyHistogram::bucketOf(i * 1000));
+  REQUIRE(near(histogram.percentile(0.0), 501000));
+  REQUIRE(LatencyHistogram::bucketOf(int64_t(1) << 62) == LatencyHistogram::BucketCount - 1);
+}
+
+TEST_CASE("sampling keeps a rolling window and captures slow frames") {
+  auto profiler = profiling::initializeProfiling(4);
+  auto prefix = (std::filesystem::temp_directory_path() / "higanbana_test_spike_").string();
+  profiling::SamplingOptions options;
+  options.windowFrames = 4;
+  options.frameBudget = std::chrono::milliseconds(5);
+  options.spikeTracePrefix = prefix;
+  options.maxSpikeTraces = 1;
+  profiling::enableSampling(profiler.get(), options);
+  profiling::endProfilingFrame(profiler.get());
+
+  int overBudget = 0;
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      HIGAN_CPU_BRACKET("sampled work");
+    }
+    if (frame == 7)
+    {
+      HIGAN_CPU_BRACKET("slow work");
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    overBudget += profiling::endProfilingFrame(profiler.get()) ? 1 : 0;
+  }
+  REQUIRE(overBudget >= 1);
+
+  auto stats = profiling::samplingStatistics(profiler.get());
+  auto find = [&](const char* name) {
+    return std::find_if(stats.begin(), stats.end(), [&](const profiling::BracketStatistics& s) { return s.name == name; });
+  };
+  REQUIRE(find("frame") != stats.end());
+  REQUIRE(find("frame")->count == 4);
+  REQUIRE(find("sampled work") != stats.end());
+  REQUIRE(find("sampled work")->count == 12);
+  auto slow = find("slow work");
+  REQUIRE(slow != stats.end());
+  REQUIRE(slow->count == 1);
+  REQUIRE(slow->max >= 10000000);
+  REQUIRE(slow->p99 >= 9000000);
+
+  // frame 8 counting the first endProfilingFrame as frame 0
+  auto path = prefix + "8.htrace";
+  auto json = readAndConvert(path);
+  std::remove(path.c_str());
+  REQUIRE(count(json, "\"name\":\"slow work\"") == 1);
+  REQUIRE(count(json, "\"name\":\"sampled work\"") == 3);
+  profiling::disableSampling(profiler.get());
+  REQUIRE(!profiler->enabled);
+
+  // sampling on top of already enabled profiling leaves it enabled
+  profiling::enableProfiling();
+  profiling::enableSampling(profiler.get(), options);
+  profiling::disableSampling(profiler.get());
+  REQUIRE(profiler->enabled);
+  profiling::disableProfiling();
+
+  // sampling works on the instance it's given, not on whichever was initialized last
+  REQUIRE(!profiler->enabled);
+  auto newer = profiling::initializeProfiling(1);
+  profiling::enableSampling(profiler.get(), options);
+  REQUIRE(profiler->enabled);
+  REQUIRE(!newer->enabled);
+  profiling::disableSampling(profiler.get());
+  REQUIRE(!profiler->enabled);
+  profiling::disableProfiling();
+}
@@ -2,6 +2,9 @@
 #include <higanbana/core/sort/radix_sort.hpp>
 #include <higanbana/core/sort/radix_sort_coro.hpp>
 #include <vector>
+#include <algorithm>
+#include <random>
+#include <limits>
 
 void radix_sort_10(std::vector<unsigned>& data) {
   auto copy = data;
@@ -163,4 +166,134 @@ TEST_CASE("thread radix sort fast long") {
   for (unsigned i = 0; i < data.size(); i++) {
     REQUIRE(control[i] == data[i]);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("thread radix sort big splits write combined") {
+  css::createThreadPool();
+
+  std::mt19937 gen32;
+  std::vector<unsigned> data;
+  for (int i = 0; i < 1000000; ++i) {
+    data.push_back(gen32());
+  }
+  auto control = data;
+  std::sort(control.begin(), control.end());
+
+  auto slow = data;
+  higanbana::radix_sort_task<8, 4>(slow).wait();
+  REQUIRE(slow == control);
+  higanbana::radix_sort_task_fast<8, 4>(data).wait();
+  REQUIRE(data == control);
+}
+TEST_CASE("thread radix sort 64bit keys") {
+  css::createThreadPool();
+
+  std::mt19937_64 gen64;
+  std::vector<uint64_t> data{0, ~0ull, 5, 1ull << 63, 12459872};
+  for (int i = 0; i < 1000000; ++i) {
+    data.push_back(gen64());
+  }
+  auto control = data;
+  std::sort(control.begin(), control.end());
+
+  std::vector<uint64_t> scratch;
+  higanbana::radix_sort_task_u64<8, 8>(data, scratch).wait();
+  REQUIRE(data == control);
+
+  // small inputs and uneven splits
+  for (size_t size : {0, 1, 2, 7, 33}) {
+    std::vector<uint64_t> small(data.end() - size, data.end());
+    std::reverse(small.begin(), small.end());
+    higanbana::radix_sort_task_u64<11, 4>(small, scratch).wait();
+    REQUIRE(std::is_sorted(small.begin(), small.end()));
+  }
+}
+
+TEST_CASE("thread radix sort 64bit pairs is stable and skips uniform digits") {
+  css::createThreadPool();
+
+  // draw call like keys, top bits are the same for everyone
+  std::mt19937 gen32;
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> values;
+  for (uint32_t i = 0; i < 300000; ++i) {
+    keys.push_back((0xabcdull << 48) | (gen32() % 1000));
+    values.push_back(i);
+  }
+  std::vector<std::pair<uint64_t, uint32_t>> control;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    control.emplace_back(keys[i], values[i]);
+  }
+  std::stable_sort(control.begin(), control.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+  std::vector<uint64_t> keyScratch;
+  std::vector<uint32_t> valueScratch;
+  higanbana::radix_sort_task_pairs<8, 6>(keys, values, keyScratch, valueScratch).wait();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    REQUIRE(keys[i] == control[i].first);
+    REQUIRE(values[i] == control[i].second);
+  }
+
+  // everything has the same key, all passes are skipped and order doesn't change
+  std::vector<uint64_t> same(1000, 42);
+  std::vector<uint32_t> order(1000);
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  higanbana::radix_sort_task_pairs<16, 8>(same, order, keyScratch, valueScratch).wait();
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    REQUIRE(order[i] == i);
+  }
+}
+
+TEST_CASE("thread radix sort float and signed keys") {
+  css::createThreadPool();
+
+  std::mt19937 gen32;
+  std::uniform_real_distribution<float> distances(-1000.f, 1000.f);
+  std::vector<float> depths{0.f, -0.f, 1.f, -1.f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::max()};
+  std::vector<int32_t> signedKeys{0, -1, 1, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()};
+  for (int i = 0; i < 1000000; ++i) {
+    depths.push_back(distances(gen32));
+    signedKeys.push_back(static_cast<int32_t>(gen32()));
+  }
+
+  auto depthControl = depths;
+  std::sort(depthControl.begin(), depthControl.end());
+  std::vector<float> depthScratch;
+  higanbana::radix_sort_task_keys<8, 8>(depths, depthScratch).wait();
+  for (size_t i = 0; i < depths.size(); ++i) {
+    REQUIRE(depths[i] == depthControl[i]);
+  }
+
+  auto signedControl = signedKeys;
+  std::sort(signedControl.begin(), signedControl.end());
+  std::vector<int32_t> signedScratch;
+  higanbana::radix_sort_task_keys<11, 4>(signedKeys, signedScratch).wait();
+  REQUIRE(signedKeys == signedControl);
+}
+
+TEST_CASE("thread radix sort big pairs go through write combining") {
+  css::createThreadPool();
+
+  std::mt19937_64 gen64;
+  std::vector<uint64_t> keys;
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < 2000000; ++i) {
+    keys.push_back(gen64() % 100000);
+    values.push_back(i);
+  }
+  std::vector<std::pair<uint64_t, uint64_t>> control;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    control.emplace_back(keys[i], values[i]);
+  }
+  std::sort(control.begin(), control.end());
+
+  std::vector<uint64_t> keyScratch;
+  std::vector<uint64_t> valueScratch;
+  higanbana::radix_sort_task_pairs<8, 4>(keys, values, keyScratch, valueScratch).wait();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    REQUIRE(keys[i] == control[i].first);
+    REQUIRE(values[i] == control[i].second);
+  }
+}
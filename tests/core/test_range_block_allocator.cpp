@@ -0,0 +1,139 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/system/RangeBlockAllocator.hpp>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using higanbana::RangeBlockAllocator;
+using higanbana::FixedRangeBlock;
+
+namespace
+{
+// first fit on a plain bool array, what the allocator should agree with when single threaded.
+struct ReferenceBlocks
+{
+  std::vector<bool> used;
+  int64_t find(int64_t count) const
+  {
+    int64_t run = 0;
+    for (int64_t i = 0; i < static_cast<int64_t>(used.size()); ++i)
+    {
+      run = used[i] ? 0 : run + 1;
+      if (run == count)
+        return i - count + 1;
+    }
+    return -1;
+  }
+  int64_t largest() const
+  {
+    int64_t run = 0, best = 0;
+    for (bool u : used)
+    {
+      run = u ? 0 : run + 1;
+      best = std::max(best, run);
+    }
+    return best;
+  }
+};
+}
+
+TEST_CASE("range block allocator basics") {
+  RangeBlockAllocator allocator(100);
+  REQUIRE(allocator.largestFreeBlockSize() == 100);
+  auto a = allocator.allocate(10);
+  auto b = allocator.allocate(64);
+  auto c = allocator.allocate(26);
+  REQUIRE(a.offset == 0);
+  REQUIRE(b.offset == 10);
+  REQUIRE(c.offset == 74);
+  REQUIRE(allocator.allocate(1).offset == -1);
+  REQUIRE(allocator.freespace() == 0);
+  allocator.release(b);
+  REQUIRE(allocator.largestFreeBlockSize() == 64);
+  REQUIRE(allocator.countContinuosFreeBlocks() == 1);
+  REQUIRE(allocator.allocate(65).offset == -1);
+  auto d = allocator.allocate(64);
+  REQUIRE(d.offset == 10);
+  allocator.release(a);
+  allocator.release(c);
+  allocator.release(d);
+  REQUIRE(allocator.largestFreeBlockSize() == 100);
+  REQUIRE(allocator.allocate(100).offset == 0);
+}
+
+TEST_CASE("range block allocator matches first fit") {
+  constexpr int64_t blocks = 20000;
+  RangeBlockAllocator allocator(blocks);
+  ReferenceBlocks reference{std::vector<bool>(blocks, false)};
+  std::mt19937 gen(5);
+  std::vector<FixedRangeBlock> live;
+  for (int i = 0; i < 20000; ++i) {
+    if (live.empty() || gen() % 5 < 3) {
+      int64_t count = 1 + ((gen() % 16 == 0) ? gen() % 5000 : gen() % 100);
+      auto expected = reference.find(count);
+      auto block = allocator.allocate(count);
+      REQUIRE(block.offset == expected);
+      if (block.offset == -1)
+        continue;
+      for (int64_t k = 0; k < count; ++k)
+        reference.used[block.offset + k] = true;
+      live.push_back(block);
+    }
+    else {
+      auto index = gen() % live.size();
+      for (int64_t k = 0; k < live[index].size; ++k)
+        reference.used[live[index].offset + k] = false;
+      allocator.release(live[index]);
+      live[index] = live.back();
+      live.pop_back();
+    }
+    if (i % 1000 == 0)
+      REQUIRE(static_cast<int64_t>(allocator.largestFreeBlockSize()) == reference.largest());
+  }
+}
+
+TEST_CASE("range block allocator concurrent allocations don't overlap") {
+  constexpr int64_t blocks = 1 << 16;
+  constexpr int threadCount = 4;
+  RangeBlockAllocator allocator(blocks);
+  std::vector<std::atomic<int>> owners(blocks);
+  std::atomic<size_t> overlaps = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      std::vector<FixedRangeBlock> live;
+      for (int i = 0; i < 20000; ++i) {
+        if (live.empty() || gen() % 2) {
+          auto block = allocator.allocate(1 + gen() % 300);
+          if (block.offset == -1)
+            continue;
+          for (int64_t k = 0; k < block.size; ++k)
+            overlaps += owners[block.offset + k].exchange(t + 1) != 0;
+          live.push_back(block);
+        }
+        else {
+          auto index = gen() % live.size();
+          auto block = live[index];
+          for (int64_t k = 0; k < block.size; ++k)
+            overlaps += owners[block.offset + k].exchange(0) != t + 1;
+          allocator.release(block);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+      for (auto& block : live) {
+        for (int64_t k = 0; k < block.size; ++k)
+          owners[block.offset + k] = 0;
+        allocator.release(block);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  REQUIRE(overlaps == 0);
+  REQUIRE(allocator.freespace() == blocks);
+  REQUIRE(allocator.largestFreeBlockSize() == blocks);
+}
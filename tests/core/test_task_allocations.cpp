@@ -0,0 +1,98 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/system/LBS.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace
+{
+  std::atomic<size_t> g_allocations = 0;
+}
+
+// the replacements pair malloc with free, gcc only sees operator new on one side once they are inlined
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size)
+{
+  g_allocations++;
+  if (void* ptr = std::malloc(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+TEST_CASE("enqueuing and splitting parallel fors doesn't allocate")
+{
+  using namespace higanbana;
+  LBS lbs(4);
+  constexpr size_t testSize = 100000;
+  std::vector<int> v(testSize, 0);
+  auto run = [&](Requirements&& waitFor)
+  {
+    lbs.addParallelFor<16>("pf", {}, {}, 0, testSize, [&v](size_t i)
+    {
+      v[i]++;
+    });
+    lbs.addParallelFor<16>("pf2", { }, {}, 0, testSize, [&v](size_t i)
+    {
+      v[i]++;
+    });
+    lbs.sleepTillKeywords(std::move(waitFor));
+  };
+  // warmup fills the pools and scratch buffers, gated so that waiter lists get used too
+  for (int i = 0; i < 4; ++i)
+  {
+    lbs.addTask("gate", { "open" }, {}, [](size_t) {});
+    lbs.addParallelFor<16>("pf", { "gate" }, {}, 0, testSize, [](size_t) {});
+    lbs.addParallelFor<16>("pf2", { "gate" }, {}, 0, testSize, [](size_t) {});
+    lbs.addTask("joined", { "pf", "pf2" }, {}, [](size_t) {});
+    lbs.addTask("open", [](size_t) {});
+    lbs.sleepTillKeywords({ "joined" });
+    run({ "pf", "pf2" });
+  }
+
+  for (int i = 0; i < 8; ++i)
+  {
+    Requirements waitFor = { "pf", "pf2" };
+    size_t before = g_allocations.load();
+    run(std::move(waitFor));
+    size_t after = g_allocations.load();
+    REQUIRE(after - before == 0);
+  }
+  for (auto& it : v)
+    REQUIRE(it == 24);
+}
+
+TEST_CASE("big callables still work through heap fallback")
+{
+  using namespace higanbana;
+  LBS lbs(2);
+  struct Big
+  {
+    size_t padding[32] = {};
+  } big;
+  big.padding[31] = 7;
+  std::atomic<size_t> sum = 0;
+  lbs.addParallelFor<4>("big", {}, {}, 0, 1000, [big, &sum](size_t)
+  {
+    sum += big.padding[31];
+  });
+  lbs.sleepTillKeywords({ "big" });
+  REQUIRE(sum.load() == 7000);
+}
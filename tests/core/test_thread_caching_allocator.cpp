@@ -0,0 +1,121 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/allocators/thread_caching_allocator.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using higanbana::ThreadCachingHeap;
+
+TEST_CASE("thread caching heap basic sizes") {
+  for (size_t size : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(17), size_t(100), size_t(4000), size_t(32 * 1024), size_t(32 * 1024 + 1), size_t(500000), size_t(3 * 1024 * 1024)}) {
+    void* ptr = ThreadCachingHeap::allocate(size);
+    REQUIRE(ptr);
+    REQUIRE(reinterpret_cast<uintptr_t>(ptr) % ThreadCachingHeap::Alignment == 0);
+    REQUIRE(ThreadCachingHeap::allocationSize(ptr) >= size);
+    memset(ptr, 0xab, size);
+    ThreadCachingHeap::deallocate(ptr);
+  }
+  ThreadCachingHeap::deallocate(nullptr);
+}
+
+TEST_CASE("thread caching heap reuses cached blocks") {
+  void* a = ThreadCachingHeap::allocate(48);
+  ThreadCachingHeap::deallocate(a);
+  void* b = ThreadCachingHeap::allocate(40); // same size class
+  REQUIRE(a == b);
+  ThreadCachingHeap::deallocate(b);
+}
+
+TEST_CASE("thread caching heap large allocations go back to the os") {
+  size_t before = ThreadCachingHeap::mappedBytes();
+  void* big = ThreadCachingHeap::allocate(16 * 1024 * 1024);
+  REQUIRE(big);
+  REQUIRE(ThreadCachingHeap::mappedBytes() >= before + 16 * 1024 * 1024);
+  ThreadCachingHeap::deallocate(big);
+  REQUIRE(ThreadCachingHeap::mappedBytes() == before);
+}
+
+TEST_CASE("thread caching heap frees from other threads") {
+  constexpr size_t count = 20000;
+  std::vector<unsigned char*> ptrs(count);
+  std::thread producer([&]() {
+    for (size_t i = 0; i < count; ++i) {
+      size_t size = 1 + (i * 7919) % 2000;
+      ptrs[i] = reinterpret_cast<unsigned char*>(ThreadCachingHeap::allocate(size));
+      memset(ptrs[i], static_cast<int>(i & 0xff), size);
+    }
+  });
+  producer.join();
+  // producer has exited, its arena is idle but the memory is still valid
+  size_t broken = 0;
+  std::thread consumer([&]() {
+    for (size_t i = 0; i < count; ++i) {
+      size_t size = 1 + (i * 7919) % 2000;
+      for (size_t k = 0; k < size; ++k)
+        broken += ptrs[i][k] != static_cast<unsigned char>(i & 0xff);
+      ThreadCachingHeap::deallocate(ptrs[i]);
+    }
+  });
+  consumer.join();
+  REQUIRE(broken == 0);
+}
+
+TEST_CASE("thread caching heap multithreaded stress") {
+  constexpr int threadCount = 4;
+  constexpr int rounds = 50000;
+  // every thread hands half of its blocks to the next thread to free
+  std::vector<std::vector<std::pair<unsigned char*, size_t>>> handoff(threadCount);
+  std::vector<std::atomic<bool>> ready(threadCount);
+  std::atomic<size_t> broken = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      std::vector<std::pair<unsigned char*, size_t>> live;
+      for (int i = 0; i < rounds; ++i) {
+        if (live.empty() || gen() % 2) {
+          size_t size = 1 + ((gen() % 32 == 0) ? gen() % 200000 : gen() % 512);
+          auto ptr = reinterpret_cast<unsigned char*>(ThreadCachingHeap::allocate(size));
+          memset(ptr, t + 1, size);
+          live.emplace_back(ptr, size);
+        }
+        else {
+          size_t index = gen() % live.size();
+          auto block = live[index];
+          broken += block.first[0] != t + 1 || block.first[block.second - 1] != t + 1;
+          ThreadCachingHeap::deallocate(block.first);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+      for (size_t i = 0; i < live.size(); i += 2)
+        handoff[t].push_back(live[i]);
+      for (size_t i = 1; i < live.size(); i += 2)
+        ThreadCachingHeap::deallocate(live[i].first);
+      ready[t] = true;
+      int next = (t + 1) % threadCount;
+      while (!ready[next])
+        std::this_thread::yield();
+      for (auto& block : handoff[next]) {
+        broken += block.first[0] != next + 1 || block.first[block.second - 1] != next + 1;
+        ThreadCachingHeap::deallocate(block.first);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  REQUIRE(broken == 0);
+}
+
+TEST_CASE("thread caching std allocator") {
+  std::vector<int, higanbana::ThreadCachingAllocator<int>> values;
+  for (int i = 0; i < 100000; ++i)
+    values.push_back(i);
+  long long sum = 0;
+  for (auto v : values)
+    sum += v;
+  REQUIRE(sum == 100000ll * 99999ll / 2);
+}
@@ -2,6 +2,9 @@
 #include <higanbana/core/platform/definitions.hpp>
 #include <higanbana/core/system/heap_allocator.hpp>
 
+#include <map>
+#include <random>
+
 struct Block {
   uint64_t offset;
   uint64_t size;
@@ -429,4 +432,62 @@ TEST_CASE("failed real world case 1") {
   higanbana::HeapAllocator tlsf(50331648, 131072);
   auto block = tlsf.allocate(50200588, 131072);
   REQUIRE(block);
-}
\ No newline at end of file
+}
+TEST_CASE("random allocations don't overlap and coalesce back") {
+  constexpr uint64_t heapSize = 64ull * 1024 * 1024;
+  higanbana::HeapAllocator tlsf(heapSize, 256);
+  std::mt19937 gen(1337);
+  std::vector<higanbana::RangeBlock> live;
+  std::map<uint64_t, uint64_t> ranges; // offset -> end
+  size_t overlaps = 0;
+  for (int i = 0; i < 100000; ++i) {
+    if (live.empty() || gen() % 3 != 0) {
+      uint64_t size = 1 + ((gen() % 16 == 0) ? gen() % (1024 * 1024) : gen() % 8192);
+      uint64_t alignment = 1ull << (gen() % 17);
+      auto block = tlsf.allocate(size, alignment);
+      if (!block)
+        continue;
+      auto b = block.value();
+      REQUIRE(b.size >= size);
+      REQUIRE(b.offset % alignment == 0);
+      REQUIRE(b.offset + b.size <= heapSize);
+      auto next = ranges.lower_bound(b.offset);
+      if (next != ranges.end() && next->first < b.offset + b.size)
+        ++overlaps;
+      if (next != ranges.begin() && std::prev(next)->second > b.offset)
+        ++overlaps;
+      ranges[b.offset] = b.offset + b.size;
+      live.push_back(b);
+    }
+    else {
+      auto index = gen() % live.size();
+      ranges.erase(live[index].offset);
+      tlsf.free(live[index]);
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  REQUIRE(overlaps == 0);
+  for (auto& block : live)
+    tlsf.free(block);
+  REQUIRE(tlsf.size_allocated() == 0);
+  REQUIRE(tlsf.findLargestAllocation() == heapSize);
+  auto all = tlsf.allocate(heapSize);
+  REQUIRE(all);
+}
+
+TEST_CASE("resize extends the last free block") {
+  higanbana::HeapAllocator tlsf(1024, 1);
+  auto a = tlsf.allocate(512);
+  auto b = tlsf.allocate(512);
+  REQUIRE(a);
+  REQUIRE(b);
+  REQUIRE_FALSE(tlsf.allocate(1));
+  tlsf.resize(2048);
+  REQUIRE(tlsf.max_size() == 2048);
+  REQUIRE(tlsf.size() == 1024);
+  tlsf.free(b.value());
+  auto c = tlsf.allocate(1536);
+  REQUIRE(c);
+  REQUIRE(c.value().offset == 512);
+}
@@ -1,6 +1,9 @@
 #include <catch2/catch_all.hpp>
 #include <higanbana/core/platform/definitions.hpp>
 #include <higanbana/core/allocators/heap_allocator_raw.hpp>
+#include <random>
+#include <vector>
+#include <cstring>
 //#include <css/utils/dynamic_allocator.hpp>
 
 TEST_CASE("some basic allocation tests") {
@@ -209,3 +212,41 @@ TEST_CASE("failed real world case 1") {
   REQUIRE(block);
   free(heap);
 }*/
+
+TEST_CASE("random allocations keep blocks intact and merge back") {
+  constexpr size_t size = 4 * 1024 * 1024;
+  void* heap = malloc(size);
+  higanbana::HeapAllocatorRaw tlsf(heap, size);
+  std::mt19937 gen(42);
+  struct Live { unsigned char* ptr; size_t size; unsigned char fill; };
+  std::vector<Live> live;
+  for (int i = 0; i < 200000; ++i) {
+    if (live.empty() || gen() % 3 != 0) {
+      size_t bytes = 1 + gen() % ((gen() % 16 == 0) ? 65536 : 256);
+      auto ptr = reinterpret_cast<unsigned char*>(tlsf.allocate(bytes));
+      if (!ptr)
+        continue;
+      REQUIRE(reinterpret_cast<uintptr_t>(ptr) % 16 == 0);
+      REQUIRE(higanbana::HeapAllocatorRaw::allocationSize(ptr) >= bytes);
+      unsigned char fill = static_cast<unsigned char>(gen());
+      memset(ptr, fill, bytes);
+      live.push_back({ptr, bytes, fill});
+    }
+    else {
+      size_t index = gen() % live.size();
+      auto block = live[index];
+      for (size_t k = 0; k < block.size; ++k)
+        REQUIRE(block.ptr[k] == block.fill);
+      tlsf.free(block.ptr);
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  for (auto& block : live)
+    tlsf.free(block.ptr);
+  REQUIRE(tlsf.size_allocated() == 0);
+  // everything merged back to one block
+  auto all = tlsf.allocate(size - higanbana::HeapAllocatorRaw::headerSize());
+  REQUIRE(all);
+  free(heap);
+}
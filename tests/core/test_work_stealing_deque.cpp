@@ -0,0 +1,72 @@
+#include <catch2/catch_all.hpp>
+#include <higanbana/core/system/WorkStealingDeque.hpp>
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+TEST_CASE("owner push and pop is lifo")
+{
+  higanbana::WorkStealingDeque<int> deque(4);
+  for (int i = 0; i < 100; ++i)
+    deque.push(i);
+  REQUIRE(deque.size() == 100);
+  int value = -1;
+  for (int i = 99; i >= 0; --i)
+  {
+    REQUIRE(deque.pop(value));
+    REQUIRE(value == i);
+  }
+  REQUIRE_FALSE(deque.pop(value));
+  REQUIRE(deque.empty());
+}
+
+TEST_CASE("steal takes the oldest")
+{
+  higanbana::WorkStealingDeque<int> deque(4);
+  for (int i = 0; i < 10; ++i)
+    deque.push(i);
+  int value = -1;
+  REQUIRE(deque.steal(value));
+  REQUIRE(value == 0);
+  REQUIRE(deque.pop(value));
+  REQUIRE(value == 9);
+}
+
+TEST_CASE("every pushed item is taken exactly once with thieves")
+{
+  constexpr int itemCount = 200000;
+  constexpr int thiefCount = 3;
+  higanbana::WorkStealingDeque<int> deque(16);
+  std::vector<std::atomic<int>> seen(itemCount);
+  for (auto& it : seen)
+    it = 0;
+  std::atomic<bool> done = false;
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < thiefCount; ++t)
+  {
+    thieves.emplace_back([&]()
+    {
+      int value;
+      while (!done.load() || !deque.empty())
+      {
+        if (deque.steal(value))
+          seen[value]++;
+      }
+    });
+  }
+  int value;
+  for (int i = 0; i < itemCount; ++i)
+  {
+    deque.push(i);
+    if (i % 3 == 0 && deque.pop(value))
+      seen[value]++;
+  }
+  while (deque.pop(value))
+    seen[value]++;
+  done = true;
+  for (auto& it : thieves)
+    it.join();
+  for (auto& it : seen)
+    REQUIRE(it.load() == 1);
+}
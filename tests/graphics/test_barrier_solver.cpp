@@ -0,0 +1,198 @@
+#include <higanbana/graphics/common/barrier_solver.hpp>
+#include <catch2/catch_all.hpp>
+
+#include <thread>
+
+using namespace higanbana;
+using namespace higanbana::backend;
+
+namespace
+{
+ViewResourceHandle view(uint64_t id, ResourceType type)
+{
+  ViewResourceHandle view;
+  view.resource = ResourceHandle(id, 0, type, 1, false).rawValue;
+  view.subresourceRange(0, 1, 0, 1);
+  return view;
+}
+
+ResourceState state(AccessUsage usage, AccessStage stage, TextureLayout layout = TextureLayout::General)
+{
+  return ResourceState(usage, stage, layout, QueueType::Graphics);
+}
+
+struct Globals
+{
+  HandleVector<ResourceState> buffers;
+  HandleVector<TextureResourceState> textures;
+  Globals(int textureCount)
+  {
+    for (int i = 0; i < textureCount; ++i)
+    {
+      auto& tex = textures[view(i, ResourceType::Texture).resourceHandle()];
+      tex.mips = 1;
+      tex.states.resize(1);
+    }
+  }
+};
+
+// every list ping pongs a few buffers and textures between compute writes and graphics reads
+void recordList(BarrierSolver& solver, int listIndex, int draws)
+{
+  for (int i = 0; i < draws; ++i)
+  {
+    auto draw = solver.addDrawCall();
+    bool write = (i + listIndex) % 2 == 0;
+    auto usage = write ? AccessUsage::ReadWrite : AccessUsage::Read;
+    auto stage = write ? AccessStage::Compute : AccessStage::Graphics;
+    solver.addBuffer(draw, view((i + listIndex) % 8, ResourceType::Buffer), state(usage, stage));
+    solver.addTexture(draw, view((i * 3 + listIndex) % 4, ResourceType::Texture), state(usage, stage, write ? TextureLayout::General : TextureLayout::ShaderReadOnly));
+  }
+}
+
+struct Recorded
+{
+  vector<BufferBarrier> buffers;
+  vector<ImageBarrier> images;
+};
+
+Recorded collect(BarrierSolver& solver)
+{
+  Recorded rec;
+  for (auto&& info : solver.barrierInfos())
+  {
+    auto barriers = solver.runBarrier(info);
+    for (auto&& b : barriers.buffers)
+      rec.buffers.push_back(b);
+    for (auto&& b : barriers.textures)
+      rec.images.push_back(b);
+  }
+  return rec;
+}
+}
+
+TEST_CASE("barriers between lists use the previous list's last state") {
+  Globals globals(1);
+  BarrierSolver first(globals.buffers, globals.textures);
+  BarrierSolver second(globals.buffers, globals.textures);
+  auto buffer = view(0, ResourceType::Buffer);
+  auto uav = state(AccessUsage::ReadWrite, AccessStage::Compute);
+  auto srv = state(AccessUsage::Read, AccessStage::Graphics);
+
+  first.addBuffer(first.addDrawCall(), buffer, uav);
+  second.addBuffer(second.addDrawCall(), buffer, srv);
+
+  // local passes don't depend on each other
+  std::thread worker([&]{ second.localBarrierPass1(false); });
+  first.localBarrierPass1(false);
+  worker.join();
+
+  first.globalBarrierPass2();
+  second.globalBarrierPass2();
+
+  auto rec = collect(second);
+  REQUIRE(rec.buffers.size() == 1);
+  REQUIRE(rec.buffers[0].before.usage == AccessUsage::ReadWrite);
+  REQUIRE(rec.buffers[0].before.stage == AccessStage::Compute);
+  REQUIRE(rec.buffers[0].after.usage == AccessUsage::Read);
+  REQUIRE(globals.buffers[buffer.resourceHandle()].usage == AccessUsage::Read);
+}
+
+TEST_CASE("concurrent local passes produce the same barriers as serial solving") {
+  constexpr int lists = 16;
+  constexpr int draws = 64;
+  Globals serialGlobals(4);
+  Globals parallelGlobals(4);
+  vector<BarrierSolver> serial;
+  vector<BarrierSolver> parallel;
+  for (int i = 0; i < lists; ++i)
+  {
+    serial.emplace_back(serialGlobals.buffers, serialGlobals.textures);
+    parallel.emplace_back(parallelGlobals.buffers, parallelGlobals.textures);
+    recordList(serial.back(), i, draws);
+    recordList(parallel.back(), i, draws);
+  }
+
+  for (auto&& solver : serial)
+  {
+    solver.localBarrierPass1(false);
+    solver.globalBarrierPass2();
+  }
+
+  vector<std::thread> workers;
+  for (int t = 0; t < 4; ++t)
+  {
+    workers.emplace_back([&, t]{
+      for (int i = t; i < lists; i += 4)
+        parallel[i].localBarrierPass1(false);
+    });
+  }
+  for (auto&& worker : workers)
+    worker.join();
+  for (auto&& solver : parallel)
+    solver.globalBarrierPass2();
+
+  for (int i = 0; i < lists; ++i)
+  {
+    auto a = collect(serial[i]);
+    auto b = collect(parallel[i]);
+    REQUIRE(a.buffers.size() == b.buffers.size());
+    REQUIRE(a.images.size() == b.images.size());
+    for (size_t k = 0; k < a.buffers.size(); ++k)
+    {
+      REQUIRE(a.buffers[k].before.raw == b.buffers[k].before.raw);
+      REQUIRE(a.buffers[k].after.raw == b.buffers[k].after.raw);
+    }
+    for (size_t k = 0; k < a.images.size(); ++k)
+    {
+      REQUIRE(a.images[k].before.raw == b.images[k].before.raw);
+      REQUIRE(a.images[k].after.raw == b.images[k].after.raw);
+    }
+  }
+}
+
+TEST_CASE("reused solver only carries state through the global tables") {
+  HandleVector<ResourceState> buffers;
+  HandleVector<TextureResourceState> textures;
+  ViewResourceHandle whole = view(0, ResourceType::Texture);
+  auto& tex = textures[whole.resourceHandle()];
+  tex.mips = 4;
+  tex.states.resize(4);
+
+  auto mipView = [&](int mip) {
+    auto v = whole;
+    v.subresourceRange(mip, 1, 0, 1);
+    return v;
+  };
+  auto uav = state(AccessUsage::ReadWrite, AccessStage::Compute, TextureLayout::General);
+  auto srv = state(AccessUsage::Read, AccessStage::Graphics, TextureLayout::ShaderReadOnly);
+
+  BarrierSolver solver(buffers, textures);
+  // frame 1 writes mip 2 only
+  solver.reset(&buffers, &textures);
+  solver.addTexture(solver.addDrawCall(), mipView(2), uav);
+  solver.localBarrierPass1(false);
+  solver.globalBarrierPass2();
+  REQUIRE(textures[whole.resourceHandle()].states[2].layout == TextureLayout::General);
+  REQUIRE(textures[whole.resourceHandle()].states[1].layout == TextureLayout::Undefined);
+
+  // frame 2 reads mip 1 and 2, the local state of mip 2 from frame 1 must not leak
+  solver.reset(&buffers, &textures);
+  auto draw = solver.addDrawCall();
+  solver.addTexture(draw, mipView(1), srv);
+  solver.addTexture(draw, mipView(2), srv);
+  solver.localBarrierPass1(false);
+  solver.globalBarrierPass2();
+
+  auto rec = collect(solver);
+  REQUIRE(rec.images.size() == 2);
+  REQUIRE(rec.images[0].startMip == 1);
+  REQUIRE(rec.images[0].before.layout == TextureLayout::Undefined);
+  REQUIRE(rec.images[1].startMip == 2);
+  REQUIRE(rec.images[1].before.layout == TextureLayout::General);
+  REQUIRE(rec.images[1].before.usage == AccessUsage::ReadWrite);
+  // untouched subresources keep their global state
+  REQUIRE(textures[whole.resourceHandle()].states[0].layout == TextureLayout::Undefined);
+  REQUIRE(textures[whole.resourceHandle()].states[3].layout == TextureLayout::Undefined);
+  REQUIRE(textures[whole.resourceHandle()].states[1].layout == TextureLayout::ShaderReadOnly);
+}
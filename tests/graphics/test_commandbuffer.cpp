@@ -9,7 +9,7 @@ using namespace higanbana::backend;
 TEST_CASE("insert 1") {
   CommandBuffer buffer(1024);
   std::string text = "testBlock";
-  buffer.insert<gfxpacket::RenderBlock>(makeMemView(text));
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
   auto itr = buffer.begin();
   auto* header = (*itr);
   REQUIRE(header->type == PacketType::RenderBlock);
@@ -27,7 +27,7 @@ TEST_CASE("insert 1") {
 TEST_CASE("insert 1 and copy") {
   CommandBuffer buffer(1024);
   std::string text = "testBlock";
-  buffer.insert<gfxpacket::RenderBlock>(makeMemView(text));
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
 
   CommandBuffer buffer2 = std::move(buffer);
 
@@ -42,7 +42,7 @@ TEST_CASE("insert 1 and copy") {
 TEST_CASE("insert 1 and resize") {
   CommandBuffer buffer(1);
   std::string text = "testBlock";
-  buffer.insert<gfxpacket::RenderBlock>(makeMemView(text));
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
 
   auto itr = buffer.begin();
   auto* header = (*itr);
@@ -58,7 +58,7 @@ TEST_CASE("insert 10 resizes") {
   constexpr int pcount = 5;
   for (int i = 0; i < pcount; ++i)
   {
-    buffer.insert<gfxpacket::RenderBlock>(makeMemView(text));
+    buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
 
     auto itr = buffer.begin();
     auto* header = (*itr);
@@ -70,4 +70,86 @@ TEST_CASE("insert 10 resizes") {
     }
     REQUIRE(header->type == PacketType::EndOfPackets);
   }
-}
\ No newline at end of file
+}
+TEST_CASE("packets span multiple pages") {
+  CommandBuffer buffer;
+  std::string text = "testBlock";
+  constexpr int pcount = 20000;
+  for (int i = 0; i < pcount; ++i)
+  {
+    buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
+  }
+  REQUIRE(buffer.size() == pcount);
+  REQUIRE(buffer.maxSizeBytes() > commandpages::PageSize);
+
+  int count = 0;
+  for (auto iter = buffer.begin(); (*iter)->type != PacketType::EndOfPackets; iter++)
+  {
+    auto& packet = (*iter)->data<gfxpacket::RenderBlock>();
+    REQUIRE(std::string(packet.name.convertToMemView().data()) == text);
+    ++count;
+  }
+  REQUIRE(count == pcount);
+  REQUIRE(buffer.begin() != buffer.end());
+}
+
+TEST_CASE("small buffers start on a small page") {
+  CommandBuffer buffer;
+  REQUIRE(buffer.maxSizeBytes() == commandpages::SmallPageSize);
+  for (int i = 0; i < 1000; ++i)
+    buffer.insert<gfxpacket::Draw>(3u, 1u, 0u, 0u);
+  REQUIRE(buffer.maxSizeBytes() == commandpages::SmallPageSize + commandpages::PageSize);
+  buffer.reset();
+  REQUIRE(buffer.maxSizeBytes() == commandpages::SmallPageSize);
+}
+
+TEST_CASE("packet larger than a page") {
+  CommandBuffer buffer;
+  std::string small = "small";
+  std::string text(commandpages::PageSize - 16, 'x');
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(small));
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(text));
+  buffer.insert<gfxpacket::RenderBlock>(MemView<char>(small));
+
+  auto itr = buffer.begin();
+  REQUIRE(std::string((*itr)->data<gfxpacket::RenderBlock>().name.convertToMemView().data()) == small);
+  itr++;
+  REQUIRE(std::string((*itr)->data<gfxpacket::RenderBlock>().name.convertToMemView().data()) == text);
+  itr++;
+  REQUIRE(std::string((*itr)->data<gfxpacket::RenderBlock>().name.convertToMemView().data()) == small);
+  itr++;
+  REQUIRE((*itr)->type == PacketType::EndOfPackets);
+}
+
+TEST_CASE("reset recycles pages") {
+  CommandBuffer buffer;
+  auto record = [&]() {
+    buffer.reset();
+    for (int i = 0; i < 50000; ++i)
+      buffer.insert<gfxpacket::Draw>(3u, 1u, 0u, 0u);
+  };
+  record();
+  auto pages = commandpages::allocatedPages();
+  for (int frame = 0; frame < 4; ++frame)
+    record();
+  REQUIRE(commandpages::allocatedPages() == pages);
+  REQUIRE(buffer.size() == 50000);
+}
+
+TEST_CASE("append across pages") {
+  CommandBuffer a;
+  CommandBuffer b;
+  for (int i = 0; i < 10000; ++i)
+  {
+    a.insert<gfxpacket::Draw>(3u, 1u, 0u, 0u);
+    b.insert<gfxpacket::Draw>(6u, 1u, 0u, 0u);
+  }
+  a.append(b);
+  REQUIRE(a.size() == 20000);
+  int i = 0;
+  for (auto iter = a.begin(); (*iter)->type != PacketType::EndOfPackets; iter++, ++i)
+  {
+    REQUIRE((*iter)->data<gfxpacket::Draw>().vertexCountPerInstance == (i < 10000 ? 3u : 6u));
+  }
+  REQUIRE(i == 20000);
+}
@@ -0,0 +1,99 @@
+#include <higanbana/graphics/GraphicsCore.hpp>
+#include <higanbana/graphics/null/nullsubsystem.hpp>
+#include "graphics_config.hpp"
+#include <catch2/catch_all.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace higanbana;
+using namespace higanbana::backend;
+
+TEST_CASE("null backend is only listed when asked for") {
+  GraphicsSubsystem graphics(GraphicsApi::Null, "higanbana");
+  auto gpus = graphics.availableGpus();
+  REQUIRE(gpus.size() == 1);
+  REQUIRE(gpus[0].api == GraphicsApi::Null);
+  REQUIRE(gpus[0].type == DeviceType::Cpu);
+}
+
+TEST_CASE("null backend submits a graph") {
+  GraphicsSubsystem graphics(GraphicsApi::Null, "higanbana");
+  FileSystem fs(TESTS_FILESYSTEM_PATH, FileSystem::MappingMode::NoMapping);
+  auto dev = graphics.createDevice(fs, graphics.getVendorDevice(GraphicsApi::Null));
+
+  auto buffer = dev.createBuffer(ResourceDescriptor()
+    .setFormat(FormatType::Float32)
+    .setElementsCount(8));
+
+  auto graph = dev.createGraph();
+  for (int i = 0; i < 16; ++i)
+  {
+    auto node = graph.createPass("copy");
+    vector<float> arr = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f};
+    auto dyn = dev.dynamicBuffer<float>(makeMemView<float>(arr.data(), arr.size()));
+    node.copy(buffer, dyn);
+    graph.addPass(std::move(node));
+  }
+  auto readbackNode = graph.createPass("readback");
+  auto asyncReadback = readbackNode.readback(buffer);
+  graph.addPass(std::move(readbackNode));
+
+  REQUIRE_NOTHROW(dev.submit(graph));
+  dev.waitGpuIdle();
+  REQUIRE(asyncReadback.ready());
+  auto rb = asyncReadback.get();
+  REQUIRE(rb.view<float>().size() == 8);
+}
+
+TEST_CASE("null device simulates queue latency") {
+  using namespace std::chrono;
+  auto info = NullSubsystem().availableGpus(VendorID::All)[0];
+  auto device = std::make_shared<NullDevice>(info, milliseconds(20));
+
+  auto fence = device->createFence();
+  auto list = device->createGraphicsList();
+  vector<std::shared_ptr<CommandBufferImpl>> lists = {list};
+  auto start = steady_clock::now();
+  device->submitGraphics(lists, {}, {}, {}, {}, fence);
+  REQUIRE(!device->checkFence(fence));
+  device->waitFence(fence);
+  REQUIRE(steady_clock::now() - start >= milliseconds(20));
+  REQUIRE(device->checkFence(fence));
+
+  // timeline waits order submits across queues
+  auto timeline = device->createTimelineSemaphore();
+  vector<TimelineSemaphoreInfo> signal = {{timeline.get(), 1}};
+  vector<TimelineSemaphoreInfo> wait = {{timeline.get(), 1}};
+  device->submitCompute(lists, {}, {}, {}, signal, {});
+  device->submitDMA(lists, {}, {}, wait, {}, fence);
+  REQUIRE(device->completedValue(timeline) == 0);
+  device->waitTimeline(timeline, 1);
+  REQUIRE(device->completedValue(timeline) == 1);
+  REQUIRE(!device->checkFence(fence));
+  device->waitGpuIdle();
+  REQUIRE(device->checkFence(fence));
+  REQUIRE(device->submitCount() == 3);
+}
+
+TEST_CASE("null device fences can be polled while submitting") {
+  using namespace std::chrono;
+  auto info = NullSubsystem().availableGpus(VendorID::All)[0];
+  auto device = std::make_shared<NullDevice>(info, microseconds(50));
+
+  auto fence = device->createFence();
+  auto list = device->createGraphicsList();
+  vector<std::shared_ptr<CommandBufferImpl>> lists = {list};
+  std::atomic<bool> stop = false;
+  std::thread poller([&]{
+    while (!stop)
+      device->checkFence(fence);
+  });
+  for (int i = 0; i < 200; ++i)
+    device->submitGraphics(lists, {}, {}, {}, {}, fence);
+  device->waitFence(fence);
+  stop = true;
+  poller.join();
+  REQUIRE(device->checkFence(fence));
+}
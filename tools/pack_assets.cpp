@@ -0,0 +1,55 @@
+#include <higanbana/core/filesystem/asset_archive.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+// Packs a directory into an AssetArchive that FileSystem::mountArchive can mount.
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    printf("usage: %s <directory> <archive.hpak> [--compress] [--align bytes]\n", argv[0]);
+    return 1;
+  }
+  std::filesystem::path root = argv[1];
+  bool compress = false;
+  uint32_t alignment = 64;
+  for (int i = 3; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--compress")
+      compress = true;
+    else if (arg == "--align" && i + 1 < argc)
+      alignment = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+  }
+  if (!std::filesystem::is_directory(root))
+  {
+    printf("%s isn't a directory\n", argv[1]);
+    return 1;
+  }
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+  {
+    printf("alignment has to be a power of two\n");
+    return 1;
+  }
+
+  higanbana::AssetArchiveBuilder builder(alignment);
+  for (auto&& file : std::filesystem::recursive_directory_iterator(root))
+  {
+    if (!file.is_regular_file())
+      continue;
+    auto path = "/" + std::filesystem::relative(file.path(), root).generic_string();
+    builder.addFile(path, file.path().string(), compress);
+  }
+  higanbana::AssetArchiveBuilder::Stats stats;
+  if (!builder.write(argv[2], &stats))
+  {
+    printf("couldn't write %s\n", argv[2]);
+    return 1;
+  }
+  printf("wrote %s: %zu files, %.2fMB -> %.2fMB stored, %zu deduplicated, %zu compressed\n", argv[2], stats.files,
+    stats.bytes / 1024.0 / 1024.0, stats.storedBytes / 1024.0 / 1024.0, stats.deduplicated, stats.compressed);
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include <higanbana/core/profiling/trace_format.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Converts a binary profiling trace (.htrace) to chrome trace json.
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    printf("usage: %s profiling.htrace [profiling.json]\n", argv[0]);
+    return 1;
+  }
+  std::string input = argv[1];
+  std::string output = argc > 2 ? argv[2] : input + ".json";
+
+  std::ifstream file(input, std::ios::binary);
+  if (!file)
+  {
+    printf("couldn't open %s\n", input.c_str());
+    return 1;
+  }
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::string json;
+  if (!higanbana::profiling::convertTraceToChromeJson(higanbana::MemView<const uint8_t>(bytes.data(), bytes.size()), json))
+  {
+    printf("%s isn't a profiling trace\n", input.c_str());
+    return 1;
+  }
+  std::ofstream out(output, std::ios::binary);
+  out.write(json.data(), json.size());
+  printf("wrote %s\n", output.c_str());
+  return out ? 0 : 1;
+}